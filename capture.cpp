@@ -0,0 +1,430 @@
+#include "capture.hpp"
+
+#include "nmea0183.hpp"
+
+#include <atomic>
+#include <mutex>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const char     FileMagic [8]  = { 'G', 'P', 'S', 'C', 'A', 'P', '1', 0 } ;
+static const char     ChunkMagic [4] = { 'C', 'H', 'N', 'K' } ;
+static const uint32_t FileVersion    = 1 ;
+
+static const size_t   ChunkSize      = 64 * 1024 ;
+static const size_t   MaxChunk       = 16 * ChunkSize ;        // larger is taken as corruption
+static const size_t   MaxRun         = 255 ;
+static const size_t   MaxVarint      = 10 ;
+
+static const int64_t  MaxChunkAge_ticks = CaptureMaxChunkAge_ms * 1000000ll / CaptureResolution_ns ;
+
+// in host byte order, like the other files written here
+typedef struct
+{
+    char        magic [8] ;
+    uint32_t    version ;
+    uint32_t    resolution_ns ;
+    int64_t     started_ns ;            // CLOCK_REALTIME
+    int64_t     reserved ;
+} FileHeader ;
+
+typedef struct
+{
+    char        magic [4] ;
+    uint32_t    length ;                // of the runs that follow
+    int64_t     tick ;                  // of the first run, since the start
+} ChunkHeader ;
+
+
+static struct {
+    atomic <bool>   recording ;
+    mutex           lock ;
+    FILE *          file ;
+    int64_t         started_ns ;        // CLOCK_MONOTONIC
+
+    uint8_t         chunk [ChunkSize] ;
+    size_t          chunkLength ;
+    int64_t         chunkTick ;
+    int64_t         previousTick ;      // of the last run in the chunk
+
+    uint8_t         run [MaxRun] ;
+    size_t          runLength ;
+    int64_t         runTick ;
+} capture ;
+
+
+
+static int64_t now_ns (clockid_t clock)
+{
+    struct timespec now ;
+    clock_gettime (clock, & now) ;
+
+    return (int64_t) now.tv_sec * 1000000000 + now.tv_nsec ;
+}
+
+
+static size_t putVarint (uint8_t * out, uint64_t value)
+{
+    size_t length = 0 ;
+
+    while (value >= 0x80)
+    {
+        out [length ++] = (value & 0x7f) | 0x80 ;
+        value >>= 7 ;
+    }
+
+    out [length ++] = value ;
+    return length ;
+}
+
+
+static bool getVarint (const uint8_t ** in, const uint8_t * end, uint64_t * value)
+{
+    * value = 0 ;
+
+    for (unsigned shift = 0 ; (* in < end) && (shift < 64) ; shift += 7)
+    {
+        uint8_t byte = * (* in) ++ ;
+        * value |= (uint64_t) (byte & 0x7f) << shift ;
+
+        if (! (byte & 0x80))
+            return true ;
+    }
+
+    return false ;
+}
+
+
+
+// recording ...
+
+static bool flushChunk (void)
+{
+    if (capture.chunkLength == 0)
+        return true ;
+
+    ChunkHeader header ;
+    memcpy (header.magic, ChunkMagic, sizeof (ChunkMagic)) ;
+    header.length = capture.chunkLength ;
+    header.tick   = capture.chunkTick ;
+
+    bool ok = (fwrite (& header, sizeof (header), 1, capture.file) == 1) &&
+              (fwrite (capture.chunk, 1, capture.chunkLength, capture.file) == capture.chunkLength) &&
+              (fflush (capture.file) == 0) ;
+
+    capture.chunkLength = 0 ;
+    return ok ;
+}
+
+
+static void closeRun (void)
+{
+    if (capture.runLength == 0)
+        return ;
+
+    if (capture.chunkLength + MaxVarint + 1 + capture.runLength > ChunkSize)
+    {
+        if (! flushChunk ())
+            perror ("capture") ;
+    }
+
+    if (capture.chunkLength == 0)
+        capture.chunkTick = capture.previousTick = capture.runTick ;
+
+    uint8_t * out = & capture.chunk [capture.chunkLength] ;
+
+    out += putVarint (out, capture.runTick - capture.previousTick) ;
+    * out ++ = capture.runLength ;
+    memcpy (out, capture.run, capture.runLength) ;
+    out += capture.runLength ;
+
+    capture.chunkLength  = out - capture.chunk ;
+    capture.previousTick = capture.runTick ;
+    capture.runLength    = 0 ;
+}
+
+
+bool capture_start (const char * path)
+{
+    lock_guard <mutex> guard (capture.lock) ;
+
+    if (capture.file != NULL)
+        return false ;
+
+    FILE * file = fopen (path, "wb") ;
+    if (file == NULL)
+        return false ;
+
+    FileHeader header ;
+    memset (& header, 0, sizeof (header)) ;
+    memcpy (header.magic, FileMagic, sizeof (FileMagic)) ;
+    header.version       = FileVersion ;
+    header.resolution_ns = CaptureResolution_ns ;
+    header.started_ns    = now_ns (CLOCK_REALTIME) ;
+
+    if (fwrite (& header, sizeof (header), 1, file) != 1)
+    {
+        fclose (file) ;
+        return false ;
+    }
+
+    capture.file        = file ;
+    capture.started_ns  = now_ns (CLOCK_MONOTONIC) ;
+    capture.chunkLength = 0 ;
+    capture.runLength   = 0 ;
+
+    capture.recording.store (true, memory_order_release) ;
+    return true ;
+}
+
+
+static void flushOlderThan (int64_t ticks)
+{
+    // with capture.lock held, the pending run and chunk, if their first byte is that old
+    if ((capture.file == NULL) || ((capture.chunkLength == 0) && (capture.runLength == 0)))
+        return ;
+
+    int64_t tick   = (now_ns (CLOCK_MONOTONIC) - capture.started_ns) / CaptureResolution_ns ;
+    int64_t oldest = (capture.chunkLength != 0) ? capture.chunkTick : capture.runTick ;
+
+    if (tick - oldest < ticks)
+        return ;
+
+    closeRun () ;
+
+    if (! flushChunk ())
+        perror ("capture") ;
+}
+
+
+void capture_poll (void)
+{
+    if (! capture.recording.load (memory_order_acquire))
+        return ;
+
+    lock_guard <mutex> guard (capture.lock) ;
+    flushOlderThan (MaxChunkAge_ticks) ;
+}
+
+
+void capture_flush (void)
+{
+    if (! capture.recording.load (memory_order_acquire))
+        return ;
+
+    lock_guard <mutex> guard (capture.lock) ;
+    flushOlderThan (0) ;
+}
+
+
+void capture_stop (void)
+{
+    capture.recording.store (false, memory_order_release) ;
+
+    lock_guard <mutex> guard (capture.lock) ;
+
+    if (capture.file == NULL)
+        return ;
+
+    closeRun () ;
+
+    if (! flushChunk () || (fclose (capture.file) != 0))
+        perror ("capture") ;
+
+    capture.file = NULL ;
+}
+
+
+void capture_rxByte (uint8_t byte)
+{
+    if (! capture.recording.load (memory_order_acquire))
+        return ;
+
+    int64_t tick = (now_ns (CLOCK_MONOTONIC) - capture.started_ns) / CaptureResolution_ns ;
+
+    lock_guard <mutex> guard (capture.lock) ;
+
+    if (capture.file == NULL)
+        return ;
+
+    if ((capture.runLength != 0) && ((tick != capture.runTick) || (capture.runLength == MaxRun)))
+    {
+        closeRun () ;
+
+        // a stream that is never idle still reaches the file within the age limit
+        if (tick - capture.chunkTick >= MaxChunkAge_ticks)
+        {
+            if (! flushChunk ())
+                perror ("capture") ;
+        }
+    }
+
+    if (capture.runLength == 0)
+        capture.runTick = tick ;
+
+    capture.run [capture.runLength ++] = byte ;
+}
+
+
+
+// replay ...
+
+void capture_toParser (const uint8_t * bytes, size_t length, void *)
+{
+    nmea0183_updateFromBytes (bytes, length) ;
+}
+
+
+void capture_toFd (const uint8_t * bytes, size_t length, void * fd)
+{
+    while (length != 0)
+    {
+        ssize_t written = write (* (int *) fd, bytes, length) ;
+        if (written <= 0)
+            return ;
+
+        bytes  += written ;
+        length -= written ;
+    }
+}
+
+
+int capture_openPty (char * path, size_t size)
+{
+    int master = posix_openpt (O_RDWR | O_NOCTTY | O_CLOEXEC) ;
+    if (master < 0)
+        return -1 ;
+
+    struct termios settings ;
+
+    bool ok = (grantpt (master) == 0) && (unlockpt (master) == 0) &&
+              (ptsname_r (master, path, size) == 0) &&
+              (tcgetattr (master, & settings) == 0) ;
+
+    if (ok)
+    {
+        // the bytes must arrive as they were captured, with no echo or line editing
+        cfmakeraw (& settings) ;
+        ok = (tcsetattr (master, TCSANOW, & settings) == 0) ;
+    }
+
+    if (! ok)
+    {
+        close (master) ;
+        return -1 ;
+    }
+
+    return master ;
+}
+
+
+static void waitUntil (int64_t target_ns)
+{
+    struct timespec target ;
+    target.tv_sec  = target_ns / 1000000000 ;
+    target.tv_nsec = target_ns % 1000000000 ;
+
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, & target, NULL) == EINTR)
+        ;
+}
+
+
+bool capture_replay (const char * path, uint32_t speed, CaptureSink sink, void * context, CaptureReplayStats * stats)
+{
+    CaptureReplayStats replayed ;
+    memset (& replayed, 0, sizeof (replayed)) ;
+
+    FILE * file = fopen (path, "rb") ;
+    if (file == NULL)
+        return false ;
+
+    FileHeader header ;
+    bool ok = (fread (& header, sizeof (header), 1, file) == 1) &&
+              (memcmp (header.magic, FileMagic, sizeof (FileMagic)) == 0) &&
+              (header.version == FileVersion) && (header.resolution_ns != 0) ;
+
+    uint8_t * payload = (uint8_t *) malloc (MaxChunk) ;
+    ok = ok && (payload != NULL) ;
+
+    bool    first = true ;
+    int64_t firstTick = 0 ;
+    int64_t tick = 0 ;
+    int64_t origin_ns = now_ns (CLOCK_MONOTONIC) ;
+
+    while (ok)
+    {
+        ChunkHeader chunk ;
+        if (fread (& chunk, sizeof (chunk), 1, file) != 1)
+            break ;         // the end, or a chunk cut short by a crash
+
+        if ((memcmp (chunk.magic, ChunkMagic, sizeof (ChunkMagic)) != 0) || (chunk.length > MaxChunk) ||
+            (fread (payload, 1, chunk.length, file) != chunk.length))
+        {
+            ok = false ;
+            break ;
+        }
+
+        const uint8_t * in  = payload ;
+        const uint8_t * end = payload + chunk.length ;
+
+        tick = chunk.tick ;
+
+        while (in < end)
+        {
+            uint64_t delta ;
+            if (! getVarint (& in, end, & delta) || (in == end) || (* in == 0) || (end - in - 1 < * in))
+            {
+                ok = false ;
+                break ;
+            }
+
+            size_t length = * in ++ ;
+            tick += delta ;
+
+            if (first)
+            {
+                first     = false ;
+                firstTick = tick ;
+                origin_ns = now_ns (CLOCK_MONOTONIC) ;
+            }
+
+            if (speed != 0)
+            {
+                int64_t target_ns = origin_ns + (tick - firstTick) * (int64_t) header.resolution_ns / speed ;
+                int64_t late_ns   = now_ns (CLOCK_MONOTONIC) - target_ns ;
+
+                if (late_ns < 0)
+                    waitUntil (target_ns) ;
+                else if (late_ns > replayed.maxLate_ns)
+                    replayed.maxLate_ns = late_ns ;
+            }
+
+            sink (in, length, context) ;
+            in += length ;
+
+            replayed.bytes += length ;
+            replayed.runs ++ ;
+        }
+    }
+
+    replayed.recorded_ns = first ? 0 : (tick - firstTick) * (int64_t) header.resolution_ns ;
+    replayed.elapsed_ns  = now_ns (CLOCK_MONOTONIC) - origin_ns ;
+
+    free (payload) ;
+    fclose (file) ;
+
+    if (stats != NULL)
+        * stats = replayed ;
+
+    return ok ;
+}
@@ -0,0 +1,69 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// capture of the raw receiver bytes with their arrival times, and replay at the recorded pace
+//
+//      the bytes are recorded as nmea0183_run() reads them, with CLOCK_MONOTONIC
+//      times, in a chunked file:
+//
+//          header      "GPSCAP1\0", version, resolution_ns, start time (CLOCK_REALTIME ns), reserved
+//          chunks      'C' 'H' 'N' 'K', payload length, time of the chunk (ticks since the start),
+//                      then runs: ticks since the previous run (varint), length (1 .. 255), bytes
+//
+//      a run is the bytes that arrived within the same tick (CaptureResolution_ns), so a USB packet
+//      costs a couple of bytes of overhead and replay is faithful to a tick
+//      a chunk is written when its buffer fills, when its first byte is CaptureMaxChunkAge_ms old,
+//      when the stream ends or the capture stops, so a crash loses at most the last second or so
+//
+//      replay feeds the runs to a sink at 1x, Nx or as fast as possible, into the parser directly
+//      or into a pty (for anything that opens a serial device), and reports how late it ran
+
+
+static const uint32_t CaptureResolution_ns  = 10000 ;
+static const uint32_t CaptureMaxChunkAge_ms = 1000 ;
+
+
+// recording ...
+
+bool capture_start (const char * path) ;
+void capture_stop  (void) ;
+
+// from the stream, each byte as it is read, does nothing unless capturing
+void capture_rxByte (uint8_t) ;
+
+// from the stream while it is idle, writes the chunk once it is CaptureMaxChunkAge_ms old
+void capture_poll  (void) ;
+
+// at the end of the stream, writes whatever is buffered
+void capture_flush (void) ;
+
+
+// replay ...
+
+typedef void (* CaptureSink) (const uint8_t * bytes, size_t length, void * context) ;
+
+void capture_toParser (const uint8_t *, size_t, void *) ;      // nmea0183_updateFromBytes()
+void capture_toFd     (const uint8_t *, size_t, void * fd) ;   // context points at an int
+
+// the master side of a new pty in raw mode, path is set to the slave's, -1 on failure
+int capture_openPty (char * path, size_t size) ;
+
+typedef struct
+{
+    uint64_t    bytes ;
+    uint64_t    runs ;
+    int64_t     recorded_ns ;       // from the first run to the last, as captured
+    int64_t     elapsed_ns ;        // taken by the replay
+    int64_t     maxLate_ns ;        // the latest a run was handed to the sink, 0 at max speed
+} CaptureReplayStats ;
+
+// speed is 1 for real time, N for N times faster, 0 for as fast as possible
+//      false if the file can't be read or is corrupt, the runs before the damage have been replayed
+bool capture_replay (const char * path, uint32_t speed, CaptureSink, void * context, CaptureReplayStats * = NULL) ;
+
+
+#endif
@@ -0,0 +1,531 @@
+#include "event-log.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const char     FileMagic [8] = { 'G', 'P', 'S', 'L', 'O', 'G', '1', 0 } ;
+static const uint32_t FileVersion   = 1 ;
+
+static const uint16_t PadFormat     = 0xffff ;     // fills the end of a ring that a record doesn't fit
+static const size_t   RecordAlign   = 16 ;
+
+
+typedef struct
+{
+    const char *    text ;
+    const char *    kinds ;             // 'd' int, 's' C string, 'S' pointer and length, one per %
+} Format ;
+
+static const Format formats [EventLogFormats] =
+{
+    { "%d events lost",                                 "d" },
+
+    { "gps started",                                    ""  },
+    { "gps stopped",                                    ""  },
+    { "setting rtc from gps...",                        ""  },
+    { "gps date/time acquired after %d minutes",        "d" },
+    { "gps lat/long acquired after %d minutes",         "d" },
+    { "gps acquisition timed out after %d minutes",     "d" },
+    { "gps date/time acquisition failed",               ""  },
+    { "gps lat/long acquisition failed",                ""  },
+    { "gps device gone",                                ""  },
+    { "gps device %s",                                  "s" },
+    { "%s",                                             "S" },
+} ;
+
+
+typedef struct
+{
+    uint64_t    time_ns ;               // CLOCK_MONOTONIC
+    uint16_t    format ;
+    uint16_t    length ;                // of the payload that follows
+    uint32_t    thread ;
+} Record ;
+
+static_assert (sizeof (Record) == RecordAlign, "records are padded to a whole header") ;
+
+
+// one per logging thread, written only by it and read only by the drainer
+typedef struct Ring
+{
+    alignas (64)
+    atomic <uint64_t>   head ;          // bytes ever written
+    alignas (64)
+    atomic <uint64_t>   tail ;          // bytes ever drained
+    atomic <uint64_t>   dropped ;
+    atomic <bool>       finished ;      // the thread has exited
+    uint64_t            reported ;      // drops the drainer has written an event for
+    uint32_t            thread ;
+    Ring *              next ;          // changed only by the drainer once the ring is on the list
+    alignas (RecordAlign)
+    uint8_t             data [EventLog_RingBytes] ;
+} Ring ;
+
+
+// a thread pushes its ring on the front of the list without a lock, only the drainer takes rings
+// off, so a thread's first event never waits for a drain that is writing to a slow file
+static struct {
+    mutex               lock ;          // one drainer at a time, never taken by a logging thread
+    atomic <Ring *>     head ;
+    atomic <uint32_t>   threads ;
+} registry ;
+
+
+// the thread's ring, marked finished when the thread exits so the drainer can free it
+struct ThreadRing
+{
+    Ring * ring = NULL ;
+
+    ~ThreadRing ()
+    {
+        if (ring != NULL)
+            ring->finished.store (true, memory_order_release) ;
+    }
+} ;
+
+static thread_local ThreadRing threadRing ;
+
+
+static struct {
+    atomic <bool>       running ;
+    thread              loop ;
+    int                 stopFd = -1 ;
+    FILE *              file ;          // NULL for text on stdout
+    int64_t             realtimeOffset_ns ;
+} drainer ;
+
+
+
+static size_t recordSize (uint16_t length)
+{
+    return (sizeof (Record) + length + RecordAlign - 1) & ~(RecordAlign - 1) ;
+}
+
+
+static int64_t now_ns (clockid_t clock)
+{
+    struct timespec now ;
+    clock_gettime (clock, & now) ;
+
+    return now.tv_sec * 1000000000ll + now.tv_nsec ;
+}
+
+
+static Ring * registerThread (void)
+{
+    Ring * ring = new Ring () ;
+
+    ring->thread = registry.threads.fetch_add (1, memory_order_relaxed) ;
+    ring->next   = registry.head.load (memory_order_relaxed) ;
+
+    while (! registry.head.compare_exchange_weak (ring->next, ring, memory_order_release, memory_order_relaxed))
+        ;
+
+    threadRing.ring = ring ;
+    return ring ;
+}
+
+
+
+void eventLog (EventLogFormat format, ...)
+{
+    if ((unsigned) format >= EventLogFormats)
+        return ;
+
+    Ring * ring = (threadRing.ring != NULL) ? threadRing.ring : registerThread () ;
+
+    // the arguments, packed as the kinds say
+    uint8_t  payload [EventLog_MaxPayload] ;
+    uint16_t length = 0 ;
+
+    va_list arguments ;
+    va_start (arguments, format) ;
+
+    for (const char * kind = formats [format].kinds ; * kind != 0 ; kind ++)
+    {
+        if (* kind == 'd')
+        {
+            int32_t value = va_arg (arguments, int) ;
+
+            if (length + sizeof (value) > EventLog_MaxPayload)
+                break ;
+
+            memcpy (payload + length, & value, sizeof (value)) ;
+            length += sizeof (value) ;
+            continue ;
+        }
+
+        const char * text = va_arg (arguments, const char *) ;
+        size_t       size = (* kind == 'S') ? (size_t) va_arg (arguments, int) : strnlen (text, EventLog_MaxPayload) ;
+
+        if (length + sizeof (uint16_t) > EventLog_MaxPayload)
+            break ;
+
+        uint16_t room = EventLog_MaxPayload - length - sizeof (uint16_t) ;
+        uint16_t cut  = (size < room) ? size : room ;
+
+        memcpy (payload + length, & cut, sizeof (cut)) ;
+        memcpy (payload + length + sizeof (cut), text, cut) ;
+        length += sizeof (cut) + cut ;
+    }
+
+    va_end (arguments) ;
+
+    // the only writer of head, so no read-modify-write
+    uint64_t head   = ring->head.load (memory_order_relaxed) ;
+    uint64_t tail   = ring->tail.load (memory_order_acquire) ;
+    size_t   size   = recordSize (length) ;
+    size_t   offset = head % EventLog_RingBytes ;
+    size_t   toEnd  = EventLog_RingBytes - offset ;
+
+    // a record is never split, a pad takes the end of the ring when it doesn't fit there
+    size_t needed = size + ((size > toEnd) ? toEnd : 0) ;
+
+    if (EventLog_RingBytes - (head - tail) < needed)
+    {
+        ring->dropped.store (ring->dropped.load (memory_order_relaxed) + 1, memory_order_relaxed) ;
+        return ;
+    }
+
+    if (size > toEnd)
+    {
+        Record pad = { 0, PadFormat, (uint16_t) (toEnd - sizeof (Record)), ring->thread } ;
+        memcpy (ring->data + offset, & pad, sizeof (pad)) ;
+
+        head  += toEnd ;
+        offset = 0 ;
+    }
+
+    Record record = { (uint64_t) now_ns (CLOCK_MONOTONIC), (uint16_t) format, length, ring->thread } ;
+
+    memcpy (ring->data + offset, & record, sizeof (record)) ;
+    memcpy (ring->data + offset + sizeof (record), payload, length) ;
+
+    ring->head.store (head + size, memory_order_release) ;
+}
+
+
+
+static bool nextArgument (const uint8_t ** payload, const uint8_t * end, char kind, FILE * out)
+{
+    // false if the payload is too short for it
+    if (kind == 'd')
+    {
+        int32_t value ;
+        if (end - * payload < (ptrdiff_t) sizeof (value))
+            return false ;
+
+        memcpy (& value, * payload, sizeof (value)) ;
+        * payload += sizeof (value) ;
+
+        fprintf (out, "%d", value) ;
+        return true ;
+    }
+
+    uint16_t length ;
+    if (end - * payload < (ptrdiff_t) sizeof (length))
+        return false ;
+
+    memcpy (& length, * payload, sizeof (length)) ;
+    * payload += sizeof (length) ;
+
+    if (end - * payload < length)
+        return false ;
+
+    fwrite (* payload, 1, length, out) ;
+    * payload += length ;
+    return true ;
+}
+
+
+static void writeText (FILE * out, const char * text, const char * kinds,
+                       const Record * record, const uint8_t * payload, int64_t realtimeOffset_ns)
+{
+    int64_t   realtime_ns = record->time_ns + realtimeOffset_ns ;
+    time_t    seconds     = realtime_ns / 1000000000 ;
+    struct tm utc ;
+    gmtime_r (& seconds, & utc) ;
+
+    fprintf (out, "%04d-%02d-%02d %02d:%02d:%02d.%06ld [%u] ",
+             utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec,
+             (long) (realtime_ns % 1000000000) / 1000, record->thread) ;
+
+    const uint8_t * end = payload + record->length ;
+
+    for (const char * c = text ; * c != 0 ; c ++)
+    {
+        if ((c [0] == '%') && ((c [1] == 'd') || (c [1] == 's')))
+        {
+            // arguments missing from a cut short payload print as ?
+            if ((* kinds == 0) || ! nextArgument (& payload, end, * kinds ++, out))
+                fputc ('?', out) ;
+            c ++ ;
+        }
+        else
+            fputc (* c, out) ;
+    }
+
+    fputc ('\n', out) ;
+}
+
+
+static void output (const Record * record, const uint8_t * payload)
+{
+    if (drainer.file != NULL)
+    {
+        fwrite (record, 1, recordSize (record->length), drainer.file) ;
+        return ;
+    }
+
+    const Format * format = & formats [record->format] ;
+    writeText (stdout, format->text, format->kinds, record, payload, drainer.realtimeOffset_ns) ;
+}
+
+
+static void drainRing (Ring * ring)
+{
+    uint64_t head = ring->head.load (memory_order_acquire) ;
+    uint64_t tail = ring->tail.load (memory_order_relaxed) ;
+
+    while (tail != head)
+    {
+        const Record * record = (const Record *) (ring->data + tail % EventLog_RingBytes) ;
+
+        if (record->format != PadFormat)
+            output (record, (const uint8_t *) (record + 1)) ;
+
+        tail += recordSize (record->length) ;
+    }
+
+    ring->tail.store (tail, memory_order_release) ;
+
+    uint64_t dropped = ring->dropped.load (memory_order_relaxed) ;
+
+    if (dropped != ring->reported)
+    {
+        int32_t lost   = dropped - ring->reported ;
+        Record  record = { (uint64_t) now_ns (CLOCK_MONOTONIC), EventLog_Dropped, sizeof (lost), ring->thread } ;
+
+        uint8_t event [RecordAlign * 2] = { 0 } ;
+        memcpy (event, & record, sizeof (record)) ;
+        memcpy (event + sizeof (record), & lost, sizeof (lost)) ;
+
+        output ((const Record *) event, event + sizeof (record)) ;
+        ring->reported = dropped ;
+    }
+}
+
+
+static void drain (void)
+{
+    lock_guard <mutex> guard (registry.lock) ;
+
+    Ring * previous = NULL ;
+    Ring * ring     = registry.head.load (memory_order_acquire) ;
+
+    while (ring != NULL)
+    {
+        // finished first, so everything the thread logged is in head
+        bool   finished = ring->finished.load (memory_order_acquire) ;
+        Ring * next     = ring->next ;
+
+        drainRing (ring) ;
+
+        // threads only ever change the front of the list, so a ring behind another is unlinked
+        // directly, and the front one only if no thread has pushed in front of it meanwhile
+        bool unlinked = false ;
+
+        if (finished && (previous != NULL))
+        {
+            previous->next = next ;
+            unlinked = true ;
+        }
+        else if (finished)
+        {
+            Ring * expected = ring ;
+            unlinked = registry.head.compare_exchange_strong (expected, next, memory_order_acq_rel) ;
+        }
+
+        if (unlinked)
+            delete ring ;
+        else
+            previous = ring ;
+
+        ring = next ;
+    }
+
+    fflush ((drainer.file != NULL) ? drainer.file : stdout) ;
+}
+
+
+static void drainLoop (void)
+{
+    struct pollfd stop = { drainer.stopFd, POLLIN, 0 } ;
+
+    while (drainer.running)
+    {
+        poll (& stop, 1, EventLog_DrainInterval_ms) ;
+        drain () ;
+    }
+}
+
+
+
+static bool writeHeader (FILE * file)
+{
+    uint32_t count = EventLogFormats ;
+    int64_t  realtime_ns  = now_ns (CLOCK_REALTIME) ;
+    int64_t  monotonic_ns = now_ns (CLOCK_MONOTONIC) ;
+
+    bool ok = (fwrite (FileMagic, sizeof (FileMagic), 1, file) == 1) &&
+              (fwrite (& FileVersion, sizeof (FileVersion), 1, file) == 1) &&
+              (fwrite (& count, sizeof (count), 1, file) == 1) &&
+              (fwrite (& realtime_ns, sizeof (realtime_ns), 1, file) == 1) &&
+              (fwrite (& monotonic_ns, sizeof (monotonic_ns), 1, file) == 1) ;
+
+    for (uint32_t i = 0 ; ok && (i < count) ; i ++)
+    {
+        uint16_t textLength  = strlen (formats [i].text) ;
+        uint8_t  kindsLength = strlen (formats [i].kinds) ;
+
+        ok = (fwrite (& textLength,  sizeof (textLength),  1, file) == 1) &&
+             (fwrite (& kindsLength, sizeof (kindsLength), 1, file) == 1) &&
+             (fwrite (formats [i].text,  1, textLength,  file) == textLength) &&
+             (fwrite (formats [i].kinds, 1, kindsLength, file) == kindsLength) ;
+    }
+
+    return ok ;
+}
+
+
+bool eventLog_start (const char * path)
+{
+    if (drainer.loop.joinable ())
+        return false ;
+
+    drainer.file = NULL ;
+    drainer.realtimeOffset_ns = now_ns (CLOCK_REALTIME) - now_ns (CLOCK_MONOTONIC) ;
+
+    if (path != NULL)
+    {
+        drainer.file = fopen (path, "wb") ;
+        if (drainer.file == NULL)
+            return false ;
+
+        if (! writeHeader (drainer.file))
+        {
+            fclose (drainer.file) ;
+            drainer.file = NULL ;
+            return false ;
+        }
+    }
+
+    drainer.stopFd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC) ;
+
+    drainer.running = true ;
+    drainer.loop    = thread (drainLoop) ;
+
+    // what is still in the rings at exit is drained, and the thread joined before it is destroyed
+    static once_flag atExit ;
+    call_once (atExit, [] { atexit (eventLog_stop) ; }) ;
+
+    return true ;
+}
+
+
+void eventLog_stop (void)
+{
+    if (! drainer.loop.joinable ())
+        return ;
+
+    drainer.running = false ;
+
+    uint64_t one = 1 ;
+    if (write (drainer.stopFd, & one, sizeof (one)) != sizeof (one))
+        perror ("eventLog_stop") ;
+
+    drainer.loop.join () ;
+
+    // what was logged while the drainer stopped
+    drain () ;
+
+    if (drainer.stopFd >= 0)
+        close (drainer.stopFd) ;
+    drainer.stopFd = -1 ;
+
+    if (drainer.file != NULL)
+        fclose (drainer.file) ;
+    drainer.file = NULL ;
+}
+
+
+
+bool eventLog_decode (const char * path, FILE * out)
+{
+    FILE * file = fopen (path, "rb") ;
+    if (file == NULL)
+        return false ;
+
+    char     magic [sizeof (FileMagic)] ;
+    uint32_t version, count ;
+    int64_t  realtime_ns, monotonic_ns ;
+
+    bool ok = (fread (magic, sizeof (magic), 1, file) == 1) && (memcmp (magic, FileMagic, sizeof (magic)) == 0) &&
+              (fread (& version, sizeof (version), 1, file) == 1) && (version == FileVersion) &&
+              (fread (& count, sizeof (count), 1, file) == 1) && (count < PadFormat) &&
+              (fread (& realtime_ns, sizeof (realtime_ns), 1, file) == 1) &&
+              (fread (& monotonic_ns, sizeof (monotonic_ns), 1, file) == 1) ;
+
+    // the formats of the build that wrote the file
+    vector <string> texts, kinds ;
+
+    for (uint32_t i = 0 ; ok && (i < count) ; i ++)
+    {
+        uint16_t textLength ;
+        uint8_t  kindsLength ;
+
+        ok = (fread (& textLength,  sizeof (textLength),  1, file) == 1) &&
+             (fread (& kindsLength, sizeof (kindsLength), 1, file) == 1) ;
+
+        string text (ok ? textLength : 0, 0), kind (ok ? kindsLength : 0, 0) ;
+
+        ok = ok && (fread (& text [0], 1, textLength, file) == textLength) &&
+                   (fread (& kind [0], 1, kindsLength, file) == kindsLength) ;
+
+        texts.push_back (text) ;
+        kinds.push_back (kind) ;
+    }
+
+    while (ok)
+    {
+        Record record ;
+        if (fread (& record, sizeof (record), 1, file) != 1)
+            break ;                             // the end
+
+        uint8_t payload [RecordAlign + UINT16_MAX] ;
+        size_t  rest = recordSize (record.length) - sizeof (record) ;
+
+        ok = (record.format < count) && (fread (payload, 1, rest, file) == rest) ;
+
+        if (ok)
+            writeText (out, texts [record.format].c_str (), kinds [record.format].c_str (),
+                       & record, payload, realtime_ns - monotonic_ns) ;
+    }
+
+    fclose (file) ;
+    return ok ;
+}
@@ -0,0 +1,62 @@
+#ifndef _EVENT_LOG_H_
+#define _EVENT_LOG_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+
+// binary event log, cheap enough to leave on in production (NMEA echo included)
+//
+//      an event is a format id and its arguments, recorded with a CLOCK_MONOTONIC time into a
+//      ring of the calling thread's own: no lock, no formatting and no system call on the calling
+//      thread, only a copy of the arguments; when a ring is full its events are dropped and counted
+//
+//      a drainer thread empties the rings every DrainInterval_ms, into a file as they are, or
+//      formatted as text onto stdout when no file is given
+//      the file begins with the format strings, so it is decoded offline by any build:
+//
+//          header      "GPSLOG1\0", version, format count, CLOCK_REALTIME and CLOCK_MONOTONIC ns at the start,
+//                      then per format: text length, argument kinds length, text, kinds
+//          records     time (ns), format, payload length, thread, payload, padded to 16 bytes
+//
+//      formats take %d (an int) and %s (a C string, or with kind 'S' a pointer and a length)
+
+
+static const uint32_t EventLog_RingBytes       = 64 * 1024 ;     // per thread
+static const uint32_t EventLog_DrainInterval_ms = 10 ;
+static const uint16_t EventLog_MaxPayload      = 240 ;           // longer strings are cut short
+
+
+typedef enum
+{
+    EventLog_Dropped,                   // written by the drainer for events a full ring lost
+
+    EventLog_GpsStarted,
+    EventLog_GpsStopped,
+    EventLog_SettingRtc,
+    EventLog_DateTimeAcquired,
+    EventLog_LatLongAcquired,
+    EventLog_AcquisitionTimedOut,
+    EventLog_DateTimeFailed,
+    EventLog_LatLongFailed,
+    EventLog_DeviceGone,
+    EventLog_Device,
+    EventLog_NmeaSentence,
+
+    EventLogFormats
+} EventLogFormat ;
+
+
+// the arguments are as the format's text and kinds say
+void eventLog (EventLogFormat, ...) ;
+
+// path NULL for text on stdout; gps_initialize () starts it so, start it with a path before that
+// for a file instead; it is stopped at exit if it hasn't been
+bool eventLog_start (const char * path) ;
+void eventLog_stop  (void) ;           // drains what has been logged first
+
+// false if the file can't be read or is corrupt, the events before the damage have been written
+bool eventLog_decode (const char * path, FILE * out) ;
+
+
+#endif
@@ -0,0 +1,374 @@
+#include "fix-history.hpp"
+
+#include "gps.hpp"
+#include "time-source.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+
+
+// offsets from the reference are clamped to this (about 185 km), which with MaxCapacity fixes
+// keeps every sum of squares and products within 64 bits
+static const int32_t  MaxOffset_x1e5 = 10000000 ;
+
+// times in the sums are tenths of a second from a base, which is moved on before they exceed this
+static const int64_t  MaxTime_ds = 1 << 21 ;
+
+static const float    MetresPerMinute_x1e5 = 1852.0f / 100000 ;
+
+// for a circular normal distribution of standard deviation sigma, taken as (sigmaNorth + sigmaEast) / 2
+static const float    Cep50PerSigma = 1.1774f ;
+static const float    Cep95PerSigma = 2.4477f ;
+
+
+// exact running sums of the fixes in a window
+//      t and the offsets x (north) and y (east) are of fixes with a position only
+typedef struct
+{
+    int64_t     fixes ;
+    int64_t     positions ;
+    int64_t     x, y, xx, yy ;
+    int64_t     t, tt, tx, ty ;
+    int64_t     speed, speeds ;
+    int64_t     hdop,  hdops ;
+    int64_t     satellites ;
+} Sums ;
+
+
+typedef struct
+{
+    int64_t     length_ms ;
+    uint64_t    oldest ;                // sequence number of the oldest fix in the window
+    Sums        sums ;
+} Window ;
+
+
+struct FixHistory
+{
+    uint32_t            capacity ;
+    uint32_t            mask ;
+    uint64_t            next ;          // sequence number of the next fix
+
+    // the ring, one array per field
+    vector <int64_t>    time_ms ;
+    vector <int32_t>    north ;         // minutes_x1e5 from the reference
+    vector <int32_t>    east ;          // minutes_x1e5 of longitude from the reference
+    vector <uint8_t>    hasPosition ;
+    vector <int32_t>    speed_knots_x1000 ;
+    vector <int32_t>    hdop_x100 ;
+    vector <uint8_t>    satellites ;
+
+    bool                referenced ;
+    LatitudeLongitude   reference ;
+    float               metresPerEast ; // per minute_x1e5 of longitude, at the reference latitude
+    int64_t             timeBase_ms ;
+
+    Window              windows [FixHistory_MaxWindows] ;
+    uint8_t             windowCount ;
+} ;
+
+
+static FixHistory * recording ;
+
+
+
+static int32_t clampOffset (int64_t offset)
+{
+    if (offset >  MaxOffset_x1e5)   return  MaxOffset_x1e5 ;
+    if (offset < -MaxOffset_x1e5)   return -MaxOffset_x1e5 ;
+
+    return offset ;
+}
+
+
+static int64_t timeOf (const FixHistory * history, uint64_t sequence)
+{
+    // in the sums
+    return (history->time_ms [sequence & history->mask] - history->timeBase_ms) / 100 ;
+}
+
+
+static void accumulate (FixHistory * history, Sums * sums, uint64_t sequence, int sign)
+{
+    // sign 1 adds the fix to the sums, -1 takes it out
+    uint32_t slot = sequence & history->mask ;
+
+    sums->fixes      += sign ;
+    sums->satellites += sign * history->satellites [slot] ;
+
+    if (history->speed_knots_x1000 [slot] >= 0)
+    {
+        sums->speed  += sign * history->speed_knots_x1000 [slot] ;
+        sums->speeds += sign ;
+    }
+
+    if (history->hdop_x100 [slot] >= 0)
+    {
+        sums->hdop   += sign * history->hdop_x100 [slot] ;
+        sums->hdops  += sign ;
+    }
+
+    if (! history->hasPosition [slot])
+        return ;
+
+    int64_t x = history->north [slot] ;
+    int64_t y = history->east  [slot] ;
+    int64_t t = timeOf (history, sequence) ;
+
+    sums->positions += sign ;
+    sums->x  += sign * x ;
+    sums->y  += sign * y ;
+    sums->xx += sign * x * x ;
+    sums->yy += sign * y * y ;
+    sums->t  += sign * t ;
+    sums->tt += sign * t * t ;
+    sums->tx += sign * t * x ;
+    sums->ty += sign * t * y ;
+}
+
+
+static void moveTimeBase (FixHistory * history, int64_t shift_ds)
+{
+    // every t in the sums becomes t - shift, exactly:
+    //      sum (t - c) = t - n c,  sum (t - c)^2 = tt - 2 c t + n c^2,  sum (t - c) x = tx - c x
+    for (uint8_t i = 0 ; i < history->windowCount ; i ++)
+    {
+        Sums * sums = & history->windows [i].sums ;
+
+        sums->tt += - 2 * shift_ds * sums->t + sums->positions * shift_ds * shift_ds ;
+        sums->t  -= sums->positions * shift_ds ;
+        sums->tx -= shift_ds * sums->x ;
+        sums->ty -= shift_ds * sums->y ;
+    }
+
+    history->timeBase_ms += shift_ds * 100 ;
+}
+
+
+static bool anyPositions (const FixHistory * history)
+{
+    for (uint8_t i = 0 ; i < history->windowCount ; i ++)
+        if (history->windows [i].sums.positions != 0)
+            return true ;
+
+    return false ;
+}
+
+
+
+FixHistory * fixHistory_create (uint32_t capacity, const uint32_t * windows_s, uint8_t windows)
+{
+    if ((windows == 0) || (windows > FixHistory_MaxWindows))
+        return NULL ;
+
+    for (uint8_t i = 0 ; i < windows ; i ++)
+        if ((windows_s [i] == 0) || (windows_s [i] > FixHistory_MaxWindow_s))
+            return NULL ;
+
+    if (capacity > FixHistory_MaxCapacity)
+        capacity = FixHistory_MaxCapacity ;
+
+    uint32_t size = 1 ;
+    while (size < capacity)
+        size <<= 1 ;
+
+    FixHistory * history = new FixHistory () ;
+
+    history->capacity = size ;
+    history->mask     = size - 1 ;
+
+    history->time_ms           .resize (size) ;
+    history->north             .resize (size) ;
+    history->east              .resize (size) ;
+    history->hasPosition       .resize (size) ;
+    history->speed_knots_x1000 .resize (size) ;
+    history->hdop_x100         .resize (size) ;
+    history->satellites        .resize (size) ;
+
+    history->windowCount = windows ;
+
+    for (uint8_t i = 0 ; i < windows ; i ++)
+        history->windows [i].length_ms = windows_s [i] * 1000ll ;
+
+    return history ;
+}
+
+
+void fixHistory_destroy (FixHistory * history)
+{
+    if (recording == history)
+        fixHistory_stopRecording () ;
+
+    delete history ;
+}
+
+
+void fixHistory_add (FixHistory * history, const GpsFix * fix, int64_t time_ms)
+{
+    uint64_t sequence = history->next ;
+
+    // out of the windows, before the ring slot is reused or the reference moved
+    for (uint8_t i = 0 ; i < history->windowCount ; i ++)
+    {
+        Window * window = & history->windows [i] ;
+
+        while ((window->oldest < sequence) &&
+               ((sequence - window->oldest >= history->capacity) ||
+                (history->time_ms [window->oldest & history->mask] <= time_ms - window->length_ms)))
+            accumulate (history, & window->sums, window->oldest ++, -1) ;
+    }
+
+    if (! history->referenced || ! anyPositions (history))
+    {
+        history->referenced = fix->positionValid ;
+        history->reference  = fix->position ;
+
+        float latitude = fix->position.latitude_minutes_x1e5 / (60.0f * 100000) ;
+        history->metresPerEast = MetresPerMinute_x1e5 * cosf (latitude * (float) M_PI / 180) ;
+    }
+
+    if (history->next == 0)
+        history->timeBase_ms = time_ms ;
+
+    // the oldest fix in any window is the earliest time still in the sums
+    if ((time_ms - history->timeBase_ms) / 100 >= MaxTime_ds)
+    {
+        uint64_t oldest = sequence ;
+        for (uint8_t i = 0 ; i < history->windowCount ; i ++)
+            if (history->windows [i].oldest < oldest)
+                oldest = history->windows [i].oldest ;
+
+        int64_t earliest_ms = (oldest < sequence) ? history->time_ms [oldest & history->mask] : time_ms ;
+        moveTimeBase (history, (earliest_ms - history->timeBase_ms) / 100) ;
+    }
+
+    uint32_t slot = sequence & history->mask ;
+
+    history->time_ms           [slot] = time_ms ;
+    history->hasPosition       [slot] = fix->positionValid && history->referenced ;
+    history->speed_knots_x1000 [slot] = fix->speed_knots_x1000 ;
+    history->hdop_x100         [slot] = fix->hdop_x100 ;
+    history->satellites        [slot] = fix->satellitesUsed ;
+
+    if (history->hasPosition [slot])
+    {
+        const LatitudeLongitude * position  = & fix->position ;
+        const LatitudeLongitude * reference = & history->reference ;
+
+        history->north [slot] = clampOffset ((int64_t) position->latitude_minutes_x1e5 - reference->latitude_minutes_x1e5) ;
+        history->east  [slot] = clampOffset (latitudeLongitude_wrapLongitude ((int64_t) position->longitude_minutes_x1e5 - reference->longitude_minutes_x1e5)) ;
+    }
+
+    history->next = sequence + 1 ;
+
+    for (uint8_t i = 0 ; i < history->windowCount ; i ++)
+        accumulate (history, & history->windows [i].sums, sequence, 1) ;
+}
+
+
+
+static void recordFix (const GpsFix * fix)
+{
+    fixHistory_add (recording, fix, timeSource_monotonic_ms ()) ;
+}
+
+
+bool fixHistory_recordFixes (FixHistory * history)
+{
+    if (recording != NULL)
+        return recording == history ;
+
+    if (! gpsFix_subscribe (recordFix))
+        return false ;
+
+    // every fix, not only those of an acquisition
+    gps_startStreaming () ;
+
+    recording = history ;
+    return true ;
+}
+
+
+void fixHistory_stopRecording (void)
+{
+    if (recording == NULL)
+        return ;
+
+    gps_stopStreaming () ;
+    gpsFix_unsubscribe (recordFix) ;
+
+    recording = NULL ;
+}
+
+
+
+bool fixHistory_getStats (const FixHistory * history, uint8_t window, FixHistoryStats * stats)
+{
+    if (window >= history->windowCount)
+        return false ;
+
+    const Window * w    = & history->windows [window] ;
+    const Sums *   sums = & w->sums ;
+
+    memset (stats, 0, sizeof (* stats)) ;
+
+    stats->fixes           = sums->fixes ;
+    stats->positions       = sums->positions ;
+    stats->meanSpeed_knots = -1 ;
+    stats->meanHdop        = -1 ;
+
+    if (sums->fixes == 0)
+        return true ;
+
+    uint64_t newest = history->next - 1 ;
+
+    stats->availability   = (float) sums->positions / sums->fixes ;
+    stats->span_ms        = history->time_ms [newest & history->mask] - history->time_ms [w->oldest & history->mask] ;
+    stats->meanSatellites = (float) sums->satellites / sums->fixes ;
+
+    if (sums->speeds != 0)      stats->meanSpeed_knots = sums->speed / 1000.0f / sums->speeds ;
+    if (sums->hdops  != 0)      stats->meanHdop        = sums->hdop  /  100.0f / sums->hdops ;
+
+    if (sums->positions == 0)
+        return true ;
+
+    // the sums are exact, double only for what is derived from them
+    double n     = sums->positions ;
+    double meanX = sums->x / n ;
+    double meanY = sums->y / n ;
+
+    stats->meanPosition.latitude_minutes_x1e5  = history->reference.latitude_minutes_x1e5 + llround (meanX) ;
+    stats->meanPosition.longitude_minutes_x1e5 = latitudeLongitude_wrapLongitude (history->reference.longitude_minutes_x1e5 + llround (meanY)) ;
+
+    double varianceX = sums->xx / n - meanX * meanX ;
+    double varianceY = sums->yy / n - meanY * meanY ;
+
+    stats->sigmaNorth_m = sqrt (varianceX > 0 ? varianceX : 0) * MetresPerMinute_x1e5 ;
+    stats->sigmaEast_m  = sqrt (varianceY > 0 ? varianceY : 0) * history->metresPerEast ;
+
+    float sigma = (stats->sigmaNorth_m + stats->sigmaEast_m) / 2 ;
+    stats->cep50_m = Cep50PerSigma * sigma ;
+    stats->cep95_m = Cep95PerSigma * sigma ;
+
+    // least squares slope of offset on time: (n tx - t x) / (n tt - t t), in minutes_x1e5 per tenth of a second
+    double spread = n * sums->tt - (double) sums->t * sums->t ;
+
+    if (spread > 0)
+    {
+        const double TenthsPerHour = 36000 ;
+
+        stats->driftNorth_m_per_h = (n * sums->tx - (double) sums->t * sums->x) / spread * TenthsPerHour * MetresPerMinute_x1e5 ;
+        stats->driftEast_m_per_h  = (n * sums->ty - (double) sums->t * sums->y) / spread * TenthsPerHour * history->metresPerEast ;
+    }
+
+    return true ;
+}
+
+
+uint32_t fixHistory_count (const FixHistory * history)
+{
+    return (history->next < history->capacity) ? history->next : history->capacity ;
+}
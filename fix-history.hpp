@@ -0,0 +1,76 @@
+#ifndef _FIX_HISTORY_H_
+#define _FIX_HISTORY_H_
+
+#include "gps-fix.hpp"
+#include "lat-long.hpp"
+
+#include <stdint.h>
+
+
+// the recent fixes of one receiver, with statistics over trailing time windows kept up to date
+// as each fix arrives, for monitoring a stationary site
+//
+//      the fixes are held in a fixed size ring as parallel arrays (time, position, speed, HDOP,
+//      satellites), and each window keeps running sums of the fixes in it: a fix is added to the
+//      sums when it arrives and taken out when it falls out of the window (or off the ring), so
+//      a query is a constant amount of arithmetic whatever the window holds
+//
+//      positions are summed as integer offsets from a reference position (the first fix), so
+//      adding and taking out are exact and the sums never drift
+//      from them, per window: the mean position, the scatter about it as CEP50 and CEP95 (from the
+//      north and east standard deviations, assuming a normal distribution), the fraction of epochs
+//      with a position, and the drift, the least squares slope of position over time
+//
+//      not thread safe, one writer and no concurrent queries
+
+
+static const uint32_t FixHistory_MaxCapacity = 1 << 16 ;
+static const uint8_t  FixHistory_MaxWindows  = 4 ;
+static const uint32_t FixHistory_MaxWindow_s = 24 * 60 * 60 ;
+
+
+typedef struct FixHistory FixHistory ;
+
+
+typedef struct
+{
+    uint32_t            fixes ;                 // epochs in the window
+    uint32_t            positions ;             // of them with a position
+    float               availability ;          // positions / fixes, 0 if there are no fixes
+    int64_t             span_ms ;               // oldest fix to newest
+
+    // with positions only
+    LatitudeLongitude   meanPosition ;
+    float               sigmaNorth_m ;
+    float               sigmaEast_m ;
+    float               cep50_m ;               // radius about the mean holding half the positions
+    float               cep95_m ;
+    float               driftNorth_m_per_h ;    // 0 with fewer than 2 positions
+    float               driftEast_m_per_h ;
+
+    float               meanSpeed_knots ;       // of fixes reporting speed, < 0 if none did
+    float               meanHdop ;              // likewise
+    float               meanSatellites ;
+} FixHistoryStats ;
+
+
+// capacity is rounded up to a power of 2, up to MaxCapacity, and should hold the longest window
+// windows are in seconds, up to MaxWindows of them, each up to MaxWindow_s
+FixHistory * fixHistory_create  (uint32_t capacity, const uint32_t * windows_s, uint8_t windows) ;
+void         fixHistory_destroy (FixHistory *) ;
+
+// time_ms from a monotonic clock, never going back
+void fixHistory_add (FixHistory *, const GpsFix *, int64_t time_ms) ;
+
+// add every fix assembled by gps-fix, to one history, at timeSource_monotonic_ms (), with the
+// receiver streaming until stopped
+bool fixHistory_recordFixes   (FixHistory *) ;
+void fixHistory_stopRecording (void) ;
+
+// the window ending at the newest fix, false if there is no such window
+bool fixHistory_getStats (const FixHistory *, uint8_t window, FixHistoryStats *) ;
+
+uint32_t fixHistory_count (const FixHistory *) ;    // fixes held, whatever their age
+
+
+#endif
@@ -0,0 +1,517 @@
+#include "fix-index.hpp"
+
+#include "geodesy.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const int64_t UnitsPerPole       =  90ll * 60 * 100000 ;
+static const int64_t UnitsPerHalfCircle = 180ll * 60 * 100000 ;
+
+static const size_t  PendingCapacity = 4096 ;
+
+static const uint64_t LongitudeBits = 0x5555555555555555ull ;    // even bits
+static const uint64_t  LatitudeBits = 0xaaaaaaaaaaaaaaaaull ;    // odd bits
+
+static const char FileMagic [8] = { 'F', 'I', 'X', 'I', 'D', 'X', '1', 0 } ;
+
+typedef struct
+{
+    char        magic [8] ;
+    uint64_t    count ;
+    // followed by count keys (uint64_t), then count ids (uint32_t)
+} FileHeader ;
+
+
+typedef struct
+{
+    uint64_t    key ;
+    uint32_t    id ;
+} Entry ;
+
+
+typedef struct
+{
+    vector <uint64_t>   keys ;
+    vector <uint32_t>   ids ;
+} Run ;
+
+
+struct FixIndex
+{
+    // the saved index, if opened from a file
+    void *              mapping ;
+    size_t              mappingLength ;
+    const uint64_t *    baseKeys ;
+    const uint32_t *    baseIds ;
+    size_t              baseCount ;
+
+    vector <Run>        runs ;          // sorted, oldest (largest) first
+    vector <Entry>      pending ;       // unsorted
+} ;
+
+
+
+// Morton keys ...
+
+static uint64_t spreadBits (uint32_t value)
+{
+    // put a 0 bit between each bit of value
+    uint64_t x = value ;
+
+    x = (x | (x << 16)) & 0x0000ffff0000ffffull ;
+    x = (x | (x <<  8)) & 0x00ff00ff00ff00ffull ;
+    x = (x | (x <<  4)) & 0x0f0f0f0f0f0f0f0full ;
+    x = (x | (x <<  2)) & 0x3333333333333333ull ;
+    x = (x | (x <<  1)) & 0x5555555555555555ull ;
+
+    return x ;
+}
+
+
+static uint32_t compactBits (uint64_t x)
+{
+    // the inverse of spreadBits ()
+    x &= 0x5555555555555555ull ;
+
+    x = (x | (x >>  1)) & 0x3333333333333333ull ;
+    x = (x | (x >>  2)) & 0x0f0f0f0f0f0f0f0full ;
+    x = (x | (x >>  4)) & 0x00ff00ff00ff00ffull ;
+    x = (x | (x >>  8)) & 0x0000ffff0000ffffull ;
+    x = (x | (x >> 16)) & 0x00000000ffffffffull ;
+
+    return (uint32_t) x ;
+}
+
+
+static uint64_t keyOf (int64_t latitude_minutes_x1e5, int64_t longitude_minutes_x1e5)
+{
+    // latitude is doubled so both axes have the same resolution and range, 0 .. 2 * 180 degrees
+    uint32_t latitude  = (uint32_t) ((latitude_minutes_x1e5 + UnitsPerPole) * 2) ;
+    uint32_t longitude = (uint32_t)  (longitude_minutes_x1e5 + UnitsPerHalfCircle) ;
+
+    return (spreadBits (latitude) << 1) | spreadBits (longitude) ;
+}
+
+
+static LatitudeLongitude positionOf (uint64_t key)
+{
+    LatitudeLongitude position ;
+
+    position. latitude_minutes_x1e5 = (int) ((int64_t) compactBits (key >> 1) / 2 - UnitsPerPole) ;
+    position.longitude_minutes_x1e5 = (int) ((int64_t) compactBits (key)          - UnitsPerHalfCircle) ;
+
+    return position ;
+}
+
+
+static bool keyInBox (uint64_t key, uint64_t minKey, uint64_t maxKey)
+{
+    // the bits of one axis compare in the same order as that axis' values
+    return ((key & LatitudeBits)  >= (minKey & LatitudeBits))  && ((key & LatitudeBits)  <= (maxKey & LatitudeBits)) &&
+           ((key & LongitudeBits) >= (minKey & LongitudeBits)) && ((key & LongitudeBits) <= (maxKey & LongitudeBits)) ;
+}
+
+
+static uint64_t nextKeyInBox (uint64_t key, uint64_t minKey, uint64_t maxKey)
+{
+    // BIGMIN: the smallest key > key that is inside the box
+    //      H. Tropf, H. Herzog, "Multidimensional Range Search in Dynamically Balanced Trees", 1981
+
+    uint64_t bigmin = 0 ;
+
+    for (int bit = 63 ; bit >= 0 ; bit --)
+    {
+        uint64_t mask  = 1ull << bit ;
+        uint64_t lower = ((bit & 1) ? LatitudeBits : LongitudeBits) & (mask - 1) ;    // the same axis' lower bits
+
+        uint8_t bits = ((key    & mask) ? 4 : 0) |
+                       ((minKey & mask) ? 2 : 0) |
+                       ((maxKey & mask) ? 1 : 0) ;
+
+        switch (bits)
+        {
+            case 0:     // 000
+            case 7:     // 111
+                break ;
+
+            case 1:     // 001
+                bigmin = (minKey | mask) & ~lower ;
+                maxKey = (maxKey & ~mask) | lower ;
+                break ;
+
+            case 3:     // 011
+                return minKey ;
+
+            case 4:     // 100
+                return bigmin ;
+
+            case 5:     // 101
+                minKey = (minKey | mask) & ~lower ;
+                break ;
+
+            default:    // 010 and 110 can't happen, minKey <= maxKey on every axis
+                return bigmin ;
+        }
+    }
+
+    return bigmin ;
+}
+
+
+
+// runs ...
+
+static size_t queryRun (const uint64_t * keys, const uint32_t * ids, size_t count,
+                        uint64_t minKey, uint64_t maxKey, FixIndexHandler handler, void * context)
+{
+    size_t found = 0 ;
+
+    const uint64_t * end = keys + count ;
+    const uint64_t * k   = lower_bound (keys, end, minKey) ;
+
+    while ((k < end) && (* k <= maxKey))
+    {
+        if (keyInBox (* k, minKey, maxKey))
+        {
+            LatitudeLongitude position = positionOf (* k) ;
+            handler (& position, ids [k - keys], context) ;
+
+            ++ found ;
+            ++ k ;
+        }
+        else
+        {
+            // skip the part of the curve that is outside the box
+            uint64_t next = nextKeyInBox (* k, minKey, maxKey) ;
+            if (next <= * k)
+                break ;
+
+            k = lower_bound (k, end, next) ;
+        }
+    }
+
+    return found ;
+}
+
+
+static void mergeRuns (const uint64_t * aKeys, const uint32_t * aIds, size_t aCount,
+                       const uint64_t * bKeys, const uint32_t * bIds, size_t bCount,
+                       uint64_t * keys, uint32_t * ids)
+{
+    size_t a = 0, b = 0, out = 0 ;
+
+    while ((a < aCount) && (b < bCount))
+    {
+        if (bKeys [b] < aKeys [a])  { keys [out] = bKeys [b] ; ids [out ++] = bIds [b ++] ; }
+        else                        { keys [out] = aKeys [a] ; ids [out ++] = aIds [a ++] ; }
+    }
+
+    while (a < aCount)  { keys [out] = aKeys [a] ; ids [out ++] = aIds [a ++] ; }
+    while (b < bCount)  { keys [out] = bKeys [b] ; ids [out ++] = bIds [b ++] ; }
+}
+
+
+static void mergeLastRuns (FixIndex * index)
+{
+    Run & older = index->runs [index->runs.size () - 2] ;
+    Run & newer = index->runs [index->runs.size () - 1] ;
+
+    Run merged ;
+    merged.keys.resize (older.keys.size () + newer.keys.size ()) ;
+    merged.ids .resize (merged.keys.size ()) ;
+
+    mergeRuns (older.keys.data (), older.ids.data (), older.keys.size (),
+               newer.keys.data (), newer.ids.data (), newer.keys.size (),
+               merged.keys.data (), merged.ids.data ()) ;
+
+    index->runs.pop_back () ;
+    index->runs.back () = move (merged) ;
+}
+
+
+static void flushPending (FixIndex * index)
+{
+    if (index->pending.empty ())
+        return ;
+
+    sort (index->pending.begin (), index->pending.end (),
+          [] (const Entry & a, const Entry & b) { return a.key < b.key ; }) ;
+
+    Run run ;
+    run.keys.reserve (index->pending.size ()) ;
+    run.ids .reserve (index->pending.size ()) ;
+
+    for (const Entry & entry : index->pending)
+    {
+        run.keys.push_back (entry.key) ;
+        run.ids .push_back (entry.id) ;
+    }
+
+    index->pending.clear () ;
+    index->runs.push_back (move (run)) ;
+
+    // keep run sizes roughly doubling, so there are only log (n) of them
+    while ((index->runs.size () >= 2) &&
+           (index->runs [index->runs.size () - 2].keys.size () <= index->runs.back ().keys.size () * 2))
+        mergeLastRuns (index) ;
+}
+
+
+
+FixIndex * fixIndex_create (void)
+{
+    FixIndex * index = new FixIndex () ;
+
+    index->pending.reserve (PendingCapacity) ;
+
+    return index ;
+}
+
+
+FixIndex * fixIndex_open (const char * path)
+{
+    int fd = open (path, O_RDONLY) ;
+    if (fd < 0)
+        return NULL ;
+
+    struct stat status ;
+    void * mapping = MAP_FAILED ;
+
+    if ((fstat (fd, & status) == 0) && ((size_t) status.st_size >= sizeof (FileHeader)))
+        mapping = mmap (NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0) ;
+
+    close (fd) ;
+
+    if (mapping == MAP_FAILED)
+        return NULL ;
+
+    const FileHeader * header = (const FileHeader *) mapping ;
+    size_t length = status.st_size ;
+
+    if ((memcmp (header->magic, FileMagic, sizeof (FileMagic)) != 0) ||
+        (length != sizeof (FileHeader) + header->count * (sizeof (uint64_t) + sizeof (uint32_t))))
+    {
+        munmap (mapping, length) ;
+        return NULL ;
+    }
+
+    FixIndex * index = fixIndex_create () ;
+
+    index->mapping       = mapping ;
+    index->mappingLength = length ;
+    index->baseCount     = header->count ;
+    index->baseKeys      = (const uint64_t *) (header + 1) ;
+    index->baseIds       = (const uint32_t *) (index->baseKeys + header->count) ;
+
+    // the index is read by queries in key order, and randomly by the binary searches
+    madvise (mapping, length, MADV_WILLNEED) ;
+
+    return index ;
+}
+
+
+void fixIndex_destroy (FixIndex * index)
+{
+    if (index->mapping != NULL)
+        munmap (index->mapping, index->mappingLength) ;
+
+    delete index ;
+}
+
+
+bool fixIndex_save (FixIndex * index, const char * path)
+{
+    // everything in memory is merged into one run, then merged with the base on the way to disk
+
+    flushPending (index) ;
+
+    while (index->runs.size () >= 2)
+        mergeLastRuns (index) ;
+
+    Run empty ;
+    const Run & run = index->runs.empty () ? empty : index->runs [0] ;
+
+    Run all ;
+    all.keys.resize (index->baseCount + run.keys.size ()) ;
+    all.ids .resize (all.keys.size ()) ;
+
+    mergeRuns (index->baseKeys, index->baseIds, index->baseCount,
+               run.keys.data (), run.ids.data (), run.keys.size (),
+               all.keys.data (), all.ids.data ()) ;
+
+    // write to a temporary file and rename, so the file is never seen half written
+    char temporary [256] ;
+    snprintf (temporary, sizeof (temporary), "%s.tmp", path) ;
+
+    FILE * file = fopen (temporary, "wb") ;
+    if (file == NULL)
+        return false ;
+
+    FileHeader header ;
+    memcpy (header.magic, FileMagic, sizeof (FileMagic)) ;
+    header.count = all.keys.size () ;
+
+    bool ok = (fwrite (& header, sizeof (header), 1, file) == 1) &&
+              (fwrite (all.keys.data (), sizeof (uint64_t), header.count, file) == header.count) &&
+              (fwrite (all.ids .data (), sizeof (uint32_t), header.count, file) == header.count) ;
+
+    ok &= (fclose (file) == 0) ;
+    ok  = ok && (rename (temporary, path) == 0) ;
+
+    if (! ok)
+        unlink (temporary) ;
+
+    return ok ;
+}
+
+
+
+void fixIndex_insert (FixIndex * index, const LatitudeLongitude * position, uint32_t id)
+{
+    Entry entry = { keyOf (position->latitude_minutes_x1e5, position->longitude_minutes_x1e5), id } ;
+
+    index->pending.push_back (entry) ;
+
+    if (index->pending.size () >= PendingCapacity)
+        flushPending (index) ;
+}
+
+
+size_t fixIndex_count (const FixIndex * index)
+{
+    size_t count = index->baseCount + index->pending.size () ;
+
+    for (const Run & run : index->runs)
+        count += run.keys.size () ;
+
+    return count ;
+}
+
+
+
+static size_t queryKeys (FixIndex * index, uint64_t minKey, uint64_t maxKey, FixIndexHandler handler, void * context)
+{
+    size_t found = queryRun (index->baseKeys, index->baseIds, index->baseCount, minKey, maxKey, handler, context) ;
+
+    for (const Run & run : index->runs)
+        found += queryRun (run.keys.data (), run.ids.data (), run.keys.size (), minKey, maxKey, handler, context) ;
+
+    for (const Entry & entry : index->pending)
+    {
+        if (keyInBox (entry.key, minKey, maxKey))
+        {
+            LatitudeLongitude position = positionOf (entry.key) ;
+            handler (& position, entry.id, context) ;
+            ++ found ;
+        }
+    }
+
+    return found ;
+}
+
+
+size_t fixIndex_queryBox (FixIndex * index, const LatitudeLongitude * southWest, const LatitudeLongitude * northEast,
+                          FixIndexHandler handler, void * context)
+{
+    int64_t south = southWest->latitude_minutes_x1e5 ;
+    int64_t north = northEast->latitude_minutes_x1e5 ;
+    int64_t west  = southWest->longitude_minutes_x1e5 ;
+    int64_t east  = northEast->longitude_minutes_x1e5 ;
+
+    if (south > north)
+        return 0 ;
+
+    if (west > east)
+    {
+        // across the antimeridian, as two boxes
+        return queryKeys (index, keyOf (south, west), keyOf (north,  UnitsPerHalfCircle), handler, context) +
+               queryKeys (index, keyOf (south, -UnitsPerHalfCircle), keyOf (north, east), handler, context) ;
+    }
+
+    return queryKeys (index, keyOf (south, west), keyOf (north, east), handler, context) ;
+}
+
+
+
+typedef struct
+{
+    LatitudeLongitude   centre ;
+    float               metres ;
+    FixIndexHandler     handler ;
+    void *              context ;
+    size_t              found ;
+} RadiusQuery ;
+
+
+static void radiusFilter (const LatitudeLongitude * position, uint32_t id, void * context)
+{
+    RadiusQuery * query = (RadiusQuery *) context ;
+
+    float metres ;
+    geodesy_distanceFrom (Geodesy_Equirectangular, & query->centre, position, & metres, 1) ;
+
+    if (metres <= query->metres)
+    {
+        query->handler (position, id, query->context) ;
+        ++ query->found ;
+    }
+}
+
+
+size_t fixIndex_queryRadius (FixIndex * index, const LatitudeLongitude * centre, float metres,
+                             FixIndexHandler handler, void * context)
+{
+    // the bounding box of the circle, then the exact distance for each fix in it
+    //      on the smallest radius of the ellipsoid, the meridian's at the equator, so the box
+    //      holds the circle wherever geodesy measures it
+
+    static const double UnitsPerMetre = (180.0 * 60 * 100000) / (3.14159265358979323846 * 6335439.3) ;
+
+    int64_t dLat = (int64_t) ceil (metres * UnitsPerMetre) ;
+
+    // longitude is widest at the pole side of the box
+    int64_t poleward = min ((int64_t) abs (centre->latitude_minutes_x1e5) + dLat, UnitsPerPole) ;
+    double latitudeRadians = (double) poleward / UnitsPerHalfCircle * 3.14159265358979323846 ;
+
+    int64_t dLon = (int64_t) ceil (metres * UnitsPerMetre / fmax (cos (latitudeRadians), 1e-6)) ;
+
+    LatitudeLongitude southWest, northEast ;
+
+    southWest.latitude_minutes_x1e5 = (int) max (centre->latitude_minutes_x1e5 - dLat, -UnitsPerPole) ;
+    northEast.latitude_minutes_x1e5 = (int) min (centre->latitude_minutes_x1e5 + dLat,  UnitsPerPole) ;
+
+    if (dLon >= UnitsPerHalfCircle)
+    {
+        southWest.longitude_minutes_x1e5 = (int) -UnitsPerHalfCircle ;
+        northEast.longitude_minutes_x1e5 = (int)  UnitsPerHalfCircle ;
+    }
+    else
+    {
+        int64_t west = centre->longitude_minutes_x1e5 - dLon ;
+        int64_t east = centre->longitude_minutes_x1e5 + dLon ;
+
+        if (west < -UnitsPerHalfCircle)     west += 2 * UnitsPerHalfCircle ;
+        if (east >  UnitsPerHalfCircle)     east -= 2 * UnitsPerHalfCircle ;
+
+        southWest.longitude_minutes_x1e5 = (int) west ;
+        northEast.longitude_minutes_x1e5 = (int) east ;
+    }
+
+    RadiusQuery query = { * centre, metres, handler, context, 0 } ;
+
+    fixIndex_queryBox (index, & southWest, & northEast, radiusFilter, & query) ;
+
+    return query.found ;
+}
@@ -0,0 +1,48 @@
+#ifndef _FIX_INDEX_H_
+#define _FIX_INDEX_H_
+
+#include "lat-long.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// spatial index of stored fixes, keyed by Morton (z-order) code
+//
+//      the key interleaves the bits of latitude and longitude, both in minutes_x1e5, so it is
+//      lossless and the position is recovered from the key itself: an entry is 12 bytes
+//
+//      inserts go to a small unsorted buffer, which is sorted into a run when full, and runs of
+//      similar size are merged (log structured), so inserting stays cheap as the index grows
+//      a box query is a binary search per run, skipping key ranges outside the box (BIGMIN)
+//
+//      an index saved to disk is opened with mmap, so opening is instant whatever its size,
+//      and further inserts go on top of it in memory
+//
+//      not thread safe, one writer and no concurrent queries
+
+
+typedef struct FixIndex FixIndex ;
+
+typedef void (* FixIndexHandler) (const LatitudeLongitude *, uint32_t id, void * context) ;
+
+
+FixIndex * fixIndex_create  (void) ;
+FixIndex * fixIndex_open    (const char * path) ;       // NULL if missing or not an index file
+void       fixIndex_destroy (FixIndex *) ;
+
+// false if the file can't be written
+bool fixIndex_save (FixIndex *, const char * path) ;
+
+void   fixIndex_insert (FixIndex *, const LatitudeLongitude *, uint32_t id) ;
+size_t fixIndex_count  (const FixIndex *) ;
+
+// return the number of fixes found, each of which is passed to the handler
+//      a box with southWest longitude > northEast longitude crosses the antimeridian
+size_t fixIndex_queryBox    (FixIndex *, const LatitudeLongitude * southWest, const LatitudeLongitude * northEast,
+                             FixIndexHandler, void * context) ;
+size_t fixIndex_queryRadius (FixIndex *, const LatitudeLongitude * centre, float metres,
+                             FixIndexHandler, void * context) ;
+
+
+#endif
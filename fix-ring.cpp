@@ -0,0 +1,381 @@
+#include "fix-ring.hpp"
+
+#include "gps.hpp"
+
+#include <atomic>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const char     RingMagic [8] = { 'G', 'P', 'S', 'R', 'I', 'N', 'G', 0 } ;
+static const uint32_t RingVersion   = 1 ;
+static const uint32_t MaxCapacity   = 1 << 20 ;
+
+
+// shared with the readers, in the mapped file
+typedef struct
+{
+    char                magic [8] ;             // written last, so a reader never sees a half made ring
+    uint32_t            version ;
+    uint32_t            fixSize ;
+    uint32_t            capacity ;
+    atomic <uint32_t>   closed ;
+    alignas (64)
+    atomic <uint64_t>   head ;                  // sequence number of the next fix to be written
+} RingHeader ;
+
+typedef struct
+{
+    alignas (64)
+    atomic <uint64_t>   sequence ;              // 2 * n + 1 while fix n is written, 2 * n + 2 when done
+    GpsFix              fix ;
+} RingSlot ;
+
+static_assert (atomic <uint64_t>::is_always_lock_free, "the ring needs lock free 64 bit atomics to be shared") ;
+
+
+struct FixRing
+{
+    void *          mapping ;
+    size_t          length ;
+    RingHeader *    header ;
+    RingSlot *      slots ;
+    uint64_t        mask ;
+    bool            writer ;
+    char            name [64] ;
+} ;
+
+
+static FixRing * publishing ;
+
+
+
+static size_t ringLength (uint32_t capacity)
+{
+    return sizeof (RingHeader) + (size_t) capacity * sizeof (RingSlot) ;
+}
+
+
+static FixRing * newRing (void * mapping, size_t length, bool writer, const char * name)
+{
+    FixRing * ring = new FixRing () ;
+
+    ring->mapping = mapping ;
+    ring->length  = length ;
+    ring->header  = (RingHeader *) mapping ;
+    ring->slots   = (RingSlot *) (ring->header + 1) ;
+    ring->mask    = ring->header->capacity - 1 ;
+    ring->writer  = writer ;
+    snprintf (ring->name, sizeof (ring->name), "/%s", name) ;
+
+    return ring ;
+}
+
+
+static void markClosed (const char * path)
+{
+    // readers still mapping an old ring under this name are told it's closed, as
+    // fixRing_destroy () would have, before the name is taken away from them
+
+    int fd = shm_open (path, O_RDWR, 0) ;
+    if (fd < 0)
+        return ;
+
+    struct stat status ;
+
+    if ((fstat (fd, & status) == 0) && ((size_t) status.st_size >= sizeof (RingHeader)))
+    {
+        void * mapping = mmap (NULL, sizeof (RingHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) ;
+
+        if (mapping != MAP_FAILED)
+        {
+            RingHeader * header = (RingHeader *) mapping ;
+
+            if (memcmp (header->magic, RingMagic, sizeof (RingMagic)) == 0)
+                header->closed.store (1, memory_order_release) ;
+
+            munmap (mapping, sizeof (RingHeader)) ;
+        }
+    }
+
+    close (fd) ;
+}
+
+
+
+FixRing * fixRing_create (const char * name, uint32_t capacity)
+{
+    if ((capacity == 0) || (capacity > MaxCapacity))
+        return NULL ;
+
+    uint32_t rounded = 1 ;
+    while (rounded < capacity)
+        rounded <<= 1 ;
+
+    char path [64] ;
+    snprintf (path, sizeof (path), "/%s", name) ;
+
+    // a new file, so readers still mapping an old ring don't see this one change under them,
+    // the old one is closed first so they know to reopen
+    markClosed (path) ;
+    shm_unlink (path) ;
+
+    int fd = shm_open (path, O_CREAT | O_EXCL | O_RDWR, 0644) ;
+    if (fd < 0)
+        return NULL ;
+
+    size_t length = ringLength (rounded) ;
+    void * mapping = MAP_FAILED ;
+
+    if (ftruncate (fd, length) == 0)
+        mapping = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) ;
+
+    close (fd) ;
+
+    if (mapping == MAP_FAILED)
+    {
+        shm_unlink (path) ;
+        return NULL ;
+    }
+
+    // the file is zero filled, so the slots start empty
+    RingHeader * header = (RingHeader *) mapping ;
+    header->version  = RingVersion ;
+    header->fixSize  = sizeof (GpsFix) ;
+    header->capacity = rounded ;
+    header->closed.store (0, memory_order_relaxed) ;
+    header->head  .store (0, memory_order_relaxed) ;
+
+    atomic_thread_fence (memory_order_release) ;
+    memcpy (header->magic, RingMagic, sizeof (RingMagic)) ;
+
+    return newRing (mapping, length, true, name) ;
+}
+
+
+void fixRing_destroy (FixRing * ring)
+{
+    if (publishing == ring)
+        fixRing_stopPublishing () ;
+
+    if (ring->writer)
+    {
+        ring->header->closed.store (1, memory_order_release) ;
+        shm_unlink (ring->name) ;
+    }
+
+    munmap (ring->mapping, ring->length) ;
+    delete ring ;
+}
+
+
+void fixRing_publish (FixRing * ring, const GpsFix * fix)
+{
+    // the only writer, so head needs no read-modify-write
+    uint64_t   sequence = ring->header->head.load (memory_order_relaxed) ;
+    RingSlot * slot     = & ring->slots [sequence & ring->mask] ;
+
+    slot->sequence.store (2 * sequence + 1, memory_order_relaxed) ;
+    atomic_thread_fence (memory_order_release) ;
+
+    memcpy (& slot->fix, fix, sizeof (GpsFix)) ;
+
+    slot->sequence.store (2 * sequence + 2, memory_order_release) ;
+    ring->header->head.store (sequence + 1, memory_order_release) ;
+}
+
+
+static void publishFix (const GpsFix * fix)
+{
+    if (publishing != NULL)
+        fixRing_publish (publishing, fix) ;
+}
+
+
+bool fixRing_publishFixes (FixRing * ring)
+{
+    if (publishing != NULL)
+        return publishing == ring ;
+
+    if (! gpsFix_subscribe (publishFix))
+        return false ;
+
+    // every fix, not only those of an acquisition
+    gps_startStreaming () ;
+
+    publishing = ring ;
+    return true ;
+}
+
+
+void fixRing_stopPublishing (void)
+{
+    if (publishing == NULL)
+        return ;
+
+    gps_stopStreaming () ;
+    gpsFix_unsubscribe (publishFix) ;
+
+    publishing = NULL ;
+}
+
+
+
+FixRing * fixRing_attach (const char * name)
+{
+    char path [64] ;
+    snprintf (path, sizeof (path), "/%s", name) ;
+
+    int fd = shm_open (path, O_RDONLY, 0) ;
+    if (fd < 0)
+        return NULL ;
+
+    struct stat status ;
+    void * mapping = MAP_FAILED ;
+
+    if ((fstat (fd, & status) == 0) && ((size_t) status.st_size >= sizeof (RingHeader)))
+        mapping = mmap (NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0) ;
+
+    close (fd) ;
+
+    if (mapping == MAP_FAILED)
+        return NULL ;
+
+    const RingHeader * header = (const RingHeader *) mapping ;
+    bool ok = (memcmp (header->magic, RingMagic, sizeof (RingMagic)) == 0) ;
+
+    atomic_thread_fence (memory_order_acquire) ;
+
+    ok = ok && (header->version  == RingVersion) &&
+               (header->fixSize  == sizeof (GpsFix)) &&
+               (header->capacity != 0) && ((header->capacity & (header->capacity - 1)) == 0) &&
+               ((size_t) status.st_size >= ringLength (header->capacity)) ;
+
+    if (! ok)
+    {
+        munmap (mapping, status.st_size) ;
+        return NULL ;
+    }
+
+    return newRing (mapping, status.st_size, false, name) ;
+}
+
+
+void fixRing_detach (FixRing * ring)
+{
+    fixRing_destroy (ring) ;
+}
+
+
+void fixRing_initializeReader (FixRingReader * reader, FixRing * ring)
+{
+    reader->ring = ring ;
+    reader->next = ring->header->head.load (memory_order_acquire) ;
+}
+
+
+
+static FixRingStatus nextSlot (FixRingReader * reader, const RingSlot ** slot, uint64_t * lost)
+{
+    // find the next fix that is still in the ring, skipping ahead if the writer lapped the reader
+    FixRing * ring = reader->ring ;
+
+    * lost = 0 ;
+
+    while (1)
+    {
+        if (ring->header->closed.load (memory_order_acquire))
+            return FixRing_Closed ;
+
+        uint64_t head = ring->header->head.load (memory_order_acquire) ;
+
+        if (reader->next >= head)
+            return FixRing_Empty ;
+
+        if (head - reader->next > ring->header->capacity)
+        {
+            * lost      += head - ring->header->capacity - reader->next ;
+            reader->next = head - ring->header->capacity ;
+        }
+
+        * slot = & ring->slots [reader->next & ring->mask] ;
+
+        if ((* slot)->sequence.load (memory_order_acquire) == 2 * reader->next + 2)
+            return (* lost != 0) ? FixRing_Overrun : FixRing_Ok ;
+
+        // overwritten since head was read
+        ++ * lost ;
+        ++ reader->next ;
+    }
+}
+
+
+static bool slotUnchanged (const FixRingReader * reader, const RingSlot * slot)
+{
+    atomic_thread_fence (memory_order_acquire) ;
+
+    return slot->sequence.load (memory_order_relaxed) == 2 * reader->next + 2 ;
+}
+
+
+FixRingStatus fixRing_read (FixRingReader * reader, GpsFix * fix, uint64_t * lost)
+{
+    uint64_t skipped = 0 ;
+
+    while (1)
+    {
+        const RingSlot * slot ;
+        uint64_t         missed ;
+
+        FixRingStatus status = nextSlot (reader, & slot, & missed) ;
+        skipped += missed ;
+
+        if ((status == FixRing_Empty) || (status == FixRing_Closed))
+        {
+            * lost = skipped ;
+            return status ;
+        }
+
+        memcpy (fix, & slot->fix, sizeof (GpsFix)) ;
+
+        bool ok = slotUnchanged (reader, slot) ;
+        ++ reader->next ;
+
+        if (ok)
+        {
+            * lost = skipped ;
+            return (skipped != 0) ? FixRing_Overrun : FixRing_Ok ;
+        }
+
+        // torn, the writer got there first
+        ++ skipped ;
+    }
+}
+
+
+const GpsFix * fixRing_peek (FixRingReader * reader, uint64_t * lost)
+{
+    const RingSlot * slot ;
+
+    FixRingStatus status = nextSlot (reader, & slot, lost) ;
+
+    return ((status == FixRing_Ok) || (status == FixRing_Overrun)) ? & slot->fix : NULL ;
+}
+
+
+bool fixRing_release (FixRingReader * reader)
+{
+    const RingSlot * slot = & reader->ring->slots [reader->next & reader->ring->mask] ;
+
+    bool ok = slotUnchanged (reader, slot) ;
+    ++ reader->next ;
+
+    return ok ;
+}
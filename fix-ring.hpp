@@ -0,0 +1,72 @@
+#ifndef _FIX_RING_H_
+#define _FIX_RING_H_
+
+#include "gps-fix.hpp"
+
+#include <stdint.h>
+
+
+// fixes shared with other processes through a ring in /dev/shm
+//
+//      one process owns the receiver and publishes each fix, any number of readers map the ring
+//      read only and follow it at their own pace, with no socket and no syscall per fix
+//      the writer never waits for readers: a reader that falls more than a ring behind is told
+//      how many fixes it lost and skips to the oldest one still there
+//
+//      each slot has a sequence number that is odd while the slot is being written, a reader
+//      checks it before and after using the slot, so a torn read is always detected
+//      the slots hold GpsFix as is, so writer and readers must be built from the same gps-fix.hpp
+//      (the ring records sizeof (GpsFix) and attaching fails on a mismatch)
+//      a restarted writer creates a new ring, readers of the old one see FixRing_Closed and attach again
+
+
+typedef struct FixRing FixRing ;
+
+typedef struct
+{
+    FixRing *   ring ;
+    uint64_t    next ;          // sequence number of the next fix to read
+} FixRingReader ;
+
+typedef enum
+{
+    FixRing_Ok,
+    FixRing_Empty,
+    FixRing_Overrun,            // fixes were lost, reading continues from the oldest one left
+    FixRing_Closed,             // the writer has gone, attach again
+} FixRingStatus ;
+
+
+// writer ...
+
+// capacity is rounded up to a power of 2, the name is a /dev/shm file name such as "gps-fixes"
+//      a ring left under the name by a writer that didn't destroy it is closed and replaced
+FixRing * fixRing_create  (const char * name, uint32_t capacity) ;
+void      fixRing_destroy (FixRing *) ;         // unmaps and removes the ring
+
+void fixRing_publish (FixRing *, const GpsFix *) ;
+
+// publish every fix assembled by gps-fix, to one ring, with the receiver streaming until stopped
+bool fixRing_publishFixes     (FixRing *) ;
+void fixRing_stopPublishing   (void) ;
+
+
+// readers ...
+
+FixRing * fixRing_attach (const char * name) ;  // NULL if missing or built with another GpsFix
+void      fixRing_detach (FixRing *) ;
+
+// start at the next fix to be published
+void fixRing_initializeReader (FixRingReader *, FixRing *) ;
+
+// copy the next fix, lost is set to the number of fixes skipped on an overrun
+FixRingStatus fixRing_read (FixRingReader *, GpsFix *, uint64_t * lost) ;
+
+// zero copy: use the next fix in place, then check it wasn't overwritten while it was used
+//      fixRing_peek () returns NULL if there is nothing new or the ring is closed, lost is as for fixRing_read ()
+//      fixRing_release () returns false if the fix was overwritten, and moves on to the next fix
+const GpsFix * fixRing_peek    (FixRingReader *, uint64_t * lost) ;
+bool           fixRing_release (FixRingReader *) ;
+
+
+#endif
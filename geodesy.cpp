@@ -0,0 +1,453 @@
+#include "geodesy.hpp"
+
+#include <math.h>
+#include <stdint.h>
+
+
+
+static const double Pi = 3.14159265358979323846 ;
+
+// minutes_x1e5 to radians
+static const double RadiansPerUnit = Pi / (180.0 * 60 * 100000) ;
+
+static const int64_t UnitsPerCircle = 360ll * 60 * 100000 ;
+static const int64_t UnitsPerPole   =  90ll * 60 * 100000 ;
+
+static const double MeanRadius = 6371008.8 ;                // metres
+
+// WGS84
+static const double SemiMajorAxis = 6378137.0 ;
+static const double Flattening    = 1 / 298.257223563 ;
+static const double SemiMinorAxis = SemiMajorAxis * (1 - Flattening) ;
+static const double Eccentricity2 = Flattening * (2 - Flattening) ;
+
+
+
+// single precision approximations, without branches so loops using them vectorize
+//      (sqrtf() also needs -fno-math-errno for that)
+
+static inline float fastCos (float x)
+{
+    // reduce to -pi .. pi, then to 0 .. pi/2 with the sign flipped for the outer half
+    x -= (float) (2 * Pi) * rintf (x * (float) (1 / (2 * Pi))) ;
+
+    float a    = fabsf (x) ;
+    bool  flip = a > (float) (Pi / 2) ;
+    a = flip ? (float) Pi - a : a ;
+
+    // to a^10, a few 1e-7 at pi/2 (to a^8 it is 2.5e-5 there, a lateral 25 m in 1000 km)
+    float a2 = a * a ;
+    float c  = 1 + a2 * (-1.0f / 2 + a2 * (1.0f / 24 + a2 * (-1.0f / 720 + a2 * (1.0f / 40320 + a2 * (-1.0f / 3628800))))) ;
+
+    return flip ? -c : c ;
+}
+
+
+static inline float fastSin (float x)
+{
+    return fastCos (x - (float) (Pi / 2)) ;
+}
+
+
+// metres per minute_x1e5 north and east at a latitude, from the WGS84 radii of curvature there
+//      the mean radius alone is out by up to 0.5%, east-west at mid latitudes by 0.3%
+
+static inline void metresPerUnit (float latitude, float * north, float * east)
+{
+    float c  = fastCos (latitude) ;
+    float w2 = 1 - (float) Eccentricity2 * (1 - c * c) ;
+    float w  = sqrtf (w2) ;
+
+    * north = (float) (RadiansPerUnit * SemiMajorAxis * (1 - Eccentricity2)) / (w2 * w) ;
+    * east  = (float) (RadiansPerUnit * SemiMajorAxis) * c / w ;
+}
+
+
+static inline float fastAtan2 (float y, float x)
+{
+    // minimax polynomial for atan on 0 .. 1, about 1e-5 radians
+
+    float ax = fabsf (x) ;
+    float ay = fabsf (y) ;
+
+    float big   = fmaxf (ax, ay) ;
+    float small = fminf (ax, ay) ;
+    float z     = small / fmaxf (big, 1e-30f) ;
+    float z2    = z * z ;
+
+    float r = z * (0.99997726f + z2 * (-0.33262347f + z2 * (0.19354346f + z2 * (-0.11643287f + z2 * (0.05265332f + z2 * -0.01172120f))))) ;
+
+    r = (ay > ax) ? (float) (Pi / 2) - r : r ;
+    r = (x < 0)   ? (float)  Pi      - r : r ;
+
+    return (y < 0) ? -r : r ;
+}
+
+
+static inline float longitudeDifference (int32_t from, int32_t to)
+{
+    // the short way round
+    int64_t difference = (int64_t) to - from ;
+
+    difference -= (difference >  UnitsPerCircle / 2) ? UnitsPerCircle : 0 ;
+    difference += (difference < -UnitsPerCircle / 2) ? UnitsPerCircle : 0 ;
+
+    return (float) difference ;
+}
+
+
+static int32_t limitLatitude (int64_t units)
+{
+    if (units >  UnitsPerPole)  units =  UnitsPerPole ;
+    if (units < -UnitsPerPole)  units = -UnitsPerPole ;
+
+    return (int32_t) units ;
+}
+
+
+
+// great circle on the mean radius, the fallback for Vincenty
+
+static void greatCircle (double lat1, double lon1, double lat2, double lon2, double * metres, double * azimuth)
+{
+    double dLat = lat2 - lat1 ;
+    double dLon = lon2 - lon1 ;
+
+    double h = sin (dLat / 2) * sin (dLat / 2) + cos (lat1) * cos (lat2) * sin (dLon / 2) * sin (dLon / 2) ;
+
+    * metres  = 2 * MeanRadius * asin (sqrt (fmin (h, 1.0))) ;
+    * azimuth = atan2 (sin (dLon) * cos (lat2), cos (lat1) * sin (lat2) - sin (lat1) * cos (lat2) * cos (dLon)) ;
+}
+
+
+
+static void vincentyInverse (double lat1, double lon1, double lat2, double lon2, double * metres, double * azimuth)
+{
+    // T. Vincenty, Survey Review XXIII, 1975
+
+    double U1 = atan ((1 - Flattening) * tan (lat1)) ;
+    double U2 = atan ((1 - Flattening) * tan (lat2)) ;
+
+    double sinU1 = sin (U1), cosU1 = cos (U1) ;
+    double sinU2 = sin (U2), cosU2 = cos (U2) ;
+
+    double L = lon2 - lon1 ;
+    if (L >  Pi)    L -= 2 * Pi ;
+    if (L < -Pi)    L += 2 * Pi ;
+
+    double lambda = L ;
+
+    double sinSigma, cosSigma, sigma, cosSqAlpha, cos2SigmaM, sinLambda, cosLambda ;
+
+    for (uint8_t iteration = 0 ; ; iteration ++)
+    {
+        if (iteration == 100)
+        {
+            // nearly antipodal, doesn't converge
+            greatCircle (lat1, lon1, lat2, lon2, metres, azimuth) ;
+            return ;
+        }
+
+        sinLambda = sin (lambda) ;
+        cosLambda = cos (lambda) ;
+
+        double a = cosU2 * sinLambda ;
+        double b = cosU1 * sinU2 - sinU1 * cosU2 * cosLambda ;
+
+        sinSigma = sqrt (a * a + b * b) ;
+        if (sinSigma == 0)
+        {
+            // same point
+            * metres = * azimuth = 0 ;
+            return ;
+        }
+
+        cosSigma = sinU1 * sinU2 + cosU1 * cosU2 * cosLambda ;
+        sigma    = atan2 (sinSigma, cosSigma) ;
+
+        double sinAlpha = cosU1 * cosU2 * sinLambda / sinSigma ;
+        cosSqAlpha = 1 - sinAlpha * sinAlpha ;
+
+        // on the equator cosSqAlpha is 0
+        cos2SigmaM = (cosSqAlpha != 0) ? cosSigma - 2 * sinU1 * sinU2 / cosSqAlpha : 0 ;
+
+        double C = Flattening / 16 * cosSqAlpha * (4 + Flattening * (4 - 3 * cosSqAlpha)) ;
+
+        double previous = lambda ;
+        lambda = L + (1 - C) * Flattening * sinAlpha *
+                 (sigma + C * sinSigma * (cos2SigmaM + C * cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM))) ;
+
+        if (fabs (lambda - previous) < 1e-12)
+            break ;
+    }
+
+    double uSq = cosSqAlpha * (SemiMajorAxis * SemiMajorAxis - SemiMinorAxis * SemiMinorAxis) / (SemiMinorAxis * SemiMinorAxis) ;
+    double A   = 1 + uSq / 16384 * (4096 + uSq * (-768 + uSq * (320 - 175 * uSq))) ;
+    double B   =     uSq /  1024 * ( 256 + uSq * (-128 + uSq * ( 74 -  47 * uSq))) ;
+
+    double deltaSigma = B * sinSigma * (cos2SigmaM + B / 4 * (cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM) -
+                        B / 6 * cos2SigmaM * (-3 + 4 * sinSigma * sinSigma) * (-3 + 4 * cos2SigmaM * cos2SigmaM))) ;
+
+    * metres  = SemiMinorAxis * A * (sigma - deltaSigma) ;
+    * azimuth = atan2 (cosU2 * sinLambda, cosU1 * sinU2 - sinU1 * cosU2 * cosLambda) ;
+}
+
+
+static void vincentyDirect (double lat1, double lon1, double azimuth, double metres, double * lat2, double * lon2)
+{
+    double sinAlpha1 = sin (azimuth) ;
+    double cosAlpha1 = cos (azimuth) ;
+
+    double tanU1 = (1 - Flattening) * tan (lat1) ;
+    double cosU1 = 1 / sqrt (1 + tanU1 * tanU1) ;
+    double sinU1 = tanU1 * cosU1 ;
+
+    double sigma1     = atan2 (tanU1, cosAlpha1) ;
+    double sinAlpha   = cosU1 * sinAlpha1 ;
+    double cosSqAlpha = 1 - sinAlpha * sinAlpha ;
+
+    double uSq = cosSqAlpha * (SemiMajorAxis * SemiMajorAxis - SemiMinorAxis * SemiMinorAxis) / (SemiMinorAxis * SemiMinorAxis) ;
+    double A   = 1 + uSq / 16384 * (4096 + uSq * (-768 + uSq * (320 - 175 * uSq))) ;
+    double B   =     uSq /  1024 * ( 256 + uSq * (-128 + uSq * ( 74 -  47 * uSq))) ;
+
+    double sigma = metres / (SemiMinorAxis * A) ;
+    double sinSigma, cosSigma, cos2SigmaM ;
+
+    for (uint8_t iteration = 0 ; iteration < 100 ; iteration ++)
+    {
+        cos2SigmaM = cos (2 * sigma1 + sigma) ;
+        sinSigma   = sin (sigma) ;
+        cosSigma   = cos (sigma) ;
+
+        double deltaSigma = B * sinSigma * (cos2SigmaM + B / 4 * (cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM) -
+                            B / 6 * cos2SigmaM * (-3 + 4 * sinSigma * sinSigma) * (-3 + 4 * cos2SigmaM * cos2SigmaM))) ;
+
+        double previous = sigma ;
+        sigma = metres / (SemiMinorAxis * A) + deltaSigma ;
+
+        if (fabs (sigma - previous) < 1e-12)
+            break ;
+    }
+
+    cos2SigmaM = cos (2 * sigma1 + sigma) ;
+    sinSigma   = sin (sigma) ;
+    cosSigma   = cos (sigma) ;
+
+    double x = sinU1 * sinSigma - cosU1 * cosSigma * cosAlpha1 ;
+
+    * lat2 = atan2 (sinU1 * cosSigma + cosU1 * sinSigma * cosAlpha1, (1 - Flattening) * sqrt (sinAlpha * sinAlpha + x * x)) ;
+
+    double lambda = atan2 (sinSigma * sinAlpha1, cosU1 * cosSigma - sinU1 * sinSigma * cosAlpha1) ;
+    double C      = Flattening / 16 * cosSqAlpha * (4 + Flattening * (4 - 3 * cosSqAlpha)) ;
+    double L      = lambda - (1 - C) * Flattening * sinAlpha *
+                    (sigma + C * sinSigma * (cos2SigmaM + C * cosSigma * (-1 + 2 * cos2SigmaM * cos2SigmaM))) ;
+
+    * lon2 = lon1 + L ;
+}
+
+
+
+// the public functions come in float and double, the Vincenty results are only rounded to the
+// output type, the equirectangular ones are computed in float either way
+
+template <typename Real>
+static void vincentyDistance (const LatitudeLongitude * from, const LatitudeLongitude * to, Real * metres)
+{
+    double distance, azimuth ;
+
+    vincentyInverse (from-> latitude_minutes_x1e5 * RadiansPerUnit, from->longitude_minutes_x1e5 * RadiansPerUnit,
+                       to-> latitude_minutes_x1e5 * RadiansPerUnit,   to->longitude_minutes_x1e5 * RadiansPerUnit,
+                     & distance, & azimuth) ;
+
+    * metres = (Real) distance ;
+}
+
+
+template <typename Real>
+static void vincentyBearing (const LatitudeLongitude * from, const LatitudeLongitude * to, Real * degrees)
+{
+    double distance, azimuth ;
+
+    vincentyInverse (from-> latitude_minutes_x1e5 * RadiansPerUnit, from->longitude_minutes_x1e5 * RadiansPerUnit,
+                       to-> latitude_minutes_x1e5 * RadiansPerUnit,   to->longitude_minutes_x1e5 * RadiansPerUnit,
+                     & distance, & azimuth) ;
+
+    double bearing = azimuth * (180 / Pi) ;
+    * degrees = (Real) ((bearing < 0) ? bearing + 360 : bearing) ;
+}
+
+
+
+template <typename Real>
+static void distance (GeodesyMode mode, const LatitudeLongitude * from, const LatitudeLongitude * to, Real * metres, size_t count)
+{
+    if (mode == Geodesy_Vincenty)
+    {
+        for (size_t i = 0 ; i < count ; i ++)
+            vincentyDistance (& from [i], & to [i], & metres [i]) ;
+        return ;
+    }
+
+    for (size_t i = 0 ; i < count ; i ++)
+    {
+        float dLat = (float) (to [i].latitude_minutes_x1e5 - from [i].latitude_minutes_x1e5) ;
+        float dLon = longitudeDifference (from [i].longitude_minutes_x1e5, to [i].longitude_minutes_x1e5) ;
+
+        float meanLatitude = ((float) from [i].latitude_minutes_x1e5 + (float) to [i].latitude_minutes_x1e5) * (float) (RadiansPerUnit / 2) ;
+
+        float north, east ;
+        metresPerUnit (meanLatitude, & north, & east) ;
+
+        float x = dLon * east ;
+        float y = dLat * north ;
+
+        metres [i] = (Real) sqrtf (x * x + y * y) ;
+    }
+}
+
+
+template <typename Real>
+static void distanceFrom (GeodesyMode mode, const LatitudeLongitude * origin, const LatitudeLongitude * points, Real * metres, size_t count)
+{
+    if (mode == Geodesy_Vincenty)
+    {
+        for (size_t i = 0 ; i < count ; i ++)
+            vincentyDistance (origin, & points [i], & metres [i]) ;
+        return ;
+    }
+
+    int32_t originLatitude  = origin-> latitude_minutes_x1e5 ;
+    int32_t originLongitude = origin->longitude_minutes_x1e5 ;
+
+    for (size_t i = 0 ; i < count ; i ++)
+    {
+        float dLat = (float) (points [i].latitude_minutes_x1e5 - originLatitude) ;
+        float dLon = longitudeDifference (originLongitude, points [i].longitude_minutes_x1e5) ;
+
+        float meanLatitude = ((float) originLatitude + (float) points [i].latitude_minutes_x1e5) * (float) (RadiansPerUnit / 2) ;
+
+        float north, east ;
+        metresPerUnit (meanLatitude, & north, & east) ;
+
+        float x = dLon * east ;
+        float y = dLat * north ;
+
+        metres [i] = (Real) sqrtf (x * x + y * y) ;
+    }
+}
+
+
+template <typename Real>
+static void bearing (GeodesyMode mode, const LatitudeLongitude * from, const LatitudeLongitude * to, Real * degrees, size_t count)
+{
+    if (mode == Geodesy_Vincenty)
+    {
+        for (size_t i = 0 ; i < count ; i ++)
+            vincentyBearing (& from [i], & to [i], & degrees [i]) ;
+        return ;
+    }
+
+    for (size_t i = 0 ; i < count ; i ++)
+    {
+        float dLat = (float) (to [i].latitude_minutes_x1e5 - from [i].latitude_minutes_x1e5) ;
+        float dLon = longitudeDifference (from [i].longitude_minutes_x1e5, to [i].longitude_minutes_x1e5) ;
+
+        float meanLatitude = ((float) from [i].latitude_minutes_x1e5 + (float) to [i].latitude_minutes_x1e5) * (float) (RadiansPerUnit / 2) ;
+
+        float north, east ;
+        metresPerUnit (meanLatitude, & north, & east) ;
+
+        float angle = fastAtan2 (dLon * east, dLat * north) * (float) (180 / Pi) ;
+
+        degrees [i] = (Real) (angle + ((angle < 0) ? 360.0f : 0.0f)) ;
+    }
+}
+
+
+template <typename Real>
+static void destination (GeodesyMode mode, const LatitudeLongitude * from, const Real * degrees, const Real * metres,
+                         LatitudeLongitude * to, size_t count)
+{
+    if (mode == Geodesy_Vincenty)
+    {
+        for (size_t i = 0 ; i < count ; i ++)
+        {
+            double lat2, lon2 ;
+
+            vincentyDirect (from [i].latitude_minutes_x1e5 * RadiansPerUnit, from [i].longitude_minutes_x1e5 * RadiansPerUnit,
+                            degrees [i] * (Pi / 180), metres [i], & lat2, & lon2) ;
+
+            to [i].latitude_minutes_x1e5  = limitLatitude (llrint (lat2 / RadiansPerUnit)) ;
+            to [i].longitude_minutes_x1e5 = latitudeLongitude_wrapLongitude (llrint (lon2 / RadiansPerUnit)) ;
+        }
+        return ;
+    }
+
+    for (size_t i = 0 ; i < count ; i ++)
+    {
+        float bearing = (float) degrees [i] * (float) (Pi / 180) ;
+
+        float latitude = from [i].latitude_minutes_x1e5 * (float) RadiansPerUnit ;
+
+        float northward = (float) metres [i] * fastCos (bearing) ;
+        float eastward  = (float) metres [i] * fastSin (bearing) ;
+
+        // the radii at the mean latitude, as distance () takes them, from a first step at the start
+        float north, east ;
+        metresPerUnit (latitude, & north, & east) ;
+        metresPerUnit (latitude + northward / north * (float) (RadiansPerUnit / 2), & north, & east) ;
+
+        float dLat = northward / north ;
+        float dLon = eastward  / fmaxf (east, (float) (1e-6 * RadiansPerUnit * SemiMajorAxis)) ;
+
+        to [i].latitude_minutes_x1e5  = limitLatitude ((int64_t) from [i].latitude_minutes_x1e5  + llrintf (dLat)) ;
+        to [i].longitude_minutes_x1e5 = latitudeLongitude_wrapLongitude ((int64_t) from [i].longitude_minutes_x1e5 + llrintf (dLon)) ;
+    }
+}
+
+
+
+void geodesy_distance (GeodesyMode mode, const LatitudeLongitude * from, const LatitudeLongitude * to, float * metres, size_t count)
+{
+    distance (mode, from, to, metres, count) ;
+}
+
+void geodesy_distance (GeodesyMode mode, const LatitudeLongitude * from, const LatitudeLongitude * to, double * metres, size_t count)
+{
+    distance (mode, from, to, metres, count) ;
+}
+
+
+void geodesy_distanceFrom (GeodesyMode mode, const LatitudeLongitude * origin, const LatitudeLongitude * points, float * metres, size_t count)
+{
+    distanceFrom (mode, origin, points, metres, count) ;
+}
+
+void geodesy_distanceFrom (GeodesyMode mode, const LatitudeLongitude * origin, const LatitudeLongitude * points, double * metres, size_t count)
+{
+    distanceFrom (mode, origin, points, metres, count) ;
+}
+
+
+void geodesy_bearing (GeodesyMode mode, const LatitudeLongitude * from, const LatitudeLongitude * to, float * degrees, size_t count)
+{
+    bearing (mode, from, to, degrees, count) ;
+}
+
+void geodesy_bearing (GeodesyMode mode, const LatitudeLongitude * from, const LatitudeLongitude * to, double * degrees, size_t count)
+{
+    bearing (mode, from, to, degrees, count) ;
+}
+
+
+void geodesy_destination (GeodesyMode mode, const LatitudeLongitude * from, const float * degrees, const float * metres,
+                          LatitudeLongitude * to, size_t count)
+{
+    destination (mode, from, degrees, metres, to, count) ;
+}
+
+void geodesy_destination (GeodesyMode mode, const LatitudeLongitude * from, const double * degrees, const double * metres,
+                          LatitudeLongitude * to, size_t count)
+{
+    destination (mode, from, degrees, metres, to, count) ;
+}
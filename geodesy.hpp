@@ -0,0 +1,55 @@
+#ifndef _GEODESY_H_
+#define _GEODESY_H_
+
+#include "lat-long.hpp"
+
+#include <stddef.h>
+
+
+// distance, bearing and destination over arrays of LatitudeLongitude
+//
+//      Equirectangular     flat earth approximation on the WGS84 radii of curvature at the mean
+//                          latitude, good to ~0.1% below a few tens of km, branch free single
+//                          precision loops the compiler vectorizes
+//      Vincenty            WGS84 ellipsoid, to well under a millimetre, double precision and
+//                          iterative (falls back to the great circle for nearly antipodal points)
+//
+//      positions stay in the integer minutes_x1e5 encoding, differences are taken in integers
+//      before converting, so no precision is lost on large coordinates; that encoding is itself
+//      a grid of 1.85 cm in latitude, which bounds what any method can resolve between positions
+//      distances are metres, bearings are degrees clockwise from true north, 0 .. 360
+//
+//      an equirectangular bearing is the straight line on the latitude/longitude grid, which its
+//      destination follows; it turns from the geodesic's initial bearing by half the convergence of
+//      the meridians, distance x tan (latitude) / 2R: 0.02 degrees over 5 km at 45 degrees, and
+//      0.6 degrees, or 540 m across the track, over 50 km at 70 degrees
+//
+//      each function takes float or double results: float has 24 bits, so a Vincenty distance in
+//      float is rounded to about 1 m at 10,000 km; use double to keep the Vincenty precision
+
+
+typedef enum
+{
+    Geodesy_Equirectangular,
+    Geodesy_Vincenty,
+} GeodesyMode ;
+
+
+// element i is from [i] to to [i]
+void geodesy_distance (GeodesyMode, const LatitudeLongitude * from, const LatitudeLongitude * to, float  * metres,  size_t count) ;
+void geodesy_distance (GeodesyMode, const LatitudeLongitude * from, const LatitudeLongitude * to, double * metres,  size_t count) ;
+void geodesy_bearing  (GeodesyMode, const LatitudeLongitude * from, const LatitudeLongitude * to, float  * degrees, size_t count) ;
+void geodesy_bearing  (GeodesyMode, const LatitudeLongitude * from, const LatitudeLongitude * to, double * degrees, size_t count) ;
+
+// element i is from the one origin to points [i]
+void geodesy_distanceFrom (GeodesyMode, const LatitudeLongitude * origin, const LatitudeLongitude * points, float  * metres, size_t count) ;
+void geodesy_distanceFrom (GeodesyMode, const LatitudeLongitude * origin, const LatitudeLongitude * points, double * metres, size_t count) ;
+
+// element i is from [i] moved metres [i] along bearing degrees [i]
+void geodesy_destination (GeodesyMode, const LatitudeLongitude * from, const float  * degrees, const float  * metres,
+                          LatitudeLongitude * to, size_t count) ;
+void geodesy_destination (GeodesyMode, const LatitudeLongitude * from, const double * degrees, const double * metres,
+                          LatitudeLongitude * to, size_t count) ;
+
+
+#endif
@@ -0,0 +1,479 @@
+#include "geofence.hpp"
+
+#include "gps.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+using namespace std;
+
+
+
+static const int64_t  UnitsPerPole       =  90ll * 60 * 100000 ;
+static const int64_t  UnitsPerHalfCircle = 180ll * 60 * 100000 ;
+
+static const double   Pi            = 3.14159265358979323846 ;
+static const double   UnitsPerMetre = (180.0 * 60 * 100000) / (Pi * 6371008.8) ;
+
+// a grid per level, each cell LevelShift times wider than the level below's; a fence is indexed
+// at the finest level where it touches no more than MaxCellsPerFence cells, and the coarsest
+// level's cells are so big that every fence fits there
+static const uint8_t  CellShift        = 17 ;       // 131072 units, ~1.3 minutes, ~2.4 km of latitude
+static const uint8_t  LevelShift       = 4 ;        // 16 x 16 cells of one level to a cell of the next
+static const uint8_t  Levels           = 4 ;        // ~2.4 km, ~39 km, ~620 km and ~9900 km cells
+static const uint32_t MaxCellsPerFence = 256 ;
+
+static const uint8_t  MaxSubscribers = 4 ;
+
+
+typedef enum
+{
+    Fence_Circle,
+    Fence_Polygon,
+} FenceShape ;
+
+
+typedef struct
+{
+    uint32_t            id ;
+    FenceShape          shape ;
+    LatitudeLongitude   southWest ;         // bounding box
+    LatitudeLongitude   northEast ;
+
+    // circle
+    LatitudeLongitude   centre ;
+    float               radius_units ;      // minutes_x1e5 of latitude
+    float               cosLatitude ;
+
+    // polygon
+    uint32_t            firstVertex ;
+    uint16_t            vertexCount ;
+} Fence ;
+
+
+static vector <Fence>               fences ;
+static vector <LatitudeLongitude>   vertices ;
+
+// the grids, all levels in one sorted index, rebuilt after fences are added
+//      cellFences [cellStart [i] .. cellStart [i + 1]) are the fences touching cell cellKeys [i]
+static bool                         gridValid ;
+static vector <uint64_t>            cellKeys ;
+static vector <uint32_t>            cellStart ;
+static vector <uint32_t>            cellFences ;
+static uint8_t                      levelsUsed ;        // bit per level with any fence
+
+// fence indices the last position was inside, sorted
+static vector <uint32_t>            inside ;
+static vector <uint32_t>            nowInside ;
+
+static GeofenceHandler              subscribers [MaxSubscribers] ;
+static uint8_t                      subscriberCount ;
+static bool                         enabled ;
+
+
+
+static uint64_t cellOf (uint8_t level, int64_t latitude_minutes_x1e5, int64_t longitude_minutes_x1e5)
+{
+    // level in the top bits, so each level's cells sort together
+    uint8_t  shift  = CellShift + level * LevelShift ;
+    uint64_t row    = (uint64_t) (latitude_minutes_x1e5  + UnitsPerPole)       >> shift ;
+    uint64_t column = (uint64_t) (longitude_minutes_x1e5 + UnitsPerHalfCircle) >> shift ;
+
+    return ((uint64_t) level << 60) | (row << 32) | column ;
+}
+
+
+static uint32_t rowOf    (uint64_t cell) { return (uint32_t) (cell >> 32) & 0x0fffffff ; }
+static uint32_t columnOf (uint64_t cell) { return (uint32_t)  cell ; }
+
+
+static void invalidateGrid (void)
+{
+    gridValid = false ;
+}
+
+
+static void buildGrid (void)
+{
+    vector <pair <uint64_t, uint32_t>> entries ;
+
+    levelsUsed = 0 ;
+
+    for (uint32_t f = 0 ; f < fences.size () ; f ++)
+    {
+        const Fence * fence = & fences [f] ;
+
+        uint64_t southWest, northEast ;
+        uint32_t rows, columns ;
+
+        // the finest level it fits, the coarsest always does
+        for (uint8_t level = 0 ; level < Levels ; level ++)
+        {
+            southWest = cellOf (level, fence->southWest.latitude_minutes_x1e5, fence->southWest.longitude_minutes_x1e5) ;
+            northEast = cellOf (level, fence->northEast.latitude_minutes_x1e5, fence->northEast.longitude_minutes_x1e5) ;
+
+            rows    = rowOf    (northEast) - rowOf    (southWest) + 1 ;
+            columns = columnOf (northEast) - columnOf (southWest) + 1 ;
+
+            if ((uint64_t) rows * columns <= MaxCellsPerFence)
+            {
+                levelsUsed |= 1 << level ;
+                break ;
+            }
+        }
+
+        for (uint32_t row = 0 ; row < rows ; row ++)
+            for (uint32_t column = 0 ; column < columns ; column ++)
+                entries.push_back (make_pair (southWest + ((uint64_t) row << 32) + column, f)) ;
+    }
+
+    sort (entries.begin (), entries.end ()) ;
+
+    cellKeys  .clear () ;
+    cellStart .clear () ;
+    cellFences.clear () ;
+    cellFences.reserve (entries.size ()) ;
+
+    for (size_t i = 0 ; i < entries.size () ; i ++)
+    {
+        if ((i == 0) || (entries [i].first != entries [i - 1].first))
+        {
+            cellKeys .push_back (entries [i].first) ;
+            cellStart.push_back ((uint32_t) i) ;
+        }
+
+        cellFences.push_back (entries [i].second) ;
+    }
+
+    cellStart.push_back ((uint32_t) entries.size ()) ;
+
+    gridValid = true ;
+}
+
+
+
+static bool insideCircle (const Fence * fence, const LatitudeLongitude * position)
+{
+    float north = (float) (position-> latitude_minutes_x1e5 - fence->centre. latitude_minutes_x1e5) ;
+    float east  = (float) (position->longitude_minutes_x1e5 - fence->centre.longitude_minutes_x1e5) * fence->cosLatitude ;
+
+    return north * north + east * east <= fence->radius_units * fence->radius_units ;
+}
+
+
+static bool insidePolygon (const Fence * fence, const LatitudeLongitude * position)
+{
+    // even-odd rule, a ray to the east, in integers
+    const LatitudeLongitude * v = & vertices [fence->firstVertex] ;
+
+    int64_t x = position->longitude_minutes_x1e5 ;
+    int64_t y = position-> latitude_minutes_x1e5 ;
+
+    bool in = false ;
+
+    for (uint16_t i = 0, j = fence->vertexCount - 1 ; i < fence->vertexCount ; j = i ++)
+    {
+        int64_t xi = v [i].longitude_minutes_x1e5,  yi = v [i].latitude_minutes_x1e5 ;
+        int64_t xj = v [j].longitude_minutes_x1e5,  yj = v [j].latitude_minutes_x1e5 ;
+
+        if ((yi > y) != (yj > y))
+        {
+            // x < the edge's x at y, without dividing
+            int64_t dy    = yj - yi ;
+            int64_t left  = (x - xi) * dy ;
+            int64_t right = (xj - xi) * (y - yi) ;
+
+            if ((dy > 0) ? (left < right) : (left > right))
+                in = ! in ;
+        }
+    }
+
+    return in ;
+}
+
+
+static bool insideFence (const Fence * fence, const LatitudeLongitude * position)
+{
+    if ((position-> latitude_minutes_x1e5 < fence->southWest. latitude_minutes_x1e5) ||
+        (position-> latitude_minutes_x1e5 > fence->northEast. latitude_minutes_x1e5) ||
+        (position->longitude_minutes_x1e5 < fence->southWest.longitude_minutes_x1e5) ||
+        (position->longitude_minutes_x1e5 > fence->northEast.longitude_minutes_x1e5))
+        return false ;
+
+    return (fence->shape == Fence_Circle) ? insideCircle  (fence, position)
+                                          : insidePolygon (fence, position) ;
+}
+
+
+
+static void publish (uint32_t fence, GeofenceEvent event, const GpsFix * fix)
+{
+    for (uint8_t i = 0 ; i < subscriberCount ; i ++)
+        subscribers [i] (fences [fence].id, event, fix) ;
+}
+
+
+void geofence_update (const GpsFix * fix)
+{
+    if (! fix->positionValid)
+        return ;
+
+    if (! gridValid)
+        buildGrid () ;
+
+    const LatitudeLongitude * position = & fix->smoothedPosition ;
+
+    nowInside.clear () ;
+
+    // one lookup per level in use, each fence is in one level only
+    for (uint8_t level = 0 ; level < Levels ; level ++)
+    {
+        if (! (levelsUsed & (1 << level)))
+            continue ;
+
+        uint64_t cell = cellOf (level, position->latitude_minutes_x1e5, position->longitude_minutes_x1e5) ;
+        vector <uint64_t>::const_iterator found = lower_bound (cellKeys.begin (), cellKeys.end (), cell) ;
+
+        if ((found == cellKeys.end ()) || (* found != cell))
+            continue ;
+
+        size_t c = found - cellKeys.begin () ;
+
+        for (uint32_t i = cellStart [c] ; i < cellStart [c + 1] ; i ++)
+            if (insideFence (& fences [cellFences [i]], position))
+                nowInside.push_back (cellFences [i]) ;
+    }
+
+    sort (nowInside.begin (), nowInside.end ()) ;
+
+    // the differences between the two sorted sets are the events
+    size_t was = 0, now = 0 ;
+
+    while ((was < inside.size ()) || (now < nowInside.size ()))
+    {
+        if ((now == nowInside.size ()) || ((was < inside.size ()) && (inside [was] < nowInside [now])))
+            publish (inside [was ++], Geofence_Exit, fix) ;
+
+        else if ((was == inside.size ()) || (nowInside [now] < inside [was]))
+            publish (nowInside [now ++], Geofence_Enter, fix) ;
+
+        else
+            was ++, now ++ ;
+    }
+
+    inside.swap (nowInside) ;
+}
+
+
+
+static void circleBounds (Fence * fence)
+{
+    int64_t dLat = (int64_t) ceil (fence->radius_units) ;
+
+    // longitude is widest at the pole side of the circle
+    int64_t poleward = min ((int64_t) abs (fence->centre.latitude_minutes_x1e5) + dLat, UnitsPerPole) ;
+    int64_t dLon = (int64_t) ceil (fence->radius_units / fmax (cos ((double) poleward / UnitsPerHalfCircle * Pi), 1e-6)) ;
+
+    fence->southWest. latitude_minutes_x1e5 = (int) max (fence->centre. latitude_minutes_x1e5 - dLat, -UnitsPerPole) ;
+    fence->northEast. latitude_minutes_x1e5 = (int) min (fence->centre. latitude_minutes_x1e5 + dLat,  UnitsPerPole) ;
+    fence->southWest.longitude_minutes_x1e5 = (int) max (fence->centre.longitude_minutes_x1e5 - dLon, -UnitsPerHalfCircle) ;
+    fence->northEast.longitude_minutes_x1e5 = (int) min (fence->centre.longitude_minutes_x1e5 + dLon,  UnitsPerHalfCircle) ;
+}
+
+
+bool geofence_addCircle (uint32_t fenceId, const LatitudeLongitude * centre, float metres)
+{
+    if (! (metres > 0))
+        return false ;
+
+    Fence fence ;
+    memset (& fence, 0, sizeof (fence)) ;
+
+    fence.id           = fenceId ;
+    fence.shape        = Fence_Circle ;
+    fence.centre       = * centre ;
+    fence.radius_units = (float) (metres * UnitsPerMetre) ;
+    fence.cosLatitude  = (float) cos ((double) centre->latitude_minutes_x1e5 / UnitsPerHalfCircle * Pi) ;
+
+    circleBounds (& fence) ;
+
+    fences.push_back (fence) ;
+    invalidateGrid () ;
+
+    return true ;
+}
+
+
+bool geofence_addPolygon (uint32_t fenceId, const LatitudeLongitude * polygon, uint16_t count)
+{
+    if (count < 3)
+        return false ;
+
+    Fence fence ;
+    memset (& fence, 0, sizeof (fence)) ;
+
+    fence.id          = fenceId ;
+    fence.shape       = Fence_Polygon ;
+    fence.firstVertex = (uint32_t) vertices.size () ;
+    fence.vertexCount = count ;
+    fence.southWest   = fence.northEast = polygon [0] ;
+
+    for (uint16_t i = 0 ; i < count ; i ++)
+    {
+        fence.southWest. latitude_minutes_x1e5 = min (fence.southWest. latitude_minutes_x1e5, polygon [i]. latitude_minutes_x1e5) ;
+        fence.southWest.longitude_minutes_x1e5 = min (fence.southWest.longitude_minutes_x1e5, polygon [i].longitude_minutes_x1e5) ;
+        fence.northEast. latitude_minutes_x1e5 = max (fence.northEast. latitude_minutes_x1e5, polygon [i]. latitude_minutes_x1e5) ;
+        fence.northEast.longitude_minutes_x1e5 = max (fence.northEast.longitude_minutes_x1e5, polygon [i].longitude_minutes_x1e5) ;
+    }
+
+    vertices.insert (vertices.end (), polygon, polygon + count) ;
+    fences.push_back (fence) ;
+    invalidateGrid () ;
+
+    return true ;
+}
+
+
+
+static bool parsePosition (const char * text, size_t length, LatitudeLongitude * position)
+{
+    // parsed in place, surrounding spaces and all
+    return latitudeLongitude_fromString (position, string_view (text, length)) ;
+}
+
+
+static bool loadLine (const char * line)
+{
+    while (isspace ((unsigned char) * line))
+        line ++ ;
+
+    if ((* line == 0) || (* line == '#'))
+        return true ;
+
+    char     shape [8] ;
+    unsigned fenceId ;
+    int      consumed ;
+
+    if (sscanf (line, "%7s %u %n", shape, & fenceId, & consumed) != 2)
+        return false ;
+
+    const char * rest = line + consumed ;
+
+    if (strcmp (shape, "circle") == 0)
+    {
+        float metres ;
+        LatitudeLongitude centre ;
+
+        return (sscanf (rest, "%f %n", & metres, & consumed) == 1) &&
+               parsePosition (rest + consumed, strlen (rest + consumed), & centre) &&
+               geofence_addCircle (fenceId, & centre, metres) ;
+    }
+
+    if (strcmp (shape, "polygon") == 0)
+    {
+        vector <LatitudeLongitude> polygon ;
+
+        while (* rest != 0)
+        {
+            const char * end = strchr (rest, ';') ;
+            if (end == NULL)
+                end = rest + strlen (rest) ;
+
+            LatitudeLongitude vertex ;
+            if (! parsePosition (rest, end - rest, & vertex) || (polygon.size () >= 0xffff))
+                return false ;
+
+            polygon.push_back (vertex) ;
+            rest = (* end == ';') ? end + 1 : end ;
+        }
+
+        return geofence_addPolygon (fenceId, polygon.data (), (uint16_t) polygon.size ()) ;
+    }
+
+    return false ;
+}
+
+
+bool geofence_load (const char * path)
+{
+    FILE * file = fopen (path, "r") ;
+    if (file == NULL)
+        return false ;
+
+    char *  line     = NULL ;
+    size_t  capacity = 0 ;
+    bool    ok       = true ;
+
+    while (ok && (getline (& line, & capacity, file) >= 0))
+        ok = loadLine (line) ;
+
+    free (line) ;
+    fclose (file) ;
+
+    return ok ;
+}
+
+
+void geofence_clear (void)
+{
+    fences     .clear () ;
+    vertices   .clear () ;
+    inside     .clear () ;
+    invalidateGrid () ;
+}
+
+
+
+bool geofence_enable (void)
+{
+    if (enabled)
+        return true ;
+
+    enabled = gpsFix_subscribe (geofence_update) ;
+
+    // the fences are watched all the time, not only while an acquisition is busy
+    if (enabled)
+        gps_startStreaming () ;
+
+    return enabled ;
+}
+
+
+void geofence_disable (void)
+{
+    if (! enabled)
+        return ;
+
+    gps_stopStreaming () ;
+    gpsFix_unsubscribe (geofence_update) ;
+
+    enabled = false ;
+}
+
+
+bool geofence_subscribe (GeofenceHandler handler)
+{
+    if (subscriberCount >= MaxSubscribers)
+        return false ;
+
+    subscribers [subscriberCount ++] = handler ;
+    return true ;
+}
+
+
+void geofence_unsubscribe (GeofenceHandler handler)
+{
+    for (uint8_t i = 0 ; i < subscriberCount ; i ++)
+    {
+        if (subscribers [i] == handler)
+        {
+            subscribers [i] = subscribers [-- subscriberCount] ;
+            break ;
+        }
+    }
+}
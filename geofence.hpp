@@ -0,0 +1,60 @@
+#ifndef _GEOFENCE_H_
+#define _GEOFENCE_H_
+
+#include "gps-fix.hpp"
+#include "lat-long.hpp"
+
+#include <stdint.h>
+
+
+// enter/exit events for circular and polygonal fences, evaluated on each published fix
+//
+//      the fences are indexed in a few levels of grid, ~2.4 km cells and each level 16 times
+//      coarser, every fence at the finest level where it touches at most MaxCellsPerFence cells;
+//      a fix is only tested against the few fences that touch its cell at each level, so the
+//      cost per fix doesn't grow with the fence count, however big the fences
+//
+//      the smoothed position is tested, so smoothing (gps-fix.hpp) also damps chatter at the edges
+//      fences are tested in flat latitude/longitude, so keep them clear of the poles and the
+//      antimeridian
+//
+//      not thread safe, add the fences before geofence_enable (), the fixes arrive on the gps reader thread
+
+
+typedef enum
+{
+    Geofence_Enter,
+    Geofence_Exit,
+} GeofenceEvent ;
+
+
+typedef void (* GeofenceHandler) (uint32_t fenceId, GeofenceEvent, const GpsFix *) ;
+
+
+// false if the fence is malformed (polygons need 3 .. 65535 vertices)
+bool geofence_addCircle  (uint32_t fenceId, const LatitudeLongitude * centre, float metres) ;
+bool geofence_addPolygon (uint32_t fenceId, const LatitudeLongitude * vertices, uint16_t count) ;
+
+// one fence per line, positions in the latitudeLongitude_fromString () format
+//      circle  <id> <metres> <position>
+//      polygon <id> <position> ; <position> ; <position> ...
+//      blank lines and lines starting with # are ignored
+// false if the file can't be read, loading stops at the first malformed line
+bool geofence_load (const char * path) ;
+
+// remove all fences, without exit events
+void geofence_clear (void) ;
+
+// test a fix and publish the events, called for each fix while enabled
+void geofence_update (const GpsFix *) ;
+
+// subscribe to the fixes (gps-fix.hpp) assembled from the receiver's output, and keep the receiver
+// streaming them (gps_startStreaming ()) while enabled
+bool geofence_enable  (void) ;
+void geofence_disable (void) ;
+
+bool geofence_subscribe   (GeofenceHandler) ;
+void geofence_unsubscribe (GeofenceHandler) ;
+
+
+#endif
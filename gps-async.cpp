@@ -0,0 +1,422 @@
+#include "gps-async.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const time_t UpdateInterval_s = 60 ;     // gps_updateAcquisition () counts whole minutes
+
+
+static struct {
+    thread              loop ;
+    atomic <bool>       running ;
+    int                 epollFd = -1 ;
+    int                 wakeFd  = -1 ;
+    int                 timerFd = -1 ;
+
+    std::mutex          lock ;                  // the ready list, and acquiring with the timer
+    GpsAsyncNode *      ready ;                 // oldest first
+    GpsAsyncNode **     readyEnd = & ready ;
+
+    uint32_t            acquiring ;             // awaited acquisitions, the timer runs while any are
+} executor ;
+
+
+// the fix consumers, changed on any thread but the reader's, and served on the reader's
+static struct {
+    std::mutex          lock ;
+    GpsNextFix *        waiting ;
+    GpsFixes *          streams ;
+} consumers ;
+
+// the fix subscription and the stream, changed on any thread but the reader's, since stopping
+// the stream waits for the reader
+static struct {
+    std::mutex          lock ;
+    bool                on ;
+} subscription ;
+
+
+
+static void post (GpsAsyncNode * node)
+{
+    // from any thread, resumed in order on the executor's
+    {
+        lock_guard <std::mutex> guard (executor.lock) ;
+
+        node->next          = NULL ;
+        * executor.readyEnd = node ;
+        executor.readyEnd   = & node->next ;
+    }
+
+    uint64_t one = 1 ;
+    if (write (executor.wakeFd, & one, sizeof (one)) != sizeof (one))
+        perror ("gpsAsync") ;
+}
+
+
+static void runReady (void)
+{
+    GpsAsyncNode * node ;
+    {
+        lock_guard <std::mutex> guard (executor.lock) ;
+
+        node = executor.ready ;
+        executor.ready    = NULL ;
+        executor.readyEnd = & executor.ready ;
+    }
+
+    while (node != NULL)
+    {
+        // the node is in the coroutine's frame, which may be gone once it is resumed
+        GpsAsyncNode * next = node->next ;
+        node->coroutine.resume () ;
+        node = next ;
+    }
+}
+
+
+static void setTimer (bool on)
+{
+    struct itimerspec interval = {} ;
+
+    if (on)
+        interval.it_interval.tv_sec = interval.it_value.tv_sec = UpdateInterval_s ;
+
+    timerfd_settime (executor.timerFd, 0, & interval, NULL) ;
+}
+
+
+
+static void onFix (const GpsFix * fix)
+{
+    // on the reader
+    lock_guard <std::mutex> guard (consumers.lock) ;
+
+    for (GpsNextFix * waiter = consumers.waiting ; waiter != NULL ; )
+    {
+        GpsNextFix * next = waiter->next ;
+
+        waiter->fix = * fix ;
+        post (& waiter->node) ;
+
+        waiter = next ;
+    }
+
+    consumers.waiting = NULL ;
+
+    for (GpsFixes * stream = consumers.streams ; stream != NULL ; stream = stream->nextStream)
+    {
+        if (stream->head - stream->tail == GpsFixes::Capacity)
+        {
+            stream->tail ++ ;
+            stream->lost ++ ;
+        }
+
+        stream->buffer [stream->head ++ % GpsFixes::Capacity] = * fix ;
+
+        if (stream->waiting)
+        {
+            stream->waiting = false ;
+            post (& stream->node) ;
+        }
+    }
+}
+
+
+static void updateSubscription (void)
+{
+    // subscribed, and streaming, while anything waits for a fix
+    lock_guard <std::mutex> guard (subscription.lock) ;
+
+    bool wanted ;
+    {
+        lock_guard <std::mutex> guard (consumers.lock) ;
+        wanted = (consumers.waiting != NULL) || (consumers.streams != NULL) ;
+    }
+
+    if (wanted && ! subscription.on)
+    {
+        if (! gpsFix_subscribe (onFix))
+        {
+            fprintf (stderr, "gpsAsync: no room for another fix subscriber\n") ;
+            return ;
+        }
+
+        gps_startStreaming () ;
+        subscription.on = true ;
+    }
+    else if (! wanted && subscription.on)
+    {
+        gpsFix_unsubscribe (onFix) ;
+        gps_stopStreaming () ;
+        subscription.on = false ;
+    }
+}
+
+
+
+static void runLoop (void)
+{
+    static const int MaxEvents = 2 ;
+
+    struct epoll_event events [MaxEvents] ;
+
+    while (executor.running)
+    {
+        int n = epoll_wait (executor.epollFd, events, MaxEvents, -1) ;
+
+        for (int i = 0 ; i < n ; i ++)
+        {
+            uint64_t count ;
+            if (read (events [i].data.fd, & count, sizeof (count)) != sizeof (count))
+                continue ;
+
+            if (events [i].data.fd != executor.timerFd)
+                continue ;
+
+            // the acquisitions' cadence, and the waiters' deadlines
+            gps_updateAcquisition () ;
+
+            lock_guard <std::mutex> guard (executor.lock) ;
+
+            if (executor.acquiring == 0)
+                setTimer (false) ;
+        }
+
+        runReady () ;
+
+        // unsubscribed once the coroutines that were waiting for a fix no longer wait for another
+        updateSubscription () ;
+    }
+}
+
+
+bool gpsAsync_start (void)
+{
+    if (executor.loop.joinable ())
+        return false ;
+
+    executor.epollFd = epoll_create1 (EPOLL_CLOEXEC) ;
+    executor.wakeFd  = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC) ;
+    executor.timerFd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC) ;
+
+    if ((executor.epollFd < 0) || (executor.wakeFd < 0) || (executor.timerFd < 0))
+    {
+        gpsAsync_stop () ;
+        return false ;
+    }
+
+    for (int fd : { executor.wakeFd, executor.timerFd })
+    {
+        struct epoll_event event = {} ;
+        event.events  = EPOLLIN ;
+        event.data.fd = fd ;
+
+        epoll_ctl (executor.epollFd, EPOLL_CTL_ADD, fd, & event) ;
+    }
+
+    {
+        lock_guard <std::mutex> guard (executor.lock) ;
+
+        if (executor.acquiring != 0)
+            setTimer (true) ;
+    }
+
+    executor.running = true ;
+    executor.loop    = thread (runLoop) ;
+
+    return true ;
+}
+
+
+void gpsAsync_stop (void)
+{
+    if (executor.loop.joinable ())
+    {
+        executor.running = false ;
+
+        uint64_t one = 1 ;
+        if (write (executor.wakeFd, & one, sizeof (one)) != sizeof (one))
+            perror ("gpsAsync_stop") ;
+
+        executor.loop.join () ;
+    }
+
+    if (executor.epollFd >= 0)  close (executor.epollFd) ;
+    if (executor.wakeFd  >= 0)  close (executor.wakeFd) ;
+    if (executor.timerFd >= 0)  close (executor.timerFd) ;
+
+    executor.epollFd = executor.wakeFd = executor.timerFd = -1 ;
+}
+
+
+
+static void acquired (GpsWaiter * waiter, bool succeeded)
+{
+    // on the thread calling gps_updateAcquisition () or gps_turnOff ()
+    GpsAcquisition * acquisition = (GpsAcquisition *) waiter->context ;
+
+    acquisition->succeeded = succeeded ;
+    {
+        lock_guard <std::mutex> guard (executor.lock) ;
+        executor.acquiring -- ;
+    }
+
+    post (& acquisition->node) ;
+}
+
+
+void GpsAcquisition::await_suspend (coroutine_handle <> coroutine)
+{
+    // here rather than when it was made, it has been copied since
+    waiter.context = this ;
+    node.coroutine = coroutine ;
+    {
+        lock_guard <std::mutex> guard (executor.lock) ;
+
+        if (executor.acquiring ++ == 0)
+            setTimer (true) ;
+    }
+
+    // the handler may run, and the coroutine be resumed, as soon as the waiter is added
+    if (latLong)
+    {
+        gps_initiateLatLongAcquisition () ;
+        gps_awaitLatLong (& waiter) ;
+    }
+    else
+    {
+        gps_initiateDateTimeAcquisition (includeRtcUpdate) ;
+        gps_awaitDateTime (& waiter) ;
+    }
+}
+
+
+static GpsAcquisition acquisition (bool latLong, time_t deadline, bool includeRtcUpdate)
+{
+    GpsAcquisition awaitable = {} ;
+
+    awaitable.latLong          = latLong ;
+    awaitable.includeRtcUpdate = includeRtcUpdate ;
+    awaitable.waiter.handler   = acquired ;
+    awaitable.waiter.deadline  = deadline ;
+
+    return awaitable ;
+}
+
+
+GpsAcquisition gpsAsync_acquireDateTime (time_t deadline, bool includeRtcUpdate)
+{
+    return acquisition (false, deadline, includeRtcUpdate) ;
+}
+
+
+GpsAcquisition gpsAsync_acquireLatLong (time_t deadline)
+{
+    return acquisition (true, deadline, false) ;
+}
+
+
+
+void GpsNextFix::await_suspend (coroutine_handle <> coroutine)
+{
+    node.coroutine = coroutine ;
+
+    {
+        lock_guard <std::mutex> guard (consumers.lock) ;
+
+        next = consumers.waiting ;
+        consumers.waiting = this ;
+    }
+
+    // this may have been resumed, and be gone, by now
+    updateSubscription () ;
+}
+
+
+GpsNextFix gpsAsync_nextFix (void)
+{
+    return {} ;
+}
+
+
+
+GpsFixes::GpsFixes ()
+{
+    head = tail = lost = 0 ;
+    waiting = false ;
+
+    {
+        lock_guard <std::mutex> guard (consumers.lock) ;
+
+        nextStream = consumers.streams ;
+        consumers.streams = this ;
+    }
+
+    updateSubscription () ;
+}
+
+
+GpsFixes::~GpsFixes ()
+{
+    {
+        lock_guard <std::mutex> guard (consumers.lock) ;
+
+        for (GpsFixes ** link = & consumers.streams ; * link != NULL ; link = & (* link)->nextStream)
+        {
+            if (* link == this)
+            {
+                * link = nextStream ;
+                break ;
+            }
+        }
+    }
+
+    updateSubscription () ;
+}
+
+
+uint32_t GpsFixes::dropped (void) const
+{
+    lock_guard <std::mutex> guard (consumers.lock) ;
+    return lost ;
+}
+
+
+bool GpsFixes::Next::await_ready (void) const
+{
+    // only the consumer takes fixes, so one buffered now is still there to resume with
+    lock_guard <std::mutex> guard (consumers.lock) ;
+    return fixes->head != fixes->tail ;
+}
+
+
+bool GpsFixes::Next::await_suspend (coroutine_handle <> coroutine)
+{
+    lock_guard <std::mutex> guard (consumers.lock) ;
+
+    // a fix arrived since await_ready (), carry on
+    if (fixes->head != fixes->tail)
+        return false ;
+
+    fixes->node.coroutine = coroutine ;
+    fixes->waiting = true ;
+    return true ;
+}
+
+
+GpsFix GpsFixes::Next::await_resume (void) const
+{
+    lock_guard <std::mutex> guard (consumers.lock) ;
+    return fixes->buffer [fixes->tail ++ % GpsFixes::Capacity] ;
+}
@@ -0,0 +1,123 @@
+#ifndef _GPS_ASYNC_H_
+#define _GPS_ASYNC_H_
+
+#include "gps.hpp"
+#include "gps-fix.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <stdint.h>
+#include <time.h>
+
+
+// C++20 coroutines over the acquisitions and the fix stream (build this and its users with -std=c++20)
+//
+//      co_await gpsAsync_acquireDateTime (deadline)   initiates the acquisition, or joins the one
+//      co_await gpsAsync_acquireLatLong  (deadline)   that is busy, true once it has succeeded,
+//                                                     false if it failed, was turned off, or the
+//                                                     deadline (a time () value, 0 for none) passed
+//      co_await gpsAsync_nextFix ()                   the next fix assembled (gps-fix.hpp)
+//      GpsFixes fixes ; co_await fixes.next ()        an async generator of every fix, in order,
+//                                                     buffered while the consumer is busy
+//
+//      every coroutine is resumed on the executor's thread, an epoll loop over an eventfd that
+//      other threads make coroutines ready through, and a timerfd that runs gps_updateAcquisition ()
+//      once a minute while an acquisition is awaited; a suspended coroutine costs its frame and
+//      nothing else, so thousands of them share the one thread without polling anything
+//      the receiver is streamed (gps_startStreaming ()) while anything awaits a fix
+//
+//      start the executor before awaiting anything, coroutines still suspended when it is stopped
+//      are not resumed
+
+
+bool gpsAsync_start (void) ;
+void gpsAsync_stop  (void) ;
+
+
+// a coroutine started straight away and left to run, its frame freed when it returns
+struct GpsTask
+{
+    struct promise_type
+    {
+        GpsTask             get_return_object   (void) noexcept { return {} ; }
+        std::suspend_never  initial_suspend     (void) noexcept { return {} ; }
+        std::suspend_never  final_suspend       (void) noexcept { return {} ; }
+        void                return_void         (void) noexcept {}
+        void                unhandled_exception (void) noexcept { std::terminate () ; }
+    } ;
+} ;
+
+
+// a suspended coroutine on the executor's ready list
+struct GpsAsyncNode
+{
+    std::coroutine_handle <>    coroutine ;
+    GpsAsyncNode *              next ;
+} ;
+
+
+struct GpsAcquisition
+{
+    bool    latLong ;
+    bool    includeRtcUpdate ;
+    bool    succeeded ;
+    GpsWaiter       waiter ;
+    GpsAsyncNode    node ;
+
+    bool await_ready   (void) const noexcept { return false ; }
+    void await_suspend (std::coroutine_handle <>) ;
+    bool await_resume  (void) const noexcept { return succeeded ; }
+} ;
+
+GpsAcquisition gpsAsync_acquireDateTime (time_t deadline = 0, bool includeRtcUpdate = false) ;
+GpsAcquisition gpsAsync_acquireLatLong  (time_t deadline = 0) ;
+
+
+struct GpsNextFix
+{
+    GpsFix          fix ;
+    GpsAsyncNode    node ;
+    GpsNextFix *    next ;
+
+    bool   await_ready   (void) const noexcept { return false ; }
+    void   await_suspend (std::coroutine_handle <>) ;
+    GpsFix await_resume  (void) const noexcept { return fix ; }
+} ;
+
+GpsNextFix gpsAsync_nextFix (void) ;
+
+
+// fixes from construction on, the oldest dropped when Capacity are waiting; only one coroutine
+// awaits next () at a time, and the stream outlives the await
+struct GpsFixes
+{
+    static const uint8_t Capacity = 16 ;
+
+    struct Next
+    {
+        GpsFixes *  fixes ;
+
+        bool   await_ready   (void) const ;
+        bool   await_suspend (std::coroutine_handle <>) ;
+        GpsFix await_resume  (void) const ;
+    } ;
+
+    GpsFixes  () ;
+    ~GpsFixes () ;
+
+    GpsFixes (const GpsFixes &) = delete ;
+    GpsFixes & operator = (const GpsFixes &) = delete ;
+
+    Next     next    (void) { return { this } ; }
+    uint32_t dropped (void) const ;
+
+    GpsFix          buffer [Capacity] ;
+    uint32_t        head, tail ;            // fixes ever buffered, and ever taken
+    uint32_t        lost ;
+    bool            waiting ;
+    GpsAsyncNode    node ;
+    GpsFixes *      nextStream ;
+} ;
+
+
+#endif
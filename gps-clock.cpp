@@ -0,0 +1,208 @@
+#include "gps-clock.hpp"
+
+#include "gps.hpp"
+#include "nmea0183.hpp"
+#include "ntp-shm.hpp"
+#include "ubx.hpp"
+
+#include <string.h>
+#include <time.h>
+
+
+
+static const uint8_t  UbxNavPvt       = 0x07 ;
+static const uint16_t UbxNavPvtLength = 92 ;
+
+static const int      PrecisionNmea   = -6 ;       // ~15 ms, arrival jitter over serial/usb
+static const uint8_t  LatencySamples  = 16 ;
+
+static bool             enabled ;
+static uint8_t          shmUnit ;
+static int64_t          delay_ns ;
+
+static struct timespec  lastEpoch ;                 // arrival of the last epoch published
+
+static int64_t          latencies [LatencySamples] ;
+static uint8_t          latencyCount ;
+static uint8_t          latencyNext ;
+
+
+
+static void publish (const struct timespec * gpsTime, int precision)
+{
+    struct timespec arrival ;
+    nmea0183_getEpochArrival (& arrival) ;
+
+    // one sample per epoch, whichever of NAV-PVT and RMC comes first
+    if ((arrival.tv_sec == 0) ||
+        ((arrival.tv_sec == lastEpoch.tv_sec) && (arrival.tv_nsec == lastEpoch.tv_nsec)))
+        return ;
+
+    lastEpoch = arrival ;
+
+    int64_t latency = (int64_t) (arrival.tv_sec - gpsTime->tv_sec) * 1000000000 + (arrival.tv_nsec - gpsTime->tv_nsec) ;
+
+    latencies [latencyNext] = latency ;
+    latencyNext = (latencyNext + 1) % LatencySamples ;
+    if (latencyCount < LatencySamples)
+        latencyCount ++ ;
+
+    int64_t receive_ns = (int64_t) arrival.tv_nsec - delay_ns ;
+
+    NtpShmSample sample ;
+    sample.clock           = * gpsTime ;
+    sample.receive.tv_sec  = arrival.tv_sec + receive_ns / 1000000000 ;
+    sample.receive.tv_nsec = receive_ns % 1000000000 ;
+    sample.leap            = 0 ;
+    sample.precision       = precision ;
+
+    if (sample.receive.tv_nsec < 0)
+    {
+        sample.receive.tv_nsec += 1000000000 ;
+        sample.receive.tv_sec  -= 1 ;
+    }
+
+    ntpShm_publish (shmUnit, & sample) ;
+}
+
+
+static void onRMC (const NmeaRMC * rmc)
+{
+    if (! rmc->active || ! rmc->time.valid || ! rmc->date.valid)
+        return ;
+
+    struct tm utc ;
+    memset (& utc, 0, sizeof (utc)) ;
+
+    utc.tm_year = rmc->date.year + ((rmc->date.year < 80) ? 100 : 0) ;     // 2 digit year, 1980 .. 2079
+    utc.tm_mon  = rmc->date.month - 1 ;
+    utc.tm_mday = rmc->date.day ;
+    utc.tm_hour = rmc->time.hours ;
+    utc.tm_min  = rmc->time.minutes ;
+    utc.tm_sec  = rmc->time.seconds ;
+
+    struct timespec gpsTime ;
+    gpsTime.tv_sec  = timegm (& utc) ;
+    gpsTime.tv_nsec = rmc->time.hundredths * 10000000l ;
+
+    publish (& gpsTime, PrecisionNmea) ;
+}
+
+
+static uint16_t u16 (const uint8_t * p) { return p [0] | (p [1] << 8) ; }
+static uint32_t u32 (const uint8_t * p) { return p [0] | (p [1] << 8) | (p [2] << 16) | ((uint32_t) p [3] << 24) ; }
+
+
+static void onNAV (uint8_t messageClass, uint8_t messageId, const uint8_t * payload, uint16_t length)
+{
+    (void) messageClass ;
+
+    if ((messageId != UbxNavPvt) || (length < UbxNavPvtLength))
+        return ;
+
+    // validDate, validTime and fullyResolved
+    if ((payload [11] & 0x07) != 0x07)
+        return ;
+
+    struct tm utc ;
+    memset (& utc, 0, sizeof (utc)) ;
+
+    utc.tm_year = u16 (payload + 4) - 1900 ;
+    utc.tm_mon  = payload [6] - 1 ;
+    utc.tm_mday = payload [7] ;
+    utc.tm_hour = payload [8] ;
+    utc.tm_min  = payload [9] ;
+    utc.tm_sec  = payload [10] ;
+
+    // nano is signed, -1e9 .. 1e9, a fraction to add to the rounded seconds
+    int32_t nano = (int32_t) u32 (payload + 16) ;
+
+    struct timespec gpsTime ;
+    gpsTime.tv_sec  = timegm (& utc) ;
+    gpsTime.tv_nsec = nano ;
+
+    if (gpsTime.tv_nsec < 0)
+    {
+        gpsTime.tv_nsec += 1000000000 ;
+        gpsTime.tv_sec  -= 1 ;
+    }
+
+    // the reported time accuracy, rounded up to a power of 2 seconds
+    uint32_t accuracy_ns = u32 (payload + 12) ;
+    int precision = -30 ;
+    while ((precision < 0) && ((1ull << (30 + precision)) < accuracy_ns))
+        precision ++ ;
+
+    publish (& gpsTime, (precision > PrecisionNmea) ? precision : PrecisionNmea) ;
+}
+
+
+
+bool gpsClock_enable (uint8_t unit)
+{
+    if (enabled)
+        gpsClock_disable () ;
+
+    if (! ntpShm_open (unit))
+        return false ;
+
+    shmUnit      = unit ;
+    latencyCount = latencyNext = 0 ;
+    memset (& lastEpoch, 0, sizeof (lastEpoch)) ;
+
+    if (! nmea0183_subscribe (onRMC))
+    {
+        ntpShm_close (unit) ;
+        return false ;
+    }
+
+    if (! ubx_subscribe (UbxClass_NAV, onNAV))
+    {
+        nmea0183_unsubscribe (onRMC) ;
+        ntpShm_close (unit) ;
+        return false ;
+    }
+
+    // samples are wanted all the time, not only while an acquisition is busy
+    gps_startStreaming () ;
+
+    enabled = true ;
+    return true ;
+}
+
+
+void gpsClock_disable (void)
+{
+    if (! enabled)
+        return ;
+
+    gps_stopStreaming () ;
+
+    nmea0183_unsubscribe (onRMC) ;
+    ubx_unsubscribe (UbxClass_NAV, onNAV) ;
+    ntpShm_close (shmUnit) ;
+
+    enabled = false ;
+}
+
+
+void gpsClock_setDelay_ns (int64_t delay)
+{
+    delay_ns = delay ;
+}
+
+
+bool gpsClock_getLatency_ns (int64_t * latency_ns)
+{
+    if (latencyCount == 0)
+        return false ;
+
+    // the minimum rejects the samples that were queued behind other traffic
+    int64_t minimum = latencies [0] ;
+    for (uint8_t i = 1 ; i < latencyCount ; i ++)
+        if (latencies [i] < minimum)
+            minimum = latencies [i] ;
+
+    * latency_ns = minimum ;
+    return true ;
+}
@@ -0,0 +1,31 @@
+#ifndef _GPS_CLOCK_H_
+#define _GPS_CLOCK_H_
+
+#include <stdint.h>
+
+
+// gps time export to ntpd/chrony through the shared memory refclock (see ntp-shm.hpp)
+//
+//      each epoch is timestamped when its first byte arrives (nmea0183_getEpochArrival), and
+//      paired with the epoch's utc time from UBX NAV-PVT (ns resolution) or else RMC
+//      one sample per epoch, the receiver is kept powered and read while enabled (gps_startStreaming ())
+//
+//      the latency estimate is the minimum of (arrival - gps time) over the last samples,
+//      which is the receiver and serial/usb delay only while the host clock is synchronized
+//      from somewhere else: use it to set the delay (or chrony's "offset") once, it is not
+//      applied automatically because that would hide any real clock error
+//
+//      chrony.conf:    refclock SHM 0 refid GPS precision 1e-2 offset 0.0 delay 0.1
+
+
+bool gpsClock_enable  (uint8_t unit) ;
+void gpsClock_disable (void) ;
+
+// subtracted from the arrival time of each sample, default 0
+void gpsClock_setDelay_ns (int64_t delay_ns) ;
+
+// false until there has been a sample
+bool gpsClock_getLatency_ns (int64_t * latency_ns) ;
+
+
+#endif
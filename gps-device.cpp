@@ -0,0 +1,329 @@
+#include "gps-device.hpp"
+
+#include <atomic>
+#include <thread>
+
+#include <dirent.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const size_t     MaxPath       = 256 ;
+static const size_t     MaxEvent      = 8192 ;
+
+static const int        KernelEvents  = 1 ;     // netlink multicast group of the kernel's uevents
+
+
+static struct {
+    GpsDeviceHandler    handler ;
+    uint16_t            vendorId ;
+    uint16_t            productId ;
+    char                sysfsRoot [MaxPath] ;
+    char                devRoot [MaxPath] ;
+    char                current [MaxPath] ;     // watcher thread only
+
+    atomic <bool>       running ;
+    thread              loop ;
+    int                 ueventFd = -1 ;
+    int                 inotifyFd = -1 ;
+    int                 stopFd = -1 ;
+} watcher ;
+
+
+
+static bool readId (const char * path, uint16_t * id)
+{
+    // sysfs ids are 4 hex digits and a newline
+    FILE * file = fopen (path, "r") ;
+    if (file == NULL)
+        return false ;
+
+    char text [16] ;
+    bool ok = (fgets (text, sizeof (text), file) != NULL) ;
+    fclose (file) ;
+
+    char * end ;
+    unsigned long value = ok ? strtoul (text, & end, 16) : 0 ;
+
+    * id = value ;
+    return ok && (end != text) && (value <= 0xffff) ;
+}
+
+
+static bool isReceiver (const char * sysfsRoot, const char * name, uint16_t vendorId, uint16_t productId)
+{
+    // class/tty/<name>/device is the USB interface, its parent is the USB device with the ids
+    //      ".." is resolved after the device symlink, as it is in sysfs
+    char path [MaxPath * 2] ;
+    uint16_t id ;
+
+    snprintf (path, sizeof (path), "%s/class/tty/%s/device/../idVendor", sysfsRoot, name) ;
+    if (! readId (path, & id) || (id != vendorId))
+        return false ;
+
+    if (productId == 0)
+        return true ;
+
+    snprintf (path, sizeof (path), "%s/class/tty/%s/device/../idProduct", sysfsRoot, name) ;
+    return readId (path, & id) && (id == productId) ;
+}
+
+
+bool gpsDevice_find (const char * sysfsRoot, const char * devRoot, uint16_t vendorId, uint16_t productId,
+                     char * path, size_t size)
+{
+    char directory [MaxPath * 2] ;
+    snprintf (directory, sizeof (directory), "%s/class/tty", sysfsRoot) ;
+
+    DIR * ttys = opendir (directory) ;
+    if (ttys == NULL)
+        return false ;
+
+    // the lowest name, so the choice doesn't depend on the directory order
+    char found [MaxPath] = "" ;
+
+    struct dirent * entry ;
+    while ((entry = readdir (ttys)) != NULL)
+    {
+        const char * name = entry->d_name ;
+
+        if ((name [0] == '.') || (strlen (name) >= sizeof (found)))
+            continue ;
+
+        if ((found [0] != 0) && (strcmp (name, found) >= 0))
+            continue ;
+
+        if (isReceiver (sysfsRoot, name, vendorId, productId))
+            strcpy (found, name) ;
+    }
+
+    closedir (ttys) ;
+
+    if (found [0] == 0)
+        return false ;
+
+    int length = snprintf (path, size, "%s/%s", devRoot, found) ;
+    if ((length < 0) || ((size_t) length >= size))
+        return false ;
+
+    // the kernel announces the device before udev has set the node up, inotify reports it when it is there
+    return access (path, F_OK) == 0 ;
+}
+
+
+
+static void rescan (void)
+{
+    char path [MaxPath] ;
+
+    if (! gpsDevice_find (watcher.sysfsRoot, watcher.devRoot, watcher.vendorId, watcher.productId, path, sizeof (path)))
+        path [0] = 0 ;
+
+    if (strcmp (path, watcher.current) == 0)
+        return ;
+
+    strcpy (watcher.current, path) ;
+    watcher.handler (watcher.current) ;
+}
+
+
+static bool isTtyUevent (const char * message, ssize_t length)
+{
+    // "action@devpath" then "KEY=value" strings, each zero terminated
+    for (const char * field = message ; field < message + length ; field += strlen (field) + 1)
+    {
+        if (strcmp (field, "SUBSYSTEM=tty") == 0)
+            return true ;
+    }
+
+    return false ;
+}
+
+
+static bool drainUevents (void)
+{
+    static char message [MaxEvent] ;
+    bool tty = false ;
+
+    while (1)
+    {
+        ssize_t length = recv (watcher.ueventFd, message, sizeof (message) - 1, MSG_DONTWAIT) ;
+        if (length <= 0)
+            return tty ;
+
+        message [length] = 0 ;
+        tty = tty || isTtyUevent (message, length) ;
+    }
+}
+
+
+static bool drainInotify (void)
+{
+    alignas (struct inotify_event) static char events [MaxEvent] ;
+    bool tty = false ;
+
+    while (1)
+    {
+        ssize_t length = read (watcher.inotifyFd, events, sizeof (events)) ;
+        if (length <= 0)
+            return tty ;
+
+        for (char * next = events ; next < events + length ; )
+        {
+            struct inotify_event * event = (struct inotify_event *) next ;
+
+            if ((event->len != 0) && (strncmp (event->name, "tty", 3) == 0))
+                tty = true ;
+
+            next += sizeof (struct inotify_event) + event->len ;
+        }
+    }
+}
+
+
+static void watch (void)
+{
+    struct pollfd fds [3] ;
+    nfds_t count = 0 ;
+
+    fds [count ++] = { watcher.stopFd, POLLIN, 0 } ;
+    if (watcher.ueventFd  >= 0)     fds [count ++] = { watcher.ueventFd,  POLLIN, 0 } ;
+    if (watcher.inotifyFd >= 0)     fds [count ++] = { watcher.inotifyFd, POLLIN, 0 } ;
+
+    while (watcher.running)
+    {
+        if (poll (fds, count, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue ;
+            break ;
+        }
+
+        bool changed = false ;
+
+        for (nfds_t i = 1 ; i < count ; i ++)
+        {
+            if (! (fds [i].revents & POLLIN))
+                continue ;
+
+            // drained in full, so one burst of events (the interface, the tty, the node) is one rescan
+            bool tty = (fds [i].fd == watcher.ueventFd) ? drainUevents () : drainInotify () ;
+            changed = changed || tty ;
+        }
+
+        if (changed && watcher.running)
+            rescan () ;
+    }
+}
+
+
+
+static int openUevents (void)
+{
+    int fd = socket (AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT) ;
+    if (fd < 0)
+        return -1 ;
+
+    struct sockaddr_nl address ;
+    memset (& address, 0, sizeof (address)) ;
+    address.nl_family = AF_NETLINK ;
+    address.nl_groups = KernelEvents ;
+
+    if (bind (fd, (struct sockaddr *) & address, sizeof (address)) != 0)
+    {
+        close (fd) ;
+        return -1 ;
+    }
+
+    return fd ;
+}
+
+
+static int openInotify (const char * devRoot)
+{
+    int fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC) ;
+    if (fd < 0)
+        return -1 ;
+
+    if (inotify_add_watch (fd, devRoot, IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM) < 0)
+    {
+        close (fd) ;
+        return -1 ;
+    }
+
+    return fd ;
+}
+
+
+bool gpsDevice_watch (GpsDeviceHandler handler, uint16_t vendorId, uint16_t productId,
+                      const char * sysfsRoot, const char * devRoot)
+{
+    if (watcher.running)
+        return false ;
+
+    if ((strlen (sysfsRoot) >= MaxPath) || (strlen (devRoot) >= MaxPath))
+        return false ;
+
+    watcher.handler   = handler ;
+    watcher.vendorId  = vendorId ;
+    watcher.productId = productId ;
+    strcpy (watcher.sysfsRoot, sysfsRoot) ;
+    strcpy (watcher.devRoot,   devRoot) ;
+
+    // either source of events will do, netlink may not be available in a container
+    watcher.ueventFd  = openUevents () ;
+    watcher.inotifyFd = openInotify (devRoot) ;
+    watcher.stopFd    = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC) ;
+
+    if (((watcher.ueventFd < 0) && (watcher.inotifyFd < 0)) || (watcher.stopFd < 0))
+    {
+        gpsDevice_stopWatching () ;
+        return false ;
+    }
+
+    // the first report, on this thread, before anything can have been missed
+    watcher.current [0] = 0 ;
+    if (gpsDevice_find (sysfsRoot, devRoot, vendorId, productId, watcher.current, sizeof (watcher.current)))
+        handler (watcher.current) ;
+    else
+    {
+        watcher.current [0] = 0 ;
+        handler ("") ;
+    }
+
+    watcher.running = true ;
+    watcher.loop    = thread (watch) ;
+
+    return true ;
+}
+
+
+void gpsDevice_stopWatching (void)
+{
+    if (watcher.running)
+    {
+        watcher.running = false ;
+
+        uint64_t one = 1 ;
+        if (write (watcher.stopFd, & one, sizeof (one)) != sizeof (one))
+            perror ("gpsDevice_stopWatching") ;
+
+        watcher.loop.join () ;
+    }
+
+    if (watcher.ueventFd  >= 0)     close (watcher.ueventFd) ;
+    if (watcher.inotifyFd >= 0)     close (watcher.inotifyFd) ;
+    if (watcher.stopFd    >= 0)     close (watcher.stopFd) ;
+
+    watcher.ueventFd = watcher.inotifyFd = watcher.stopFd = -1 ;
+}
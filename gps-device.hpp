@@ -0,0 +1,37 @@
+#ifndef _GPS_DEVICE_H_
+#define _GPS_DEVICE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// finding the receiver's USB serial device, and following it when it is re-enumerated
+//
+//      a USB brownout makes the receiver come back as another tty (ttyACM0 becomes ttyACM1):
+//      the tty is found by the USB vendor (and product) id of its device in sysfs, and a watcher
+//      thread rescans on each kernel uevent for a tty (netlink) and on each tty node created or
+//      removed in the device directory (inotify), so a change is reported within milliseconds
+//
+//      the sysfs and device roots are parameters, so a fake tree (class/tty/<name>/device/../idVendor)
+//      and a directory of symlinks to ptys can stand in for the real ones
+
+
+static const uint16_t GpsDevice_UbloxVendorId = 0x1546 ;
+
+
+// called on the watcher thread with the receiver's device path, or "" when it has gone
+typedef void (* GpsDeviceHandler) (const char * path) ;
+
+
+// one scan: the first tty (by name) of a USB device with the vendor id, and the product id unless it is 0
+//      false if there is none, or its device node doesn't exist (yet)
+bool gpsDevice_find (const char * sysfsRoot, const char * devRoot, uint16_t vendorId, uint16_t productId,
+                     char * path, size_t size) ;
+
+// reports the current device (or "") straight away, and then every change
+bool gpsDevice_watch (GpsDeviceHandler, uint16_t vendorId = GpsDevice_UbloxVendorId, uint16_t productId = 0,
+                      const char * sysfsRoot = "/sys", const char * devRoot = "/dev") ;
+void gpsDevice_stopWatching (void) ;
+
+
+#endif
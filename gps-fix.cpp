@@ -0,0 +1,269 @@
+#include "gps-fix.hpp"
+
+#include "nmea0183.hpp"
+#include "position-filter.hpp"
+
+#include <mutex>
+#include <string.h>
+using namespace std;
+
+
+
+static const uint8_t MaxSubscribers = 8 ;       // five in the tree: geofence, gpsd-server, fix-ring, fix-history, position-track
+
+// the list is held while the subscribers run, and changes to it are made one at a time
+//      changing is held while the sentences are subscribed to, but never by the reader, and
+//      subscribersLock never while nmea0183's lock is taken, since the reader holds that first
+static mutex            changing ;
+static mutex            subscribersLock ;
+
+static GpsFixHandler    subscribers [MaxSubscribers] ;
+static uint8_t          subscriberCount ;
+
+static NmeaSentenceType terminalSentence = NmeaSentence_GLL ;
+
+static GpsFix           epoch ;
+static bool             epochHasTime ;
+
+// kept across epochs and updated in place, copied into each published fix
+static SatelliteTable   satellites ;
+
+static bool             smoothing ;
+static PositionFilter   filter ;
+
+
+
+static bool sameTime (const NmeaTime * a, const NmeaTime * b)
+{
+    return (a->hours      == b->hours)   &&
+           (a->minutes    == b->minutes) &&
+           (a->seconds    == b->seconds) &&
+           (a->hundredths == b->hundredths) ;
+}
+
+
+static void resetEpoch (void)
+{
+    memset (& epoch, 0, sizeof (epoch)) ;
+
+    epoch.speed_knots_x1000   =
+    epoch.course_degrees_x100 =
+    epoch.pdop_x100           =
+    epoch.hdop_x100           =
+    epoch.vdop_x100           = -1 ;
+
+    epochHasTime = false ;
+}
+
+
+static void publishEpoch (void)
+{
+    if (epoch.sentences != 0)
+    {
+        epoch.satellites = satellites ;
+
+        epoch.smoothedPosition = epoch.position ;
+        if (smoothing)
+            positionFilter_update (& filter, & epoch, & epoch.smoothedPosition) ;
+
+        lock_guard <mutex> guard (subscribersLock) ;
+
+        for (uint8_t i = 0 ; i < subscriberCount ; i ++)
+            subscribers [i] (& epoch) ;
+    }
+
+    resetEpoch () ;
+}
+
+
+static void beginSentence (const NmeaTime * time)
+{
+    // a sentence with a different time tag means the previous epoch is over
+    if (! time->valid)
+        return ;
+
+    if (epochHasTime && ! sameTime (time, & epoch.time))
+        publishEpoch () ;
+
+    epoch.time   = * time ;
+    epochHasTime = true ;
+}
+
+
+static void endSentence (NmeaSentenceType type)
+{
+    epoch.sentences |= 1 << type ;
+
+    if (type == terminalSentence)
+        publishEpoch () ;
+}
+
+
+static void onRMC (const NmeaRMC * rmc)
+{
+    beginSentence (& rmc->time) ;
+
+    epoch.date = rmc->date ;
+
+    if (rmc->active && rmc->positionValid)
+    {
+        epoch.positionValid = true ;
+        epoch.position      = rmc->position ;
+    }
+
+    epoch.speed_knots_x1000   = rmc->speed_knots_x1000 ;
+    epoch.course_degrees_x100 = rmc->course_degrees_x100 ;
+
+    endSentence (NmeaSentence_RMC) ;
+}
+
+
+static void onGGA (const NmeaGGA * gga)
+{
+    beginSentence (& gga->time) ;
+
+    if (gga->positionValid && (gga->fixQuality != 0))
+    {
+        epoch.positionValid = true ;
+        epoch.position      = gga->position ;
+    }
+
+    epoch.altitudeValid  = gga->altitudeValid ;
+    epoch.altitude_cm    = gga->altitude_cm ;
+    epoch.fixQuality     = gga->fixQuality ;
+    epoch.satellitesUsed = gga->satellitesUsed ;
+
+    if (gga->hdop_x100 >= 0)
+        epoch.hdop_x100 = gga->hdop_x100 ;
+
+    endSentence (NmeaSentence_GGA) ;
+}
+
+
+static void onGSA (const NmeaGSA * gsa)
+{
+    // a multi-constellation receiver sends one GSA per constellation, all with the same DOPs
+
+    epoch.fixType   = gsa->fixType ;
+    epoch.pdop_x100 = gsa->pdop_x100 ;
+    epoch.hdop_x100 = gsa->hdop_x100 ;
+    epoch.vdop_x100 = gsa->vdop_x100 ;
+
+    satelliteTable_updateFromGSA (& satellites, gsa) ;
+
+    endSentence (NmeaSentence_GSA) ;
+}
+
+
+static void onGSV (const NmeaGSV * gsv)
+{
+    satelliteTable_updateFromGSV (& satellites, gsv) ;
+
+    endSentence (NmeaSentence_GSV) ;
+}
+
+
+static void onGLL (const NmeaGLL * gll)
+{
+    beginSentence (& gll->time) ;
+
+    if (! epoch.positionValid && gll->active && gll->positionValid)
+    {
+        epoch.positionValid = true ;
+        epoch.position      = gll->position ;
+    }
+
+    endSentence (NmeaSentence_GLL) ;
+}
+
+
+
+static void unsubscribeSentences (void)
+{
+    // unsubscribing a handler that isn't subscribed does nothing
+    nmea0183_unsubscribe (onRMC) ;
+    nmea0183_unsubscribe (onGGA) ;
+    nmea0183_unsubscribe (onGSA) ;
+    nmea0183_unsubscribe (onGSV) ;
+    nmea0183_unsubscribe (onGLL) ;
+}
+
+
+static bool subscribeSentences (void)
+{
+    // all or none, an epoch can't be assembled without every sentence
+    if (nmea0183_subscribe (onRMC) &&
+        nmea0183_subscribe (onGGA) &&
+        nmea0183_subscribe (onGSA) &&
+        nmea0183_subscribe (onGSV) &&
+        nmea0183_subscribe (onGLL))
+        return true ;
+
+    unsubscribeSentences () ;
+    return false ;
+}
+
+
+bool gpsFix_subscribe (GpsFixHandler handler)
+{
+    lock_guard <mutex> guard (changing) ;
+
+    if (subscriberCount >= MaxSubscribers)
+        return false ;
+
+    if (subscriberCount == 0)
+    {
+        // the reader has no part in the epoch until the sentences are subscribed to
+        resetEpoch () ;
+        satelliteTable_clear (& satellites) ;
+
+        if (! subscribeSentences ())
+            return false ;
+    }
+
+    lock_guard <mutex> list (subscribersLock) ;
+
+    subscribers [subscriberCount ++] = handler ;
+    return true ;
+}
+
+
+void gpsFix_unsubscribe (GpsFixHandler handler)
+{
+    lock_guard <mutex> guard (changing) ;
+
+    {
+        lock_guard <mutex> list (subscribersLock) ;
+
+        for (uint8_t i = 0 ; i < subscriberCount ; i ++)
+        {
+            if (subscribers [i] == handler)
+            {
+                subscribers [i] = subscribers [-- subscriberCount] ;
+                break ;
+            }
+        }
+    }
+
+    if (subscriberCount == 0)
+        unsubscribeSentences () ;
+}
+
+
+void gpsFix_setTerminalSentence (NmeaSentenceType type)
+{
+    terminalSentence = type ;
+}
+
+
+void gpsFix_enableSmoothing (uint16_t alpha_x256, uint16_t beta_x256)
+{
+    positionFilter_initialize (& filter, alpha_x256, beta_x256) ;
+    smoothing = true ;
+}
+
+
+void gpsFix_disableSmoothing (void)
+{
+    smoothing = false ;
+}
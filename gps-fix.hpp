@@ -0,0 +1,61 @@
+#ifndef _GPS_FIX_H_
+#define _GPS_FIX_H_
+
+#include "lat-long.hpp"
+#include "nmea-sentence.hpp"
+#include "satellite-table.hpp"
+
+#include <stdint.h>
+
+
+// one receiver epoch, assembled from all the sentences that share its utc time tag
+//
+//      RMC, GGA and GLL carry the time tag, GSA and GSV are added to the epoch they arrive in
+//      the fix is published when the terminal sentence arrives (GLL unless changed), or
+//      when a sentence with a newer time tag shows that the epoch is over
+
+
+typedef struct
+{
+    NmeaTime            time ;
+    NmeaDate            date ;                  // RMC
+
+    bool                positionValid ;
+    LatitudeLongitude   position ;
+    LatitudeLongitude   smoothedPosition ;      // same as position unless smoothing is on
+    int32_t             speed_knots_x1000 ;     // RMC, < 0 if not reported
+    int32_t             course_degrees_x100 ;   // RMC, < 0 if not reported
+
+    bool                altitudeValid ;
+    int32_t             altitude_cm ;           // GGA, above mean sea level
+    uint8_t             fixQuality ;            // GGA, 0 = invalid, 1 = GPS, 2 = DGPS, ...
+    uint8_t             fixType ;               // GSA, 1 = no fix, 2 = 2D, 3 = 3D
+    uint8_t             satellitesUsed ;        // GGA
+
+    int32_t             pdop_x100 ;             // GSA, < 0 if not reported
+    int32_t             hdop_x100 ;
+    int32_t             vdop_x100 ;
+
+    SatelliteTable      satellites ;            // GSV and GSA, in view, all constellations
+
+    uint8_t             sentences ;             // bit (1 << NmeaSentenceType) for each type seen
+} GpsFix ;
+
+
+typedef void (* GpsFixHandler) (const GpsFix *) ;
+
+// the assembler subscribes to the NMEA sentences it needs only while it has subscribers
+//      false when full, or when nmea0183 has no room for those subscriptions (none are kept then)
+//      safe while the reader runs, but not from a handler, as for nmea0183_subscribe ()
+bool gpsFix_subscribe   (GpsFixHandler) ;
+void gpsFix_unsubscribe (GpsFixHandler) ;
+
+// the sentence the receiver sends last in each epoch
+void gpsFix_setTerminalSentence (NmeaSentenceType) ;
+
+// smooth the published positions once, for all subscribers (see position-filter.hpp)
+void gpsFix_enableSmoothing  (uint16_t alpha_x256, uint16_t beta_x256) ;
+void gpsFix_disableSmoothing (void) ;
+
+
+#endif
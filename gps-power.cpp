@@ -0,0 +1,227 @@
+#include "gps-power.hpp"
+
+#include "serial-tx.hpp"
+#include "ubx.hpp"
+#include "ubx-tx.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+static const uint8_t  RXM_PMREQ   = 0x41 ;
+static const uint8_t  CFG_PM2     = 0x3b ;
+static const uint8_t  CFG_RXM     = 0x11 ;
+
+// RXM-PMREQ flags and wakeup sources
+static const uint32_t PmreqBackup       = 1 << 1 ;
+static const uint32_t PmreqForce        = 1 << 2 ;
+static const uint32_t WakeOnUartRx      = 1 << 3 ;
+
+// CFG-PM2 flags
+static const uint32_t Pm2UpdateEph      = 1 << 12 ;     // keep the ephemeris up to date while cycling
+static const uint32_t Pm2CyclicTracking = 1 << 17 ;
+
+static const uint32_t CyclicUpdatePeriod_ms = 1000 ;
+static const uint32_t CyclicSearchPeriod_ms = 10000 ;   // between attempts when there is no signal
+
+static const uint8_t  WakeBytes = 8 ;                   // any traffic on rx wakes it, and is lost
+
+
+static GpsPowerModel model =
+{
+    70,             // tracking_mW
+    12,             // cyclic_mW
+    45,             // backup_uW
+    30,             // coldStart_s
+    25,             // warmStart_s
+    2,              // hotStart_s
+    1,              // cyclicFix_s
+    4 * 3600,       // ephemerisValid_s
+} ;
+
+static GpsPowerMode mode ;
+static GpsPowerMode suspendedIn ;               // what the receiver was put in after the last look
+
+
+
+static void put32 (uint8_t * out, uint32_t value)
+{
+    out [0] = value ;
+    out [1] = value >>  8 ;
+    out [2] = value >> 16 ;
+    out [3] = value >> 24 ;
+}
+
+
+uint16_t gpsPower_backupRequest (uint8_t * buffer)
+{
+    // the 16 byte form, so the receiver can be woken by the uart rather than only by a timer
+    uint8_t payload [16] ;
+    memset (payload, 0, sizeof (payload)) ;
+
+    payload [0] = 0x00 ;                                // version
+    put32 (& payload  [4], 0) ;                         // duration, 0 = until woken
+    put32 (& payload  [8], PmreqBackup | PmreqForce) ;
+    put32 (& payload [12], WakeOnUartRx) ;
+
+    return ubx_frame (buffer, UbxClass_RXM, RXM_PMREQ, payload, sizeof (payload)) ;
+}
+
+
+uint16_t gpsPower_cyclicConfig (uint8_t * buffer)
+{
+    uint8_t payload [44] ;
+    memset (payload, 0, sizeof (payload)) ;
+
+    payload [0] = 0x01 ;                                // version
+    put32 (& payload  [4], Pm2UpdateEph | Pm2CyclicTracking) ;
+    put32 (& payload  [8], CyclicUpdatePeriod_ms) ;
+    put32 (& payload [12], CyclicSearchPeriod_ms) ;
+    // grid offset, on time and minimum acquisition time 0
+
+    return ubx_frame (buffer, UbxClass_CFG, CFG_PM2, payload, sizeof (payload)) ;
+}
+
+
+uint16_t gpsPower_lowPowerMode (uint8_t * buffer, bool on)
+{
+    uint8_t payload [2] = { 0x08, (uint8_t) (on ? 1 : 0) } ;   // reserved, 1 = power save, 0 = continuous
+
+    return ubx_frame (buffer, UbxClass_CFG, CFG_RXM, payload, sizeof (payload)) ;
+}
+
+
+static void send (const uint8_t * message, uint16_t length)
+{
+    // framed here so the frames can be checked, queued by ubx-tx for the reader to send, and the
+    // CFG ones acknowledged
+    if (! ubxTx_send (message [2], message [3], & message [6], length - UbxOverhead))
+        fprintf (stderr, "gpsPower: the transmit queue is full\n") ;
+}
+
+
+
+void gpsPower_setModel (const GpsPowerModel * newModel) { model = * newModel ; }
+void gpsPower_getModel (GpsPowerModel * copy)           { * copy = model ; }
+
+
+static void estimate (GpsPowerMode candidate, uint32_t interval_s, GpsPowerEstimate * estimate)
+{
+    // energy from the end of one look to the fix of the next, mW * s = mJ
+
+    switch (candidate)
+    {
+        case GpsPower_Off:
+            estimate->timeToFix_s = model.coldStart_s ;
+            estimate->energy_mJ   = (uint64_t) model.tracking_mW * model.coldStart_s ;
+            break ;
+
+        case GpsPower_Backup:
+            estimate->timeToFix_s = (interval_s <= model.ephemerisValid_s) ? model.hotStart_s : model.warmStart_s ;
+            estimate->energy_mJ   = (uint64_t) model.backup_uW * interval_s / 1000 +
+                                    (uint64_t) model.tracking_mW * estimate->timeToFix_s ;
+            break ;
+
+        default:
+            estimate->timeToFix_s = model.cyclicFix_s ;
+            estimate->energy_mJ   = (uint64_t) model.cyclic_mW * interval_s ;
+            break ;
+    }
+}
+
+
+GpsPowerMode gpsPower_choose (const GpsPowerNeeds * needs, GpsPowerEstimate estimates [GpsPowerModes])
+{
+    GpsPowerEstimate own [GpsPowerModes] ;
+    if (estimates == NULL)
+        estimates = own ;
+
+    for (int candidate = 0 ; candidate < GpsPowerModes ; candidate ++)
+        estimate ((GpsPowerMode) candidate, needs->interval_s, & estimates [candidate]) ;
+
+    // the cheapest that is fast enough and within budget, else the fastest within budget,
+    // else the cheapest
+    int cheapestOk = -1, fastestInBudget = -1, cheapest = 0 ;
+
+    for (int candidate = 0 ; candidate < GpsPowerModes ; candidate ++)
+    {
+        const GpsPowerEstimate * e = & estimates [candidate] ;
+
+        bool fast     = (needs->maxTimeToFix_s  == 0) || (e->timeToFix_s <= needs->maxTimeToFix_s) ;
+        bool inBudget = (needs->energyBudget_mJ == 0) || (e->energy_mJ   <= needs->energyBudget_mJ) ;
+
+        if (fast && inBudget && ((cheapestOk < 0) || (e->energy_mJ < estimates [cheapestOk].energy_mJ)))
+            cheapestOk = candidate ;
+
+        if (inBudget && ((fastestInBudget < 0) || (e->timeToFix_s < estimates [fastestInBudget].timeToFix_s)))
+            fastestInBudget = candidate ;
+
+        if (e->energy_mJ < estimates [cheapest].energy_mJ)
+            cheapest = candidate ;
+    }
+
+    if (cheapestOk >= 0)
+        return (GpsPowerMode) cheapestOk ;
+
+    return (GpsPowerMode) ((fastestInBudget >= 0) ? fastestInBudget : cheapest) ;
+}
+
+
+void         gpsPower_setMode (GpsPowerMode newMode) { mode = newMode ; }
+GpsPowerMode gpsPower_getMode (void)                 { return mode ; }
+
+bool gpsPower_isSuspended (void) { return suspendedIn != GpsPower_Off ; }
+
+
+
+void gpsPower_suspend (void)
+{
+    uint8_t message [64] ;
+
+    switch (mode)
+    {
+        case GpsPower_Backup:
+            send (message, gpsPower_backupRequest (message)) ;
+            break ;
+
+        case GpsPower_Cyclic:
+            send (message, gpsPower_cyclicConfig (message)) ;
+            send (message, gpsPower_lowPowerMode (message, true)) ;
+            break ;
+
+        default:
+            // the supply is cut by gps_close()
+            break ;
+    }
+
+    suspendedIn = mode ;
+}
+
+
+void gpsPower_resume (void)
+{
+    static const uint8_t Wake [WakeBytes] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } ;
+
+    uint8_t message [16] ;
+
+    switch (suspendedIn)
+    {
+        case GpsPower_Backup:
+            // the receiver only needs traffic on its rx line, what it gets is discarded
+            if (! serialTx_queue (SerialTx_Config, Wake, sizeof (Wake)))
+                fprintf (stderr, "gpsPower: the transmit queue is full\n") ;
+            break ;
+
+        case GpsPower_Cyclic:
+            // still tracking, back to full power unless it is to stay cyclic
+            if (mode != GpsPower_Cyclic)
+                send (message, gpsPower_lowPowerMode (message, false)) ;
+            break ;
+
+        default:
+            break ;
+    }
+
+    suspendedIn = GpsPower_Off ;
+}
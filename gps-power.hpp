@@ -0,0 +1,86 @@
+#ifndef _GPS_POWER_H_
+#define _GPS_POWER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// what the receiver does between looks, and a policy to choose it
+//
+//      Off         the supply is cut (GPS_EN_N), every look is a cold start
+//      Backup      UBX-RXM-PMREQ backup: only the RTC and the backup RAM (ephemeris, almanac, last
+//                  position) are kept, a few tens of uW, and the next look is a hot start while
+//                  the ephemeris is still valid (about 4 hours), a warm start after that
+//      Cyclic      UBX-CFG-PM2 cyclic tracking: the receiver keeps tracking at a low duty cycle,
+//                  a few mW, and has a fix whenever it is looked at
+//
+//      the policy estimates the energy and time to fix of each per look, from a receiver model,
+//      and picks the cheapest that meets the time to fix, within the energy budget if it can
+//      Off is the default, as before
+
+
+typedef enum
+{
+    GpsPower_Off,
+    GpsPower_Backup,
+    GpsPower_Cyclic,
+
+    GpsPowerModes
+} GpsPowerMode ;
+
+
+typedef struct
+{
+    uint32_t    tracking_mW ;           // acquiring and tracking at full power
+    uint32_t    cyclic_mW ;             // average in cyclic tracking
+    uint32_t    backup_uW ;
+    uint32_t    coldStart_s ;           // time to fix
+    uint32_t    warmStart_s ;
+    uint32_t    hotStart_s ;
+    uint32_t    cyclicFix_s ;           // to the next fix when tracking cyclically
+    uint32_t    ephemerisValid_s ;      // a hot start needs ephemeris no older than this
+} GpsPowerModel ;
+
+
+typedef struct
+{
+    uint32_t    interval_s ;            // between looks
+    uint32_t    maxTimeToFix_s ;        // 0 for no limit
+    uint32_t    energyBudget_mJ ;       // per look, including the time in between, 0 for no limit
+} GpsPowerNeeds ;
+
+
+typedef struct
+{
+    uint32_t    timeToFix_s ;
+    uint64_t    energy_mJ ;             // per look
+} GpsPowerEstimate ;
+
+
+// the model defaults to typical figures for a u-blox M8 on 3 V
+void gpsPower_setModel (const GpsPowerModel *) ;
+void gpsPower_getModel (GpsPowerModel *) ;
+
+// estimates for each mode, indexed by GpsPowerMode, are returned if estimates isn't NULL
+GpsPowerMode gpsPower_choose (const GpsPowerNeeds *, GpsPowerEstimate estimates [GpsPowerModes] = NULL) ;
+
+void         gpsPower_setMode (GpsPowerMode) ;
+GpsPowerMode gpsPower_getMode (void) ;
+
+
+// used by gps_close() and gps_open(): enter the mode after a look, and leave it before the next
+//      the messages are queued (ubx-tx.hpp, serial-tx.hpp), and sent by the reader before it
+//      stops, or as the first thing it does
+void gpsPower_suspend (void) ;
+void gpsPower_resume  (void) ;
+
+bool gpsPower_isSuspended (void) ;     // in backup or cyclic tracking, so it needs resuming
+
+
+// the messages, for checking them
+uint16_t gpsPower_backupRequest (uint8_t * buffer) ;        // UBX-RXM-PMREQ, returns the framed length
+uint16_t gpsPower_cyclicConfig  (uint8_t * buffer) ;        // UBX-CFG-PM2
+uint16_t gpsPower_lowPowerMode  (uint8_t * buffer, bool on) ;   // UBX-CFG-RXM
+
+
+#endif
@@ -1,14 +1,24 @@
 #include "gps.hpp"
 #include "character.h"
+#include "event-log.hpp"
+#include "gps-device.hpp"
+#include "gps-power.hpp"
 #include "lat-long.hpp"
 #include "main-cm4-task.h"
+#include "metrics.hpp"
 #include "nmea0183.hpp"
 #include "osal.h"
 #include "serial-port.h"
+#include "serial-tx.hpp"
+#include "time-source.hpp"
+#include "ubx.hpp"
+#include "ubx-tx.hpp"
 #include <time.h>
 
 #include <stdio.h>
 #include <string.h>
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <thread>
 using namespace std;
@@ -30,65 +40,90 @@ static uint16_t minutesOn ;
 static uint8_t lastUpdateMinutes ;
 
 
-typedef enum { GpsBusy, GpsSucceeded, GpsFailed, GpsStopped } Status ;
+// each acquisition's status, changed without a lock so status queries never wait
+//
+//      Idle, Succeeded, Failed, Stopped  -- initiate -->     Busy
+//      Busy                        -- acquired -->     Succeeded
+//      Busy                        -- timed out -->    Failed
+//      Busy                        -- turned off -->   Stopped
+//
+//      only initiate moves into Busy, and leaving Busy is a compare and swap, so an acquisition
+//      turned off while its read is in flight stays Stopped whatever the read found
+//      Idle is before the first initiate, waiters added then wait for its outcome
+typedef enum { GpsIdle, GpsBusy, GpsSucceeded, GpsFailed, GpsStopped } Status ;
 
 static struct {
-    Status          status ;
+    atomic <Status> status ;
     struct tm       data ;
     bool            includeRtcUpdate ;
+    time_t          started ;
 } dateTime ;
 
 
 static struct {
-    Status          status ;
+    atomic <Status> status ;
     LatLongString   data ;
+    time_t          started ;
 } latLong ;
 
-static std::mutex m;
+// busy guards the power state and the update bookkeeping, it is never held across serial I/O
 static Mutex            busy ;
+static atomic <bool>    powered ;               // as decided with busy held
+static uint16_t         streamers ;             // gps_startStreaming () not yet stopped
 
-static void get_local_time(){
+// the receiver is brought to what was decided once busy is released, gps_close () can take
+// seconds sending what is queued for it; power keeps the opens and closes in order
+static std::mutex       power ;
+static bool             opened ;
 
-    time_t t = time(NULL);
-    struct tm tm = *gmtime(&t);
-    
-    printf("now: %d-%02d-%02d %02d:%02d:%02d\n", tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
-}
+// the reader frames everything the receiver sends, on a thread of its own, for as long as the
+// receiver is powered; the acquisitions only look at what it has found
+static const uint16_t   ReopenDelay_ms = 100 ;  // while the device is gone
 
-static uint16_t cksum_FletcherAlgorithm (uint8_t * data, uint8_t length)
-{
-    uint8_t ck_a = 0 ;
-    uint8_t ck_b = 0 ;
+// the longest the reader is kept for what is still to be sent or answered, once it is no longer needed
+static const uint32_t   DrainTimeout_ms = UbxTx_AckTimeout_ms * UbxTx_MaxAttempts ;
+static const uint16_t   DrainPoll_ms    = 10 ;
 
-    while (length --)
-    {
-        ck_a += * data ++ ;
-        ck_b += ck_a ;
-    }
+// the receiver's UART after it is powered up, until gps_setBaudRate ()
+static const uint32_t   DefaultBaudRate = 9600 ;
 
-    return ck_b * 256 + ck_a ;
-}
+static struct {
+    thread              loop ;
+    atomic <bool>       running ;
+    std::mutex          port ;                  // opening the port, so a cancel isn't lost
+    atomic <uint32_t>   baud ;                  // the port is opened at
+    atomic <uint32_t>   requestedBaud ;         // by the CFG-PRT being sent
+} reader ;
+
+static atomic <bool>    cancelRead ;            // makes nmea0183_run () return, to stop or reopen
 
+static const uint16_t MgaIniTimeAccuracy_s = 2 ;     // whole seconds of the system clock, and the time to write them
 
-void txMessage_UBX_MGA_INI_TIME_UTC (SerialPort * port)
+static void stampTimeUtc (uint8_t * payload, uint16_t, void *)
 {
-    uint8_t message [32] ;
-    uint8_t * msg = message ;
+    // as the message is written, so the time isn't as old as the queue
+    uint8_t * msg = & payload [4] ;
 
-    time_t t = time(NULL);
+    time_t t = timeSource_time ();
     struct tm tm = *gmtime(&t);
 
-    * msg ++ = 0xb5 ;   // sync
-    * msg ++ = 0x62 ;   // sync
+    uint16_t year = tm.tm_year + 1900 ;
+    * msg ++ = year  & 0xff ;   // lsb
+    * msg ++ = year >>    8 ;   // msb
 
-    * msg ++ = 0x13 ;   // class
-    * msg ++ = 0x40 ;   // id
+    * msg ++ = tm.tm_mon + 1 ;  // 1 .. 12
+    * msg ++ = tm.tm_mday ;
 
-    * msg ++ = 24 ;     // payload length lsb
-    * msg ++ =  0 ;     // payload length msb
+    * msg ++ = tm.tm_hour ;
+    * msg ++ = tm.tm_min ;
+    * msg ++ = tm.tm_sec ;
+}
 
 
-    // payload (24 bytes) ...
+bool txMessage_UBX_MGA_INI_TIME_UTC (UbxTxDone done, void * context)
+{
+    uint8_t payload [24] ;
+    uint8_t * msg = payload ;
 
     * msg ++ = 0x10 ;   // type
     * msg ++ = 0x00 ;   // version
@@ -97,16 +132,9 @@ void txMessage_UBX_MGA_INI_TIME_UTC (SerialPort * port)
 
     * msg ++ = 0x80 ;   // leap seconds unknown
 
-    uint16_t year = tm.tm_year ;
-    * msg ++ = year  & 0xff ;   // lsb
-    * msg ++ = year >>    8 ;   // msb
-
-    * msg ++ = tm.tm_mon ;
-    * msg ++ = tm.tm_mday ;
-
-    * msg ++ = tm.tm_hour ;
-    * msg ++ = tm.tm_min ;
-    * msg ++ = tm.tm_sec ;
+    // year, month, day, hour, minute and second, stamped as the message is written
+    for (uint8_t i = 0 ; i < 7 ; i ++)
+        * msg ++ = 0 ;
 
     * msg ++ = 0 ;      // reserved
 
@@ -117,8 +145,8 @@ void txMessage_UBX_MGA_INI_TIME_UTC (SerialPort * port)
     * msg ++ = 0 ;
 
     // seconds part of time accuracy
-    * msg ++ = 0 ;
-    * msg ++ = 0 ;
+    * msg ++ = MgaIniTimeAccuracy_s & 0xff ;
+    * msg ++ = MgaIniTimeAccuracy_s >> 8 ;
 
     * msg ++ = 0 ;      // reserved
     * msg ++ = 0 ;      // reserved
@@ -129,73 +157,316 @@ void txMessage_UBX_MGA_INI_TIME_UTC (SerialPort * port)
     * msg ++ = 0 ;
     * msg ++ = 0 ;
 
+    // queued, and sent by the reader while the receiver is powered (see ubx-tx.hpp)
+    return ubxTx_send (UbxClass_MGA, 0x40, payload, sizeof (payload), done, context, stampTimeUtc) ;
+}
 
-    // cksum ...
 
-    uint16_t cksum = cksum_FletcherAlgorithm (& message [2], sizeof (message) - 4) ;
+static bool finish (atomic <Status> * status, Status outcome)
+{
+    // leave Busy, unless gps_turnOff () got there first
+    Status expected = GpsBusy ;
+    return status->compare_exchange_strong (expected, outcome) ;
+}
 
-    * msg ++ = cksum  & 0xff ;      // lsb
-    * msg ++ = cksum >>    8 ;      // msb
 
-    // transmit the packet to the gps chip
-    msg = message ;
-    uint8_t length = sizeof (message) ;
-    while (length --)
-        serialPort_txByte (port, * msg ++) ;
+static bool anyBusy (void)
+{
+    return (dateTime.status == GpsBusy) || (latLong.status == GpsBusy) ;
+}
+
+
+
+static void readReceiver (void)
+{
+    while (reader.running)
+    {
+        SerialPort * gps_port ;
+        {
+            lock_guard <std::mutex> guard (reader.port) ;
+
+            if (! reader.running)
+                break ;
+
+            cancelRead = FALSE ;
+            gps_port   = serialPort_open (SerialPort_GPS) ;
+        }
+
+        if (gps_port == NULL)
+        {
+            // re-enumerating, deviceChanged () gives the port its new path
+            this_thread::sleep_for (chrono::milliseconds (ReopenDelay_ms)) ;
+            continue ;
+        }
+
+        serialPort_setBaudRate (gps_port, reader.baud);
+
+        // until stopped, the receiver moves to another device, or its baud rate changes
+        nmea0183_run (gps_port, & cancelRead) ;
+
+        serialPort_close (SerialPort_GPS) ;
+    }
+}
+
+
+static void startReader (void)
+{
+    if (reader.loop.joinable ())
+        return ;
+
+    reader.running = TRUE ;
+    reader.loop    = thread (readReceiver) ;
+}
+
+
+static void stopReader (void)
+{
+    if (! reader.loop.joinable ())
+        return ;
+
+    // what is queued for the receiver (gpsPower_suspend ()) goes out, and is answered, first
+    for (uint32_t waited_ms = 0 ; waited_ms < DrainTimeout_ms ; waited_ms += DrainPoll_ms)
+    {
+        if ((serialTx_pendingBytes () == 0) && (ubxTx_outstanding () == 0))
+            break ;
+
+        this_thread::sleep_for (chrono::milliseconds (DrainPoll_ms)) ;
+    }
+
+    {
+        lock_guard <std::mutex> guard (reader.port) ;
+
+        reader.running = FALSE ;
+        cancelRead     = TRUE ;
+    }
+
+    // within one poll of the port, once it is cancelled
+    reader.loop.join () ;
+}
+
+
+static void updatePower (void)
+{
+    // with busy held: powered, and read, while an acquisition or a stream needs the receiver
+    //      the receiver is only opened or closed by applyPower (), once busy is released
+    powered = anyBusy () || (streamers != 0) ;
+}
+
+
+static void applyPower (void)
+{
+    // with busy released: to whatever was decided last, by this thread or another meanwhile
+    lock_guard <std::mutex> guard (power) ;
+
+    while (opened != powered)
+    {
+        opened = powered ;
+
+        if (opened)
+        {
+            gps_open ();
+            metrics_powerOn () ;
+
+            eventLog (EventLog_GpsStarted) ;
+        }
+        else
+        {
+            gps_close ();
+
+            eventLog (EventLog_GpsStopped) ;
+        }
+    }
 }
 
 
 static void initiateAcquisition (void)
 {
-    lastUpdateMinutes = tm.tm_min % 60 ;
+    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
+
+    time_t t = timeSource_time ();
+    lastUpdateMinutes = gmtime (& t)->tm_min ;
 
     minutesOn = 0 ;
 
-    gps_open ();
+    updatePower () ;
+
+    mutex_release (& busy) ;
+
+    applyPower () ;
+}
+
+
+static struct {
+    std::mutex      lock ;
+    GpsWaiter *     dateTime ;
+    GpsWaiter *     latLong ;
+} waiters ;
+
 
-    printf ("gps started") ;
+static bool isFinished (Status status)
+{
+    return (status != GpsIdle) && (status != GpsBusy) ;
 }
 
 
-static void terminateAcquisition (void)
+static void addWaiter (GpsWaiter ** list, GpsWaiter * waiter, Status status)
 {
-    gps_close ();
+    waiters.lock.lock ();
+
+    bool done = isFinished (status) ;
+    if (! done)
+    {
+        waiter->next = * list ;
+        * list = waiter ;
+    }
 
-    printf ("gps stopped") ;
+    waiters.lock.unlock ();
+
+    if (done)
+        waiter->handler (waiter, status == GpsSucceeded) ;
 }
 
 
+static bool removeWaiter (GpsWaiter ** list, GpsWaiter * waiter)
+{
+    for (GpsWaiter ** link = list ; * link != NULL ; link = & (* link)->next)
+    {
+        if (* link == waiter)
+        {
+            * link = waiter->next ;
+            waiter->next = NULL ;
+            return true ;
+        }
+    }
+
+    return false ;
+}
+
 
-void gps_turnOff (void)
+static void serviceWaiters (GpsWaiter ** list, Status status, time_t now)
 {
-    m.lock();
-    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
+    // detach the waiters that are done (acquisition finished or deadline passed)
+    // and run their handlers outside the lock, so a handler may wait again
+
+    GpsWaiter * done = NULL ;
 
-    if ((dateTime.status == GpsBusy) || (latLong.status == GpsBusy))
+    waiters.lock.lock ();
+
+    GpsWaiter ** link = list ;
+    while (* link != NULL)
     {
-        terminateAcquisition () ;
+        GpsWaiter * waiter = * link ;
+
+        if (isFinished (status) || ((waiter->deadline != 0) && (now >= waiter->deadline)))
+        {
+            * link = waiter->next ;
+            waiter->next = done ;
+            done = waiter ;
+        }
+        else
+            link = & waiter->next ;
+    }
 
-        if (dateTime.status == GpsBusy)
-            dateTime.status  = GpsStopped ;
+    waiters.lock.unlock ();
 
-        if (latLong.status == GpsBusy)
-            latLong.status  = GpsStopped ;
+    while (done != NULL)
+    {
+        GpsWaiter * waiter = done ;
+        done = waiter->next ;
+        waiter->next = NULL ;
+
+        waiter->handler (waiter, status == GpsSucceeded) ;
     }
+}
+
+
+static void notifyWaiters (void)
+{
+    time_t now = timeSource_time () ;
+
+    serviceWaiters (& waiters.dateTime, dateTime.status, now) ;
+    serviceWaiters (& waiters.latLong,   latLong.status, now) ;
+}
+
+
+void gps_awaitDateTime (GpsWaiter * waiter) { addWaiter (& waiters.dateTime, waiter, dateTime.status) ; }
+void gps_awaitLatLong  (GpsWaiter * waiter) { addWaiter (& waiters.latLong,  waiter,  latLong.status) ; }
+
+
+bool gps_cancelWait (GpsWaiter * waiter)
+{
+    // a waiter being dispatched has already been detached by serviceWaiters (), so isn't found
+    waiters.lock.lock ();
+
+    bool removed = removeWaiter (& waiters.dateTime, waiter) ||
+                   removeWaiter (& waiters.latLong,  waiter) ;
+
+    waiters.lock.unlock ();
+
+    return removed ;
+}
+
+
+
+void gps_turnOff (void)
+{
+    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
+
+    finish (& dateTime.status, GpsStopped) ;
+    finish (&  latLong.status, GpsStopped) ;
+
+    streamers = 0 ;
+    updatePower () ;
 
     mutex_release (& busy) ;
-    m.unlock()
+
+    // told now, not after the seconds the reader may take to send what is queued
+    notifyWaiters () ;
+
+    applyPower () ;
 }
 
 
+void gps_startStreaming (void)
+{
+    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
+
+    ++ streamers ;
+    updatePower () ;
 
-void gps_updateAcquisition (void)
+    mutex_release (& busy) ;
+
+    applyPower () ;
+}
+
+
+void gps_stopStreaming (void)
 {
+    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
+
+    // gps_turnOff () may have stopped it already
+    if (streamers != 0)
+        -- streamers ;
 
-    if ((dateTime.status != GpsBusy) && (latLong.status != GpsBusy))
+    updatePower () ;
+
+    mutex_release (& busy) ;
+
+    applyPower () ;
+}
+
+
+
+static void updateAcquisition (void)
+{
+
+    if (! anyBusy ())
         return ;
 
 
-    time_t t = time(NULL);
+    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
+
+    time_t t = timeSource_time ();
     struct tm timeNow = *gmtime(&t);
 
     timeNow.tm_min %= 60 ;
@@ -209,106 +480,105 @@ void gps_updateAcquisition (void)
         // somebody must have messed with the RTC
         minutesDelta = MinutesUpdateInterval ;
 
-    if (minutesDelta < MinutesUpdateInterval)
+    if ((minutesDelta < MinutesUpdateInterval) || ! anyBusy ())
+    {
+        // not yet, or the acquisitions were turned off meanwhile
+        mutex_release (& busy) ;
         return ;
+    }
 
 
-    // do an update ...
-
-    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
+    // do an update, from what the reader has found since the receiver was powered ...
 
     lastUpdateMinutes = timeNow.tm_min ;
     minutesOn += minutesDelta ;
 
-
-    {
-        // must set a long timeout, since the clock may be altered and that would affect the timeout
-///     peripheralClocks_setSecondsTimeout (180, PeripheralClock_Dependent_GPS) ;
-
-        SerialPort * gps_port = serialPort_open (SerialPort_GPS) ;
-        serialPort_setBaudRate (gps_port, 9600);
-
-        uint8_t maxSeconds = 5 ;
-        nmea0183_updateFromStream (gps_port, maxSeconds);
-
-        serialPort_close (SerialPort_GPS) ;
-
-///     peripheralClocks_setSecondsTimeout (0, PeripheralClock_Dependent_GPS) ;
-    }
+    // the data is written while the status is still Busy, so it is complete before anyone can see Succeeded
 
     if ((dateTime.status == GpsBusy) && nmea0183_isDateTimeValid ())
     {
-        dateTime.status = GpsSucceeded ;
         nmea0183_getDateAndTime (& dateTime.data);
 
-        if (dateTime.includeRtcUpdate)
+        if (finish (& dateTime.status, GpsSucceeded))
         {
-            // update the rtc
-            printf ("setting rtc from gps...");
-            // k_sleep(2000)
-            // alarmClock_setDateAndTime (& dateTime.data) ;
-            // main_resetAlarm ();
+            if (dateTime.includeRtcUpdate)
+            {
+                // update the rtc
+                eventLog (EventLog_SettingRtc) ;
+                // k_sleep(2000)
+                // alarmClock_setDateAndTime (& dateTime.data) ;
+                // main_resetAlarm ();
+            }
+
+            metrics_observe (Metric_DateTimeAcquisition, (uint32_t) (timeSource_time () - dateTime.started) * 1000) ;
+            eventLog (EventLog_DateTimeAcquired, minutesOn) ;
         }
-
-        printf ("gps date/time acquired after %d minutes", minutesOn) ;
     }
 
 
     if ((latLong.status == GpsBusy) && nmea0183_isLatLongValid () && nmea0183_isDateTimeValid ())
     {
-        latLong.status = GpsSucceeded ;
-        nmea0183_getDateAndTime (& dateTime.data);
-        strncpy (latLong.data, nmea0183_getLatLongString (), sizeof (latLong.data));
+        nmea0183_getLatLongString (latLong.data) ;
 
-        printf ("gps lat/long acquired after %d minutes", minutesOn);
-    }
-
-
-    if ((dateTime.status != GpsBusy) && (latLong.status != GpsBusy))
-    {
-        // success
-        terminateAcquisition ();
-        mutex_release (& busy) ;
-        return ;
+        if (finish (& latLong.status, GpsSucceeded))
+        {
+            metrics_observe (Metric_LatLongAcquisition, (uint32_t) (timeSource_time () - latLong.started) * 1000) ;
+            eventLog (EventLog_LatLongAcquired, minutesOn) ;
+        }
     }
 
 
-    if (minutesOn >= MaxMinutesOn)
+    if (anyBusy () && (minutesOn >= MaxMinutesOn))
     {
         // timeout
 
-        printf ("gps acquisition timed out after %d minutes", minutesOn) ;
-
-        terminateAcquisition ();
+        eventLog (EventLog_AcquisitionTimedOut, minutesOn) ;
 
-        if (dateTime.status == GpsBusy)
+        if (finish (& dateTime.status, GpsFailed))
         {
-            dateTime.status =  GpsFailed ;
-            printf ("gps date/time acquisition failed") ;
+            metrics_count (Metric_AcquisitionsFailed) ;
+            eventLog (EventLog_DateTimeFailed) ;
         }
 
-        if (latLong.status == GpsBusy)
+        if (finish (& latLong.status, GpsFailed))
         {
-            latLong.status =  GpsFailed ;
-            printf ("gps lat/long acquisition failed") ;
+            metrics_count (Metric_AcquisitionsFailed) ;
+            eventLog (EventLog_LatLongFailed) ;
         }
     }
 
 
+    // powered down once nothing needs it, unless it is streaming
+    updatePower () ;
+
     mutex_release (& busy) ;
+
+    applyPower () ;
+}
+
+
+void gps_updateAcquisition (void)
+{
+    updateAcquisition () ;
+
+    // also runs when no update was due, so that waiter deadlines are honoured
+    notifyWaiters () ;
 }
 
 
 
 void gps_initiateDateTimeAcquisition (bool includeRtcUpdate)
 {
-    if (dateTime.status == GpsBusy)
+    if (dateTime.status.exchange (GpsBusy) == GpsBusy)
         return ;
 
     dateTime.includeRtcUpdate = includeRtcUpdate ;
 
-    dateTime.status = GpsBusy ;
+    dateTime.started = timeSource_time () ;
+
+    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
     memset ((uint8_t *) & dateTime.data, 0, sizeof (dateTime.data)) ;
+    mutex_release (& busy) ;
 
     initiateAcquisition () ;
 }
@@ -316,11 +586,14 @@ void gps_initiateDateTimeAcquisition (bool includeRtcUpdate)
 
 void gps_initiateLatLongAcquisition (void)
 {
-    if (latLong.status == GpsBusy)
+    if (latLong.status.exchange (GpsBusy) == GpsBusy)
         return ;
 
-    latLong.status = GpsBusy ;
+    latLong.started = timeSource_time () ;
+
+    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
     memset ((uint8_t *) &  latLong.data, 0, sizeof ( latLong.data)) ;
+    mutex_release (& busy) ;
 
     initiateAcquisition () ;
 }
@@ -333,13 +606,109 @@ bool gps_dateTimeAcquisitionSucceeded (void) { return dateTime.status == GpsSucc
 bool gps_latLongAcquisitionSucceeded  (void) { return  latLong.status == GpsSucceeded ; }
 
 struct tm * gps_getDateTime        (void) { return & dateTime.data ; }
-string      gps_getLatLongString   (void) { return    latLong.data ; }
+string_view gps_getLatLongString (LatLongString copy)
+{
+    // busy, so an update can't be writing it meanwhile
+    mutex_get (& busy, OSAL_WAIT_FOREVER) ;
+
+    strcpy (copy, latLong.data) ;
+
+    mutex_release (& busy) ;
+
+    return copy ;
+}
+
+
+static void deviceChanged (const char * path)
+{
+    // nmea0183 and the fix assembly keep their state, only the port moves to the new device
+    if (path [0] == 0)
+    {
+        eventLog (EventLog_DeviceGone) ;
+        return ;
+    }
+
+    eventLog (EventLog_Device, path) ;
+
+    // the reader opens the port with reader.port held, so it either opens the new path, or is
+    // cancelled out of the old one and reopens at the new path
+    lock_guard <std::mutex> guard (reader.port) ;
+
+    cancelRead = TRUE ;
+    serialPort_setDevicePath (SerialPort_GPS, path) ;
+}
+
+
+static void baudRateSent (void *, bool sent)
+{
+    // on the reader, the receiver changes rate as soon as it has the message, so reopen at the new one
+    if (! sent)
+        return ;
+
+    reader.baud = reader.requestedBaud.load () ;
+    cancelRead  = TRUE ;
+}
+
+
+bool gps_setBaudRate (uint32_t baud)
+{
+    // UBX-CFG-PRT for UART1: 8N1, UBX, NMEA and RTCM3 in, UBX and NMEA out
+    static const uint8_t  CFG_PRT       = 0x00 ;
+    static const uint32_t Mode8N1       = 0x08c0 ;
+    static const uint16_t InProtocols   = 0x0023 ;
+    static const uint16_t OutProtocols  = 0x0003 ;
+
+    uint8_t payload [20] ;
+    memset (payload, 0, sizeof (payload)) ;
+
+    payload [0]  = 1 ;                  // UART1
+    payload [4]  = Mode8N1 & 0xff ;
+    payload [5]  = Mode8N1 >> 8 ;
+    payload [8]  = baud ;
+    payload [9]  = baud >> 8 ;
+    payload [10] = baud >> 16 ;
+    payload [11] = baud >> 24 ;
+    payload [12] = InProtocols ;
+    payload [14] = OutProtocols ;
+
+    // not through ubx-tx: the answer comes at the new rate, if it isn't lost in the change
+    uint8_t message [sizeof (payload) + UbxOverhead] ;
+    uint16_t length = ubx_frame (message, UbxClass_CFG, CFG_PRT, payload, sizeof (payload)) ;
+
+    reader.requestedBaud = baud ;
+    return serialTx_queue (SerialTx_Config, message, length, baudRateSent) ;
+}
+
+
+bool gps_followDevice (const char * sysfsRoot, const char * devRoot)
+{
+    return gpsDevice_watch (deviceChanged, GpsDevice_UbloxVendorId, 0, sysfsRoot, devRoot) ;
+}
+
+
+void gps_stopFollowingDevice (void)
+{
+    gpsDevice_stopWatching () ;
+}
 
 
 void gps_close (void)
 {
+    // keep it powered, in backup or cyclic tracking, so the next look is a hot start
+    //      the messages that put it there are sent by the reader before it stops
+    bool suspending = (gpsPower_getMode () != GpsPower_Off) ;
 
-    serialPort_close (SerialPort_GPS) ;
+    if (suspending)
+        gpsPower_suspend () ;
+
+    stopReader () ;
+
+    // only cyclic tracking keeps the port settings
+    if (gpsPower_getMode () != GpsPower_Cyclic)
+        reader.baud = DefaultBaudRate ;
+
+    if (suspending)
+        return ;
 
     // power it down
     gpio_set (GPS_EN_N, CHIP_OFF) ;
@@ -349,6 +718,9 @@ void gps_close (void)
 
 void gps_open (void)
 {
+    // out of backup, or back to full power from cyclic tracking, by the first messages the reader sends
+    if (gpsPower_isSuspended ())
+        gpsPower_resume () ;
 
     // power it up and take it out of reset
     // gpio_set (GPS_RESET_N, 0) ;
@@ -358,29 +730,30 @@ void gps_open (void)
     // gpio_set (GPS_RESET_N, 1) ;
 
     // gpio_set (SONIC_EN, 0) ;
+
+    startReader () ;
 }
 
 
 void gps_initialize (void)
 {
-    dateTime.status = latLong.status = GpsFailed ;
+    dateTime.status = GpsIdle ;
+     latLong.status = GpsIdle ;
 
     memset ((uint8_t *) & dateTime.data, 0, sizeof (dateTime.data)) ;
     memset ((uint8_t *) &  latLong.data, 0, sizeof ( latLong.data)) ;
 
     mutex_initialize (& busy);
 
-    // gpio_set (GPS_EN_N, CHIP_OFF) ;
-    // gpio_set (GPS_RESET_N, 0) ;
-}
+    reader.baud = DefaultBaudRate ;
 
-void main(){
-    gps_initialize()
-    gps_
+    // text on stdout, unless it was already started with a file
+    eventLog_start (NULL) ;
 
+    // gpio_set (GPS_EN_N, CHIP_OFF) ;
+    // gpio_set (GPS_RESET_N, 0) ;
 }
 
-
 #if 0
 
 > gps-location
@@ -434,7 +807,7 @@ messages to send this data to the receiver.
 u-blox receivers currently accept the following types of assistance data:
 
 
-â€¢ Time: The current time can either be supplied as an inexact value via the
+- Time: The current time can either be supplied as an inexact value via the
 standard communication interfaces, suffering from latency depending on the baud
 rate, or using hardware time synchronization where an accurate time pulse is
 connected to an external interrupt.
@@ -444,7 +817,7 @@ message, but times referenced to some GNSS can be delivered with the
 UBX-MGA-INI-TIME_GNSS message.
 
 
-â€¢ Position: Estimated receiver position can be submitted to the receiver using
+- Position: Estimated receiver position can be submitted to the receiver using
 the UBX-MGA-INI-POS_XYZ or UBX-MGA-INI-POS_LLH messages.
 
 
@@ -4,8 +4,9 @@
 
 #include "lat-long.hpp"
 #include "serial-port.h"
+#include "ubx-tx.hpp"
 
-#include <string>
+#include <string_view>
 #include <time.h>
 
 
@@ -14,6 +15,7 @@ void    gps_initiateLatLongAcquisition  (void) ;
 
 void    gps_updateAcquisition (void) ;
 
+// status queries never block, they are safe from any thread during an update
 bool gps_dateTimeAcquisitionBusy (void) ;
 bool gps_latLongAcquisitionBusy  (void) ;
 
@@ -21,14 +23,76 @@ bool gps_dateTimeAcquisitionSucceeded (void) ;
 bool gps_latLongAcquisitionSucceeded  (void) ;
 
 struct tm * gps_getDateTime      (void);
-string            gps_getLatLongString (void);
+
+// the last lat/long acquired, copied into the caller's string, which the view returned is of
+//      a copy because the acquisition's own string is cleared by the next initiate
+string_view gps_getLatLongString (LatLongString) ;
+
+
+// completion notification, as an alternative to polling the busy/succeeded flags
+//      the waiter is owned by the caller and must remain valid until its handler has run
+//      the handler runs on the thread calling gps_updateAcquisition() or gps_turnOff()
+//      deadline is an absolute time () value, 0 for none
+//      a waiter added before the first initiate waits for that acquisition, one added after an
+//      acquisition has finished is told its outcome straight away
+//
+//      gps_cancelWait () returns true if the waiter was removed before its handler was dispatched,
+//      false if the handler has run or is running now on another thread, in which case the waiter
+//      must stay valid until the handler returns
+//
+//      C++20 coroutines can co_await the acquisitions and the fixes instead, see gps-async.hpp
+
+typedef struct GpsWaiter GpsWaiter ;
+
+typedef void (* GpsWaiterHandler) (GpsWaiter *, bool succeeded) ;
+
+struct GpsWaiter
+{
+    GpsWaiterHandler    handler ;
+    void *              context ;
+    time_t              deadline ;
+    GpsWaiter *         next ;
+} ;
+
+void gps_awaitDateTime (GpsWaiter *) ;
+void gps_awaitLatLong  (GpsWaiter *) ;
+bool gps_cancelWait    (GpsWaiter *) ;
+
+
+// the receiver is powered, and everything it sends is framed by a reader thread (nmea0183_run ()),
+// while an acquisition is busy or anything is streaming; the acquisitions only check what the
+// reader has found, every MinutesUpdateInterval
+//
+//      streaming is for the continuous consumers of the receiver's output (gps-clock, raw-capture,
+//      the fix subscribers), each gps_startStreaming () needs a gps_stopStreaming ()
+void gps_startStreaming (void) ;
+void gps_stopStreaming  (void) ;
+
+// ask the receiver for another baud rate on its UART (UBX-CFG-PRT), and read it at that rate once
+// the request is written; it is back to 9600 when the receiver is powered down, or put in backup
+//      false if the request couldn't be queued
+bool gps_setBaudRate (uint32_t baud) ;
 
 
 // intended for use by the monitor
+//      gps_turnOff () stops the acquisitions and any streaming, tells the waiters, and returns once
+//      the reader has stopped and the receiver is powered down or suspended, up to the few seconds
+//      gps_close () takes; the acquisitions' state can be read and changed meanwhile
+//      gps_open () starts the reader, and gps_close () stops it once what is queued for the
+//      receiver has been sent and answered (a few seconds at most); the power mode's messages
+//      (gps-power.hpp) are queued for it to send
 void gps_open    (void);
 void gps_close   (void);
 void gps_turnOff (void);
-void txMessage_UBX_MGA_INI_TIME_UTC (SerialPort *) ;
+
+// the time of day as assistance, stamped from the system clock as the message is written
+bool txMessage_UBX_MGA_INI_TIME_UTC (UbxTxDone = NULL, void * context = NULL) ;
+
+
+// follow the receiver from one USB serial device to the next when it is re-enumerated (see
+// gps-device.hpp), the reader moves to the new device straight away
+bool gps_followDevice        (const char * sysfsRoot = "/sys", const char * devRoot = "/dev") ;
+void gps_stopFollowingDevice (void) ;
 
 
 void gps_initialize (void);
@@ -0,0 +1,616 @@
+#include "gpsd-server.hpp"
+
+#include "gps.hpp"
+#include "gps-fix.hpp"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const size_t  MaxQueuedBytes  = 64 * 1024 ;     // per client
+static const size_t  MaxCommand      = 512 ;
+static const int     MaxEvents       = 64 ;
+
+typedef shared_ptr <const string> Report ;
+
+
+typedef struct
+{
+    int             fd ;
+    bool            watching ;
+    char            command [MaxCommand] ;
+    size_t          commandLength ;
+    deque <Report>  queue ;
+    size_t          sent ;              // of the report at the front
+    size_t          queuedBytes ;
+    bool            wantsOutput ;       // EPOLLOUT is on
+} Client ;
+
+
+static char                         device [64] ;
+static atomic <bool>                running ;
+static thread                       loop ;
+static int                          epollFd = -1 ;
+static int                          wakeFd  = -1 ;
+static vector <int>                 listeners ;
+
+// handed from the fix thread to the server thread
+static mutex                        reportsLock ;
+static vector <Report>              pending ;
+static Report                       lastTpv ;
+static Report                       lastSky ;
+
+static unordered_map <int, Client *> clients ;         // server thread only
+
+
+
+// serializing ...
+
+static size_t formatTime (char * text, size_t size, const GpsFix * fix)
+{
+    if (! fix->date.valid || ! fix->time.valid)
+        return 0 ;
+
+    unsigned year = fix->date.year + ((fix->date.year < 80) ? 2000 : 1900) ;     // 2 digit year, 1980 .. 2079
+
+    return snprintf (text, size, "\"time\":\"%u-%02u-%02uT%02u:%02u:%02u.%02uZ\",",
+                     year, fix->date.month, fix->date.day,
+                     fix->time.hours, fix->time.minutes, fix->time.seconds, fix->time.hundredths) ;
+}
+
+
+static Report serializeTpv (const GpsFix * fix)
+{
+    char text [512] ;
+    char time [48] = "" ;
+    formatTime (time, sizeof (time), fix) ;
+
+    uint8_t mode = ! fix->positionValid    ? 1 :
+                   (fix->fixType >= 2)     ? fix->fixType :
+                   fix->altitudeValid      ? 3 : 2 ;
+
+    int length = snprintf (text, sizeof (text), "{\"class\":\"TPV\",\"device\":\"%s\",\"mode\":%u,%s",
+                           device, mode, time) ;
+
+    if (fix->positionValid)
+    {
+        length += snprintf (text + length, sizeof (text) - length, "\"lat\":%.9f,\"lon\":%.9f,",
+                            fix->smoothedPosition. latitude_minutes_x1e5 / 6000000.0,
+                            fix->smoothedPosition.longitude_minutes_x1e5 / 6000000.0) ;
+    }
+
+    if (fix->altitudeValid)
+        length += snprintf (text + length, sizeof (text) - length, "\"altMSL\":%.2f,", fix->altitude_cm / 100.0) ;
+
+    if (fix->speed_knots_x1000 >= 0)
+        length += snprintf (text + length, sizeof (text) - length, "\"speed\":%.3f,", fix->speed_knots_x1000 * (1852.0 / 3600 / 1000)) ;
+
+    if (fix->course_degrees_x100 >= 0)
+        length += snprintf (text + length, sizeof (text) - length, "\"track\":%.2f,", fix->course_degrees_x100 / 100.0) ;
+
+    // replace the last ',' with the end of the object
+    snprintf (text + length - 1, sizeof (text) - length + 1, "}\r\n") ;
+
+    return make_shared <const string> (text) ;
+}
+
+
+static int gnssId (uint8_t system)
+{
+    // -1 if there is no gpsd id for the system, and the field is left out
+    switch (system)
+    {
+        case SatelliteSystem_GPS:       return 0 ;
+        case SatelliteSystem_Galileo:   return 2 ;
+        case SatelliteSystem_BeiDou:    return 3 ;
+        case SatelliteSystem_QZSS:      return 5 ;
+        case SatelliteSystem_GLONASS:   return 6 ;
+        default:                        return -1 ;
+    }
+}
+
+
+static Report serializeSky (const GpsFix * fix)
+{
+    const SatelliteTable * table = & fix->satellites ;
+
+    string text ;
+    text.reserve (128 + table->count * 80) ;
+
+    char field [128] ;
+    snprintf (field, sizeof (field), "{\"class\":\"SKY\",\"device\":\"%s\",", device) ;
+    text += field ;
+
+    if (formatTime (field, sizeof (field), fix) != 0)
+        text += field ;
+
+    if (fix->hdop_x100 >= 0)  { snprintf (field, sizeof (field), "\"hdop\":%.2f,", fix->hdop_x100 / 100.0) ;  text += field ; }
+    if (fix->vdop_x100 >= 0)  { snprintf (field, sizeof (field), "\"vdop\":%.2f,", fix->vdop_x100 / 100.0) ;  text += field ; }
+    if (fix->pdop_x100 >= 0)  { snprintf (field, sizeof (field), "\"pdop\":%.2f,", fix->pdop_x100 / 100.0) ;  text += field ; }
+
+    snprintf (field, sizeof (field), "\"nSat\":%u,\"uSat\":%u,\"satellites\":[",
+              table->count, satelliteTable_usedCount (table)) ;
+    text += field ;
+
+    for (uint8_t i = 0 ; i < table->count ; i ++)
+    {
+        int id = gnssId (table->system [i]) ;
+
+        snprintf (field, sizeof (field), "%s{\"PRN\":%u,", (i == 0) ? "" : ",", table->prn [i]) ;
+        text += field ;
+
+        if (id >= 0)
+        {
+            snprintf (field, sizeof (field), "\"gnssid\":%d,", id) ;
+            text += field ;
+        }
+
+        snprintf (field, sizeof (field), "\"el\":%d,\"az\":%d,\"ss\":%u,\"used\":%s}",
+                  table->elevation [i], table->azimuth [i], table->snr [i],
+                  ((table->usedInFix >> i) & 1) ? "true" : "false") ;
+        text += field ;
+    }
+
+    text += "]}\r\n" ;
+
+    return make_shared <const string> (move (text)) ;
+}
+
+
+static void onFix (const GpsFix * fix)
+{
+    // serialized once here, on the receiver's thread, whatever the number of clients
+    Report tpv = serializeTpv (fix) ;
+    Report sky = serializeSky (fix) ;
+
+    {
+        lock_guard <mutex> guard (reportsLock) ;
+
+        pending.push_back (tpv) ;
+        pending.push_back (sky) ;
+        lastTpv = tpv ;
+        lastSky = sky ;
+    }
+
+    uint64_t one = 1 ;
+    if (write (wakeFd, & one, sizeof (one)) < 0)
+        return ;    // the counter is already non zero, the server thread will wake anyway
+}
+
+
+
+// clients ...
+
+static void setOutput (Client * client, bool wanted)
+{
+    if (client->wantsOutput == wanted)
+        return ;
+
+    struct epoll_event event ;
+    event.events  = EPOLLIN | (wanted ? (uint32_t) EPOLLOUT : 0) ;
+    event.data.fd = client->fd ;
+    epoll_ctl (epollFd, EPOLL_CTL_MOD, client->fd, & event) ;
+
+    client->wantsOutput = wanted ;
+}
+
+
+static bool flush (Client * client)
+{
+    // false if the client has gone
+    while (! client->queue.empty ())
+    {
+        const string & report = * client->queue.front () ;
+
+        ssize_t n = send (client->fd, report.data () + client->sent, report.size () - client->sent, MSG_NOSIGNAL | MSG_DONTWAIT) ;
+
+        if (n < 0)
+        {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+                break ;
+            return false ;
+        }
+
+        client->sent += n ;
+
+        if (client->sent == report.size ())
+        {
+            client->queuedBytes -= report.size () ;
+            client->queue.pop_front () ;
+            client->sent = 0 ;
+        }
+    }
+
+    setOutput (client, ! client->queue.empty ()) ;
+    return true ;
+}
+
+
+static void enqueue (Client * client, const Report & report)
+{
+    client->queue.push_back (report) ;
+    client->queuedBytes += report->size () ;
+
+    // backpressure: drop the oldest reports that haven't started to go out
+    while ((client->queuedBytes > MaxQueuedBytes) && (client->queue.size () > 1))
+    {
+        deque <Report>::iterator oldest = client->queue.begin () + ((client->sent != 0) ? 1 : 0) ;
+
+        client->queuedBytes -= (* oldest)->size () ;
+        client->queue.erase (oldest) ;
+    }
+}
+
+
+static void respond (Client * client, const char * text)
+{
+    enqueue (client, make_shared <const string> (text)) ;
+}
+
+
+static void respondDevices (Client * client)
+{
+    char text [256] ;
+    snprintf (text, sizeof (text),
+              "{\"class\":\"DEVICES\",\"devices\":[{\"class\":\"DEVICE\",\"path\":\"%s\",\"driver\":\"u-blox\",\"native\":0}]}\r\n",
+              device) ;
+    respond (client, text) ;
+}
+
+
+static void runCommand (Client * client, const char * command)
+{
+    if (strncmp (command, "?WATCH", 6) == 0)
+    {
+        client->watching = (strstr (command, "\"enable\":false") == NULL) ;
+
+        respondDevices (client) ;
+
+        char text [128] ;
+        snprintf (text, sizeof (text), "{\"class\":\"WATCH\",\"enable\":%s,\"json\":true,\"nmea\":false,\"raw\":0}\r\n",
+                  client->watching ? "true" : "false") ;
+        respond (client, text) ;
+    }
+    else if (strncmp (command, "?VERSION", 8) == 0)
+    {
+        respond (client, "{\"class\":\"VERSION\",\"release\":\"3.25\",\"rev\":\"usb-gps\",\"proto_major\":3,\"proto_minor\":15}\r\n") ;
+    }
+    else if (strncmp (command, "?DEVICES", 8) == 0)
+    {
+        respondDevices (client) ;
+    }
+    else if (strncmp (command, "?POLL", 5) == 0)
+    {
+        Report tpv, sky ;
+        {
+            lock_guard <mutex> guard (reportsLock) ;
+            tpv = lastTpv ;
+            sky = lastSky ;
+        }
+
+        // the reports without their line ends
+        string text = "{\"class\":\"POLL\",\"active\":" ;
+        text += (tpv != NULL) ? "1,\"tpv\":[" : "0,\"tpv\":[" ;
+        if (tpv != NULL)    text.append (* tpv, 0, tpv->size () - 2) ;
+        text += "],\"sky\":[" ;
+        if (sky != NULL)    text.append (* sky, 0, sky->size () - 2) ;
+        text += "]}\r\n" ;
+
+        enqueue (client, make_shared <const string> (move (text))) ;
+    }
+    else
+    {
+        respond (client, "{\"class\":\"ERROR\",\"message\":\"Unrecognized request\"}\r\n") ;
+    }
+}
+
+
+static bool receive (Client * client)
+{
+    // false if the client has gone
+    char buffer [MaxCommand] ;
+
+    ssize_t n = recv (client->fd, buffer, sizeof (buffer), MSG_DONTWAIT) ;
+    if (n == 0)
+        return false ;
+    if (n < 0)
+        return (errno == EAGAIN) || (errno == EWOULDBLOCK) ;
+
+    for (ssize_t i = 0 ; i < n ; i ++)
+    {
+        char c = buffer [i] ;
+
+        if ((c == ';') || (c == '\n') || (c == '\r'))
+        {
+            client->command [client->commandLength] = 0 ;
+            if (client->commandLength > 0)
+                runCommand (client, client->command) ;
+            client->commandLength = 0 ;
+        }
+        else if (client->commandLength < MaxCommand - 1)
+        {
+            client->command [client->commandLength ++] = c ;
+        }
+    }
+
+    return flush (client) ;
+}
+
+
+static void acceptClient (int listener)
+{
+    int fd = accept4 (listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC) ;
+    if (fd < 0)
+        return ;
+
+    Client * client = new Client () ;
+    client->fd = fd ;
+
+    struct epoll_event event ;
+    event.events  = EPOLLIN ;
+    event.data.fd = fd ;
+    epoll_ctl (epollFd, EPOLL_CTL_ADD, fd, & event) ;
+
+    clients [fd] = client ;
+
+    respond (client, "{\"class\":\"VERSION\",\"release\":\"3.25\",\"rev\":\"usb-gps\",\"proto_major\":3,\"proto_minor\":15}\r\n") ;
+    flush (client) ;
+}
+
+
+static void disconnect (Client * client)
+{
+    epoll_ctl (epollFd, EPOLL_CTL_DEL, client->fd, NULL) ;
+    close (client->fd) ;
+
+    clients.erase (client->fd) ;
+    delete client ;
+}
+
+
+static void distribute (void)
+{
+    uint64_t count ;
+    if (read (wakeFd, & count, sizeof (count)) < 0)
+        return ;
+
+    vector <Report> reports ;
+    {
+        lock_guard <mutex> guard (reportsLock) ;
+        reports.swap (pending) ;
+    }
+
+    vector <Client *> gone ;
+
+    for (auto & entry : clients)
+    {
+        Client * client = entry.second ;
+        if (! client->watching)
+            continue ;
+
+        for (const Report & report : reports)
+            enqueue (client, report) ;
+
+        if (! flush (client))
+            gone.push_back (client) ;
+    }
+
+    for (Client * client : gone)
+        disconnect (client) ;
+}
+
+
+static bool isListener (int fd)
+{
+    for (int listener : listeners)
+        if (listener == fd)
+            return true ;
+
+    return false ;
+}
+
+
+static void serve (void)
+{
+    struct epoll_event events [MaxEvents] ;
+
+    while (running)
+    {
+        int n = epoll_wait (epollFd, events, MaxEvents, 500) ;
+
+        for (int i = 0 ; i < n ; i ++)
+        {
+            int fd = events [i].data.fd ;
+
+            if (fd == wakeFd)
+            {
+                distribute () ;
+            }
+            else if (isListener (fd))
+            {
+                acceptClient (fd) ;
+            }
+            else
+            {
+                unordered_map <int, Client *>::iterator found = clients.find (fd) ;
+                if (found == clients.end ())
+                    continue ;
+
+                Client * client = found->second ;
+                bool ok = true ;
+
+                if (events [i].events & (EPOLLERR | EPOLLHUP))
+                    ok = false ;
+                if (ok && (events [i].events & EPOLLIN))
+                    ok = receive (client) ;
+                if (ok && (events [i].events & EPOLLOUT))
+                    ok = flush (client) ;
+
+                if (! ok)
+                    disconnect (client) ;
+            }
+        }
+    }
+}
+
+
+
+static bool addListener (int fd)
+{
+    if (listen (fd, 16) != 0)
+    {
+        close (fd) ;
+        return false ;
+    }
+
+    listeners.push_back (fd) ;
+    return true ;
+}
+
+
+bool gpsdServer_listenUnix (const char * path)
+{
+    if (running)
+        return false ;
+
+    struct sockaddr_un address ;
+    memset (& address, 0, sizeof (address)) ;
+    address.sun_family = AF_UNIX ;
+
+    if (strlen (path) >= sizeof (address.sun_path))
+        return false ;
+
+    strcpy (address.sun_path, path) ;
+
+    int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) ;
+    if (fd < 0)
+        return false ;
+
+    unlink (path) ;
+
+    if (bind (fd, (struct sockaddr *) & address, sizeof (address)) != 0)
+    {
+        close (fd) ;
+        return false ;
+    }
+
+    return addListener (fd) ;
+}
+
+
+bool gpsdServer_listenTcp (uint16_t port)
+{
+    if (running)
+        return false ;
+
+    struct sockaddr_in address ;
+    memset (& address, 0, sizeof (address)) ;
+    address.sin_family      = AF_INET ;
+    address.sin_port        = htons (port) ;
+    address.sin_addr.s_addr = htonl (INADDR_LOOPBACK) ;
+
+    int fd = socket (AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) ;
+    if (fd < 0)
+        return false ;
+
+    int on = 1 ;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, & on, sizeof (on)) ;
+
+    if (bind (fd, (struct sockaddr *) & address, sizeof (address)) != 0)
+    {
+        close (fd) ;
+        return false ;
+    }
+
+    return addListener (fd) ;
+}
+
+
+bool gpsdServer_start (const char * devicePath)
+{
+    if (running)
+        return false ;
+
+    snprintf (device, sizeof (device), "%s", devicePath) ;
+
+    epollFd = epoll_create1 (EPOLL_CLOEXEC) ;
+    wakeFd  = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC) ;
+
+    if ((epollFd < 0) || (wakeFd < 0))
+    {
+        gpsdServer_stop () ;
+        return false ;
+    }
+
+    struct epoll_event event ;
+    event.events  = EPOLLIN ;
+    event.data.fd = wakeFd ;
+    epoll_ctl (epollFd, EPOLL_CTL_ADD, wakeFd, & event) ;
+
+    for (int fd : listeners)
+    {
+        event.data.fd = fd ;
+        epoll_ctl (epollFd, EPOLL_CTL_ADD, fd, & event) ;
+    }
+
+    if (! gpsFix_subscribe (onFix))
+    {
+        gpsdServer_stop () ;
+        return false ;
+    }
+
+    // clients are served every fix, not only while an acquisition has the receiver
+    gps_startStreaming () ;
+
+    running = true ;
+    loop    = thread (serve) ;
+
+    return true ;
+}
+
+
+void gpsdServer_stop (void)
+{
+    if (running)
+    {
+        gps_stopStreaming () ;
+        gpsFix_unsubscribe (onFix) ;
+
+        running = false ;
+        loop.join () ;
+    }
+
+    while (! clients.empty ())
+        disconnect (clients.begin ()->second) ;
+
+    for (int fd : listeners)
+        close (fd) ;
+    listeners.clear () ;
+
+    if (epollFd >= 0)   close (epollFd) ;
+    if (wakeFd  >= 0)   close (wakeFd) ;
+    epollFd = wakeFd = -1 ;
+
+    lock_guard <mutex> guard (reportsLock) ;
+    pending.clear () ;
+    lastTpv = lastSky = NULL ;
+}
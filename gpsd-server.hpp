@@ -0,0 +1,30 @@
+#ifndef _GPSD_SERVER_H_
+#define _GPSD_SERVER_H_
+
+#include <stdint.h>
+
+
+// gpsd JSON protocol server, so gpsd clients (cgps, gpspipe, libgps, chrony's SOCK, ...) can
+// read the fixes directly
+//
+//      each fix (gps-fix.hpp) is serialized once, into a TPV and a SKY report, and the same
+//      buffers are queued to every watching client
+//      one thread runs an epoll loop over the listening sockets and all the clients
+//      a client that doesn't keep up has its oldest unsent reports dropped once it has more than
+//      MaxQueuedBytes waiting, so a slow client never holds up the others or the receiver
+//
+//      commands understood: ?WATCH={...}; (enable/disable only, json is always on), ?VERSION;
+//      ?DEVICES; and ?POLL;
+
+
+// the device path reported to clients, such as "/dev/ttyACM0"
+//      the receiver is kept streaming (gps_startStreaming ()) while the server runs
+bool gpsdServer_start (const char * device) ;
+void gpsdServer_stop  (void) ;
+
+// either or both, before starting
+bool gpsdServer_listenUnix (const char * path) ;
+bool gpsdServer_listenTcp  (uint16_t port) ;         // loopback only, gpsd's port is 2947
+
+
+#endif
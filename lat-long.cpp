@@ -1,12 +1,30 @@
 #include "lat-long.hpp"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+using namespace std;
 
 
 
-void latitudeLongitude_toString (LatitudeLongitude * latLong, LatLongString outputString)
+static const int64_t MinutesPerCircle_x1e5 = 360ll * 60 * 100000 ;
+
+
+
+int32_t latitudeLongitude_wrapLongitude (int64_t minutes_x1e5)
+{
+    minutes_x1e5 %= MinutesPerCircle_x1e5 ;
+
+    if (minutes_x1e5 >  MinutesPerCircle_x1e5 / 2)     minutes_x1e5 -= MinutesPerCircle_x1e5 ;
+    if (minutes_x1e5 < -MinutesPerCircle_x1e5 / 2)     minutes_x1e5 += MinutesPerCircle_x1e5 ;
+
+    return (int32_t) minutes_x1e5 ;
+}
+
+
+
+string_view latitudeLongitude_toString (const LatitudeLongitude * latLong, LatLongString outputString)
 {
     // convert latitude/longitude to "48 02.391740 N, 123 03.672452 W" format
 
@@ -36,46 +54,102 @@ void latitudeLongitude_toString (LatitudeLongitude * latLong, LatLongString outp
     unsigned int latMin = lat % (100000 * 60) ;
     unsigned int lonMin = lon % (100000 * 60) ;
 
-    sprintf (outputString, "%2d %2d.%05d %c, %3d %2d.%05d %c",
-            latDeg, latMin / 100000, latMin % 100000, northSouth,
-            lonDeg, lonMin / 100000, lonMin % 100000, eastWest ) ;
+    int length = snprintf (outputString, sizeof (LatLongString), "%2d %2d.%05d %c, %3d %2d.%05d %c",
+                           latDeg, latMin / 100000, latMin % 100000, northSouth,
+                           lonDeg, lonMin / 100000, lonMin % 100000, eastWest ) ;
 
 /*
     2013/03/03 18:08:12  48 02.391740,N, 123 03.672452
     48  2.391744 N, 123  3.672576 W
 */
+
+    return string_view (outputString, length) ;
 }
 
 
 
-static bool decimalMinutes_x1e6_fromString (char * decimalString, unsigned int * decimalMinutes_x1e6)
+// a hand scanner over the view, accepting what sscanf ("%u %u.%6s %c, %u %u.%6s %c") did
+
+typedef struct
 {
-    // on success, decimalMinutes_x1e6 will be set to a number from 0 to 999999
+    const char *    next ;
+    const char *    end ;
+} Scan ;
 
-    uint8_t numDigits = strlen (decimalString) ;
 
-    bool fault = numDigits > 6 ;
+static void skipSpaces (Scan * scan)
+{
+    while ((scan->next < scan->end) && isspace ((unsigned char) * scan->next))
+        scan->next ++ ;
+}
 
-    unsigned int decimalMinutes ;
-    uint8_t scanResult = sscanf (decimalString, "%u", & decimalMinutes) ;
 
-    fault |= (scanResult != 1) ;
+static bool scanNumber (Scan * scan, unsigned int * value, uint8_t * digits)
+{
+    // at most 9 digits, so it can't overflow
+    * value  = 0 ;
+    * digits = 0 ;
 
-    if (! fault)
+    while ((scan->next < scan->end) && isdigit ((unsigned char) * scan->next) && (* digits < 9))
     {
-        // for each digit short of 6, multiply the result by 10
-        while (numDigits ++ < 6)
-            decimalMinutes *= 10 ;
-
-        * decimalMinutes_x1e6 = decimalMinutes ;
+        * value = * value * 10 + (* scan->next ++ - '0') ;
+        ++ * digits ;
     }
 
-    return ! fault ;
+    return * digits != 0 ;
 }
 
 
+static bool scanCharacter (Scan * scan, char * c)
+{
+    if (scan->next == scan->end)
+        return false ;
+
+    * c = * scan->next ++ ;
+    return true ;
+}
 
-bool latitudeLongitude_fromString (LatitudeLongitude * latLon, LatLongString latLongString)
+
+typedef struct {
+    unsigned int degrees ;
+    unsigned int minutes ;
+    unsigned int decimalMinutes ;       // x1e6, 0 .. 999999
+    char         direction ;
+} Coordinate ;
+
+
+static bool scanCoordinate (Scan * scan, Coordinate * coordinate)
+{
+    // d m.m {N|S} or d m.m {E|W}, the direction in either case
+    uint8_t digits ;
+    char    point ;
+
+    skipSpaces (scan) ;
+    if (! scanNumber (scan, & coordinate->degrees, & digits))
+        return false ;
+
+    skipSpaces (scan) ;
+    if (! scanNumber (scan, & coordinate->minutes, & digits))
+        return false ;
+
+    if (! scanCharacter (scan, & point) || (point != '.'))
+        return false ;
+
+    // decimal minutes is max 6 digits, for each digit short of 6, multiply the result by 10
+    skipSpaces (scan) ;
+    if (! scanNumber (scan, & coordinate->decimalMinutes, & digits) || (digits > 6))
+        return false ;
+
+    while (digits ++ < 6)
+        coordinate->decimalMinutes *= 10 ;
+
+    skipSpaces (scan) ;
+    return scanCharacter (scan, & coordinate->direction) ;
+}
+
+
+
+bool latitudeLongitude_fromString (LatitudeLongitude * latLon, string_view latLongString)
 {
     // lat/lon string format is
     //      d m.m {N|S}, d m.m {E|W}
@@ -83,31 +157,27 @@ bool latitudeLongitude_fromString (LatitudeLongitude * latLon, LatLongString lat
     //      degrees and decimal minutes are always >= 0
     //      decimal minutes is max 6 digits
 
-    struct {
-        unsigned int degrees ;
-        unsigned int minutes ;
-        char         decimalDigits [7] ;    // max 6 decimal digits
-        unsigned int decimalMinutes ;
-        char         direction ;
-    } lat, lon ;
+    Coordinate lat, lon ;
+    Scan       scan = { latLongString.data (), latLongString.data () + latLongString.size () } ;
+    char       comma ;
+
+    bool fault = ! scanCoordinate (& scan, & lat) ;
 
-    uint8_t scanResult;
+    if (! fault)
+    {
+        skipSpaces (& scan) ;
+        fault = ! scanCharacter (& scan, & comma) || (comma != ',') || ! scanCoordinate (& scan, & lon) ;
+    }
 
-    scanResult = sscanf (latLongString, "%u %u.%6s %c, %u %u.%6s %c",
-                         & lat.degrees, & lat.minutes, lat.decimalDigits, & lat.direction,
-                         & lon.degrees, & lon.minutes, lon.decimalDigits, & lon.direction) ;
+    if (fault)
+        return false ;
 
     lat.direction = toupper (lat.direction) ;
     lon.direction = toupper (lon.direction) ;
 
-    bool fault = (scanResult != 8) ;
-
     fault |= (lat.degrees >  90) || (lat.minutes > 60) ||
              (lon.degrees > 180) || (lon.minutes > 60) ;
 
-    fault |= ! decimalMinutes_x1e6_fromString (lat.decimalDigits, & lat.decimalMinutes) ||
-             ! decimalMinutes_x1e6_fromString (lon.decimalDigits, & lon.decimalMinutes) ;
-
     fault |= ! ((lat.direction == 'N') || (lat.direction == 'S')) ||
              ! ((lon.direction == 'E') || (lon.direction == 'W')) ;
 
@@ -1,6 +1,9 @@
 #ifndef _LATITIDE_LONGITUDE_H_
 #define _LATITIDE_LONGITUDE_H_
 
+#include <stdint.h>
+#include <string_view>
+
 
 typedef struct
 {
@@ -21,11 +24,16 @@ typedef struct
 
 typedef char LatLongString [36] ;
 
-// convert latitude/longitude to string
-void    latitudeLongitude_toString   (LatitudeLongitude *, LatLongString) ;
+// convert latitude/longitude to string, returns a view of the string written
+std::string_view latitudeLongitude_toString (const LatitudeLongitude *, LatLongString) ;
+
+// set latitude/longitude from string, which needn't be terminated, text after it is ignored
+//      neither allocates, so both are fine on the receive path
+bool latitudeLongitude_fromString (LatitudeLongitude *, std::string_view) ;
 
-// set latitude/longitude from string
-bool latitudeLongitude_fromString (LatitudeLongitude *, LatLongString) ;
+// a longitude, or the difference of two, into -180 .. +180 degrees
+//      taken as 64 bits, a difference or a whole circle of minutes_x1e5 is beyond int
+int32_t latitudeLongitude_wrapLongitude (int64_t minutes_x1e5) ;
 
 
 #endif
\ No newline at end of file
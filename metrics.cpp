@@ -0,0 +1,288 @@
+#include "metrics.hpp"
+
+#include <atomic>
+#include <thread>
+
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const struct
+{
+    const char *    name ;
+    const char *    help ;
+} counterInfo [] =
+{
+    { "gps_bytes_received_total",            "Bytes read from the receiver" },
+    { "gps_sentences_framed_total",          "NMEA sentences framed" },
+    { "gps_checksum_failures_total",         "NMEA sentences dropped for a bad checksum" },
+    { "gps_sentences_truncated_total",       "NMEA sentences too long or with missing fields" },
+    { "gps_sentences_unknown_total",         "NMEA sentences of an unknown type" },
+    { "gps_ubx_messages_total",              "UBX messages received" },
+    { "gps_ubx_checksum_failures_total",     "UBX messages dropped for a bad checksum" },
+    { "gps_ubx_too_long_total",              "UBX headers dropped for a length longer than any message" },
+    { "gps_raw_messages_dropped_total",      "Raw measurement messages the capture had no room for" },
+    { "gps_fixes_total",                     "Epochs with a valid position" },
+    { "gps_acquisitions_failed_total",       "Acquisitions that timed out" },
+} ;
+
+static const struct
+{
+    const char *    name ;
+    const char *    help ;
+} durationInfo [] =
+{
+    { "gps_datetime_acquisition_seconds",    "Time to acquire the date and time" },
+    { "gps_latlong_acquisition_seconds",     "Time to acquire the latitude and longitude" },
+} ;
+
+static_assert (sizeof (counterInfo)  / sizeof (counterInfo [0])  == MetricCounters,  "a counter has no name") ;
+static_assert (sizeof (durationInfo) / sizeof (durationInfo [0]) == MetricDurations, "a duration has no name") ;
+
+
+static atomic <uint64_t>    counters [MetricCounters] ;
+
+static struct
+{
+    atomic <uint64_t>       sum_ms ;
+    atomic <uint64_t>       count ;
+    atomic <uint32_t>       last_ms ;
+} durations [MetricDurations] ;
+
+static atomic <uint32_t>    fixesPerSecond_x1000 ;
+static atomic <int64_t>     timeToFirstFix_ms ;        // < 0 until the first fix
+
+// fix rate and time to first fix, from the reader thread, and power on from the acquisitions
+static atomic <int64_t>     poweredOn_ms ;
+static atomic <bool>        waitingForFirstFix ;
+static atomic <int64_t>     rateWindowStart_ms ;
+static atomic <uint32_t>    rateWindowFixes ;
+static atomic <int64_t>     rateUpdated_ms ;           // when fixesPerSecond was last set
+
+static thread               server ;
+static int                  serverSocket = -1 ;
+
+
+
+static int64_t monotonic_ms (void)
+{
+    struct timespec now ;
+    clock_gettime (CLOCK_MONOTONIC, & now) ;
+
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000 ;
+}
+
+
+void metrics_count (MetricCounter counter, uint64_t n)
+{
+    counters [counter].fetch_add (n, memory_order_relaxed) ;
+}
+
+
+void metrics_observe (MetricDuration duration, uint32_t milliseconds)
+{
+    durations [duration].sum_ms .fetch_add (milliseconds, memory_order_relaxed) ;
+    durations [duration].count  .fetch_add (1,            memory_order_relaxed) ;
+    durations [duration].last_ms.store     (milliseconds, memory_order_relaxed) ;
+}
+
+
+void metrics_powerOn (void)
+{
+    poweredOn_ms.store       (monotonic_ms (), memory_order_relaxed) ;
+    timeToFirstFix_ms.store  (-1,              memory_order_relaxed) ;
+    waitingForFirstFix.store (true,            memory_order_release) ;
+}
+
+
+void metrics_fix (bool positionValid)
+{
+    int64_t now_ms = monotonic_ms () ;
+
+    if (positionValid)
+    {
+        metrics_count (Metric_Fixes) ;
+        rateWindowFixes.fetch_add (1, memory_order_relaxed) ;
+
+        if (waitingForFirstFix.exchange (false, memory_order_acquire))
+            timeToFirstFix_ms.store (now_ms - poweredOn_ms.load (memory_order_relaxed), memory_order_relaxed) ;
+    }
+
+    // the rate over windows of at least a second
+    int64_t window_ms = now_ms - rateWindowStart_ms.load (memory_order_relaxed) ;
+
+    if (window_ms >= 1000)
+    {
+        uint32_t fixes = rateWindowFixes.exchange (0, memory_order_relaxed) ;
+
+        fixesPerSecond_x1000.store ((window_ms < 10000) ? (uint32_t) (fixes * 1000000ull / window_ms) : 0,
+                                    memory_order_relaxed) ;
+
+        rateWindowStart_ms.store (now_ms, memory_order_relaxed) ;
+        rateUpdated_ms    .store (now_ms, memory_order_relaxed) ;
+    }
+}
+
+
+
+size_t metrics_format (char * text, size_t size)
+{
+    size_t length = 0 ;
+
+    #define APPEND(...)                                                                 \
+        do {                                                                            \
+            int n = snprintf (text + length, size - length, __VA_ARGS__) ;              \
+            if ((n < 0) || ((size_t) n >= size - length)) return length ;              \
+            length += n ;                                                               \
+        } while (0)
+
+    for (uint8_t i = 0 ; i < MetricCounters ; i ++)
+    {
+        APPEND ("# HELP %s %s\n# TYPE %s counter\n%s %llu\n",
+                counterInfo [i].name, counterInfo [i].help, counterInfo [i].name, counterInfo [i].name,
+                (unsigned long long) counters [i].load (memory_order_relaxed)) ;
+    }
+
+    for (uint8_t i = 0 ; i < MetricDurations ; i ++)
+    {
+        const char * name = durationInfo [i].name ;
+
+        APPEND ("# HELP %s %s\n# TYPE %s summary\n%s_sum %.3f\n%s_count %llu\n",
+                name, durationInfo [i].help, name,
+                name, durations [i].sum_ms.load (memory_order_relaxed) / 1000.0,
+                name, (unsigned long long) durations [i].count.load (memory_order_relaxed)) ;
+
+        APPEND ("# HELP %s_last The last acquisition\n# TYPE %s_last gauge\n%s_last %.3f\n",
+                name, name, name, durations [i].last_ms.load (memory_order_relaxed) / 1000.0) ;
+    }
+
+    // no epochs at all for a while means no fixes, however long ago the rate was last set
+    bool     stale = monotonic_ms () - rateUpdated_ms.load (memory_order_relaxed) > Metrics_RateStale_ms ;
+    uint32_t rate  = stale ? 0 : fixesPerSecond_x1000.load (memory_order_relaxed) ;
+
+    APPEND ("# HELP gps_fixes_per_second Fix rate over the last second\n"
+            "# TYPE gps_fixes_per_second gauge\ngps_fixes_per_second %.3f\n",
+            rate / 1000.0) ;
+
+    int64_t ttff_ms = timeToFirstFix_ms.load (memory_order_relaxed) ;
+    if (ttff_ms >= 0)
+    {
+        APPEND ("# HELP gps_time_to_first_fix_seconds Time from power on to the first fix\n"
+                "# TYPE gps_time_to_first_fix_seconds gauge\ngps_time_to_first_fix_seconds %.3f\n",
+                ttff_ms / 1000.0) ;
+    }
+
+    #undef APPEND
+
+    return length ;
+}
+
+
+bool metrics_writeFile (const char * path)
+{
+    static char text [4096] ;
+    size_t length = metrics_format (text, sizeof (text)) ;
+
+    // node_exporter must never read a half written file
+    char temporary [256] ;
+    snprintf (temporary, sizeof (temporary), "%s.tmp", path) ;
+
+    FILE * file = fopen (temporary, "w") ;
+    if (file == NULL)
+        return false ;
+
+    bool ok = fwrite (text, 1, length, file) == length ;
+
+    ok &= (fclose (file) == 0) ;
+    ok  = ok && (rename (temporary, path) == 0) ;
+
+    if (! ok)
+        unlink (temporary) ;
+
+    return ok ;
+}
+
+
+
+static void serve (int listening)
+{
+    char text [4096] ;
+
+    while (1)
+    {
+        int client = accept (listening, NULL, NULL) ;
+        if (client < 0)
+            break ;     // metrics_stopServing () shut the socket down
+
+        // answer as HTTP, so curl and the Prometheus scraper (through a proxy) can read it,
+        // after giving the client a moment to send its request
+        struct pollfd ready = { client, POLLIN, 0 } ;
+        if (poll (& ready, 1, 100) > 0)
+            recv (client, text, sizeof (text), MSG_DONTWAIT) ;
+
+        size_t length = metrics_format (text, sizeof (text)) ;
+
+        char header [128] ;
+        int headerLength = snprintf (header, sizeof (header),
+                                     "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n",
+                                     length) ;
+
+        send (client, header, headerLength, MSG_NOSIGNAL) ;
+        send (client, text,   length,       MSG_NOSIGNAL) ;
+        close (client) ;
+    }
+}
+
+
+bool metrics_serve (const char * socketPath)
+{
+    if (serverSocket >= 0)
+        return false ;
+
+    struct sockaddr_un address ;
+    memset (& address, 0, sizeof (address)) ;
+    address.sun_family = AF_UNIX ;
+
+    if (strlen (socketPath) >= sizeof (address.sun_path))
+        return false ;
+
+    strcpy (address.sun_path, socketPath) ;
+
+    int listening = socket (AF_UNIX, SOCK_STREAM, 0) ;
+    if (listening < 0)
+        return false ;
+
+    unlink (socketPath) ;
+
+    if ((bind (listening, (struct sockaddr *) & address, sizeof (address)) != 0) ||
+        (listen (listening, 4) != 0))
+    {
+        close (listening) ;
+        return false ;
+    }
+
+    serverSocket = listening ;
+    server       = thread (serve, listening) ;
+
+    return true ;
+}
+
+
+void metrics_stopServing (void)
+{
+    if (serverSocket < 0)
+        return ;
+
+    shutdown (serverSocket, SHUT_RDWR) ;
+    server.join () ;
+
+    close (serverSocket) ;
+    serverSocket = -1 ;
+}
@@ -0,0 +1,68 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// receiver and parser health, in the Prometheus text exposition format
+//
+//      counters and gauges are relaxed atomics, so updating them from the reader thread costs
+//      an uncontended add and never blocks on the exporter
+//      export to a file (for node_exporter's textfile collector), or serve them on a UNIX socket:
+//          curl --unix-socket /run/gps-metrics.sock http://localhost/metrics
+
+
+typedef enum
+{
+    Metric_BytesReceived,
+    Metric_SentencesFramed,
+    Metric_ChecksumFailures,            // only checked for sentence types that are subscribed to
+    Metric_TruncatedSentences,          // too long for the buffer, or missing fields
+    Metric_UnknownSentences,
+    Metric_UbxMessages,
+    Metric_UbxChecksumFailures,         // each one resynchronizes the framer
+    Metric_UbxTooLong,                  // a length longer than any message, taken as a false sync
+    Metric_RawMessagesDropped,          // raw measurements lost by the capture (raw-capture.hpp)
+    Metric_Fixes,                       // epochs with a valid position
+    Metric_AcquisitionsFailed,
+
+    MetricCounters
+} MetricCounter ;
+
+
+typedef enum
+{
+    Metric_DateTimeAcquisition,
+    Metric_LatLongAcquisition,
+
+    MetricDurations
+} MetricDuration ;
+
+
+void metrics_count   (MetricCounter, uint64_t n = 1) ;
+void metrics_observe (MetricDuration, uint32_t milliseconds) ;
+
+// the receiver was powered on, time to first fix is measured from here
+void metrics_powerOn (void) ;
+
+// an epoch was received (its RMC, see nmea0183.cpp), updates the fix counter, the fix rate and
+// time to first fix, whether or not anything subscribes to the fixes
+//      the rate is reported as 0 once no epoch has arrived for RateStale_ms
+static const uint32_t Metrics_RateStale_ms = 2000 ;
+
+void metrics_fix (bool positionValid) ;
+
+
+// returns the length of the text, which is cut short if it doesn't fit
+size_t metrics_format (char * text, size_t size) ;
+
+// false if the file can't be written, it is replaced atomically
+bool metrics_writeFile (const char * path) ;
+
+// answer each connection to the socket with the metrics, on a thread of its own
+bool metrics_serve       (const char * socketPath) ;
+void metrics_stopServing (void) ;
+
+
+#endif
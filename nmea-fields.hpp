@@ -0,0 +1,336 @@
+#ifndef _NMEA_FIELDS_H_
+#define _NMEA_FIELDS_H_
+
+#include "nmea-sentence.hpp"
+
+#include <stdint.h>
+#include <string.h>
+#include <string_view>
+
+
+// the field parsers shared by the decoders in nmea-sentence.cpp and the compile time
+// specialized parsers in nmea-parser.hpp, inline so each parser only keeps what it calls
+
+
+namespace nmeaFields
+{
+
+inline int hexDigit (char c)
+{
+    if ((c >= '0') && (c <= '9'))   return c - '0' ;
+    if ((c >= 'A') && (c <= 'F'))   return c - 'A' + 10 ;
+    if ((c >= 'a') && (c <= 'f'))   return c - 'a' + 10 ;
+    return -1 ;
+}
+
+
+inline bool checksumIsOk (std::string_view message, const char ** checksumDelimiter)
+{
+    // *CS is checksum (8 bit exclusive OR of all data in the sentence, including ","
+    // delimiters, between but not including the '$' and '*' delimiters.
+
+    // the first character must be '$'
+    if (message.empty () || (message [0] != '$'))
+        return false ;
+
+    // the message ends at the first line end, if there is one
+    size_t length = message.find_first_of ("\r\n\0", 1, 3) ;
+    if (length == std::string_view::npos)
+        length = message.size () ;
+
+    // check minimum length
+    if (length < 4)
+        return false ;
+
+    // read the checksum
+    int high = hexDigit (message [length - 2]) ;
+    int low  = hexDigit (message [length - 1]) ;
+    if ((high < 0) || (low < 0))
+        return false ;
+
+    // verify '*' character
+    if (message [length - 3] != '*')
+        return false ;
+
+    * checksumDelimiter = message.data () + length - 3 ;
+
+    // compute the checksum
+    uint8_t checksum = (high << 4) | low ;
+    for (size_t i = 1 ; i < length - 3 ; i ++)
+        checksum ^= message [i] ;
+
+    return (checksum == 0) ;
+}
+
+
+
+// fields are read in place, straight out of the received sentence
+//      (no copy, and unlike strtok() empty fields are kept)
+
+typedef struct
+{
+    const char *    text ;
+    uint8_t         length ;
+} Field ;
+
+
+typedef struct
+{
+    const char *    next ;          // start of the next field, NULL when there are no more
+    const char *    end ;           // the '*' checksum delimiter
+    bool            truncated ;     // a field was asked for that isn't there
+} Fields ;
+
+
+
+inline void fields_initialize (Fields * fields, const char * sentence, const char * end)
+{
+    // skip the address field ("$GPRMC")
+    const char * comma = (const char *) memchr (sentence, ',', end - sentence) ;
+
+    fields->next      = (comma != NULL) ? comma + 1 : NULL ;
+    fields->end       = end ;
+    fields->truncated = false ;
+}
+
+
+inline Field nextField (Fields * fields)
+{
+    Field field = { "", 0 } ;
+
+    if (fields->next == NULL)
+    {
+        fields->truncated = true ;
+        return field ;
+    }
+
+    const char * comma = (const char *) memchr (fields->next, ',', fields->end - fields->next) ;
+    const char * stop  = (comma != NULL) ? comma : fields->end ;
+
+    field.text   = fields->next ;
+    field.length = stop - fields->next ;
+
+    fields->next = (comma != NULL) ? comma + 1 : NULL ;
+
+    return field ;
+}
+
+
+inline void skipFields (Fields * fields, uint8_t count)
+{
+    while (count --)
+        nextField (fields) ;
+}
+
+
+inline uint8_t remainingFields (Fields * fields)
+{
+    if (fields->next == NULL)
+        return 0 ;
+
+    uint8_t count = 1 ;
+    for (const char * c = fields->next ; c < fields->end ; ++ c)
+        count += (* c == ',') ;
+
+    return count ;
+}
+
+
+inline void copyTalker (NmeaTalker talker, const char * sentence)
+{
+    talker [0] = sentence [1] ;
+    talker [1] = sentence [2] ;
+    talker [2] = 0 ;
+}
+
+
+
+inline bool parseDigits (const char * text, uint8_t count, uint8_t * value)
+{
+    uint8_t result = 0 ;
+
+    while (count --)
+    {
+        uint8_t digit = * text ++ - '0' ;
+        if (digit > 9)
+            return false ;
+
+        result = result * 10 + digit ;
+    }
+
+    * value = result ;
+    return true ;
+}
+
+
+inline bool parseUnsigned (Field field, uint32_t * value)
+{
+    if ((field.length == 0) || (field.length > 9))
+        return false ;
+
+    uint32_t result = 0 ;
+
+    for (uint8_t i = 0 ; i < field.length ; i ++)
+    {
+        uint8_t digit = field.text [i] - '0' ;
+        if (digit > 9)
+            return false ;
+
+        result = result * 10 + digit ;
+    }
+
+    * value = result ;
+    return true ;
+}
+
+
+inline bool parseFixed (Field field, uint8_t decimals, int32_t * value)
+{
+    // "-12.345" with decimals = 2 gives -1234 (extra decimals are truncated)
+
+    const char * c   = field.text ;
+    const char * end = field.text + field.length ;
+
+    bool negative = (c < end) && (* c == '-') ;
+    if (negative)
+        ++ c ;
+
+    int32_t result   = 0 ;
+    uint8_t digits   = 0 ;
+    int8_t  fraction = -1 ;         // decimals seen so far, -1 before the '.'
+
+    for ( ; c < end ; ++ c)
+    {
+        if ((* c == '.') && (fraction < 0))
+        {
+            fraction = 0 ;
+            continue ;
+        }
+
+        uint8_t digit = * c - '0' ;
+        if (digit > 9)
+            return false ;
+
+        if (fraction >= decimals)
+            continue ;
+
+        if (++ digits > 9)
+            return false ;
+
+        result = result * 10 + digit ;
+
+        if (fraction >= 0)
+            ++ fraction ;
+    }
+
+    if (digits == 0)
+        return false ;
+
+    for (fraction = (fraction < 0) ? 0 : fraction ; fraction < decimals ; ++ fraction)
+        result *= 10 ;
+
+    * value = negative ? -result : result ;
+    return true ;
+}
+
+
+inline bool parseTime (Field field, NmeaTime * time)
+{
+    // hhmmss or hhmmss.ss
+
+    time->hundredths = 0 ;
+
+    time->valid = (field.length >= 6) &&
+                  parseDigits (field.text + 0, 2, & time->hours)   && (time->hours   < 24) &&
+                  parseDigits (field.text + 2, 2, & time->minutes) && (time->minutes < 60) &&
+                  parseDigits (field.text + 4, 2, & time->seconds) && (time->seconds < 61) ;
+
+    if (time->valid && (field.length >= 9) && (field.text [6] == '.'))
+        time->valid = parseDigits (field.text + 7, 2, & time->hundredths) ;
+
+    return time->valid ;
+}
+
+
+inline bool parseDate (Field field, NmeaDate * date)
+{
+    // ddmmyy
+
+    date->valid = (field.length == 6) &&
+                  parseDigits (field.text + 0, 2, & date->day)   && (date->day   >= 1) && (date->day   <= 31) &&
+                  parseDigits (field.text + 2, 2, & date->month) && (date->month >= 1) && (date->month <= 12) &&
+                  parseDigits (field.text + 4, 2, & date->year) ;
+
+    return date->valid ;
+}
+
+
+inline bool parseCoordinate (Field value, Field direction, uint8_t degreeDigits,
+                             char positive, char negative, int * minutes_x1e5)
+{
+    // (d)ddmm.mmmmm followed by a direction field
+
+    uint8_t degrees ;
+    int32_t minutes ;
+
+    if ((value.length <= degreeDigits) || ! parseDigits (value.text, degreeDigits, & degrees))
+        return false ;
+
+    Field minutesField = { value.text + degreeDigits, (uint8_t) (value.length - degreeDigits) } ;
+    if (! parseFixed (minutesField, 5, & minutes) || (minutes < 0) || (minutes >= 60 * 100000))
+        return false ;
+
+    if (direction.length != 1)
+        return false ;
+
+    int result = degrees * 60 * 100000 + minutes ;
+
+    if      (direction.text [0] == positive)    * minutes_x1e5 =  result ;
+    else if (direction.text [0] == negative)    * minutes_x1e5 = -result ;
+    else                                        return false ;
+
+    return true ;
+}
+
+
+inline bool parsePosition (Fields * fields, LatitudeLongitude * position)
+{
+    // always consume all 4 fields
+
+    Field latitude           = nextField (fields) ;
+    Field latitudeDirection  = nextField (fields) ;
+    Field longitude          = nextField (fields) ;
+    Field longitudeDirection = nextField (fields) ;
+
+    LatitudeLongitude result ;
+
+    bool ok = parseCoordinate (latitude,  latitudeDirection,  2, 'N', 'S', & result.latitude_minutes_x1e5) &&
+              parseCoordinate (longitude, longitudeDirection, 3, 'E', 'W', & result.longitude_minutes_x1e5) &&
+              (result.latitude_minutes_x1e5  >=  -90 * 60 * 100000) && (result.latitude_minutes_x1e5  <=  90 * 60 * 100000) &&
+              (result.longitude_minutes_x1e5 >= -180 * 60 * 100000) && (result.longitude_minutes_x1e5 <= 180 * 60 * 100000) ;
+
+    if (! ok)
+        result.latitude_minutes_x1e5 = result.longitude_minutes_x1e5 = 0 ;
+
+    * position = result ;
+
+    return ok ;
+}
+
+
+inline int32_t optionalFixed (Field field, uint8_t decimals)
+{
+    int32_t value ;
+    return parseFixed (field, decimals, & value) ? value : -1 ;
+}
+
+
+inline bool isActive (Field field)
+{
+    return (field.length == 1) && (field.text [0] == 'A') ;
+}
+
+}
+
+
+#endif
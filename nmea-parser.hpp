@@ -0,0 +1,506 @@
+#ifndef _NMEA_PARSER_H_
+#define _NMEA_PARSER_H_
+
+#include "nmea-fields.hpp"
+#include "nmea-sentence.hpp"
+
+#include <stdint.h>
+#include <string_view>
+
+
+// NMEA parsers specialized at compile time for the sentences and fields an application uses
+//
+//      NmeaParser <Rmc <RmcField_Time | RmcField_Date>, Gga <GgaField_Position>>::parse (line, handler)
+//
+//      recognition is a handful of integer compares against constexpr keys, for the listed
+//      sentences only, and each decoder parses just its wanted fields: the others are skipped
+//      without being looked at, and decoding stops after the last wanted field
+//      fields that aren't wanted are left as they were in the struct passed to decode (), and
+//      are zero in the one NmeaParser hands to the handler
+//
+//      the handler is any callable taking a const pointer to each listed sentence's struct,
+//      such as a struct with an operator () per sentence, so it can be inlined too
+//
+//      Rmc <> and friends (all fields) are what nmeaSentence_decodeXXX () use
+
+
+constexpr uint32_t nmeaSentenceKey (char a, char b, char c)
+{
+    // the sentence id ("RMC") packed into an integer, so recognizing it is one compare
+    return ((uint32_t) (uint8_t) a << 16) | ((uint32_t) (uint8_t) b << 8) | (uint8_t) c ;
+}
+
+constexpr uint16_t nmeaTalkerKey (char a, char b)
+{
+    return (uint16_t) (((uint8_t) a << 8) | (uint8_t) b) ;
+}
+
+
+// what is recognized, here and by nmea0183's reader, from the one table of each
+
+// the talkers the receiver uses
+static constexpr uint16_t nmeaTalkers [] =
+{
+    nmeaTalkerKey ('G', 'P'),       // GPS
+    nmeaTalkerKey ('G', 'L'),       // GLONASS
+    nmeaTalkerKey ('G', 'A'),       // Galileo
+    nmeaTalkerKey ('G', 'B'),       // BeiDou
+    nmeaTalkerKey ('G', 'Q'),       // QZSS
+    nmeaTalkerKey ('G', 'N'),       // combined
+    nmeaTalkerKey ('B', 'D'),       // BeiDou, before NMEA 4.10
+} ;
+
+// the sentence ids, and the type each is decoded as
+static constexpr struct
+{
+    uint32_t            key ;
+    NmeaSentenceType    type ;
+} nmeaSentenceIds [] =
+{
+    { nmeaSentenceKey ('R', 'M', 'C'), NmeaSentence_RMC },
+    { nmeaSentenceKey ('G', 'G', 'A'), NmeaSentence_GGA },
+    { nmeaSentenceKey ('G', 'S', 'A'), NmeaSentence_GSA },
+    { nmeaSentenceKey ('G', 'S', 'V'), NmeaSentence_GSV },
+    { nmeaSentenceKey ('V', 'T', 'G'), NmeaSentence_VTG },
+    { nmeaSentenceKey ('G', 'L', 'L'), NmeaSentence_GLL },
+} ;
+
+static_assert (sizeof (nmeaSentenceIds) / sizeof (nmeaSentenceIds [0]) == NmeaSentenceTypes, "every sentence type needs a table entry") ;
+
+constexpr uint32_t nmeaSentenceKeyOf (NmeaSentenceType type)
+{
+    for (const auto & id : nmeaSentenceIds)
+        if (id.type == type)
+            return id.key ;
+
+    return 0 ;
+}
+
+
+// true if any field after field is wanted
+constexpr bool nmeaWantsAfter (uint32_t wanted, uint32_t field)
+{
+    return (wanted & ~(field | (field - 1))) != 0 ;
+}
+
+
+
+typedef enum
+{
+    RmcField_Time       = 1 << 0,
+    RmcField_Status     = 1 << 1,
+    RmcField_Position   = 1 << 2,
+    RmcField_Speed      = 1 << 3,
+    RmcField_Course     = 1 << 4,
+    RmcField_Date       = 1 << 5,
+    RmcField_All        = (1 << 6) - 1,
+} RmcField ;
+
+
+template <uint32_t Wanted = RmcField_All>
+struct Rmc
+{
+    typedef NmeaRMC Sentence ;
+    static constexpr uint32_t key = nmeaSentenceKeyOf (NmeaSentence_RMC) ;
+
+    static bool decode (const char * sentence, const char * end, NmeaRMC * rmc)
+    {
+        // $GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W*6A
+        using namespace nmeaFields ;
+
+        Fields fields ;
+        fields_initialize (& fields, sentence, end) ;
+
+        copyTalker (rmc->talker, sentence) ;
+
+        if constexpr (Wanted & RmcField_Time)       parseTime (nextField (& fields), & rmc->time) ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, RmcField_Time))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & RmcField_Status)     rmc->active = isActive (nextField (& fields)) ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, RmcField_Status))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & RmcField_Position)   rmc->positionValid = parsePosition (& fields, & rmc->position) ;
+        else                                        skipFields (& fields, 4) ;
+        if constexpr (! nmeaWantsAfter (Wanted, RmcField_Position))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & RmcField_Speed)      rmc->speed_knots_x1000 = optionalFixed (nextField (& fields), 3) ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, RmcField_Speed))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & RmcField_Course)     rmc->course_degrees_x100 = optionalFixed (nextField (& fields), 2) ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, RmcField_Course))
+            return ! fields.truncated ;
+
+        parseDate (nextField (& fields), & rmc->date) ;
+
+        // magnetic variation, mode and navigation status are not used
+
+        return ! fields.truncated ;
+    }
+} ;
+
+
+
+typedef enum
+{
+    GgaField_Time            = 1 << 0,
+    GgaField_Position        = 1 << 1,
+    GgaField_Quality         = 1 << 2,
+    GgaField_Satellites      = 1 << 3,
+    GgaField_Hdop            = 1 << 4,
+    GgaField_Altitude        = 1 << 5,
+    GgaField_GeoidSeparation = 1 << 6,
+    GgaField_All             = (1 << 7) - 1,
+} GgaField ;
+
+
+template <uint32_t Wanted = GgaField_All>
+struct Gga
+{
+    typedef NmeaGGA Sentence ;
+    static constexpr uint32_t key = nmeaSentenceKeyOf (NmeaSentence_GGA) ;
+
+    static bool decode (const char * sentence, const char * end, NmeaGGA * gga)
+    {
+        // $GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47
+        using namespace nmeaFields ;
+
+        Fields fields ;
+        fields_initialize (& fields, sentence, end) ;
+
+        copyTalker (gga->talker, sentence) ;
+
+        [[maybe_unused]] uint32_t value ;
+
+        if constexpr (Wanted & GgaField_Time)       parseTime (nextField (& fields), & gga->time) ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, GgaField_Time))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & GgaField_Position)   gga->positionValid = parsePosition (& fields, & gga->position) ;
+        else                                        skipFields (& fields, 4) ;
+        if constexpr (! nmeaWantsAfter (Wanted, GgaField_Position))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & GgaField_Quality)    gga->fixQuality = parseUnsigned (nextField (& fields), & value) ? value : 0 ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, GgaField_Quality))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & GgaField_Satellites) gga->satellitesUsed = parseUnsigned (nextField (& fields), & value) ? value : 0 ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, GgaField_Satellites))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & GgaField_Hdop)       gga->hdop_x100 = optionalFixed (nextField (& fields), 2) ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, GgaField_Hdop))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & GgaField_Altitude)   gga->altitudeValid = parseFixed (nextField (& fields), 2, & gga->altitude_cm) ;
+        else                                        skipFields (& fields, 1) ;
+        nextField (& fields) ;      // M
+        if constexpr (! nmeaWantsAfter (Wanted, GgaField_Altitude))
+            return ! fields.truncated ;
+
+        if (! parseFixed (nextField (& fields), 2, & gga->geoidSeparation_cm))
+            gga->geoidSeparation_cm = 0 ;
+        nextField (& fields) ;      // M
+
+        // age of differential corrections and station id are not used
+
+        return ! fields.truncated ;
+    }
+} ;
+
+
+
+typedef enum
+{
+    GsaField_Mode       = 1 << 0,       // selection mode and fix type
+    GsaField_Satellites = 1 << 1,
+    GsaField_Dop        = 1 << 2,
+    GsaField_SystemId   = 1 << 3,
+    GsaField_All        = (1 << 4) - 1,
+} GsaField ;
+
+
+template <uint32_t Wanted = GsaField_All>
+struct Gsa
+{
+    typedef NmeaGSA Sentence ;
+    static constexpr uint32_t key = nmeaSentenceKeyOf (NmeaSentence_GSA) ;
+
+    static bool decode (const char * sentence, const char * end, NmeaGSA * gsa)
+    {
+        // $GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1*39
+        using namespace nmeaFields ;
+
+        Fields fields ;
+        fields_initialize (& fields, sentence, end) ;
+
+        copyTalker (gsa->talker, sentence) ;
+
+        [[maybe_unused]] uint32_t value ;
+
+        if constexpr (Wanted & GsaField_Mode)
+        {
+            Field mode = nextField (& fields) ;
+            gsa->selectionMode = (mode.length == 1) ? mode.text [0] : 0 ;
+            gsa->fixType       = parseUnsigned (nextField (& fields), & value) ? value : 1 ;
+        }
+        else
+            skipFields (& fields, 2) ;
+        if constexpr (! nmeaWantsAfter (Wanted, GsaField_Mode))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & GsaField_Satellites)
+        {
+            gsa->satelliteCount = 0 ;
+            for (uint8_t i = 0 ; i < NmeaGsaMaxSatellites ; i ++)
+            {
+                if (parseUnsigned (nextField (& fields), & value) && (value != 0) && (value <= 255))
+                    gsa->prn [gsa->satelliteCount ++] = value ;
+            }
+        }
+        else
+            skipFields (& fields, NmeaGsaMaxSatellites) ;
+        if constexpr (! nmeaWantsAfter (Wanted, GsaField_Satellites))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & GsaField_Dop)
+        {
+            gsa->pdop_x100 = optionalFixed (nextField (& fields), 2) ;
+            gsa->hdop_x100 = optionalFixed (nextField (& fields), 2) ;
+            gsa->vdop_x100 = optionalFixed (nextField (& fields), 2) ;
+        }
+        else
+            skipFields (& fields, 3) ;
+
+        if (fields.truncated)
+            return false ;
+
+        if constexpr (Wanted & GsaField_SystemId)
+            gsa->systemId = (remainingFields (& fields) > 0) && parseUnsigned (nextField (& fields), & value) ? value : 0 ;
+
+        return true ;
+    }
+} ;
+
+
+
+typedef enum
+{
+    GsvField_Header     = 1 << 0,       // sentence count and number, satellites in view (always decoded)
+    GsvField_Satellites = 1 << 1,
+    GsvField_All        = (1 << 2) - 1,
+} GsvField ;
+
+
+template <uint32_t Wanted = GsvField_All>
+struct Gsv
+{
+    typedef NmeaGSV Sentence ;
+    static constexpr uint32_t key = nmeaSentenceKeyOf (NmeaSentence_GSV) ;
+
+    static bool decode (const char * sentence, const char * end, NmeaGSV * gsv)
+    {
+        // $GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45*75
+        using namespace nmeaFields ;
+
+        Fields fields ;
+        fields_initialize (& fields, sentence, end) ;
+
+        copyTalker (gsv->talker, sentence) ;
+
+        // the header is needed to tell whether the sentence is good
+        uint32_t value ;
+        gsv->sentenceCount    = parseUnsigned (nextField (& fields), & value) ? value : 0 ;
+        gsv->sentenceNumber   = parseUnsigned (nextField (& fields), & value) ? value : 0 ;
+        gsv->satellitesInView = parseUnsigned (nextField (& fields), & value) ? value : 0 ;
+
+        if (fields.truncated || (gsv->sentenceNumber == 0) || (gsv->sentenceNumber > gsv->sentenceCount))
+            return false ;
+
+        if constexpr (Wanted & GsvField_Satellites)
+        {
+            // 4 fields per satellite, possibly followed by a NMEA 4.1 signal id
+            uint8_t satellites = remainingFields (& fields) / 4 ;
+            if (satellites > NmeaGsvMaxSatellites)
+                satellites = NmeaGsvMaxSatellites ;
+
+            gsv->satelliteCount = 0 ;
+            while (satellites --)
+            {
+                NmeaSatellite * satellite = & gsv->satellites [gsv->satelliteCount] ;
+
+                bool ok = parseUnsigned (nextField (& fields), & value) && (value <= 255) ;
+                satellite->prn       = ok ? value : 0 ;
+                satellite->elevation = optionalFixed (nextField (& fields), 0) ;
+                satellite->azimuth   = optionalFixed (nextField (& fields), 0) ;
+                satellite->snr       = optionalFixed (nextField (& fields), 0) ;
+
+                if (ok)
+                    ++ gsv->satelliteCount ;
+            }
+        }
+
+        return ! fields.truncated ;
+    }
+} ;
+
+
+
+typedef enum
+{
+    VtgField_Course     = 1 << 0,
+    VtgField_Speed      = 1 << 1,       // knots
+    VtgField_SpeedKph   = 1 << 2,
+    VtgField_All        = (1 << 3) - 1,
+} VtgField ;
+
+
+template <uint32_t Wanted = VtgField_All>
+struct Vtg
+{
+    typedef NmeaVTG Sentence ;
+    static constexpr uint32_t key = nmeaSentenceKeyOf (NmeaSentence_VTG) ;
+
+    static bool decode (const char * sentence, const char * end, NmeaVTG * vtg)
+    {
+        // $GPVTG,054.7,T,034.4,M,005.5,N,010.2,K*48
+        using namespace nmeaFields ;
+
+        Fields fields ;
+        fields_initialize (& fields, sentence, end) ;
+
+        copyTalker (vtg->talker, sentence) ;
+
+        if constexpr (Wanted & VtgField_Course)     vtg->course_degrees_x100 = optionalFixed (nextField (& fields), 2) ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, VtgField_Course))
+            return ! fields.truncated ;
+
+        skipFields (& fields, 3) ;  // T, magnetic track, M
+
+        if constexpr (Wanted & VtgField_Speed)      vtg->speed_knots_x1000 = optionalFixed (nextField (& fields), 3) ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, VtgField_Speed))
+            return ! fields.truncated ;
+
+        nextField (& fields) ;      // N
+        vtg->speed_kph_x1000 = optionalFixed (nextField (& fields), 3) ;
+
+        return ! fields.truncated ;
+    }
+} ;
+
+
+
+typedef enum
+{
+    GllField_Position   = 1 << 0,
+    GllField_Time       = 1 << 1,
+    GllField_Status     = 1 << 2,
+    GllField_All        = (1 << 3) - 1,
+} GllField ;
+
+
+template <uint32_t Wanted = GllField_All>
+struct Gll
+{
+    typedef NmeaGLL Sentence ;
+    static constexpr uint32_t key = nmeaSentenceKeyOf (NmeaSentence_GLL) ;
+
+    static bool decode (const char * sentence, const char * end, NmeaGLL * gll)
+    {
+        // $GPGLL,4916.45,N,12311.12,W,225444,A,*1D
+        using namespace nmeaFields ;
+
+        Fields fields ;
+        fields_initialize (& fields, sentence, end) ;
+
+        copyTalker (gll->talker, sentence) ;
+
+        if constexpr (Wanted & GllField_Position)   gll->positionValid = parsePosition (& fields, & gll->position) ;
+        else                                        skipFields (& fields, 4) ;
+        if constexpr (! nmeaWantsAfter (Wanted, GllField_Position))
+            return ! fields.truncated ;
+
+        if constexpr (Wanted & GllField_Time)       parseTime (nextField (& fields), & gll->time) ;
+        else                                        skipFields (& fields, 1) ;
+        if constexpr (! nmeaWantsAfter (Wanted, GllField_Time))
+            return ! fields.truncated ;
+
+        gll->active = isActive (nextField (& fields)) ;
+
+        return ! fields.truncated ;
+    }
+} ;
+
+
+
+template <typename... Sentences>
+struct NmeaParser
+{
+    static_assert (sizeof... (Sentences) > 0, "a parser needs at least one sentence type") ;
+
+    // one sentence, checked and decoded, returns false if it isn't one of Sentences, its
+    // checksum is bad or it is missing fields
+    template <typename Handler>
+    static bool parse (std::string_view sentence, Handler && handler)
+    {
+        // "$" talker id ","
+        if ((sentence.size () < 7) || (sentence [0] != '$') || (sentence [6] != ','))
+            return false ;
+
+        if (! isTalker (nmeaTalkerKey (sentence [1], sentence [2])))
+            return false ;
+
+        // only sentences this parser decodes get their checksum checked
+        uint32_t key = nmeaSentenceKey (sentence [3], sentence [4], sentence [5]) ;
+        if (! ((key == Sentences::key) || ...))
+            return false ;
+
+        const char * end ;
+        if (! nmeaFields::checksumIsOk (sentence, & end))
+            return false ;
+
+        return (decode <Sentences> (key, sentence.data (), end, handler) || ...) ;
+    }
+
+private:
+
+    static constexpr bool isTalker (uint16_t talker)
+    {
+        for (uint16_t known : nmeaTalkers)
+            if (talker == known)
+                return true ;
+
+        return false ;
+    }
+
+    template <typename Sentence, typename Handler>
+    static bool decode (uint32_t key, const char * sentence, const char * end, Handler & handler)
+    {
+        if (key != Sentence::key)
+            return false ;
+
+        typename Sentence::Sentence decoded = {} ;
+        if (! Sentence::decode (sentence, end, & decoded))
+            return false ;
+
+        handler (static_cast <const typename Sentence::Sentence *> (& decoded)) ;
+        return true ;
+    }
+} ;
+
+
+#endif
@@ -0,0 +1,42 @@
+#include "nmea-sentence.hpp"
+
+#include "nmea-parser.hpp"
+
+
+// the decoders with every field, the field parsing is in nmea-parser.hpp and nmea-fields.hpp
+
+
+bool nmeaSentence_decodeRMC (const char * sentence, const char * end, NmeaRMC * rmc)
+{
+    return Rmc <>::decode (sentence, end, rmc) ;
+}
+
+
+bool nmeaSentence_decodeGGA (const char * sentence, const char * end, NmeaGGA * gga)
+{
+    return Gga <>::decode (sentence, end, gga) ;
+}
+
+
+bool nmeaSentence_decodeGSA (const char * sentence, const char * end, NmeaGSA * gsa)
+{
+    return Gsa <>::decode (sentence, end, gsa) ;
+}
+
+
+bool nmeaSentence_decodeGSV (const char * sentence, const char * end, NmeaGSV * gsv)
+{
+    return Gsv <>::decode (sentence, end, gsv) ;
+}
+
+
+bool nmeaSentence_decodeVTG (const char * sentence, const char * end, NmeaVTG * vtg)
+{
+    return Vtg <>::decode (sentence, end, vtg) ;
+}
+
+
+bool nmeaSentence_decodeGLL (const char * sentence, const char * end, NmeaGLL * gll)
+{
+    return Gll <>::decode (sentence, end, gll) ;
+}
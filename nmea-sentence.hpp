@@ -0,0 +1,146 @@
+#ifndef _NMEA_SENTENCE_H_
+#define _NMEA_SENTENCE_H_
+
+#include "lat-long.hpp"
+
+#include <stdint.h>
+
+
+// decoded NMEA 0183 sentences
+//      numeric fields are fixed point integers, scaled as the field name says
+//      a field the receiver left empty is reported as negative (or as not valid)
+
+
+typedef enum
+{
+    NmeaSentence_RMC,
+    NmeaSentence_GGA,
+    NmeaSentence_GSA,
+    NmeaSentence_GSV,
+    NmeaSentence_VTG,
+    NmeaSentence_GLL,
+
+    NmeaSentenceTypes,                  // number of known sentence types
+    NmeaSentence_Unknown = NmeaSentenceTypes
+} NmeaSentenceType ;
+
+
+typedef struct
+{
+    uint8_t     hours ;
+    uint8_t     minutes ;
+    uint8_t     seconds ;
+    uint8_t     hundredths ;            // 0 if the receiver doesn't send fractional seconds
+    bool        valid ;
+} NmeaTime ;
+
+
+typedef struct
+{
+    uint8_t     day ;
+    uint8_t     month ;
+    uint8_t     year ;                  // 2 digits
+    bool        valid ;
+} NmeaDate ;
+
+
+typedef char NmeaTalker [3] ;           // "GP", "GL", "GA", "GB", "GN", ...
+
+
+typedef struct
+{
+    NmeaTalker          talker ;
+    NmeaTime            time ;
+    bool                active ;                // status A (active) or V (void)
+    bool                positionValid ;
+    LatitudeLongitude   position ;
+    int32_t             speed_knots_x1000 ;
+    int32_t             course_degrees_x100 ;   // true
+    NmeaDate            date ;
+} NmeaRMC ;
+
+
+typedef struct
+{
+    NmeaTalker          talker ;
+    NmeaTime            time ;
+    bool                positionValid ;
+    LatitudeLongitude   position ;
+    uint8_t             fixQuality ;            // 0 = invalid, 1 = GPS, 2 = DGPS, ... see nmea0183.cpp
+    uint8_t             satellitesUsed ;
+    int32_t             hdop_x100 ;
+    bool                altitudeValid ;
+    int32_t             altitude_cm ;           // above mean sea level
+    int32_t             geoidSeparation_cm ;
+} NmeaGGA ;
+
+
+static const uint8_t NmeaGsaMaxSatellites = 12 ;
+
+typedef struct
+{
+    NmeaTalker          talker ;
+    char                selectionMode ;         // A (auto) or M (manual)
+    uint8_t             fixType ;               // 1 = no fix, 2 = 2D, 3 = 3D
+    uint8_t             satelliteCount ;
+    uint8_t             prn [NmeaGsaMaxSatellites] ;
+    int32_t             pdop_x100 ;
+    int32_t             hdop_x100 ;
+    int32_t             vdop_x100 ;
+    uint8_t             systemId ;              // NMEA 4.1, 0 if not sent
+} NmeaGSA ;
+
+
+static const uint8_t NmeaGsvMaxSatellites = 4 ;
+
+typedef struct
+{
+    uint8_t             prn ;
+    int8_t              elevation ;             // degrees
+    int16_t             azimuth ;               // degrees
+    int8_t              snr ;                   // dB, < 0 if not tracked
+} NmeaSatellite ;
+
+typedef struct
+{
+    NmeaTalker          talker ;
+    uint8_t             sentenceCount ;
+    uint8_t             sentenceNumber ;        // 1 .. sentenceCount
+    uint8_t             satellitesInView ;
+    uint8_t             satelliteCount ;        // in this sentence
+    NmeaSatellite       satellites [NmeaGsvMaxSatellites] ;
+} NmeaGSV ;
+
+
+typedef struct
+{
+    NmeaTalker          talker ;
+    int32_t             course_degrees_x100 ;   // true
+    int32_t             speed_knots_x1000 ;
+    int32_t             speed_kph_x1000 ;
+} NmeaVTG ;
+
+
+typedef struct
+{
+    NmeaTalker          talker ;
+    bool                positionValid ;
+    LatitudeLongitude   position ;
+    NmeaTime            time ;
+    bool                active ;
+} NmeaGLL ;
+
+
+// decode a sentence whose checksum has already been verified
+//      sentence points at the '$', end points at the '*' before the checksum
+//      returns false if the sentence is missing mandatory fields
+
+bool nmeaSentence_decodeRMC (const char * sentence, const char * end, NmeaRMC *) ;
+bool nmeaSentence_decodeGGA (const char * sentence, const char * end, NmeaGGA *) ;
+bool nmeaSentence_decodeGSA (const char * sentence, const char * end, NmeaGSA *) ;
+bool nmeaSentence_decodeGSV (const char * sentence, const char * end, NmeaGSV *) ;
+bool nmeaSentence_decodeVTG (const char * sentence, const char * end, NmeaVTG *) ;
+bool nmeaSentence_decodeGLL (const char * sentence, const char * end, NmeaGLL *) ;
+
+
+#endif
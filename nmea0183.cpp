@@ -1,23 +1,45 @@
 
 #include "nmea0183.hpp"
 
+#include "capture.hpp"
 #include "character.h"
+#include "event-log.hpp"
+#include "metrics.hpp"
+#include "nmea-parser.hpp"
 #include "monitor.h"
 #include "osal.h"
-#include "stopwatch.h"
+#include "serial-tx.hpp"
+#include "time-source.hpp"
+#include "ubx.hpp"
+#include "ubx-tx.hpp"
 
 #include <stdio.h>
 #include <string.h>
 
+#include <mutex>
 #include <time.h>
 
+// the latest RMC, written on the thread running nmea0183_run () and read by the acquisition
+static mutex    rmcLock ;
+
 static bool  latLongValid ;
 static bool dateTimeValid ;
 
 static LatLongString   latLongString ;
-static struct tm dateTime
+static struct tm dateTime ;
 
 static char nmeaMessage [96];       // tbd - use a local variable instead?
+static uint8_t messageLength ;      // 0 while waiting for the start character
+
+// the receiver sends each epoch as one burst, so the first byte after the line has been
+// idle for EpochGap_ns is the start of an epoch
+static const int64_t    EpochGap_ns = 50 * 1000000ll ;
+
+// the most handed to the port in one write, when a poll finds nothing to read
+static const uint16_t   TxBatchBytes = 1024 ;
+
+static struct timespec  lastArrival ;
+static struct timespec  epochArrival ;
 
 
 
@@ -31,12 +53,14 @@ void nmea0183_echoToMonitor (bool echoOrNot)
 
 bool nmea0183_isLatLongValid ()
 {
+    lock_guard <mutex> guard (rmcLock) ;
     return latLongValid ;
 }
 
 
 bool nmea0183_isDateTimeValid ()
 {
+    lock_guard <mutex> guard (rmcLock) ;
     return dateTimeValid ;
 }
 
@@ -44,6 +68,8 @@ bool nmea0183_isDateTimeValid ()
 
 void nmea0183_getDateAndTime (struct tm * dateTimePtr)
 {
+    lock_guard <mutex> guard (rmcLock) ;
+
     if (! dateTimeValid)
     {
         dateTime.tm_year =
@@ -60,301 +86,393 @@ void nmea0183_getDateAndTime (struct tm * dateTimePtr)
 
 
 
-char * nmea0183_getLatLongString (void)
+void nmea0183_getEpochArrival (struct timespec * arrival)
 {
-    if (! latLongValid)
-        strcpy (latLongString, "");
-
-    return latLongString ;
+    * arrival = epochArrival ;
 }
 
 
 
-static bool checksumIsOk (string message)
+static uint8_t receiveByte (SerialPort * serialStream)
 {
-    // *CS is checksum (8 bit exclusive OR of all data in the sentence, including ","
-    // delimiters, between but not including the '$' and '*' delimiters.
+    uint8_t in = serialPort_rxByte (serialStream) ;
 
-    char * start = message ;
+    metrics_count (Metric_BytesReceived) ;
+    capture_rxByte (in) ;
 
-    // the first character must be '$'
-    if (* start != '$')
-        return FALSE ;
+    struct timespec now ;
+    clock_gettime (CLOCK_REALTIME, & now) ;
 
-    // find the end of the message
-    char * end = start + 1 ;
-    while (1)
-    {
-        uint8_t endChar = * end ;
+    int64_t idle_ns = (int64_t) (now.tv_sec - lastArrival.tv_sec) * 1000000000 + (now.tv_nsec - lastArrival.tv_nsec) ;
+    if (idle_ns >= EpochGap_ns)
+        epochArrival = now ;
 
-        if ((endChar == CarriageReturn) ||
-            (endChar == Linefeed) ||
-            (endChar == 0))
-            break ;
+    lastArrival = now ;
 
-        ++ end ;
-    }
+    return in ;
+}
 
-    // check minimum length
-    uint8_t messageLength = end - start ;
-    if (messageLength < 4)
-        return FALSE ;
 
-    // read the checksum
-    end -= 2 ;
-    unsigned int checksum ;
-    uint8_t scanResult = sscanf (end, "%2x", & checksum);
-    if (scanResult != 1)
-        return FALSE ;
 
-    // verify '*' character
-    end -= 1 ;
-    if (* end != '*')
-        return FALSE ;
+void nmea0183_getLatLongString (LatLongString copy)
+{
+    lock_guard <mutex> guard (rmcLock) ;
+
+    if (! latLongValid)
+        strcpy (latLongString, "");
+
+    strcpy (copy, latLongString) ;
+}
 
-    // compute the checksum
-    end -= 1 ;
-    while (end != start)
-        checksum ^= * end -- ;
 
-    return (checksum == 0) ;
+static void invalidate (void)
+{
+    lock_guard <mutex> guard (rmcLock) ;
+
+     latLongValid =
+    dateTimeValid = FALSE ;
 }
 
 
 
-static char * strtok_save_ptr ;
 
-static string getNextField (void)
+
+
+// typed subscriptions ...
+
+static const uint8_t MaxSubscribers = 4 ;
+
+// the lists, held while their handlers run so none runs once it is unsubscribed
+static mutex    subscribersLock ;
+
+template <typename Sentence>
+struct Subscribers
 {
-    string tokenPtr = strtok_r (NULL, ",", & strtok_save_ptr);
-    return tokenPtr != 0 ? tokenPtr : "" ;
+    void (* handlers [MaxSubscribers]) (const Sentence *) ;
+    atomic <uint8_t> count ;            // also read without the lock, to skip decoding what nobody wants
+} ;
+
+static Subscribers <NmeaRMC> rmcSubscribers ;
+static Subscribers <NmeaGGA> ggaSubscribers ;
+static Subscribers <NmeaGSA> gsaSubscribers ;
+static Subscribers <NmeaGSV> gsvSubscribers ;
+static Subscribers <NmeaVTG> vtgSubscribers ;
+static Subscribers <NmeaGLL> gllSubscribers ;
+
+
+template <typename Sentence>
+static bool subscribe (Subscribers <Sentence> & subscribers, void (* handler) (const Sentence *))
+{
+    lock_guard <mutex> guard (subscribersLock) ;
+
+    if (subscribers.count >= MaxSubscribers)
+        return FALSE ;
+
+    subscribers.handlers [subscribers.count ++] = handler ;
+    return TRUE ;
 }
 
 
-void nmea0183_updateFromString (string message)
+template <typename Sentence>
+static void unsubscribe (Subscribers <Sentence> & subscribers, void (* handler) (const Sentence *))
 {
-    if (echo)
-    {
-      #if 0
-        serialPort_txString (monitorPort, message) ;
-        serialPort_txString (monitorPort, "\r\n") ;
-      #endif
-    }
+    lock_guard <mutex> guard (subscribersLock) ;
 
-    if (! checksumIsOk (message))
+    for (uint8_t i = 0 ; i < subscribers.count ; i ++)
     {
-        latLongValid = dateTimeValid = FALSE ;
-        return;
+        if (subscribers.handlers [i] == handler)
+        {
+            subscribers.handlers [i] = subscribers.handlers [-- subscribers.count] ;
+            return ;
+        }
     }
+}
 
-    // make a copy of the given string, but with a space after each comma (because
-    // strtok() considers consecutive delimiters to be a single delimiter)
-    char copy [90] ;
-    uint8_t length = 0 ;
-    while (length < ArrayLength (copy) - 2)
-    {
-        char aChar = * message ++ ;
-        if (aChar == 0)
-            break ;
-        copy [length ++] = aChar ;
-        if (aChar == ',')
-            copy [length ++] = ' ' ;
-    }
-    copy [length] = 0 ;
 
+template <typename Sentence>
+static void publish (Subscribers <Sentence> & subscribers, const Sentence * sentence)
+{
+    lock_guard <mutex> guard (subscribersLock) ;
 
-    char activeOrVoid ;
+    for (uint8_t i = 0 ; i < subscribers.count ; i ++)
+        subscribers.handlers [i] (sentence) ;
+}
 
-    unsigned int hours, minutes, seconds ;
-    unsigned int day, month, year ;
 
-    struct
-    {
-        char degrees [ 4] ;
-        char minutes [10] ;
-        char direction ;
-    } latitude, longitude ;
+bool nmea0183_subscribe (NmeaRmcHandler handler) { return subscribe (rmcSubscribers, handler) ; }
+bool nmea0183_subscribe (NmeaGgaHandler handler) { return subscribe (ggaSubscribers, handler) ; }
+bool nmea0183_subscribe (NmeaGsaHandler handler) { return subscribe (gsaSubscribers, handler) ; }
+bool nmea0183_subscribe (NmeaGsvHandler handler) { return subscribe (gsvSubscribers, handler) ; }
+bool nmea0183_subscribe (NmeaVtgHandler handler) { return subscribe (vtgSubscribers, handler) ; }
+bool nmea0183_subscribe (NmeaGllHandler handler) { return subscribe (gllSubscribers, handler) ; }
 
+void nmea0183_unsubscribe (NmeaRmcHandler handler) { unsubscribe (rmcSubscribers, handler) ; }
+void nmea0183_unsubscribe (NmeaGgaHandler handler) { unsubscribe (ggaSubscribers, handler) ; }
+void nmea0183_unsubscribe (NmeaGsaHandler handler) { unsubscribe (gsaSubscribers, handler) ; }
+void nmea0183_unsubscribe (NmeaGsvHandler handler) { unsubscribe (gsvSubscribers, handler) ; }
+void nmea0183_unsubscribe (NmeaVtgHandler handler) { unsubscribe (vtgSubscribers, handler) ; }
+void nmea0183_unsubscribe (NmeaGllHandler handler) { unsubscribe (gllSubscribers, handler) ; }
 
-    uint8_t scanResult ;
 
-    // the first field must be "$GxRMC"
-    string field = strtok_r (copy, ",", & strtok_save_ptr) ;
-    char aChar ;
-    scanResult = sscanf (field, "$G%*cRM%c", & aChar) ;
-    if ((scanResult != 1) || (aChar != 'C'))
-    {
-        latLongValid = dateTimeValid = FALSE ;
-        return;
-    }
 
+// sentence recognition ...
+
+// the address field after the '$', talker and sentence id ("GPRMC"), packed into an integer,
+// so each table entry is one compare
+static constexpr uint64_t sentenceKey (uint16_t talker, uint32_t id)
+{
+    return ((uint64_t) talker << 24) | id ;
+}
 
-    latLongValid = dateTimeValid = TRUE ;
 
+typedef struct
+{
+    uint64_t            key ;
+    NmeaSentenceType    type ;
+} SentenceType ;
+
+static const uint8_t SentenceTypes = ArrayLength (nmeaTalkers) * ArrayLength (nmeaSentenceIds) ;
 
-    // the next field contains hours, minutes, seconds and maybe hundredths of seconds
-    scanResult = sscanf (getNextField(), " %2d%2d%2d", & hours, & minutes, & seconds) ;
-    if (scanResult != 3)
-        dateTimeValid = FALSE ;
+// every talker with every sentence id (nmea-parser.hpp), built at compile time
+static constexpr struct SentenceTable
+{
+    SentenceType        entries [SentenceTypes] ;
 
-    // the next field is status A:active or V:void
-    scanResult = sscanf (getNextField(), " %c", & activeOrVoid) ;
-    if  (scanResult != 1)
+    constexpr SentenceTable () : entries ()
     {
-        latLongValid = dateTimeValid = FALSE ;
-        return ;
+        for (uint8_t t = 0 ; t < ArrayLength (nmeaTalkers) ; t ++)
+            for (uint8_t i = 0 ; i < ArrayLength (nmeaSentenceIds) ; i ++)
+                entries [t * ArrayLength (nmeaSentenceIds) + i] = { sentenceKey (nmeaTalkers [t], nmeaSentenceIds [i].key), nmeaSentenceIds [i].type } ;
     }
+} sentenceTypes ;
 
-    if (activeOrVoid != 'A')
-      #if 1
-        latLongValid =                 FALSE ;      // don't invalidate the date/time
-      #else
-        latLongValid = dateTimeValid = FALSE ;
-      #endif
 
+static NmeaSentenceType sentenceType (string_view sentence)
+{
+    // "$", the talker, the sentence id, then the first field separator
+    if ((sentence.size () < 7) || (sentence [0] != '$') || (sentence [6] != ','))
+        return NmeaSentence_Unknown ;
 
-    // the next field is latitude
-    scanResult = sscanf (getNextField(), " %2s%s", latitude.degrees, latitude.minutes) ;
-    if (scanResult != 2)
-        latLongValid = FALSE ;
+    uint64_t key = sentenceKey (nmeaTalkerKey (sentence [1], sentence [2]), nmeaSentenceKey (sentence [3], sentence [4], sentence [5])) ;
 
-    // the next field is latitude direction
-    scanResult = sscanf (getNextField(), " %c", & latitude.direction) ;
-    if ((scanResult != 1) || ((latitude.direction != 'N') && (latitude.direction != 'S')))
-        latLongValid = FALSE ;
+    for (uint8_t i = 0 ; i < SentenceTypes ; i ++)
+        if (sentenceTypes.entries [i].key == key)
+            return sentenceTypes.entries [i].type ;
 
+    return NmeaSentence_Unknown ;
+}
 
-    // the next field is longitude
-    scanResult = sscanf (getNextField(), " %3s%s", longitude.degrees, longitude.minutes) ;
-    if (scanResult != 2)
-        latLongValid = FALSE ;
 
-    // the next field is longitude direction
-    scanResult = sscanf (getNextField(), " %c", & longitude.direction) ;
-    if ((scanResult != 1) || ((longitude.direction != 'E') && (longitude.direction != 'W')))
-        latLongValid = FALSE ;
+static bool isWanted (NmeaSentenceType type)
+{
+    switch (type)
+    {
+        case NmeaSentence_RMC:   return TRUE ;       // always needed for the date/time and lat/long
+        case NmeaSentence_GGA:   return ggaSubscribers.count != 0 ;
+        case NmeaSentence_GSA:   return gsaSubscribers.count != 0 ;
+        case NmeaSentence_GSV:   return gsvSubscribers.count != 0 ;
+        case NmeaSentence_VTG:   return vtgSubscribers.count != 0 ;
+        case NmeaSentence_GLL:   return gllSubscribers.count != 0 ;
+        default:        return FALSE ;
+    }
+}
 
 
-    // skip ground speed
-    getNextField () ;
 
-    // skip track angle
-    getNextField () ;
+static void updateFromRMC (const NmeaRMC * rmc)
+{
+    lock_guard <mutex> guard (rmcLock) ;
 
-    // the next field contains day, month, year
-    scanResult = sscanf (getNextField(), " %2d%2d%2d", & day, & month, & year) ;
-    if (scanResult != 3)
-    {
-        dateTimeValid = FALSE ;
-        return ;
-    }
+    dateTimeValid = rmc->time.valid && rmc->date.valid ;
 
+    // a void fix doesn't invalidate the date/time
+    latLongValid = rmc->active && rmc->positionValid ;
 
     if (dateTimeValid)
     {
+        dateTime.tm_year = rmc->date.year; //+ 2000
+        dateTime.tm_mon = rmc->date.month;
+        dateTime.tm_mday = rmc->date.day;
 
-        dateTime.tm_year = year; //+ 2000
-        dateTime.tm_mon = month;
-        dateTime.tm_mday = day;
-
-        dateTime.tm_hour = hours;
-        dateTime.tm_min = minutes;
-        dateTime.tm_sec = seconds;
+        dateTime.tm_hour = rmc->time.hours;
+        dateTime.tm_min = rmc->time.minutes;
+        dateTime.tm_sec = rmc->time.seconds;
     }
 
-
     if (latLongValid)
     {
-        // save latitude/longitude in "48 02.391740 N, 123 03.672452 W" format
-        snprintf (latLongString, sizeof (latLongString), "%s %s %c, %s %s %c",
-                   latitude.degrees,  latitude.minutes,  latitude.direction,
-                  longitude.degrees, longitude.minutes, longitude.direction);
-    }
+        // save latitude/longitude in "48 02.39174 N, 123 03.67245 W" format
+        int lat = rmc->position. latitude_minutes_x1e5 ;
+        int lon = rmc->position.longitude_minutes_x1e5 ;
+
+        char northSouth = (lat < 0) ? 'S' : 'N' ;
+        char   eastWest = (lon < 0) ? 'W' : 'E' ;
+
+        unsigned int latMinutes_x1e5 = (lat < 0) ? -lat : lat ;
+        unsigned int lonMinutes_x1e5 = (lon < 0) ? -lon : lon ;
 
+        snprintf (latLongString, sizeof (latLongString), "%02u %02u.%05u %c, %03u %02u.%05u %c",
+                  latMinutes_x1e5 / 6000000, latMinutes_x1e5 % 6000000 / 100000, latMinutes_x1e5 % 100000, northSouth,
+                  lonMinutes_x1e5 / 6000000, lonMinutes_x1e5 % 6000000 / 100000, lonMinutes_x1e5 % 100000,   eastWest) ;
+    }
 }
 
 
+template <typename Sentence>
+static void decodeAndPublish (Subscribers <Sentence> & subscribers,
+                              bool (* decode) (const char *, const char *, Sentence *),
+                              const char * sentence, const char * end)
+{
+    Sentence decoded ;
+
+    if (decode (sentence, end, & decoded))
+        publish (subscribers, & decoded) ;
+    else
+        metrics_count (Metric_TruncatedSentences) ;
+}
+
 
-void nmea0183_updateFromStream (SerialPort * serialStream, uint16_t timeoutSeconds)
+void nmea0183_updateFromString (string_view message)
 {
-     latLongValid =
-    dateTimeValid = FALSE ;
+    // a copy into the event log, formatted by its drainer (see event-log.hpp)
+    if (echo)
+        eventLog (EventLog_NmeaSentence, message.data (), (int) message.size ()) ;
 
-    Stopwatch timer ;
-    stopwatch_initialize (& timer);
+    const char * sentence = message.data () ;
 
-    uint8_t length ;
-    char in ;
+    metrics_count (Metric_SentencesFramed) ;
 
-    while (1)
+    // recognize the sentence before doing any other work, so that sentence types
+    // nobody has subscribed to are skipped right after framing
+    NmeaSentenceType type = sentenceType (message) ;
+    if (type == NmeaSentence_Unknown)
+        metrics_count (Metric_UnknownSentences) ;
+
+    if (! isWanted (type))
+        return ;
+
+    const char * end ;
+    if (! nmeaFields::checksumIsOk (message, & end))
     {
+        metrics_count (Metric_ChecksumFailures) ;
 
-        // wait for the start character
-        while (1)
-        {
-            task_yield ();
+        if (type == NmeaSentence_RMC)
+            invalidate () ;
+        return;
+    }
 
-            if (stopwatch_elapsedSeconds (& timer) > timeoutSeconds)
+    switch (type)
+    {
+        case NmeaSentence_RMC:
+        {
+            NmeaRMC rmc ;
+            if (! nmeaSentence_decodeRMC (sentence, end, & rmc))
+            {
+                metrics_count (Metric_TruncatedSentences) ;
+                invalidate () ;
                 return ;
+            }
 
-            if (! serialPort_rxReady (serialStream))
-                continue ;
-
-            in = serialPort_rxByte (serialStream) ;
-            if (in != '$')
-                continue ;
+            updateFromRMC (& rmc) ;
+            metrics_fix (rmc.active && rmc.positionValid) ;     // one RMC per epoch
 
-            length = 0 ;
-            nmeaMessage [length ++] = in ;
+            publish (rmcSubscribers, & rmc) ;
             break ;
         }
 
-        // get the rest of the message
-        while (length < ArrayLength (nmeaMessage) - 1)
-        {
-            task_yield ();
+        case NmeaSentence_GGA:   decodeAndPublish (ggaSubscribers, nmeaSentence_decodeGGA, sentence, end) ;     break ;
+        case NmeaSentence_GSA:   decodeAndPublish (gsaSubscribers, nmeaSentence_decodeGSA, sentence, end) ;     break ;
+        case NmeaSentence_GSV:   decodeAndPublish (gsvSubscribers, nmeaSentence_decodeGSV, sentence, end) ;     break ;
+        case NmeaSentence_VTG:   decodeAndPublish (vtgSubscribers, nmeaSentence_decodeVTG, sentence, end) ;     break ;
+        case NmeaSentence_GLL:   decodeAndPublish (gllSubscribers, nmeaSentence_decodeGLL, sentence, end) ;     break ;
+        default:        break ;
+    }
+}
 
-            if (stopwatch_elapsedSeconds (& timer) > timeoutSeconds)
-                return ;
 
-            if (! serialPort_rxReady (serialStream))
-                continue ;
 
-            in = serialPort_rxByte (serialStream) ;
-          #if 0
-            serialPort_txByte (serialStream, in) ;
-          #endif
+static void frameByte (char in)
+{
+    if (messageLength == 0)
+    {
+        // wait for the start character
 
-            if ((in == CarriageReturn) || (in == Linefeed) || (in == 0))
-            {
-                nmeaMessage [length ++] = 0 ;       // make zero-terminated string
+        // UBX messages are interleaved with the NMEA sentences
+        if (ubx_rxByte (in))
+            return ;
 
-                nmea0183_updateFromString (nmeaMessage);
+        if (in == '$')
+            nmeaMessage [messageLength ++] = in ;
 
-                if (dateTimeValid)
-                    return;
+        return ;
+    }
 
-                // try the next line
-                break;
-            }
-            else
-            {
-                nmeaMessage [length ++] = in ;
-            }
+    if ((in == CarriageReturn) || (in == Linefeed) || (in == 0))
+    {
+        nmeaMessage [messageLength ++] = 0 ;    // make zero-terminated string
+
+        nmea0183_updateFromString (string_view (nmeaMessage, messageLength - 1));
+
+        messageLength = 0 ;
+        return ;
+    }
+
+    nmeaMessage [messageLength ++] = in ;
+
+    if (messageLength == ArrayLength (nmeaMessage) - 1)
+    {
+        // the buffer filled up before the end of the line
+        metrics_count (Metric_TruncatedSentences) ;
+        messageLength = 0 ;
+    }
+}
+
+
+void nmea0183_run (SerialPort * serialStream, const atomic <bool> * cancel)
+{
+    // what was known from an earlier run may be stale by now
+    invalidate () ;
+
+    messageLength = 0 ;
+
+    // checked between bytes, so a cancel takes effect within one poll of the port
+    while (! cancel->load (memory_order_acquire))
+    {
+        task_yield ();
+
+        if (! serialPort_rxReady (serialStream))
+        {
+            // nothing to read, a chance to send without holding up the reading
+            serialTx_service (serialStream, TxBatchBytes) ;
+            ubxTx_poll () ;
+            timeSource_waited () ;
+            capture_poll () ;
+            continue ;
         }
 
+        frameByte (receiveByte (serialStream)) ;
     }
 
+    // the port is about to close, or move to another device
+    capture_flush () ;
+}
+
+
+void nmea0183_updateFromBytes (const uint8_t * bytes, size_t length)
+{
+    while (length --)
+        frameByte (* bytes ++) ;
 }
 
 
 
 void nmea0183_initialize (void)
 {
-     latLongValid =
-    dateTimeValid = FALSE ;
+    invalidate () ;
 
     echo = FALSE ;
+
+    ubx_initialize () ;
 }
 
 
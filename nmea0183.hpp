@@ -2,20 +2,64 @@
 #define _NMEA_H_
 
 #include "lat-long.hpp"
+#include "nmea-sentence.hpp"
 #include "serial-port.h"
-#include <string>
+#include <atomic>
+#include <string_view>
 
+// the latest RMC, safe from any thread while nmea0183_run () is running on another
 void    nmea0183_getDateAndTime   (struct tm *);
-char *  nmea0183_getLatLongString (void);
+void    nmea0183_getLatLongString (LatLongString);     // a copy, "" when not valid
 
 bool nmea0183_isLatLongValid  (void);
 bool nmea0183_isDateTimeValid (void);
 
-void nmea0183_updateFromStream (SerialPort *, uint16_t timeoutSeconds);
-void nmea0183_updateFromString (string);
+// frames every byte from the receiver, NMEA and UBX, until * cancel is set, and sends what is
+// queued for the receiver (serial-tx.hpp, ubx-tx.hpp) whenever there is nothing to read
+//      meant to have a thread of its own for as long as the receiver is powered (see gps.cpp),
+//      so it returns within one poll of the port once * cancel is set
+//      the latest RMC is forgotten at the start of each run
+void nmea0183_run (SerialPort *, const atomic <bool> * cancel);
+void nmea0183_updateFromString (string_view);     // one sentence, the line end is optional
+void nmea0183_updateFromBytes  (const uint8_t *, size_t);    // raw receiver bytes, as from the stream
 
+// each sentence framed is recorded in the event log (event-log.hpp), cheap enough to leave on
 void nmea0183_echoToMonitor (bool echoOrNot) ;
 
+// local CLOCK_REALTIME when the first byte of the current epoch was read by nmea0183_run()
+//      the first byte after the line was idle, so it is the same for every sentence in the epoch
+void nmea0183_getEpochArrival (struct timespec *) ;
+
+
+// typed subscriptions, by sentence id from any of the receiver's talkers (GP, GL, GA, GB, GQ, GN, BD)
+//      sentences from other talkers are counted as unknown
+//      only sentence types with a subscriber are decoded, others are dropped right after framing
+//      handlers run on the thread calling nmea0183_run() / nmea0183_updateFromString()
+//      subscribing and unsubscribing are safe while the reader runs, but not from a handler;
+//      once unsubscribe returns the handler isn't running and won't be called again
+//      UBX messages are subscribed to by class, see ubx.hpp
+
+typedef void (* NmeaRmcHandler) (const NmeaRMC *) ;
+typedef void (* NmeaGgaHandler) (const NmeaGGA *) ;
+typedef void (* NmeaGsaHandler) (const NmeaGSA *) ;
+typedef void (* NmeaGsvHandler) (const NmeaGSV *) ;
+typedef void (* NmeaVtgHandler) (const NmeaVTG *) ;
+typedef void (* NmeaGllHandler) (const NmeaGLL *) ;
+
+bool nmea0183_subscribe (NmeaRmcHandler) ;
+bool nmea0183_subscribe (NmeaGgaHandler) ;
+bool nmea0183_subscribe (NmeaGsaHandler) ;
+bool nmea0183_subscribe (NmeaGsvHandler) ;
+bool nmea0183_subscribe (NmeaVtgHandler) ;
+bool nmea0183_subscribe (NmeaGllHandler) ;
+
+void nmea0183_unsubscribe (NmeaRmcHandler) ;
+void nmea0183_unsubscribe (NmeaGgaHandler) ;
+void nmea0183_unsubscribe (NmeaGsaHandler) ;
+void nmea0183_unsubscribe (NmeaGsvHandler) ;
+void nmea0183_unsubscribe (NmeaVtgHandler) ;
+void nmea0183_unsubscribe (NmeaGllHandler) ;
+
 void nmea0183_initialize (void);
 
 #endif
@@ -0,0 +1,139 @@
+#include "ntp-shm.hpp"
+
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+
+
+static const key_t   ShmKeyBase = 0x4E545030 ;     // "NTP0"
+static const uint8_t MaxUnits   = 4 ;
+
+
+// layout shared with ntpd (refclock_shm.c) and chrony (refclock_shm.c), don't change it
+typedef struct
+{
+    int             mode ;
+    volatile int    count ;
+    time_t          clockTimeStampSec ;
+    int             clockTimeStampUSec ;
+    time_t          receiveTimeStampSec ;
+    int             receiveTimeStampUSec ;
+    int             leap ;
+    int             precision ;
+    int             nsamples ;
+    volatile int    valid ;
+    unsigned        clockTimeStampNSec ;
+    unsigned        receiveTimeStampNSec ;
+    int             dummy [8] ;
+} ShmTime ;
+
+
+static ShmTime * segments [MaxUnits] ;
+
+
+
+static ShmTime * attach (uint8_t unit, bool create)
+{
+    int flags = create ? (IPC_CREAT | ((unit < 2) ? 0600 : 0666)) : 0 ;
+
+    int id = shmget (ShmKeyBase + unit, sizeof (ShmTime), flags) ;
+    if (id < 0)
+        return NULL ;
+
+    void * segment = shmat (id, NULL, 0) ;
+
+    return (segment == (void *) -1) ? NULL : (ShmTime *) segment ;
+}
+
+
+bool ntpShm_open (uint8_t unit)
+{
+    if (unit >= MaxUnits)
+        return false ;
+
+    if (segments [unit] == NULL)
+    {
+        segments [unit] = attach (unit, true) ;
+
+        if (segments [unit] != NULL)
+        {
+            memset ((void *) segments [unit], 0, sizeof (ShmTime)) ;
+            segments [unit]->mode     = 1 ;
+            segments [unit]->nsamples = 3 ;
+        }
+    }
+
+    return segments [unit] != NULL ;
+}
+
+
+void ntpShm_close (uint8_t unit)
+{
+    if ((unit < MaxUnits) && (segments [unit] != NULL))
+    {
+        shmdt ((void *) segments [unit]) ;
+        segments [unit] = NULL ;
+    }
+}
+
+
+void ntpShm_publish (uint8_t unit, const NtpShmSample * sample)
+{
+    if ((unit >= MaxUnits) || (segments [unit] == NULL))
+        return ;
+
+    ShmTime * shm = segments [unit] ;
+
+    shm->valid = 0 ;
+    shm->count = shm->count + 1 ;
+    __sync_synchronize () ;
+
+    shm->clockTimeStampSec    = sample->clock.tv_sec ;
+    shm->clockTimeStampUSec   = (int) (sample->clock.tv_nsec / 1000) ;
+    shm->clockTimeStampNSec   = (unsigned) sample->clock.tv_nsec ;
+    shm->receiveTimeStampSec  = sample->receive.tv_sec ;
+    shm->receiveTimeStampUSec = (int) (sample->receive.tv_nsec / 1000) ;
+    shm->receiveTimeStampNSec = (unsigned) sample->receive.tv_nsec ;
+    shm->leap                 = sample->leap ;
+    shm->precision            = sample->precision ;
+
+    __sync_synchronize () ;
+    shm->count = shm->count + 1 ;
+    shm->valid = 1 ;
+}
+
+
+bool ntpShm_read (uint8_t unit, NtpShmSample * sample)
+{
+    if (unit >= MaxUnits)
+        return false ;
+
+    ShmTime * shm = attach (unit, false) ;
+    if (shm == NULL)
+        return false ;
+
+    bool ok = shm->valid ;
+
+    if (ok)
+    {
+        int count = shm->count ;
+        __sync_synchronize () ;
+
+        sample->clock.  tv_sec  = shm->clockTimeStampSec ;
+        sample->clock.  tv_nsec = shm->clockTimeStampNSec ;
+        sample->receive.tv_sec  = shm->receiveTimeStampSec ;
+        sample->receive.tv_nsec = shm->receiveTimeStampNSec ;
+        sample->leap            = shm->leap ;
+        sample->precision       = shm->precision ;
+
+        __sync_synchronize () ;
+        ok = (count == shm->count) && ((count & 1) == 0) ;
+
+        shm->valid = 0 ;
+    }
+
+    shmdt ((void *) shm) ;
+
+    return ok ;
+}
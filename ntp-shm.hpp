@@ -0,0 +1,36 @@
+#ifndef _NTP_SHM_H_
+#define _NTP_SHM_H_
+
+#include <stdint.h>
+#include <time.h>
+
+
+// the ntpd/chrony shared memory reference clock (driver 28, "refclock SHM <unit>" in chrony)
+//
+//      segment key is 0x4E545030 + unit ("NTP0"), units 0 and 1 are root only, 2 and up are
+//      world writable, as ntpd and chrony expect
+//      samples are written with the mode 1 protocol, count is bumped before and after the
+//      write so a reader can tell if it raced the writer
+
+
+typedef struct
+{
+    struct timespec     clock ;         // the reference (gps) time
+    struct timespec     receive ;       // the local time it was received
+    int                 leap ;          // 0 = no warning, 1 = insert, 2 = delete, 3 = not in sync
+    int                 precision ;     // log2 seconds
+} NtpShmSample ;
+
+
+// false if the segment can't be created or attached
+bool ntpShm_open  (uint8_t unit) ;
+void ntpShm_close (uint8_t unit) ;
+
+void ntpShm_publish (uint8_t unit, const NtpShmSample *) ;
+
+// read and consume a sample the way ntpd does, to check the export without a time server
+//      false if there is no new sample, or the writer was busy with it
+bool ntpShm_read (uint8_t unit, NtpShmSample *) ;
+
+
+#endif
@@ -0,0 +1,178 @@
+#include "position-filter.hpp"
+
+
+
+static const uint32_t MillisecondsPerDay = 24ul * 60 * 60 * 1000 ;
+static const int32_t  MaxGap_ms          = 10 * 1000 ;     // longer gaps restart the filter
+
+
+// sin (0 .. 90 degrees) in 1 degree steps, x32767
+static const int16_t sineTable [91] =
+{
+        0,   572,  1144,  1715,  2286,  2856,  3425,  3993,  4560,  5126,
+     5690,  6252,  6813,  7371,  7927,  8481,  9032,  9580, 10126, 10668,
+    11207, 11743, 12275, 12803, 13328, 13848, 14364, 14876, 15383, 15886,
+    16383, 16876, 17364, 17846, 18323, 18794, 19260, 19720, 20173, 20621,
+    21062, 21497, 21925, 22347, 22762, 23170, 23571, 23964, 24351, 24730,
+    25101, 25465, 25821, 26169, 26509, 26841, 27165, 27481, 27788, 28087,
+    28377, 28659, 28932, 29196, 29451, 29697, 29934, 30162, 30381, 30591,
+    30791, 30982, 31163, 31335, 31498, 31650, 31794, 31927, 32051, 32165,
+    32269, 32364, 32448, 32523, 32587, 32642, 32687, 32722, 32747, 32762,
+    32767,
+} ;
+
+
+static int32_t sine_q15 (int32_t degrees_x100)
+{
+    // linear interpolation between the 1 degree table entries
+
+    degrees_x100 %= 36000 ;
+    if (degrees_x100 < 0)
+        degrees_x100 += 36000 ;
+
+    bool negative = degrees_x100 >= 18000 ;
+    if (negative)
+        degrees_x100 -= 18000 ;
+
+    if (degrees_x100 > 9000)
+        degrees_x100 = 18000 - degrees_x100 ;
+
+    int32_t index    = degrees_x100 / 100 ;
+    int32_t fraction = degrees_x100 % 100 ;
+
+    int32_t sine = sineTable [index] ;
+    if (index < 90)
+        sine += (sineTable [index + 1] - sine) * fraction / 100 ;
+
+    return negative ? -sine : sine ;
+}
+
+
+static int32_t cosine_q15 (int32_t degrees_x100)
+{
+    return sine_q15 (9000 - degrees_x100) ;
+}
+
+
+static uint32_t timeOfDay_ms (const NmeaTime * time)
+{
+    return ((time->hours * 60ul + time->minutes) * 60 + time->seconds) * 1000 + time->hundredths * 10 ;
+}
+
+
+static bool measuredVelocity (const GpsFix * fix, int32_t * north_x16, int32_t * east_x16)
+{
+    // 1 knot is 1 minute of latitude per hour, so knots_x1000 * 16 / 36 is minutes_x1e5 per second x16
+
+    if (fix->speed_knots_x1000 < 0)
+        return false ;
+
+    int64_t speed_x16 = (int64_t) fix->speed_knots_x1000 * 4 / 9 ;
+
+    if (fix->course_degrees_x100 < 0)
+    {
+        // receivers leave the course empty when not moving
+        if (fix->speed_knots_x1000 > 500)
+            return false ;
+
+        * north_x16 = * east_x16 = 0 ;
+        return true ;
+    }
+
+    // a minute of longitude shrinks with the cosine of the latitude (limited near the poles)
+    int32_t latitude_degrees_x100 = fix->position.latitude_minutes_x1e5 / 60000 ;
+
+    int32_t cosLatitude = cosine_q15 (latitude_degrees_x100) ;
+    if (cosLatitude < 512)
+        cosLatitude = 512 ;
+
+    * north_x16 = speed_x16 * cosine_q15 (fix->course_degrees_x100) >> 15 ;
+    * east_x16  = speed_x16 *   sine_q15 (fix->course_degrees_x100) / cosLatitude ;
+
+    return true ;
+}
+
+
+static int32_t scale_x256 (int64_t value, uint16_t factor_x256)
+{
+    // rounded to nearest
+    int64_t product = value * factor_x256 ;
+    return (product >= 0) ? (product + 128) >> 8 : -((-product + 128) >> 8) ;
+}
+
+
+
+void positionFilter_initialize (PositionFilter * filter, uint16_t alpha_x256, uint16_t beta_x256)
+{
+    filter->alpha_x256 = alpha_x256 ;
+    filter->beta_x256  = beta_x256 ;
+
+    positionFilter_reset (filter) ;
+}
+
+
+void positionFilter_reset (PositionFilter * filter)
+{
+    filter->initialized       = false ;
+    filter->velocityNorth_x16 = 0 ;
+    filter->velocityEast_x16  = 0 ;
+}
+
+
+bool positionFilter_update (PositionFilter * filter, const GpsFix * fix, LatitudeLongitude * smoothed)
+{
+    if (! fix->positionValid || ! fix->time.valid)
+        return false ;
+
+    uint32_t time_ms = timeOfDay_ms (& fix->time) ;
+
+    int32_t dt_ms = time_ms - filter->lastTime_ms ;
+    if (dt_ms < 0)
+        dt_ms += MillisecondsPerDay ;      // midnight
+
+    filter->lastTime_ms = time_ms ;
+
+    int32_t north_x16, east_x16 ;
+    bool haveVelocity = measuredVelocity (fix, & north_x16, & east_x16) ;
+
+    if (! filter->initialized || (dt_ms == 0) || (dt_ms > MaxGap_ms))
+    {
+        filter->initialized       = true ;
+        filter->position          = fix->position ;
+        filter->velocityNorth_x16 = haveVelocity ? north_x16 : 0 ;
+        filter->velocityEast_x16  = haveVelocity ?  east_x16 : 0 ;
+
+        * smoothed = filter->position ;
+        return true ;
+    }
+
+    // predict ...
+
+    int32_t latitude  = filter->position.latitude_minutes_x1e5 + (int64_t) filter->velocityNorth_x16 * dt_ms / 16000 ;
+    int32_t longitude = latitudeLongitude_wrapLongitude (filter->position.longitude_minutes_x1e5 +
+                                                         (int64_t) filter->velocityEast_x16 * dt_ms / 16000) ;
+
+    // ... and correct, across the antimeridian the longitudes differ by nearly a circle, beyond int32_t
+
+    int32_t latitudeResidual  = fix->position.latitude_minutes_x1e5 - latitude ;
+    int32_t longitudeResidual = latitudeLongitude_wrapLongitude ((int64_t) fix->position.longitude_minutes_x1e5 - longitude) ;
+
+    filter->position. latitude_minutes_x1e5 = latitude + scale_x256 (latitudeResidual, filter->alpha_x256) ;
+    filter->position.longitude_minutes_x1e5 = latitudeLongitude_wrapLongitude ((int64_t) longitude +
+                                                                               scale_x256 (longitudeResidual, filter->alpha_x256)) ;
+
+    if (haveVelocity)
+    {
+        // the receiver's doppler velocity beats anything derived from the positions
+        filter->velocityNorth_x16 = north_x16 ;
+        filter->velocityEast_x16  =  east_x16 ;
+    }
+    else
+    {
+        filter->velocityNorth_x16 += scale_x256 ((int64_t) latitudeResidual  * 16000 / dt_ms, filter->beta_x256) ;
+        filter->velocityEast_x16  += scale_x256 ((int64_t) longitudeResidual * 16000 / dt_ms, filter->beta_x256) ;
+    }
+
+    * smoothed = filter->position ;
+    return true ;
+}
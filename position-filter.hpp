@@ -0,0 +1,40 @@
+#ifndef _POSITION_FILTER_H_
+#define _POSITION_FILTER_H_
+
+#include "gps-fix.hpp"
+#include "lat-long.hpp"
+
+#include <stdint.h>
+
+
+// alpha-beta smoothing of the fix position, in fixed point
+//
+//      the prediction uses the receiver's own speed/course (RMC) when it reports them,
+//      otherwise the velocity is estimated by the filter from the position residuals
+//      each update is a constant amount of integer arithmetic, no heap, no floating point
+//
+//      alpha and beta are x256, e.g. alpha 64 and beta 8 are 0.25 and 0.03
+
+
+typedef struct
+{
+    bool                initialized ;
+    LatitudeLongitude   position ;              // smoothed
+    int32_t             velocityNorth_x16 ;     // minutes_x1e5 per second
+    int32_t             velocityEast_x16 ;      // minutes_x1e5 of longitude per second
+    uint32_t            lastTime_ms ;           // utc time of day
+    uint16_t            alpha_x256 ;
+    uint16_t            beta_x256 ;
+} PositionFilter ;
+
+
+void positionFilter_initialize (PositionFilter *, uint16_t alpha_x256, uint16_t beta_x256) ;
+
+// restart from the next fix, e.g. after a gap in the fixes
+void positionFilter_reset (PositionFilter *) ;
+
+// returns false (and leaves smoothed alone) if the fix has no position
+bool positionFilter_update (PositionFilter *, const GpsFix *, LatitudeLongitude * smoothed) ;
+
+
+#endif
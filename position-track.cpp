@@ -0,0 +1,323 @@
+#include "position-track.hpp"
+
+#include "gps.hpp"
+#include "time-source.hpp"
+
+#include <math.h>
+#include <mutex>
+#include <string.h>
+#include <time.h>
+using namespace std;
+
+
+
+static const float    MetresPerMinute_x1e5  = 1852.0f / 100000 ;
+static const float    MetresPerSecondPerKnot = 1852.0f / 3600 ;
+
+static const int64_t  MaxVelocityGap_ms     = 10 * 1000 ;    // fixes further apart don't give a velocity
+static const int64_t  MillisecondsPerDay    = 24ll * 60 * 60 * 1000 ;
+
+static const uint8_t  Mask = PositionTrack_Fixes - 1 ;
+
+static_assert ((PositionTrack_Fixes & Mask) == 0, "the fixes are a ring indexed by a mask") ;
+
+
+typedef struct
+{
+    int64_t             time_ms ;
+    LatitudeLongitude   position ;
+    bool                velocityKnown ;
+    float               velocityNorth_m_s ;
+    float               velocityEast_m_s ;
+    float               hdop ;
+} Fix ;
+
+
+struct PositionTrack
+{
+    mutex               lock ;
+    Fix                 fixes [PositionTrack_Fixes] ;
+    uint32_t            count ;         // fixes ever added
+    float               maxAcceleration_m_s2 ;
+} ;
+
+
+static PositionTrack * recording ;
+
+
+
+static float metresPerEast (const LatitudeLongitude * at)
+{
+    // per minute_x1e5 of longitude
+    float latitude = at->latitude_minutes_x1e5 / (60.0f * 100000) ;
+    return MetresPerMinute_x1e5 * cosf (latitude * (float) M_PI / 180) ;
+}
+
+
+static void offset (const LatitudeLongitude * from, const LatitudeLongitude * to, float * north_m, float * east_m)
+{
+    // metres from one position to the other, flat earth, which is plenty over a few seconds of travel
+    * north_m = ((int64_t) to->latitude_minutes_x1e5 - from->latitude_minutes_x1e5) * MetresPerMinute_x1e5 ;
+    * east_m  = latitudeLongitude_wrapLongitude ((int64_t) to->longitude_minutes_x1e5 - from->longitude_minutes_x1e5) * metresPerEast (from) ;
+}
+
+
+static void move (const LatitudeLongitude * from, float north_m, float east_m, LatitudeLongitude * to)
+{
+    to->latitude_minutes_x1e5  = from->latitude_minutes_x1e5 + lroundf (north_m / MetresPerMinute_x1e5) ;
+    to->longitude_minutes_x1e5 = latitudeLongitude_wrapLongitude (from->longitude_minutes_x1e5 + lroundf (east_m / metresPerEast (from))) ;
+}
+
+
+static float positionError (const Fix * fix)
+{
+    // an HDOP of 1 when the receiver doesn't report it
+    return PositionTrack_Uere_m * ((fix->hdop > 0) ? fix->hdop : 1) ;
+}
+
+
+
+PositionTrack * positionTrack_create (float maxAcceleration_m_s2)
+{
+    PositionTrack * track = new PositionTrack () ;
+
+    track->maxAcceleration_m_s2 = maxAcceleration_m_s2 ;
+
+    return track ;
+}
+
+
+void positionTrack_destroy (PositionTrack * track)
+{
+    if (recording == track)
+        positionTrack_stopRecording () ;
+
+    delete track ;
+}
+
+
+void positionTrack_add (PositionTrack * track, const GpsFix * gpsFix, int64_t time_ms)
+{
+    if (! gpsFix->positionValid)
+        return ;
+
+    lock_guard <mutex> guard (track->lock) ;
+
+    const Fix * previous = (track->count != 0) ? & track->fixes [(track->count - 1) & Mask] : NULL ;
+
+    if ((previous != NULL) && (time_ms <= previous->time_ms))
+        return ;
+
+    Fix fix ;
+    memset (& fix, 0, sizeof (fix)) ;
+
+    fix.time_ms  = time_ms ;
+    fix.position = gpsFix->position ;
+    fix.hdop     = (gpsFix->hdop_x100 >= 0) ? gpsFix->hdop_x100 / 100.0f : 0 ;
+
+    if ((gpsFix->speed_knots_x1000 >= 0) && (gpsFix->course_degrees_x100 >= 0))
+    {
+        float speed  = gpsFix->speed_knots_x1000 / 1000.0f * MetresPerSecondPerKnot ;
+        float course = gpsFix->course_degrees_x100 / 100.0f * (float) M_PI / 180 ;
+
+        fix.velocityKnown     = true ;
+        fix.velocityNorth_m_s = speed * cosf (course) ;
+        fix.velocityEast_m_s  = speed * sinf (course) ;
+    }
+    else if ((previous != NULL) && (time_ms - previous->time_ms <= MaxVelocityGap_ms))
+    {
+        // the average since the previous fix stands in for the velocity now
+        float north_m, east_m ;
+        offset (& previous->position, & fix.position, & north_m, & east_m) ;
+
+        float seconds = (time_ms - previous->time_ms) / 1000.0f ;
+
+        fix.velocityKnown     = true ;
+        fix.velocityNorth_m_s = north_m / seconds ;
+        fix.velocityEast_m_s  = east_m  / seconds ;
+    }
+
+    track->fixes [track->count & Mask] = fix ;
+    ++ track->count ;
+}
+
+
+
+static int64_t fixTime_ms (const GpsFix * fix)
+{
+    // UTC ms since the Unix epoch, -1 without a time tag
+    if (! fix->time.valid)
+        return -1 ;
+
+    int64_t timeOfDay_ms = ((fix->time.hours * 60ll + fix->time.minutes) * 60 + fix->time.seconds) * 1000 +
+                           fix->time.hundredths * 10 ;
+
+    if (fix->date.valid)
+    {
+        struct tm utc ;
+        memset (& utc, 0, sizeof (utc)) ;
+
+        utc.tm_year = fix->date.year + ((fix->date.year < 80) ? 100 : 0) ;     // 2 digit year, 1980 .. 2079
+        utc.tm_mon  = fix->date.month - 1 ;
+        utc.tm_mday = fix->date.day ;
+
+        return timegm (& utc) * 1000ll + timeOfDay_ms ;
+    }
+
+    // today, or yesterday for a fix from just before midnight
+    int64_t now_ms = timeSource_time () * 1000ll ;
+    int64_t time_ms = now_ms - now_ms % MillisecondsPerDay + timeOfDay_ms ;
+
+    if (time_ms > now_ms + MillisecondsPerDay / 2)
+        time_ms -= MillisecondsPerDay ;
+
+    return time_ms ;
+}
+
+
+static void recordFix (const GpsFix * fix)
+{
+    int64_t time_ms = fixTime_ms (fix) ;
+
+    if (time_ms >= 0)
+        positionTrack_add (recording, fix, time_ms) ;
+}
+
+
+bool positionTrack_recordFixes (PositionTrack * track)
+{
+    if (recording != NULL)
+        return recording == track ;
+
+    if (! gpsFix_subscribe (recordFix))
+        return false ;
+
+    // every fix, not only those of an acquisition
+    gps_startStreaming () ;
+
+    recording = track ;
+    return true ;
+}
+
+
+void positionTrack_stopRecording (void)
+{
+    if (recording == NULL)
+        return ;
+
+    gps_stopStreaming () ;
+    gpsFix_unsubscribe (recordFix) ;
+
+    recording = NULL ;
+}
+
+
+
+static bool extrapolate (const PositionTrack * track, const Fix * newest, int64_t time_ms, PositionEstimate * estimate)
+{
+    int64_t age_ms = time_ms - newest->time_ms ;
+
+    // with no velocity, where it went is anyone's guess
+    if ((age_ms > PositionTrack_MaxExtrapolation_ms) || ((age_ms != 0) && ! newest->velocityKnown))
+        return false ;
+
+    float t = age_ms / 1000.0f ;
+
+    move (& newest->position, newest->velocityNorth_m_s * t, newest->velocityEast_m_s * t, & estimate->position) ;
+
+    estimate->error_m           = positionError (newest) + PositionTrack_VelocityError_m_s * t +
+                                  track->maxAcceleration_m_s2 * t * t / 2 ;
+    estimate->velocityNorth_m_s = newest->velocityNorth_m_s ;
+    estimate->velocityEast_m_s  = newest->velocityEast_m_s ;
+    estimate->method            = PositionTrack_Extrapolated ;
+    estimate->age_ms            = age_ms ;
+
+    return true ;
+}
+
+
+static void interpolate (const PositionTrack * track, const Fix * a, const Fix * b, int64_t time_ms, PositionEstimate * estimate)
+{
+    float span   = (b->time_ms - a->time_ms) / 1000.0f ;
+    float s      = (time_ms - a->time_ms) / 1000.0f / span ;     // 0 at a, 1 at b
+
+    float north_m, east_m ;
+    offset (& a->position, & b->position, & north_m, & east_m) ;
+
+    float maxError = (positionError (a) > positionError (b)) ? positionError (a) : positionError (b) ;
+
+    if (a->velocityKnown && b->velocityKnown)
+    {
+        // cubic Hermite from a (at the origin) to b: position h01 d, plus the velocities h10 v0 and h11 v1
+        // with acceleration within a, the path is at most a span^2 / 16 off it, and a velocity
+        // error moves it by at most 4/27 span of the error from each end
+        float s2  = s * s ;
+        float s3  = s2 * s ;
+        float h10 = s3 - 2 * s2 + s ;
+        float h01 = -2 * s3 + 3 * s2 ;
+        float h11 = s3 - s2 ;
+
+        // the derivatives, for the velocity along the curve
+        float d10 = 3 * s2 - 4 * s + 1 ;
+        float d01 = -6 * s2 + 6 * s ;
+        float d11 = 3 * s2 - 2 * s ;
+
+        move (& a->position,
+              h10 * span * a->velocityNorth_m_s + h01 * north_m + h11 * span * b->velocityNorth_m_s,
+              h10 * span * a->velocityEast_m_s  + h01 * east_m  + h11 * span * b->velocityEast_m_s,
+              & estimate->position) ;
+
+        estimate->velocityNorth_m_s = d10 * a->velocityNorth_m_s + d01 * north_m / span + d11 * b->velocityNorth_m_s ;
+        estimate->velocityEast_m_s  = d10 * a->velocityEast_m_s  + d01 * east_m  / span + d11 * b->velocityEast_m_s ;
+
+        estimate->error_m = maxError + 2 * (4.0f / 27) * span * PositionTrack_VelocityError_m_s +
+                            track->maxAcceleration_m_s2 * span * span / 16 ;
+    }
+    else
+    {
+        // straight, at most a span^2 / 8 off the path with acceleration within a
+        move (& a->position, s * north_m, s * east_m, & estimate->position) ;
+
+        estimate->velocityNorth_m_s = north_m / span ;
+        estimate->velocityEast_m_s  = east_m  / span ;
+
+        estimate->error_m = maxError + track->maxAcceleration_m_s2 * span * span / 8 ;
+    }
+
+    int64_t fromA = time_ms - a->time_ms ;
+    int64_t toB   = b->time_ms - time_ms ;
+
+    estimate->method = PositionTrack_Interpolated ;
+    estimate->age_ms = (fromA < toB) ? fromA : toB ;
+}
+
+
+bool positionTrack_at (PositionTrack * track, int64_t time_ms, PositionEstimate * estimate)
+{
+    lock_guard <mutex> guard (track->lock) ;
+
+    if (track->count == 0)
+        return false ;
+
+    uint32_t    newest = track->count - 1 ;
+    const Fix * latest = & track->fixes [newest & Mask] ;
+
+    if (time_ms >= latest->time_ms)
+        return extrapolate (track, latest, time_ms, estimate) ;
+
+    // the fix at or before the time, at most Fixes back
+    uint32_t kept = (track->count < PositionTrack_Fixes) ? track->count : PositionTrack_Fixes ;
+
+    for (uint32_t back = 1 ; back < kept ; back ++)
+    {
+        const Fix * a = & track->fixes [(newest - back) & Mask] ;
+
+        if (a->time_ms <= time_ms)
+        {
+            interpolate (track, a, & track->fixes [(newest - back + 1) & Mask], time_ms, estimate) ;
+            return true ;
+        }
+    }
+
+    return false ;
+}
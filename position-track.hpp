@@ -0,0 +1,72 @@
+#ifndef _POSITION_TRACK_H_
+#define _POSITION_TRACK_H_
+
+#include "gps-fix.hpp"
+#include "lat-long.hpp"
+
+#include <stdint.h>
+
+
+// position at any time, between and after the receiver's epochs, with a bound on its error
+//
+//      the last few fixes with a position are kept with their UTC time and velocity (RMC speed
+//      and course, or else the difference of successive positions)
+//
+//      between two fixes the path is a cubic Hermite curve through both positions with both
+//      velocities, exact for constant acceleration; without velocities, a straight line
+//      after the newest fix it is dead reckoned along the newest velocity, up to MaxExtrapolation_ms
+//
+//      the error bound is the position error (Uere_m per unit of HDOP) plus what the motion model
+//      can get wrong: a velocity error of VelocityError_m_s, and any acceleration up to the
+//      track's maximum, half a t squared after the newest fix
+//
+//      each query looks at no more than Fixes fixes, under a lock held only for that, so it can
+//      be asked far more often than the receiver's rate from any thread
+
+
+static const uint8_t  PositionTrack_Fixes              = 8 ;
+static const uint32_t PositionTrack_MaxExtrapolation_ms = 10 * 1000 ;
+
+static const float    PositionTrack_Uere_m             = 2.5f ;    // per unit of HDOP
+static const float    PositionTrack_VelocityError_m_s  = 0.1f ;
+
+
+typedef struct PositionTrack PositionTrack ;
+
+
+typedef enum
+{
+    PositionTrack_Interpolated,
+    PositionTrack_Extrapolated,
+} PositionTrackMethod ;
+
+
+typedef struct
+{
+    LatitudeLongitude   position ;
+    float               error_m ;               // bound on the horizontal error
+    float               velocityNorth_m_s ;
+    float               velocityEast_m_s ;
+    PositionTrackMethod method ;
+    int64_t             age_ms ;                // from the nearest fix
+} PositionEstimate ;
+
+
+// maxAcceleration is what the platform can do, e.g. 0.1 for a fixed site, 3 for a car
+PositionTrack * positionTrack_create  (float maxAcceleration_m_s2) ;
+void            positionTrack_destroy (PositionTrack *) ;
+
+// time_ms is UTC, ms since the Unix epoch, increasing; fixes without a position are ignored
+void positionTrack_add (PositionTrack *, const GpsFix *, int64_t time_ms) ;
+
+// add every fix assembled by gps-fix, to one track, at the fix's own UTC time, with the receiver
+// streaming until stopped
+//      (the date from RMC, or from timeSource_time () when RMC isn't sent)
+bool positionTrack_recordFixes   (PositionTrack *) ;
+void positionTrack_stopRecording (void) ;
+
+// false if time_ms is before the oldest fix kept or too long after the newest
+bool positionTrack_at (PositionTrack *, int64_t time_ms, PositionEstimate *) ;
+
+
+#endif
@@ -0,0 +1,327 @@
+#include "raw-capture.hpp"
+
+#include "gps.hpp"
+#include "metrics.hpp"
+#include "ubx.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const uint8_t  RXM_SFRBX = 0x13 ;
+static const uint8_t  RXM_RAWX  = 0x15 ;
+static const uint8_t  CFG_MSG   = 0x01 ;
+
+static const size_t   Alignment = 4096 ;       // O_DIRECT needs block aligned buffers, offsets and lengths
+static const size_t   MaxBuffers = RawCapture_MaxBufferedBytes / RawCapture_BufferBytes ;
+
+
+typedef struct
+{
+    uint8_t *   data ;
+    size_t      length ;
+} Buffer ;
+
+
+static struct {
+    bool                running ;
+    int                 fd = -1 ;
+    bool                direct ;
+    thread              writer ;
+
+    // the receiving thread fills current, the writer empties full
+    //      messages run on from one buffer to the next, so every buffer but the last is written whole
+    mutex               lock ;
+    condition_variable  wake ;
+    Buffer *            current ;
+    deque <Buffer *>    full ;
+    vector <Buffer *>   free ;
+    bool                stopping ;
+
+    RawCaptureStats     stats ;
+} capture ;
+
+
+
+static bool allocateBuffers (void)
+{
+    // all of them up front, and touched, so the receiving thread never waits on the allocator
+    // or on a page fault
+    capture.free.reserve (MaxBuffers) ;
+
+    while (capture.free.size () < MaxBuffers)
+    {
+        Buffer * buffer = new Buffer () ;
+        buffer->data   = (uint8_t *) aligned_alloc (Alignment, RawCapture_BufferBytes) ;
+        buffer->length = 0 ;
+
+        if (buffer->data == NULL)
+        {
+            delete buffer ;
+            return false ;
+        }
+
+        memset (buffer->data, 0, RawCapture_BufferBytes) ;
+        capture.free.push_back (buffer) ;
+    }
+
+    return true ;
+}
+
+
+static void freeBuffers (void)
+{
+    for (Buffer * buffer : capture.free)
+    {
+        free (buffer->data) ;
+        delete buffer ;
+    }
+
+    capture.free.clear () ;
+}
+
+
+static Buffer * takeBuffer (void)
+{
+    // with the lock held, NULL when the writer has all of them
+    if (capture.free.empty ())
+        return NULL ;
+
+    Buffer * buffer = capture.free.back () ;
+    capture.free.pop_back () ;
+    return buffer ;
+}
+
+
+static void queueFull (Buffer * buffer)
+{
+    // with the lock held
+    capture.full.push_back (buffer) ;
+
+    if (capture.full.size () > capture.stats.maxBuffersQueued)
+        capture.stats.maxBuffersQueued = capture.full.size () ;
+
+    capture.wake.notify_one () ;
+}
+
+
+static void onRxm (uint8_t messageClass, uint8_t messageId, const uint8_t * payload, uint16_t length)
+{
+    if ((messageId != RXM_RAWX) && (messageId != RXM_SFRBX))
+        return ;
+
+    // framed again as received, the ubx framer has checked it
+    static uint8_t framed [UINT16_MAX + UbxOverhead] ;
+    size_t size = ubx_frame (framed, messageClass, messageId, payload, length) ;
+
+    lock_guard <mutex> guard (capture.lock) ;
+
+    if (! capture.running)
+        return ;
+
+    size_t   room = (capture.current != NULL) ? RawCapture_BufferBytes - capture.current->length : 0 ;
+    Buffer * next = NULL ;
+
+    // all or nothing, so a dropped message doesn't leave half a message in the file
+    if (room < size)
+    {
+        next = takeBuffer () ;
+
+        if (next == NULL)
+        {
+            ++ capture.stats.dropped ;
+            metrics_count (Metric_RawMessagesDropped) ;
+            return ;
+        }
+    }
+
+    size_t first = (room < size) ? room : size ;
+
+    if (first != 0)
+    {
+        memcpy (capture.current->data + capture.current->length, framed, first) ;
+        capture.current->length += first ;
+    }
+
+    if (next != NULL)
+    {
+        if (capture.current != NULL)
+            queueFull (capture.current) ;
+
+        capture.current = next ;
+
+        memcpy (capture.current->data, framed + first, size - first) ;
+        capture.current->length = size - first ;
+    }
+
+    ++ capture.stats.messages ;
+    capture.stats.bytes += size ;
+}
+
+
+
+static bool writeAll (const uint8_t * data, size_t length)
+{
+    while (length != 0)
+    {
+        ssize_t written = write (capture.fd, data, length) ;
+        if (written <= 0)
+            return false ;
+
+        data   += written ;
+        length -= written ;
+    }
+
+    return true ;
+}
+
+
+static void writeBuffers (void)
+{
+    unique_lock <mutex> guard (capture.lock) ;
+
+    while (1)
+    {
+        capture.wake.wait (guard, [] { return ! capture.full.empty () || capture.stopping ; }) ;
+
+        if (capture.full.empty ())
+            return ;
+
+        Buffer * buffer = capture.full.front () ;
+        capture.full.pop_front () ;
+
+        bool last = capture.stopping && capture.full.empty () ;
+        bool failed = capture.stats.writeFailed ;
+
+        guard.unlock () ;
+
+        // only the last buffer can be part filled, and O_DIRECT can't write it
+        if (last && capture.direct && (buffer->length % Alignment != 0))
+            fcntl (capture.fd, F_SETFL, fcntl (capture.fd, F_GETFL) & ~O_DIRECT) ;
+
+        bool ok = failed || writeAll (buffer->data, buffer->length) ;
+
+        guard.lock () ;
+
+        if (! ok)
+        {
+            perror ("rawCapture") ;
+            capture.stats.writeFailed = true ;
+        }
+        else if (! failed)
+            ++ capture.stats.buffersWritten ;
+
+        buffer->length = 0 ;
+        capture.free.push_back (buffer) ;
+    }
+}
+
+
+
+bool rawCapture_start (const char * path, bool direct)
+{
+    if (capture.running)
+        return false ;
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC ;
+
+    // tmpfs and some others refuse O_DIRECT, buffered writes of the same buffers will do there
+    capture.direct = direct ;
+    capture.fd     = direct ? open (path, flags | O_DIRECT, 0644) : -1 ;
+
+    if (capture.fd < 0)
+    {
+        capture.direct = false ;
+        capture.fd     = open (path, flags, 0644) ;
+    }
+
+    if (capture.fd < 0)
+        return false ;
+
+    if (! allocateBuffers () || ! ubx_subscribe (UbxClass_RXM, onRxm))
+    {
+        freeBuffers () ;
+        close (capture.fd) ;
+        capture.fd = -1 ;
+        return false ;
+    }
+
+    memset (& capture.stats, 0, sizeof (capture.stats)) ;
+    capture.stopping = false ;
+    capture.current  = NULL ;
+
+    {
+        lock_guard <mutex> guard (capture.lock) ;
+        capture.running = true ;
+    }
+
+    capture.writer = thread (writeBuffers) ;
+
+    // the receiver is read for as long as the capture runs
+    gps_startStreaming () ;
+    return true ;
+}
+
+
+void rawCapture_stop (void)
+{
+    if (! capture.writer.joinable ())
+        return ;
+
+    gps_stopStreaming () ;
+    ubx_unsubscribe (UbxClass_RXM, onRxm) ;
+
+    {
+        lock_guard <mutex> guard (capture.lock) ;
+
+        capture.running = false ;
+
+        if ((capture.current != NULL) && (capture.current->length != 0))
+            queueFull (capture.current) ;
+        else if (capture.current != NULL)
+            capture.free.push_back (capture.current) ;
+
+        capture.current  = NULL ;
+        capture.stopping = true ;
+        capture.wake.notify_one () ;
+    }
+
+    capture.writer.join () ;
+
+    if (close (capture.fd) != 0)
+        capture.stats.writeFailed = true ;
+    capture.fd = -1 ;
+
+    freeBuffers () ;
+}
+
+
+void rawCapture_getStats (RawCaptureStats * stats)
+{
+    lock_guard <mutex> guard (capture.lock) ;
+    * stats = capture.stats ;
+}
+
+
+bool rawCapture_enableMessages (UbxTxDone done, void * context)
+{
+    // CFG-MSG: class, id, rate on the port the message is sent on (1 = every epoch)
+    uint8_t rawx  [3] = { UbxClass_RXM, RXM_RAWX,  1 } ;
+    uint8_t sfrbx [3] = { UbxClass_RXM, RXM_SFRBX, 1 } ;
+
+    // then the faster rate, any answers lost in the change are asked for again at the new rate
+    return ubxTx_send (UbxClass_CFG, CFG_MSG, rawx,  sizeof (rawx),  done, context) &&
+           ubxTx_send (UbxClass_CFG, CFG_MSG, sfrbx, sizeof (sfrbx), done, context) &&
+           gps_setBaudRate (RawCapture_BaudRate) ;
+}
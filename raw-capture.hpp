@@ -0,0 +1,54 @@
+#ifndef _RAW_CAPTURE_H_
+#define _RAW_CAPTURE_H_
+
+#include "ubx-tx.hpp"
+
+#include <stdint.h>
+
+
+// capture of raw measurements (UBX-RXM-RAWX) and navigation subframes (UBX-RXM-SFRBX) to a file,
+// for post-processing (RTKLIB's convbin and the like read it as a .ubx file)
+//
+//      each message, checksum verified by the ubx framer, is copied whole into a large aligned
+//      buffer on the receiving thread; full buffers are written by a writer thread, so a slow
+//      disk never holds up the NMEA and fix processing
+//      all MaxBufferedBytes of buffers are allocated and touched by rawCapture_start (), so the
+//      receiving thread never allocates; when the disk falls behind by all of them, messages are
+//      dropped (and counted, see metrics.hpp)
+//      the receiver is kept powered and read while the capture runs (gps_startStreaming ())
+//      with direct set the file is opened O_DIRECT where the file system allows it, which the
+//      buffer alignment and size are chosen for
+//
+//      a buffer is written when it is full or the capture stops, so a crash loses up to one buffer
+
+
+static const uint32_t RawCapture_BufferBytes      = 1 << 20 ;
+static const uint32_t RawCapture_MaxBufferedBytes = 16 << 20 ;
+
+// RAWX for 30 odd satellites is about 1 KB an epoch, more than 9600 baud carries
+static const uint32_t RawCapture_BaudRate         = 460800 ;
+
+
+typedef struct
+{
+    uint64_t    messages ;
+    uint64_t    bytes ;
+    uint64_t    dropped ;
+    uint64_t    buffersWritten ;
+    uint32_t    maxBuffersQueued ;      // the most waiting for the writer at one time
+    bool        writeFailed ;
+} RawCaptureStats ;
+
+
+bool rawCapture_start (const char * path, bool direct = false) ;
+void rawCapture_stop  (void) ;             // writes what is buffered and waits for the writer
+
+void rawCapture_getStats (RawCaptureStats *) ;
+
+// ask the receiver for RAWX and SFRBX on the port it is connected by, every epoch, and raise the
+// baud rate to RawCapture_BaudRate to carry them (see gps_setBaudRate ())
+//      two CFG-MSG, sent on the next read of the receiver, done is called with the answer to each
+bool rawCapture_enableMessages (UbxTxDone = NULL, void * context = NULL) ;
+
+
+#endif
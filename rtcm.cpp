@@ -0,0 +1,342 @@
+#include "rtcm.hpp"
+
+#include "gps.hpp"
+#include "serial-tx.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const uint8_t    Preamble     = 0xD3 ;
+static const size_t     MaxFrame     = RtcmMaxPayload + RtcmOverhead ;
+static const size_t     MaxPath      = 256 ;
+
+// a file is read while fewer than this are waiting to be sent, so none are dropped
+static const size_t     FileBacklog  = SerialTx_MaxQueuedBytes [SerialTx_Correction] / 2 ;
+static const int        FilePause_ms = 10 ;
+
+
+typedef enum
+{
+    Source_File,
+    Source_Fifo,
+    Source_Socket,
+} SourceKind ;
+
+
+static struct {
+    char                path [MaxPath] ;
+    SourceKind          kind ;
+    int                 fd = -1 ;
+
+    atomic <bool>       running ;
+    thread              loop ;
+    int                 stopFd = -1 ;
+
+    // reader thread only
+    uint8_t             buffer [4 * MaxFrame] ;
+    size_t              length ;
+
+    mutex               lock ;
+    RtcmStats           stats ;
+} reader ;
+
+
+
+static uint32_t crcTable [256] ;
+
+static void makeCrcTable (void)
+{
+    // CRC-24Q (Qualcomm), polynomial 0x1864CFB
+    for (uint32_t i = 0 ; i < 256 ; i ++)
+    {
+        uint32_t crc = i << 16 ;
+
+        for (int bit = 0 ; bit < 8 ; bit ++)
+        {
+            crc <<= 1 ;
+            if (crc & 0x1000000)
+                crc ^= 0x1864CFB ;
+        }
+
+        crcTable [i] = crc & 0xFFFFFF ;
+    }
+}
+
+[[maybe_unused]] static const bool crcTableMade = (makeCrcTable (), true) ;
+
+
+uint32_t rtcm_crc24q (const uint8_t * data, size_t length)
+{
+    uint32_t crc = 0 ;
+
+    while (length --)
+        crc = ((crc << 8) ^ crcTable [((crc >> 16) ^ * data ++) & 0xFF]) & 0xFFFFFF ;
+
+    return crc ;
+}
+
+
+
+static void frameBuffered (void)
+{
+    // frames out of the buffer, leaving a partial frame at its start
+    uint64_t frames = 0, bytes = 0, crcFailures = 0, skipped = 0 ;
+    size_t   start  = 0 ;
+
+    while (start < reader.length)
+    {
+        const uint8_t * frame = reader.buffer + start ;
+        size_t          available = reader.length - start ;
+
+        if (frame [0] != Preamble)
+        {
+            ++ start ;
+            ++ skipped ;
+            continue ;
+        }
+
+        if (available < 3)
+            break ;
+
+        // the 6 bits ahead of the length are reserved, and 0
+        if (frame [1] & 0xFC)
+        {
+            ++ start ;
+            ++ skipped ;
+            continue ;
+        }
+
+        size_t size = (((frame [1] & 0x03) << 8) | frame [2]) + RtcmOverhead ;
+        if (available < size)
+            break ;
+
+        uint32_t crc = (frame [size - 3] << 16) | (frame [size - 2] << 8) | frame [size - 1] ;
+
+        if (rtcm_crc24q (frame, size - 3) != crc)
+        {
+            // a preamble in the middle of something else, or damage: look again from the next byte
+            ++ crcFailures ;
+            ++ start ;
+            ++ skipped ;
+            continue ;
+        }
+
+        serialTx_queue (SerialTx_Correction, frame, size) ;
+
+        ++ frames ;
+        bytes += size ;
+        start += size ;
+    }
+
+    reader.length -= start ;
+    memmove (reader.buffer, reader.buffer + start, reader.length) ;
+
+    lock_guard <mutex> guard (reader.lock) ;
+
+    reader.stats.frames       += frames ;
+    reader.stats.bytes        += bytes ;
+    reader.stats.crcFailures  += crcFailures ;
+    reader.stats.skippedBytes += skipped ;
+}
+
+
+
+static int openSource (void)
+{
+    if (reader.kind != Source_Socket)
+        return open (reader.path, O_RDONLY | O_NONBLOCK | O_CLOEXEC) ;
+
+    int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) ;
+    if (fd < 0)
+        return -1 ;
+
+    struct sockaddr_un address ;
+    memset (& address, 0, sizeof (address)) ;
+    address.sun_family = AF_UNIX ;
+    strcpy (address.sun_path, reader.path) ;              // the length was checked by rtcm_start()
+
+    // a local connect completes or fails straight away
+    if (connect (fd, (struct sockaddr *) & address, sizeof (address)) != 0)
+    {
+        close (fd) ;
+        return -1 ;
+    }
+
+    return fd ;
+}
+
+
+static bool waitForStop (int timeout_ms)
+{
+    // true if stopped
+    struct pollfd stop = { reader.stopFd, POLLIN, 0 } ;
+    poll (& stop, 1, timeout_ms) ;
+
+    return ! reader.running ;
+}
+
+
+static void closeSource (void)
+{
+    if (reader.fd >= 0)
+        close (reader.fd) ;
+
+    reader.fd     = -1 ;
+    reader.length = 0 ;             // a frame cut short by the source going away is of no use
+}
+
+
+static void readSource (void)
+{
+    while (reader.running)
+    {
+        if (reader.fd < 0)
+        {
+            reader.fd = openSource () ;
+
+            if (reader.fd < 0)
+            {
+                if (waitForStop (RtcmReconnectInterval_ms))
+                    break ;
+                continue ;
+            }
+        }
+
+        if ((reader.kind == Source_File) && (serialTx_pendingBytes () > FileBacklog))
+        {
+            if (waitForStop (FilePause_ms))
+                break ;
+            continue ;
+        }
+
+        struct pollfd fds [2] = { { reader.stopFd, POLLIN, 0 }, { reader.fd, POLLIN, 0 } } ;
+
+        if (poll (fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue ;
+            break ;
+        }
+
+        if (! reader.running)
+            break ;
+
+        if (! (fds [1].revents & (POLLIN | POLLHUP | POLLERR)))
+            continue ;
+
+        ssize_t count = ::read (reader.fd, reader.buffer + reader.length, sizeof (reader.buffer) - reader.length) ;
+
+        if ((count < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+            continue ;
+
+        if (count > 0)
+        {
+            reader.length += count ;
+            frameBuffered () ;
+            continue ;
+        }
+
+        // the end of the file, the FIFO's writer has gone, or the socket's peer
+        closeSource () ;
+
+        if (reader.kind == Source_File)
+        {
+            lock_guard <mutex> guard (reader.lock) ;
+            reader.stats.finished = true ;
+            break ;
+        }
+
+        {
+            lock_guard <mutex> guard (reader.lock) ;
+            ++ reader.stats.reconnects ;
+        }
+
+        // a FIFO opened again waits for the next writer, but a socket would be refused at once
+        if ((reader.kind == Source_Socket) && waitForStop (RtcmReconnectInterval_ms))
+            break ;
+    }
+
+    closeSource () ;
+}
+
+
+
+bool rtcm_start (const char * path)
+{
+    if (reader.running || reader.loop.joinable ())
+        return false ;
+
+    if (strlen (path) >= MaxPath)
+        return false ;
+
+    struct stat status ;
+    if (stat (path, & status) != 0)
+        return false ;
+
+    if (S_ISSOCK (status.st_mode) && (strlen (path) < sizeof (((struct sockaddr_un *) 0)->sun_path)))
+        reader.kind = Source_Socket ;
+    else if (S_ISFIFO (status.st_mode))
+        reader.kind = Source_Fifo ;
+    else if (S_ISREG (status.st_mode))
+        reader.kind = Source_File ;
+    else
+        return false ;
+
+    strcpy (reader.path, path) ;
+
+    reader.stopFd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC) ;
+    if (reader.stopFd < 0)
+        return false ;
+
+    memset (& reader.stats, 0, sizeof (reader.stats)) ;
+    reader.length  = 0 ;
+    reader.running = true ;
+    reader.loop    = thread (readSource) ;
+
+    // the frames are sent by the receiver's reader, which runs while anything is streaming
+    gps_startStreaming () ;
+    return true ;
+}
+
+
+void rtcm_stop (void)
+{
+    if (reader.loop.joinable ())
+    {
+        reader.running = false ;
+
+        uint64_t one = 1 ;
+        if (write (reader.stopFd, & one, sizeof (one)) != sizeof (one))
+            perror ("rtcm_stop") ;
+
+        reader.loop.join () ;
+
+        gps_stopStreaming () ;
+    }
+
+    if (reader.stopFd >= 0)
+        close (reader.stopFd) ;
+    reader.stopFd = -1 ;
+}
+
+
+void rtcm_getStats (RtcmStats * stats)
+{
+    lock_guard <mutex> guard (reader.lock) ;
+    * stats = reader.stats ;
+}
@@ -0,0 +1,45 @@
+#ifndef _RTCM_H_
+#define _RTCM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// RTCM3 corrections from a local source (a base station relay) passed on to the receiver, for RTK
+//
+//      the source is a regular file, a FIFO or a UNIX stream socket, read on a thread of its own;
+//      the stream is framed (0xD3, 6 zero bits, 10 bit length, payload, CRC-24Q) and each frame
+//      whose CRC checks is queued whole for the receiver at correction priority (see serial-tx.hpp),
+//      anything else is skipped a byte at a time until a frame checks again
+//
+//      a file is read once, no faster than the frames are sent; a FIFO is reopened when its writer
+//      goes away, and a socket reconnected every ReconnectInterval_ms until it answers
+//      the receiver is kept powered and read while the source is (gps_startStreaming ()), the
+//      reader is what sends the frames
+
+
+static const uint16_t RtcmMaxPayload        = 1023 ;
+static const uint16_t RtcmOverhead          = 6 ;       // preamble and length, and the CRC
+static const uint32_t RtcmReconnectInterval_ms = 1000 ;
+
+
+typedef struct
+{
+    uint64_t    frames ;                // queued for the receiver
+    uint64_t    bytes ;
+    uint64_t    crcFailures ;
+    uint64_t    skippedBytes ;          // not part of a frame that checked
+    uint32_t    reconnects ;            // FIFO reopened or socket reconnected
+    bool        finished ;              // a file has been read to its end
+} RtcmStats ;
+
+
+uint32_t rtcm_crc24q (const uint8_t *, size_t) ;
+
+bool rtcm_start (const char * path) ;
+void rtcm_stop  (void) ;
+
+void rtcm_getStats (RtcmStats *) ;
+
+
+#endif
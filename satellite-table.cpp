@@ -0,0 +1,275 @@
+#include "satellite-table.hpp"
+
+#include <string.h>
+
+
+
+static SatelliteSystem systemFromTalker (const NmeaTalker talker)
+{
+    if ((talker [0] == 'B') && (talker [1] == 'D'))
+        return SatelliteSystem_BeiDou ;
+
+    if (talker [0] != 'G')
+        return SatelliteSystem_Unknown ;
+
+    switch (talker [1])
+    {
+        case 'P':   return SatelliteSystem_GPS ;
+        case 'L':   return SatelliteSystem_GLONASS ;
+        case 'A':   return SatelliteSystem_Galileo ;
+        case 'B':   return SatelliteSystem_BeiDou ;
+        case 'Q':   return SatelliteSystem_QZSS ;
+        default:    return SatelliteSystem_Unknown ;    // GN, combined
+    }
+}
+
+
+static SatelliteSystem systemFromPrn (uint8_t prn)
+{
+    // NMEA 4.0 numbering, as used with the combined GN talker
+    //      1 .. 32 GPS, 33 .. 64 SBAS (reported with GPS), 65 .. 96 GLONASS, 193 .. 202 QZSS
+    //      anything else can't be placed without the talker
+
+    if ((prn >= 1) && (prn <= 64))
+        return SatelliteSystem_GPS ;
+
+    if ((prn >= 65) && (prn <= 96))
+        return SatelliteSystem_GLONASS ;
+
+    if ((prn >= 193) && (prn <= 202))
+        return SatelliteSystem_QZSS ;
+
+    return SatelliteSystem_Unknown ;
+}
+
+
+static SatelliteSystem systemFromSystemId (uint8_t systemId)
+{
+    // NMEA 4.1 GSA system id
+    switch (systemId)
+    {
+        case 1:     return SatelliteSystem_GPS ;
+        case 2:     return SatelliteSystem_GLONASS ;
+        case 3:     return SatelliteSystem_Galileo ;
+        case 4:     return SatelliteSystem_BeiDou ;
+        case 5:     return SatelliteSystem_QZSS ;
+        default:    return SatelliteSystem_Unknown ;
+    }
+}
+
+
+
+static uint8_t systemBit (SatelliteSystem system)
+{
+    return 1 << system ;
+}
+
+
+static uint64_t systemMask (const SatelliteTable * table, uint8_t systems)
+{
+    // the entries of the given systems, a systemBit () for each
+
+    uint64_t mask = 0 ;
+
+    for (uint8_t i = 0 ; i < table->count ; i ++)
+        if (systems & systemBit ((SatelliteSystem) table->system [i]))
+            mask |= 1ull << i ;
+
+    return mask ;
+}
+
+
+static void startCycle (SatelliteTable * table, SatelliteSystem system)
+{
+    // the first time the cycle lists a system, that system's satellites are due to be seen again
+    if (table->cycleSystems & systemBit (system))
+        return ;
+
+    table->cycleSystems |= systemBit (system) ;
+    table->seen         &= ~systemMask (table, systemBit (system)) ;
+}
+
+
+static uint8_t findEntry (const SatelliteTable * table, SatelliteSystem system, uint8_t prn)
+{
+    // returns count if not found
+
+    uint8_t i ;
+
+    for (i = 0 ; i < table->count ; i ++)
+        if ((table->prn [i] == prn) && (table->system [i] == system))
+            break ;
+
+    return i ;
+}
+
+
+static uint8_t findOrAddEntry (SatelliteTable * table, SatelliteSystem system, uint8_t prn)
+{
+    // returns SatelliteTableCapacity if the table is full
+
+    uint8_t i = findEntry (table, system, prn) ;
+
+    if ((i == table->count) && (table->count < SatelliteTableCapacity))
+    {
+        table->system [i] = system ;
+        table->prn    [i] = prn ;
+        ++ table->count ;
+    }
+
+    return (i < table->count) ? i : SatelliteTableCapacity ;
+}
+
+
+static uint64_t moveBit (uint64_t bits, uint8_t from, uint8_t to)
+{
+    bits &= ~(1ull << to) ;
+    bits |= ((bits >> from) & 1) << to ;
+    return bits & ~(1ull << from) ;
+}
+
+
+static void removeEntry (SatelliteTable * table, uint8_t i)
+{
+    // move the last entry into the hole and zero the old last entry
+
+    uint8_t last = -- table->count ;
+
+    table->system    [i] = table->system    [last] ;
+    table->prn       [i] = table->prn       [last] ;
+    table->elevation [i] = table->elevation [last] ;
+    table->azimuth   [i] = table->azimuth   [last] ;
+    table->snr       [i] = table->snr       [last] ;
+
+    table->usedInFix = moveBit (table->usedInFix, last, i) ;
+    table->seen      = moveBit (table->seen,      last, i) ;
+
+    table->system    [last] = 0 ;
+    table->prn       [last] = 0 ;
+    table->elevation [last] = 0 ;
+    table->azimuth   [last] = 0 ;
+    table->snr       [last] = 0 ;
+}
+
+
+
+void satelliteTable_clear (SatelliteTable * table)
+{
+    memset (table, 0, sizeof (* table)) ;
+}
+
+
+void satelliteTable_updateFromGSV (SatelliteTable * table, const NmeaGSV * gsv)
+{
+    // a GSV cycle is 1 .. sentenceCount sentences from one talker
+    //      satellites not listed anywhere in the cycle have gone out of view, but only for the
+    //      systems the cycle is about: the talker's, or for the combined GN talker those of the
+    //      satellites it lists; a satellite whose system can't be told is skipped
+
+    SatelliteSystem cycleSystem = systemFromTalker (gsv->talker) ;
+
+    if (gsv->sentenceNumber == 1)
+    {
+        table->cycleSystems = 0 ;
+
+        // a talker's cycle with no satellites says none of its system are in view
+        if (cycleSystem != SatelliteSystem_Unknown)
+            startCycle (table, cycleSystem) ;
+    }
+
+    for (uint8_t s = 0 ; s < gsv->satelliteCount ; s ++)
+    {
+        const NmeaSatellite * satellite = & gsv->satellites [s] ;
+
+        SatelliteSystem system = (cycleSystem != SatelliteSystem_Unknown) ? cycleSystem : systemFromPrn (satellite->prn) ;
+        if (system == SatelliteSystem_Unknown)
+            continue ;
+
+        startCycle (table, system) ;
+
+        uint8_t i = findOrAddEntry (table, system, satellite->prn) ;
+        if (i == SatelliteTableCapacity)
+            break ;
+
+        table->elevation [i] = satellite->elevation ;
+        table->azimuth   [i] = satellite->azimuth ;
+        table->snr       [i] = (satellite->snr > 0) ? satellite->snr : 0 ;
+        table->seen          |= 1ull << i ;
+    }
+
+    if (gsv->sentenceNumber == gsv->sentenceCount)
+    {
+        uint64_t gone = systemMask (table, table->cycleSystems) & ~table->seen ;
+
+        // from the top down, so removing doesn't move an entry that is still to be checked
+        for (uint8_t i = table->count ; i -- > 0 ; )
+            if (gone & (1ull << i))
+                removeEntry (table, i) ;
+    }
+}
+
+
+void satelliteTable_updateFromGSA (SatelliteTable * table, const NmeaGSA * gsa)
+{
+    // one GSA per constellation, so only that constellation's used flags are replaced
+    //      a GSA whose constellation can't be told is ignored, rather than taken as all of them
+
+    SatelliteSystem system = systemFromTalker (gsa->talker) ;
+
+    if (system == SatelliteSystem_Unknown)
+        system = systemFromSystemId (gsa->systemId) ;
+
+    if ((system == SatelliteSystem_Unknown) && (gsa->satelliteCount != 0))
+        system = systemFromPrn (gsa->prn [0]) ;
+
+    if (system == SatelliteSystem_Unknown)
+        return ;
+
+    table->usedInFix &= ~systemMask (table, systemBit (system)) ;
+
+    for (uint8_t s = 0 ; s < gsa->satelliteCount ; s ++)
+    {
+        // a satellite not yet seen in a GSV is added, and filled in by the next GSV
+        uint8_t i = findOrAddEntry (table, system, gsa->prn [s]) ;
+        if (i == SatelliteTableCapacity)
+            break ;
+
+        table->usedInFix |= 1ull << i ;
+    }
+}
+
+
+
+uint16_t satelliteTable_meanSnr_x10 (const SatelliteTable * table)
+{
+    uint16_t sum     = 0 ;
+    uint8_t  tracked = 0 ;
+
+    for (uint8_t i = 0 ; i < SatelliteTableCapacity ; i ++)
+    {
+        sum     += table->snr [i] ;
+        tracked += (table->snr [i] != 0) ;
+    }
+
+    return (tracked != 0) ? (sum * 10) / tracked : 0 ;
+}
+
+
+uint8_t satelliteTable_countAbove (const SatelliteTable * table, uint8_t snr)
+{
+    if (snr == 0)
+        snr = 1 ;
+
+    uint8_t count = 0 ;
+
+    for (uint8_t i = 0 ; i < SatelliteTableCapacity ; i ++)
+        count += (table->snr [i] >= snr) ;
+
+    return count ;
+}
+
+
+uint8_t satelliteTable_usedCount (const SatelliteTable * table)
+{
+    return __builtin_popcountll (table->usedInFix) ;
+}
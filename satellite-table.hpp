@@ -0,0 +1,54 @@
+#ifndef _SATELLITE_TABLE_H_
+#define _SATELLITE_TABLE_H_
+
+#include "nmea-sentence.hpp"
+
+#include <stdint.h>
+
+
+// satellites in view, all constellations, updated in place from GSV and GSA
+//
+//      structure of arrays with a fixed capacity, so the statistics are short loops over
+//      a few contiguous bytes that the compiler can vectorize
+//      entries past count are kept zeroed, so the loops can run over the whole capacity
+
+
+typedef enum
+{
+    SatelliteSystem_Unknown,
+    SatelliteSystem_GPS,
+    SatelliteSystem_GLONASS,
+    SatelliteSystem_Galileo,
+    SatelliteSystem_BeiDou,
+    SatelliteSystem_QZSS,
+} SatelliteSystem ;
+
+
+static const uint8_t SatelliteTableCapacity = 64 ;      // one bit each in usedInFix
+
+typedef struct
+{
+    uint8_t     count ;
+    uint8_t     system    [SatelliteTableCapacity] ;    // SatelliteSystem
+    uint8_t     prn       [SatelliteTableCapacity] ;
+    int8_t      elevation [SatelliteTableCapacity] ;    // degrees
+    int16_t     azimuth   [SatelliteTableCapacity] ;    // degrees
+    uint8_t     snr       [SatelliteTableCapacity] ;    // dB, 0 if not tracked
+    uint64_t    usedInFix ;                             // bit i for entry i
+    uint64_t    seen ;                                  // bit i if entry i is in the current GSV cycle
+    uint8_t     cycleSystems ;                          // bit (1 << SatelliteSystem) for each in the current GSV cycle
+} SatelliteTable ;
+
+
+void satelliteTable_clear (SatelliteTable *) ;
+
+void satelliteTable_updateFromGSV (SatelliteTable *, const NmeaGSV *) ;
+void satelliteTable_updateFromGSA (SatelliteTable *, const NmeaGSA *) ;
+
+// signal health
+uint16_t satelliteTable_meanSnr_x10 (const SatelliteTable *) ;                   // over tracked satellites, 0 if none
+uint8_t  satelliteTable_countAbove  (const SatelliteTable *, uint8_t snr) ;       // tracked with snr >= the given value
+uint8_t  satelliteTable_usedCount   (const SatelliteTable *) ;
+
+
+#endif
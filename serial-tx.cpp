@@ -0,0 +1,242 @@
+#include "serial-tx.hpp"
+
+#include "time-source.hpp"
+
+#include <deque>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+
+
+typedef struct
+{
+    vector <uint8_t>    bytes ;
+    int64_t             queued_ms ;
+    SerialTxSent        sent ;
+    void *              context ;
+    SerialTxPrepare     prepare ;
+} Message ;
+
+
+typedef struct
+{
+    size_t              end ;           // offset in the batch of the byte after the message
+    uint16_t            length ;
+    SerialTxPriority    priority ;
+    SerialTxSent        sent ;
+    void *              context ;
+    SerialTxPrepare     prepare ;
+} Batched ;
+
+
+static struct {
+    mutex               lock ;
+    deque <Message>     queued [SerialTxPriorities] ;
+    size_t              queuedBytes [SerialTxPriorities] ;
+    SerialTxStats       stats [SerialTxPriorities] ;
+
+    // the batch being sent, by the thread servicing the port only
+    vector <uint8_t>    batch ;
+    size_t              written ;
+    deque <Batched>     messages ;      // in the batch, not yet written in full
+} tx ;
+
+
+
+bool serialTx_queue (SerialTxPriority priority, const uint8_t * message, uint16_t length,
+                     SerialTxSent sent, void * context, SerialTxPrepare prepare)
+{
+    if ((length == 0) || (length > SerialTx_MaxQueuedBytes [priority]))
+        return false ;
+
+    vector <Message> dropped ;
+
+    {
+        lock_guard <mutex> guard (tx.lock) ;
+
+        deque <Message> & queue = tx.queued [priority] ;
+
+        while (tx.queuedBytes [priority] + length > SerialTx_MaxQueuedBytes [priority])
+        {
+            if (priority != SerialTx_Correction)
+            {
+                ++ tx.stats [priority].dropped ;
+                return false ;
+            }
+
+            tx.queuedBytes [priority] -= queue.front ().bytes.size () ;
+            dropped.push_back (move (queue.front ())) ;
+            queue.pop_front () ;
+            ++ tx.stats [priority].dropped ;
+        }
+
+        queue.push_back ({ vector <uint8_t> (message, message + length), timeSource_monotonic_ms (), sent, context, prepare }) ;
+        tx.queuedBytes [priority] += length ;
+    }
+
+    // told outside the lock, so they can queue again
+    for (Message & old : dropped)
+        if (old.sent != NULL)
+            old.sent (old.context, false) ;
+
+    return true ;
+}
+
+
+static void dropExpired (SerialTxPriority priority, int64_t now_ms, vector <Message> & dropped)
+{
+    // with the lock held, from the front, the oldest
+    deque <Message> & queue = tx.queued [priority] ;
+
+    if (SerialTx_MaxAge_ms [priority] == 0)
+        return ;
+
+    while (! queue.empty () && (now_ms - queue.front ().queued_ms > SerialTx_MaxAge_ms [priority]))
+    {
+        tx.queuedBytes [priority] -= queue.front ().bytes.size () ;
+        dropped.push_back (move (queue.front ())) ;
+        queue.pop_front () ;
+        ++ tx.stats [priority].dropped ;
+    }
+}
+
+
+static void fillBatch (uint16_t maxBytes, vector <Message> & dropped, vector <Batched> & prepare)
+{
+    tx.batch.clear () ;
+    tx.written = 0 ;
+
+    int64_t now_ms = timeSource_monotonic_ms () ;
+
+    lock_guard <mutex> guard (tx.lock) ;
+
+    for (int priority = 0 ; priority < SerialTxPriorities ; priority ++)
+    {
+        deque <Message> & queue = tx.queued [priority] ;
+
+        dropExpired ((SerialTxPriority) priority, now_ms, dropped) ;
+
+        // the first message goes in whatever its length, so a long one isn't stuck
+        while (! queue.empty () &&
+               (tx.batch.empty () || (tx.batch.size () + queue.front ().bytes.size () <= maxBytes)))
+        {
+            Message & message = queue.front () ;
+
+            tx.batch.insert (tx.batch.end (), message.bytes.begin (), message.bytes.end ()) ;
+            tx.messages.push_back ({ tx.batch.size (), (uint16_t) message.bytes.size (),
+                                     (SerialTxPriority) priority, message.sent, message.context, message.prepare }) ;
+
+            if (message.prepare != NULL)
+                prepare.push_back (tx.messages.back ()) ;
+
+            tx.queuedBytes [priority] -= message.bytes.size () ;
+            queue.pop_front () ;
+        }
+
+        // a lower priority only fills out a batch, it never starts ahead of a higher one
+        if (! queue.empty ())
+            return ;
+    }
+}
+
+
+void serialTx_service (SerialPort * port, uint16_t maxBytes)
+{
+    while (1)
+    {
+        if (tx.written == tx.batch.size ())
+        {
+            vector <Message> dropped ;
+            vector <Batched> prepare ;
+            fillBatch (maxBytes, dropped, prepare) ;
+
+            // told outside the lock, so they can queue again
+            for (Message & old : dropped)
+                if (old.sent != NULL)
+                    old.sent (old.context, false) ;
+
+            // the batch is this thread's, so it can be changed outside the lock
+            for (Batched & message : prepare)
+                message.prepare (& tx.batch [message.end - message.length], message.length, message.context) ;
+        }
+
+        if (tx.batch.empty ())
+            return ;
+
+        uint16_t count = serialPort_write (port, & tx.batch [tx.written], tx.batch.size () - tx.written) ;
+        tx.written += count ;
+
+        vector <Batched> done ;
+
+        {
+            lock_guard <mutex> guard (tx.lock) ;
+
+            // counted against the message the write started in
+            if (count != 0)
+                ++ tx.stats [tx.messages.front ().priority].writes ;
+
+            while (! tx.messages.empty () && (tx.messages.front ().end <= tx.written))
+            {
+                Batched & message = tx.messages.front () ;
+
+                ++ tx.stats [message.priority].messages ;
+                tx.stats [message.priority].bytes += message.length ;
+
+                done.push_back (message) ;
+                tx.messages.pop_front () ;
+            }
+        }
+
+        for (Batched & message : done)
+            if (message.sent != NULL)
+                message.sent (message.context, true) ;
+
+        // the port will take no more for now
+        if (tx.written != tx.batch.size ())
+            return ;
+    }
+}
+
+
+size_t serialTx_pendingBytes (void)
+{
+    lock_guard <mutex> guard (tx.lock) ;
+
+    size_t pending = 0 ;
+    for (int priority = 0 ; priority < SerialTxPriorities ; priority ++)
+        pending += tx.queuedBytes [priority] ;
+
+    return pending ;
+}
+
+
+void serialTx_getStats (SerialTxPriority priority, SerialTxStats * stats)
+{
+    lock_guard <mutex> guard (tx.lock) ;
+    * stats = tx.stats [priority] ;
+}
+
+
+void serialTx_clear (void)
+{
+    // a batch already being sent is finished, so the receiver doesn't see half a message
+    vector <Message> cleared ;
+
+    {
+        lock_guard <mutex> guard (tx.lock) ;
+
+        for (int priority = 0 ; priority < SerialTxPriorities ; priority ++)
+        {
+            for (Message & message : tx.queued [priority])
+                cleared.push_back (move (message)) ;
+
+            tx.queued [priority].clear () ;
+            tx.queuedBytes [priority] = 0 ;
+        }
+    }
+
+    for (Message & message : cleared)
+        if (message.sent != NULL)
+            message.sent (message.context, false) ;
+}
@@ -0,0 +1,66 @@
+#ifndef _SERIAL_TX_H_
+#define _SERIAL_TX_H_
+
+#include "serial-port.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// messages to the receiver, queued by any thread and sent by nmea0183_run() while it waits
+// for received bytes, so transmitting never holds up the RX path
+//      the reader runs nmea0183_run () for as long as the receiver is powered (gps.hpp), so
+//      nothing is sent while it is off, and what is queued meanwhile waits
+//
+//      waiting messages are packed whole into a batch, highest priority and oldest first, and the
+//      batch is handed to the port in as few writes as it will take: corrections go ahead of
+//      configuration traffic, but not ahead of a batch already started
+//      corrections are worthless once stale: those older than their SerialTx_MaxAge_ms when they
+//      would go into a batch are dropped, as are the oldest when they back up; configuration
+//      messages never expire, and are refused when the queue is full instead, so the caller knows
+
+
+typedef enum
+{
+    SerialTx_Correction,                // RTCM3, see rtcm.hpp
+    SerialTx_Config,                    // UBX configuration and assistance, see ubx-tx.hpp
+
+    SerialTxPriorities
+} SerialTxPriority ;
+
+
+static const size_t   SerialTx_MaxQueuedBytes [SerialTxPriorities] = { 16 * 1024, 16 * 1024 } ;
+static const uint32_t SerialTx_MaxAge_ms      [SerialTxPriorities] = { 5000, 0 } ;     // 0 for no limit
+
+
+typedef struct
+{
+    uint64_t    messages ;              // sent
+    uint64_t    bytes ;
+    uint64_t    dropped ;               // corrections dropped (backed up or stale), or config messages refused
+    uint64_t    writes ;                // to the port, a batch may take more than one
+} SerialTxStats ;
+
+
+// called on the thread servicing the port when the message's last byte has been written,
+// or with sent false when it was dropped or cleared before then
+typedef void (* SerialTxSent) (void * context, bool sent) ;
+
+// called on the thread servicing the port as the message goes into a batch, just before it is
+// written, for what must be filled in as late as possible (a time); it may change the bytes but
+// not their number, and must not queue
+typedef void (* SerialTxPrepare) (uint8_t * message, uint16_t length, void * context) ;
+
+bool serialTx_queue (SerialTxPriority, const uint8_t * message, uint16_t length,
+                     SerialTxSent = NULL, void * context = NULL, SerialTxPrepare = NULL) ;
+
+// send what the port will take without waiting, in batches of up to maxBytes, called with the port open
+void serialTx_service (SerialPort *, uint16_t maxBytes) ;
+
+size_t serialTx_pendingBytes (void) ;  // queued, not yet in a batch
+void   serialTx_getStats     (SerialTxPriority, SerialTxStats *) ;
+
+void serialTx_clear (void) ;
+
+
+#endif
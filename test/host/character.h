@@ -0,0 +1,16 @@
+#ifndef _CHARACTER_H_
+#define _CHARACTER_H_
+
+// host stand-in for the target's character.h, just what the gps code uses
+
+#define CarriageReturn  '\r'
+#define Linefeed        '\n'
+
+#ifndef TRUE
+#define TRUE            true
+#define FALSE           false
+#endif
+
+#define ArrayLength(a)  (sizeof (a) / sizeof ((a) [0]))
+
+#endif
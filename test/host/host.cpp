@@ -0,0 +1,169 @@
+// host implementations of the target's platform interfaces, for the tests (see the headers here)
+
+#include "main-cm4-task.h"
+#include "osal.h"
+#include "serial-port.h"
+#include "stopwatch.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+int host_gpio [HostGpioPins] ;
+
+void gpio_set (int pin, int level)
+{
+    if ((pin >= 0) && (pin < HostGpioPins))
+        host_gpio [pin] = level ;
+}
+
+
+
+void mutex_initialize (Mutex *)                 { }
+void mutex_get        (Mutex * mutex, int)      { mutex->lock.lock () ; }
+void mutex_release    (Mutex * mutex)           { mutex->lock.unlock () ; }
+
+void task_yield (void)
+{
+    sched_yield () ;
+}
+
+
+
+static int64_t monotonic_ms (void)
+{
+    struct timespec now ;
+    clock_gettime (CLOCK_MONOTONIC, & now) ;
+
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000 ;
+}
+
+void stopwatch_initialize (Stopwatch * stopwatch)
+{
+    stopwatch->started_ms = monotonic_ms () ;
+}
+
+uint32_t stopwatch_elapsedSeconds (Stopwatch * stopwatch)
+{
+    return (uint32_t) ((monotonic_ms () - stopwatch->started_ms) / 1000) ;
+}
+
+
+
+struct SerialPort
+{
+    int                 fd ;
+    char                path [256] ;
+    uint32_t            baud ;
+    vector <uint8_t> *  capture ;
+} ;
+
+static SerialPort port = { -1, "/dev/ttyACM0", 0, NULL } ;
+
+
+SerialPort * serialPort_open (SerialPortId)
+{
+    if (port.fd >= 0)
+        close (port.fd) ;
+
+    port.fd = open (port.path, O_RDWR | O_NOCTTY | O_NONBLOCK) ;
+    if (port.fd < 0)
+        return (port.capture != NULL) ? & port : NULL ;
+
+    struct termios settings ;
+    if (tcgetattr (port.fd, & settings) == 0)
+    {
+        cfmakeraw (& settings) ;
+        tcsetattr (port.fd, TCSANOW, & settings) ;
+    }
+
+    return & port ;
+}
+
+
+void serialPort_close (SerialPortId)
+{
+    if (port.fd >= 0)
+        close (port.fd) ;
+
+    port.fd = -1 ;
+}
+
+
+bool serialPort_setDevicePath (SerialPortId, const char * path)
+{
+    if (strlen (path) >= sizeof (port.path))
+        return false ;
+
+    strcpy (port.path, path) ;
+    return true ;
+}
+
+
+void serialPort_setBaudRate (SerialPort * serial, uint32_t baud)
+{
+    serial->baud = baud ;
+}
+
+
+bool serialPort_rxReady (SerialPort * serial)
+{
+    if (serial->fd < 0)
+    {
+        usleep (1000) ;
+        return false ;
+    }
+
+    struct pollfd ready = { serial->fd, POLLIN, 0 } ;
+    return (poll (& ready, 1, 1) > 0) && (ready.revents & POLLIN) ;
+}
+
+
+uint8_t serialPort_rxByte (SerialPort * serial)
+{
+    uint8_t in = 0 ;
+    if (read (serial->fd, & in, 1) != 1)
+        in = 0 ;
+
+    return in ;
+}
+
+
+uint16_t serialPort_write (SerialPort * serial, const uint8_t * bytes, uint16_t length)
+{
+    if (serial->capture != NULL)
+    {
+        serial->capture->insert (serial->capture->end (), bytes, bytes + length) ;
+        return length ;
+    }
+
+    if (serial->fd < 0)
+        return 0 ;
+
+    ssize_t written = write (serial->fd, bytes, length) ;
+    return (written > 0) ? (uint16_t) written : 0 ;
+}
+
+
+void serialPort_txByte (SerialPort * serial, uint8_t out)
+{
+    serialPort_write (serial, & out, 1) ;
+}
+
+
+void host_captureTx (vector <uint8_t> * capture)
+{
+    port.capture = capture ;
+}
+
+
+uint32_t host_baudRate (void)
+{
+    return port.baud ;
+}
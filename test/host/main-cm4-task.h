@@ -0,0 +1,12 @@
+#ifndef _MAIN_CM4_TASK_H_
+#define _MAIN_CM4_TASK_H_
+
+// host stand-in, the gpio writes are recorded (see host.cpp)
+
+enum { GPS_EN_N, GPS_RESET_N, HostGpioPins } ;
+
+void gpio_set (int pin, int level) ;
+
+extern int host_gpio [HostGpioPins] ;
+
+#endif
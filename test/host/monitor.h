@@ -0,0 +1,6 @@
+#ifndef _MONITOR_H_
+#define _MONITOR_H_
+
+// host stand-in, the gps code includes it but the tests don't need the monitor
+
+#endif
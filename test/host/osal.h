@@ -0,0 +1,21 @@
+#ifndef _OSAL_H_
+#define _OSAL_H_
+
+// host stand-in for the target's OSAL, on std::mutex
+
+#include <mutex>
+
+typedef struct
+{
+    std::mutex  lock ;
+} Mutex ;
+
+#define OSAL_WAIT_FOREVER   (-1)
+
+void mutex_initialize (Mutex *) ;
+void mutex_get        (Mutex *, int timeout) ;
+void mutex_release    (Mutex *) ;
+
+void task_yield (void) ;
+
+#endif
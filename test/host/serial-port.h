@@ -0,0 +1,36 @@
+#ifndef _SERIAL_PORT_H_
+#define _SERIAL_PORT_H_
+
+// host stand-in for the target's serial port driver, on a POSIX tty (a pty in the tests)
+//
+//      the port opens the path last given to serialPort_setDevicePath (), /dev/ttyACM0 until then
+//      bytes written can also be captured instead (host_captureTx), for the tests that check
+//      what would be sent
+
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+using namespace std ;
+
+typedef struct SerialPort SerialPort ;
+
+typedef enum { SerialPort_GPS } SerialPortId ;
+
+SerialPort * serialPort_open          (SerialPortId) ;        // NULL if the device can't be opened
+void         serialPort_close         (SerialPortId) ;
+bool         serialPort_setDevicePath (SerialPortId, const char * path) ;
+void         serialPort_setBaudRate   (SerialPort *, uint32_t baud) ;
+
+bool         serialPort_rxReady (SerialPort *) ;              // waits up to a millisecond
+uint8_t      serialPort_rxByte  (SerialPort *) ;
+
+void         serialPort_txByte  (SerialPort *, uint8_t) ;
+uint16_t     serialPort_write   (SerialPort *, const uint8_t *, uint16_t) ;
+
+// with a non-NULL vector, everything written goes there rather than to the device
+void host_captureTx (vector <uint8_t> *) ;
+
+// the baud rate last set
+uint32_t host_baudRate (void) ;
+
+#endif
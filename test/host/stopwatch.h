@@ -0,0 +1,16 @@
+#ifndef _STOPWATCH_H_
+#define _STOPWATCH_H_
+
+#include <stdint.h>
+
+// host stand-in
+
+typedef struct
+{
+    int64_t     started_ms ;
+} Stopwatch ;
+
+void     stopwatch_initialize     (Stopwatch *) ;
+uint32_t stopwatch_elapsedSeconds (Stopwatch *) ;
+
+#endif
@@ -0,0 +1,210 @@
+// the acquisitions run through their minutes long cadence on the simulated clock
+//
+//      time-source.hpp's simulated clock is moved on a minute at a time, with gps_updateAcquisition ()
+//      called after each step as the application would: an acquisition that never sees a valid RMC
+//      fails after MaxMinutesOn (180 minutes), one that does succeeds at the next update, and the
+//      waiters are told at the right minute, by their deadline or by the outcome; and while
+//      gps_turnOff () waits for what suspending queued, the acquisitions' state can still be read
+//
+//      the receiver's port is left unopenable, so the reader only retries, and the sentences are
+//      given to nmea0183 straight from the test
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-acquisition.cpp test/host/host.cpp gps.cpp
+//              gps-device.cpp gps-power.cpp nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp
+//              position-filter.cpp lat-long.cpp capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp
+//              ubx.cpp time-source.cpp -o test-acquisition && ./test-acquisition
+
+#include "gps.hpp"
+#include "gps-power.hpp"
+#include "main-cm4-task.h"
+#include "nmea0183.hpp"
+#include "time-source.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <stdio.h>
+#include <string.h>
+using namespace std;
+
+
+
+static const time_t     Start = 1589299200 ;            // 2020-05-12 16:00:00 UTC
+static const int        NotYet = -1 ;
+
+static const char       Rmc [] = "$GPRMC,162500.00,A,4153.38633,N,08746.35785,W,0.114,,120520,,,A*6D" ;
+
+static int              minute ;
+static bool             failed ;
+
+
+typedef struct
+{
+    GpsWaiter   waiter ;
+    const char * name ;
+    int         toldAt ;
+    bool        succeeded ;
+} Watch ;
+
+
+static void told (GpsWaiter * waiter, bool succeeded)
+{
+    Watch * watch = (Watch *) waiter->context ;
+
+    watch->toldAt    = minute ;
+    watch->succeeded = succeeded ;
+}
+
+
+static void watch (Watch * watch, const char * name, time_t deadline, void (* await) (GpsWaiter *))
+{
+    memset (watch, 0, sizeof (* watch)) ;
+
+    watch->name            = name ;
+    watch->toldAt          = NotYet ;
+    watch->waiter.handler  = told ;
+    watch->waiter.context  = watch ;
+    watch->waiter.deadline = deadline ;
+
+    await (& watch->waiter) ;
+}
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static void expectTold (const Watch * watch, int atMinute, bool succeeded)
+{
+    if ((watch->toldAt == atMinute) && (watch->succeeded == succeeded))
+        return ;
+
+    printf ("FAIL: %s told at minute %d (%s), expected %d (%s)\n", watch->name,
+            watch->toldAt, watch->succeeded ? "succeeded" : "failed", atMinute, succeeded ? "succeeded" : "failed") ;
+    failed = true ;
+}
+
+
+static void runUntil (int lastMinute, int rmcAtMinute = NotYet)
+{
+    while (minute < lastMinute)
+    {
+        timeSource_advance (60 * 1000) ;
+        minute ++ ;
+
+        if (minute == rmcAtMinute)
+            nmea0183_updateFromString (Rmc) ;
+
+        gps_updateAcquisition () ;
+    }
+}
+
+
+
+int main ()
+{
+    // nothing there, so the reader never runs nmea0183 over what the test gave it
+    serialPort_setDevicePath (SerialPort_GPS, "/nonexistent/ttyACM0") ;
+
+    timeSource_simulate (Start, 0) ;
+
+    nmea0183_initialize () ;
+    gps_initialize () ;
+
+    // a waiter added before the first initiate waits for it, rather than being told Idle
+    Watch early ;
+    watch (& early, "early date/time waiter", 0, gps_awaitDateTime) ;
+    expect (early.toldAt == NotYet, "a waiter added before the first initiate is told straight away") ;
+
+
+    // no valid RMC, both time out ...
+
+    gps_initiateDateTimeAcquisition (false) ;
+    gps_initiateLatLongAcquisition () ;
+
+    Watch dateTime, latLong, deadline, cancelled ;
+    watch (& dateTime,  "date/time waiter",      0,                  gps_awaitDateTime) ;
+    watch (& latLong,   "lat/long waiter",       0,                  gps_awaitLatLong) ;
+    watch (& deadline,  "60 minute deadline",    Start + 60 * 60,    gps_awaitLatLong) ;
+    watch (& cancelled, "cancelled waiter",      0,                  gps_awaitLatLong) ;
+
+    expect (gps_cancelWait (& cancelled.waiter),   "cancelling a pending waiter") ;
+    expect (! gps_cancelWait (& cancelled.waiter), "cancelling a waiter twice") ;
+
+    runUntil (179) ;
+    expect (gps_dateTimeAcquisitionBusy () && gps_latLongAcquisitionBusy (), "still busy at minute 179") ;
+    expectTold (& deadline, 60, false) ;
+
+    runUntil (200) ;
+    expect (! gps_dateTimeAcquisitionBusy () && ! gps_latLongAcquisitionBusy (), "stopped after 180 minutes") ;
+    expect (! gps_dateTimeAcquisitionSucceeded () && ! gps_latLongAcquisitionSucceeded (), "failed after 180 minutes") ;
+    expect (host_gpio [GPS_EN_N] == 1, "powered down after the timeout") ;
+
+    expectTold (& early,     180, false) ;
+    expectTold (& dateTime,  180, false) ;
+    expectTold (& latLong,   180, false) ;
+    expectTold (& cancelled, NotYet, false) ;
+
+    // added after the outcome, told it straight away
+    Watch late ;
+    watch (& late, "late waiter", 0, gps_awaitLatLong) ;
+    expectTold (& late, 200, false) ;
+
+
+    // again from 16:20, a valid RMC at minute 25 is acquired at the 10 minute update ...
+
+    timeSource_simulate (Start + 20 * 60, 0) ;
+    minute = 20 ;
+
+    gps_initiateLatLongAcquisition () ;
+    watch (& latLong, "lat/long waiter", 0, gps_awaitLatLong) ;
+
+    runUntil (45, 25) ;
+    expect (gps_latLongAcquisitionSucceeded (), "lat/long acquired") ;
+    expectTold (& latLong, 30, true) ;
+
+    LatLongString expected, acquired ;
+    nmea0183_getLatLongString (expected) ;
+    string_view view = gps_getLatLongString (acquired) ;
+    expect ((expected [0] != 0) && (view == expected), "the lat/long acquired is the RMC's") ;
+
+    gps_turnOff () ;
+    timeSource_useSystem () ;
+
+
+    // in backup, turning off waits for the PMREQ queued to go, here never, as the port is gone ...
+
+    gpsPower_setMode (GpsPower_Backup) ;
+    gps_startStreaming () ;
+
+    atomic <bool> turningOff (true) ;
+    thread turnOff ([& turningOff] ()
+    {
+        gps_turnOff () ;
+        turningOff = false ;
+    }) ;
+
+    this_thread::sleep_for (chrono::milliseconds (100)) ;
+
+    auto before = chrono::steady_clock::now () ;
+    gps_getLatLongString (acquired) ;
+    auto waited = chrono::steady_clock::now () - before ;
+
+    expect (turningOff && (waited < chrono::milliseconds (100)), "the lat/long read at once, while turning off waits for what is queued") ;
+
+    turnOff.join () ;
+    gpsPower_setMode (GpsPower_Off) ;
+
+    if (! failed)
+        printf ("ok: timed out at minute 180, acquired at minute 30, waiters told on time, read while turning off (%s)\n", expected) ;
+
+    return failed ? 1 : 0 ;
+}
@@ -0,0 +1,130 @@
+// the steady state receive path makes no heap allocations
+//
+//      every operator new is counted; after one warm up pass (first use of the event log ring,
+//      the fix assembler's subscriptions), framing, decoding and assembling sentences from bytes,
+//      and the lat/long string conversions, must not allocate at all
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-allocations.cpp test/host/host.cpp
+//              nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp position-filter.cpp lat-long.cpp
+//              capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp ubx.cpp time-source.cpp
+//              -o test-allocations && ./test-allocations
+
+#include "gps-fix.hpp"
+#include "lat-long.hpp"
+#include "nmea0183.hpp"
+
+#include <atomic>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+using namespace std;
+
+
+
+static atomic <uint64_t> allocations ;
+
+void * operator new (size_t size)
+{
+    allocations ++ ;
+
+    void * memory = malloc (size ? size : 1) ;
+    if (memory == NULL)
+        throw bad_alloc () ;
+
+    return memory ;
+}
+
+void * operator new [] (size_t size)            { return operator new (size) ; }
+void   operator delete (void * memory) noexcept { free (memory) ; }
+void   operator delete [] (void * memory) noexcept { free (memory) ; }
+void   operator delete (void * memory, size_t) noexcept { free (memory) ; }
+void   operator delete [] (void * memory, size_t) noexcept { free (memory) ; }
+
+
+
+static const char * const Bodies [] =
+{
+    "GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A",
+    "GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,",
+    "GPGSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1",
+    "GPGSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45",
+    "GPGSV,2,2,08,15,40,083,46,16,17,308,41,17,07,344,39,18,22,228,45",
+    "GLGSV,1,1,01,70,40,083,46",
+    "GPGLL,4807.038,N,01131.000,E,123519.00,A,A",
+    "GPZDA,123519.00,23,03,1994,00,00",             // unknown, dropped right after framing
+} ;
+
+static char    stream [1024] ;
+static size_t  streamLength ;
+
+
+static void addSentence (const char * body)
+{
+    uint8_t checksum = 0 ;
+    for (const char * c = body ; * c != 0 ; c ++)
+        checksum ^= (uint8_t) * c ;
+
+    streamLength += snprintf (stream + streamLength, sizeof (stream) - streamLength, "$%s*%02X\r\n", body, checksum) ;
+}
+
+
+static uint32_t fixes ;
+
+static void onFix (const GpsFix * fix)
+{
+    fixes += fix->positionValid ;
+}
+
+
+static bool convertLatLong (void)
+{
+    LatitudeLongitude position = { 48 * 6000000 + 238000, -(123 * 6000000 + 367245) } ;
+    LatitudeLongitude parsed ;
+    LatLongString     text ;
+
+    string_view view = latitudeLongitude_toString (& position, text) ;
+
+    return latitudeLongitude_fromString (& parsed, view) &&
+           (parsed.latitude_minutes_x1e5  == position.latitude_minutes_x1e5) &&
+           (parsed.longitude_minutes_x1e5 == position.longitude_minutes_x1e5) ;
+}
+
+
+
+int main ()
+{
+    for (const char * body : Bodies)
+        addSentence (body) ;
+
+    nmea0183_initialize () ;
+
+    if (! gpsFix_subscribe (onFix))
+    {
+        printf ("FAIL: gpsFix_subscribe\n") ;
+        return 1 ;
+    }
+
+    // warm up
+    nmea0183_updateFromBytes ((const uint8_t *) stream, streamLength) ;
+    bool converted = convertLatLong () ;
+
+    uint64_t before = allocations ;
+
+    const uint32_t Passes = 1000 ;
+    for (uint32_t i = 0 ; i < Passes ; i ++)
+    {
+        nmea0183_updateFromBytes ((const uint8_t *) stream, streamLength) ;
+        converted &= convertLatLong () ;
+    }
+
+    uint64_t made = allocations - before ;
+
+    bool ok = (made == 0) && converted && (fixes >= Passes) ;
+
+    printf ("%s: %llu allocations in %u passes, %u fixes, lat/long round trip %s\n", ok ? "ok" : "FAIL",
+            (unsigned long long) made, Passes, fixes, converted ? "ok" : "wrong") ;
+
+    return ok ? 0 : 1 ;
+}
@@ -0,0 +1,204 @@
+// coroutines awaiting the acquisitions and the fixes, all resumed on the executor's thread
+//
+//      thousands of coroutines await one date/time acquisition and are resumed together when the
+//      update that finds the RMC runs on the test's thread; one with a deadline is resumed with
+//      false at its deadline; one awaits the next fix and another reads three from a stream
+//
+//      the receiver's port is left unopenable, and the sentences are given to nmea0183 straight
+//      from the test, on the simulated clock as in test-acquisition.cpp
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++20 -pthread -Itest/host -I. test/test-async.cpp test/host/host.cpp gps-async.cpp gps.cpp
+//              gps-device.cpp gps-power.cpp nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp
+//              position-filter.cpp lat-long.cpp capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp
+//              ubx.cpp time-source.cpp -o test-async && ./test-async
+
+#include "gps-async.hpp"
+#include "nmea0183.hpp"
+#include "time-source.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+using namespace std;
+
+
+
+static const time_t     Start     = 1589299200 ;        // 2020-05-12 16:00:00 UTC
+static const uint32_t   Waiters   = 2000 ;
+static const uint32_t   Streamed  = 3 ;
+
+static bool             failed ;
+static thread::id       testThread ;
+
+static atomic <uint32_t> acquired, acquiredOnTest ;
+static atomic <int>      deadlineOutcome = -1 ;
+static atomic <int>      nextFixSeconds  = -1 ;
+static atomic <uint32_t> streamed ;
+static int               streamedSeconds [Streamed] ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static bool settle (const atomic <uint32_t> & count, uint32_t expected)
+{
+    // the executor resumes them on its own thread
+    for (int i = 0 ; (i < 2000) && (count < expected) ; i ++)
+        this_thread::sleep_for (chrono::milliseconds (1)) ;
+
+    return count == expected ;
+}
+
+
+static void feedSentence (const char * body)
+{
+    uint8_t checksum = 0 ;
+    for (const char * c = body ; * c != 0 ; c ++)
+        checksum ^= (uint8_t) * c ;
+
+    char sentence [128] ;
+    snprintf (sentence, sizeof (sentence), "$%s*%02X", body, checksum) ;
+
+    nmea0183_updateFromString (sentence) ;
+}
+
+
+static void feedEpoch (int second)
+{
+    char body [96] ;
+
+    snprintf (body, sizeof (body), "GPRMC,1625%02d.00,A,4153.38633,N,08746.35785,W,0.114,,120520,,,A", second) ;
+    feedSentence (body) ;
+
+    snprintf (body, sizeof (body), "GPGLL,4153.38633,N,08746.35785,W,1625%02d.00,A,A", second) ;
+    feedSentence (body) ;
+}
+
+
+static void advanceMinutes (int minutes)
+{
+    for (int i = 0 ; i < minutes ; i ++)
+    {
+        timeSource_advance (60 * 1000) ;
+        gps_updateAcquisition () ;
+    }
+}
+
+
+
+static GpsTask awaitDateTime (void)
+{
+    bool succeeded = co_await gpsAsync_acquireDateTime () ;
+
+    if (succeeded)
+        acquired ++ ;
+
+    if (this_thread::get_id () == testThread)
+        acquiredOnTest ++ ;
+}
+
+
+static GpsTask awaitLatLongBy (time_t deadline)
+{
+    deadlineOutcome = co_await gpsAsync_acquireLatLong (deadline) ;
+}
+
+
+static GpsTask awaitNextFix (void)
+{
+    GpsFix fix = co_await gpsAsync_nextFix () ;
+    nextFixSeconds = fix.time.seconds ;
+}
+
+
+static GpsTask readStream (void)
+{
+    GpsFixes fixes ;
+
+    for (uint32_t i = 0 ; i < Streamed ; i ++)
+    {
+        GpsFix fix = co_await fixes.next () ;
+
+        streamedSeconds [i] = fix.time.seconds ;
+        streamed ++ ;
+    }
+}
+
+
+
+int main ()
+{
+    testThread = this_thread::get_id () ;
+
+    // nothing there, so the reader never runs nmea0183 over what the test gives it
+    serialPort_setDevicePath (SerialPort_GPS, "/nonexistent/ttyACM0") ;
+
+    timeSource_simulate (Start, 0) ;
+
+    nmea0183_initialize () ;
+    gps_initialize () ;
+
+    expect (gpsAsync_start (), "the executor starts") ;
+
+
+    // thousands wait for one acquisition, and one gives up at 16:05 ...
+
+    for (uint32_t i = 0 ; i < Waiters ; i ++)
+        awaitDateTime () ;
+
+    awaitLatLongBy (Start + 5 * 60) ;
+
+    expect (gps_dateTimeAcquisitionBusy () && gps_latLongAcquisitionBusy (), "awaiting initiates the acquisitions") ;
+
+    advanceMinutes (4) ;
+    this_thread::sleep_for (chrono::milliseconds (20)) ;
+    expect (deadlineOutcome == -1, "resumed before its deadline") ;
+
+    advanceMinutes (1) ;
+    for (int i = 0 ; (i < 2000) && (deadlineOutcome == -1) ; i ++)
+        this_thread::sleep_for (chrono::milliseconds (1)) ;
+    expect (deadlineOutcome == 0, "resumed with false at its deadline") ;
+
+    feedSentence ("GPRMC,160500.00,A,4153.38633,N,08746.35785,W,0.114,,120520,,,A") ;
+
+    advanceMinutes (4) ;
+    this_thread::sleep_for (chrono::milliseconds (20)) ;
+    expect (acquired == 0, "resumed before the 10 minute update") ;
+
+    advanceMinutes (1) ;
+    expect (settle (acquired, Waiters), "every waiter resumed with true at the 10 minute update") ;
+    expect (acquiredOnTest == 0, "resumed on the executor, not the thread that ran the update") ;
+
+
+    // the next fix, and a stream of three ...
+
+    awaitNextFix () ;
+    readStream () ;
+
+    for (int second = 0 ; second < (int) Streamed ; second ++)
+        feedEpoch (second) ;
+
+    expect (settle (streamed, Streamed), "three fixes streamed") ;
+    expect ((streamedSeconds [0] == 0) && (streamedSeconds [1] == 1) && (streamedSeconds [2] == 2), "streamed in order") ;
+    expect (nextFixSeconds == 0, "the next fix is the first") ;
+
+    gpsAsync_stop () ;
+    gps_turnOff () ;
+    timeSource_useSystem () ;
+
+    if (! failed)
+        printf ("ok: %u coroutines resumed by one acquisition, one at its deadline, next fix and a stream of %u\n",
+                Waiters, Streamed) ;
+
+    return failed ? 1 : 0 ;
+}
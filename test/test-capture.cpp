@@ -0,0 +1,338 @@
+// capture and replay of the raw receiver bytes
+//
+//      bytes captured in bursts (one of them several chunks long) replay as they were, in runs of
+//      at most 255, at as fast as possible, 1x and 4x, each taking the time it should; a chunk is
+//      written once its first byte is a second old and at the end of the stream; a file cut between
+//      chunks replays up to the cut, a chunk cut short or damaged is refused after the ones before it; and
+//      a replay reaches the parser, and a pty as a receiver would
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-capture.cpp test/host/host.cpp capture.cpp
+//              nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp position-filter.cpp lat-long.cpp
+//              event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp ubx.cpp time-source.cpp
+//              -o test-capture && ./test-capture
+
+#include "capture.hpp"
+#include "nmea0183.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const size_t     HeaderSize      = 32 ;          // the file's, then 16 for each chunk's
+static const size_t     ChunkHeaderSize = 16 ;
+
+static char             path [64] ;
+static char             damaged [64] ;
+static bool             failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static uint32_t random32 (void)
+{
+    static uint32_t state = 2463534242u ;
+
+    state ^= state << 13 ;
+    state ^= state >> 17 ;
+    state ^= state << 5 ;
+
+    return state ;
+}
+
+
+static int64_t now_ns (void)
+{
+    return chrono::duration_cast <chrono::nanoseconds> (chrono::steady_clock::now ().time_since_epoch ()).count () ;
+}
+
+
+static size_t fileSize (const char * name)
+{
+    struct stat status ;
+    return (stat (name, & status) == 0) ? (size_t) status.st_size : 0 ;
+}
+
+
+typedef struct
+{
+    vector <uint8_t>    bytes ;
+    size_t              longestRun ;
+} Replayed ;
+
+static void collect (const uint8_t * bytes, size_t length, void * context)
+{
+    Replayed * replayed = (Replayed *) context ;
+
+    replayed->bytes.insert (replayed->bytes.end (), bytes, bytes + length) ;
+
+    if (length > replayed->longestRun)
+        replayed->longestRun = length ;
+}
+
+
+static void capture (const vector <uint8_t> & bytes)
+{
+    for (uint8_t byte : bytes)
+        capture_rxByte (byte) ;
+}
+
+
+
+static void checkRoundTrip (vector <uint8_t> * captured)
+{
+    // 100 bytes, 30 ms, 300000 bytes (several chunks), 30 ms, 10 bytes
+    vector <uint8_t> bursts [3] = { vector <uint8_t> (100), vector <uint8_t> (300000), vector <uint8_t> (10) } ;
+
+    for (vector <uint8_t> & burst : bursts)
+        for (uint8_t & byte : burst)
+            byte = (uint8_t) random32 () ;
+
+    capture_rxByte (0xff) ;
+    expect (fileSize (path) == 0, "nothing captured before the start") ;
+
+    expect (capture_start (path), "capture started") ;
+    expect (! capture_start (damaged), "only one capture at a time") ;
+
+    int64_t started_ns = now_ns () ;
+
+    capture (bursts [0]) ;
+    this_thread::sleep_for (chrono::milliseconds (30)) ;
+    capture (bursts [1]) ;
+    this_thread::sleep_for (chrono::milliseconds (30)) ;
+    capture (bursts [2]) ;
+
+    int64_t captured_ns = now_ns () - started_ns ;
+
+    capture_stop () ;
+    capture_rxByte (0xff) ;
+
+    for (vector <uint8_t> & burst : bursts)
+        captured->insert (captured->end (), burst.begin (), burst.end ()) ;
+
+    // as fast as possible
+    Replayed replayed = { } ;
+    CaptureReplayStats stats ;
+
+    expect (capture_replay (path, 0, collect, & replayed, & stats), "replayed") ;
+    expect (replayed.bytes == * captured, "the bytes replayed are the bytes captured") ;
+    expect ((stats.bytes == captured->size ()) && (replayed.longestRun <= 255) && (stats.runs * 255 >= stats.bytes),
+            "in runs of 255 at most") ;
+    expect ((stats.recorded_ns >= 60000000 - 2 * (int64_t) CaptureResolution_ns) && (stats.recorded_ns <= captured_ns + CaptureResolution_ns),
+            "the time recorded is the time captured") ;
+    expect (stats.elapsed_ns < stats.recorded_ns / 2, "as fast as possible, faster than captured") ;
+
+    // at 1x and 4x
+    for (uint32_t speed : { 1, 4 })
+    {
+        replayed = { } ;
+        expect (capture_replay (path, speed, collect, & replayed, & stats) && (replayed.bytes == * captured), "replayed again") ;
+
+        int64_t expected_ns = stats.recorded_ns / speed ;
+
+        if ((stats.elapsed_ns < expected_ns) || (stats.elapsed_ns > expected_ns + 50000000))
+        {
+            printf ("FAIL: at %ux, %lld ms replayed in %lld ms\n", speed,
+                    (long long) (stats.recorded_ns / 1000000), (long long) (stats.elapsed_ns / 1000000)) ;
+            failed = true ;
+        }
+    }
+}
+
+
+static void checkAge (void)
+{
+    // written when its first byte is a second old, and at the end of the stream
+    vector <uint8_t> first (10, 'a'), second (10, 'b') ;
+
+    expect (capture_start (path), "capture started again, over the old file") ;
+
+    capture (first) ;
+    capture_poll () ;
+    expect (fileSize (path) <= HeaderSize, "a chunk not yet a second old isn't written") ;
+
+    this_thread::sleep_for (chrono::milliseconds (CaptureMaxChunkAge_ms + 50)) ;
+    capture_poll () ;
+    expect (fileSize (path) > HeaderSize + ChunkHeaderSize, "a chunk a second old is written, while capturing") ;
+
+    size_t written = fileSize (path) ;
+
+    capture (second) ;
+    capture_flush () ;
+    expect (fileSize (path) > written, "the chunk written at the end of the stream") ;
+
+    capture_stop () ;
+
+    Replayed replayed = { } ;
+    expect (capture_replay (path, 0, collect, & replayed) && (replayed.bytes.size () == 20) &&
+            equal (first.begin (), first.end (), replayed.bytes.begin ()) &&
+            equal (second.begin (), second.end (), replayed.bytes.begin () + 10),
+            "both chunks replayed") ;
+}
+
+
+static void copyFile (const char * from, const char * to, size_t length)
+{
+    vector <uint8_t> bytes (length) ;
+
+    FILE * in  = fopen (from, "rb") ;
+    FILE * out = fopen (to, "wb") ;
+
+    expect ((in != NULL) && (out != NULL) && (fread (bytes.data (), 1, length, in) == length) &&
+            (fwrite (bytes.data (), 1, length, out) == length), "a copy of the capture") ;
+
+    if (in != NULL)
+        fclose (in) ;
+    if (out != NULL)
+        fclose (out) ;
+}
+
+
+static void checkDamage (const vector <uint8_t> & captured)
+{
+    // the second chunk starts after the first's header and runs
+    uint32_t firstLength ;
+
+    FILE * file = fopen (path, "rb") ;
+    expect ((file != NULL) && (fseek (file, HeaderSize + 4, SEEK_SET) == 0) && (fread (& firstLength, 4, 1, file) == 1),
+            "the first chunk's length") ;
+    if (file != NULL)
+        fclose (file) ;
+
+    size_t second = HeaderSize + ChunkHeaderSize + firstLength ;
+    expect (second + ChunkHeaderSize < fileSize (path), "more than one chunk") ;
+
+    // cut after the first chunk, as by a crash between chunks: the first replays, and that is all there is
+    copyFile (path, damaged, second) ;
+
+    Replayed replayed = { } ;
+    expect (capture_replay (damaged, 0, collect, & replayed), "a file cut between chunks replays") ;
+
+    size_t firstChunkBytes = replayed.bytes.size () ;
+    expect ((firstChunkBytes > 0) && (firstChunkBytes < captured.size ()) &&
+            equal (replayed.bytes.begin (), replayed.bytes.end (), captured.begin ()),
+            "up to the cut") ;
+
+    // cut in the middle of the second chunk's runs: refused, after replaying the first
+    copyFile (path, damaged, second + ChunkHeaderSize + 100) ;
+
+    replayed = { } ;
+    expect (! capture_replay (damaged, 0, collect, & replayed) && (replayed.bytes.size () == firstChunkBytes),
+            "a chunk cut short refused, the one before it replayed") ;
+
+    // the second chunk's magic damaged: refused, after replaying the first
+    copyFile (path, damaged, fileSize (path)) ;
+
+    file = fopen (damaged, "r+b") ;
+    expect ((file != NULL) && (fseek (file, second, SEEK_SET) == 0) && (fputc ('X', file) == 'X'), "the chunk damaged") ;
+    if (file != NULL)
+        fclose (file) ;
+
+    replayed = { } ;
+    expect (! capture_replay (damaged, 0, collect, & replayed), "a damaged chunk refused") ;
+    expect ((replayed.bytes.size () == firstChunkBytes) && equal (replayed.bytes.begin (), replayed.bytes.end (), captured.begin ()),
+            "the chunk before the damage replayed") ;
+
+    Replayed none = { } ;
+    expect (! capture_replay ("/nonexistent/capture", 0, collect, & none) && none.bytes.empty (), "no file, nothing replayed") ;
+}
+
+
+
+static uint32_t rmcs ;
+
+static void onRmc (const NmeaRMC *)
+{
+    rmcs ++ ;
+}
+
+
+static void checkSinks (void)
+{
+    static const char Rmc [] = "$GPRMC,162500.00,A,4153.38633,N,08746.35785,W,0.114,,120520,,,A*6D\r\n" ;
+
+    expect (capture_start (path), "capture started for the sinks") ;
+
+    for (int i = 0 ; i < 3 ; i ++)
+        capture (vector <uint8_t> (Rmc, Rmc + strlen (Rmc))) ;
+
+    capture_stop () ;
+
+    // into the parser
+    nmea0183_initialize () ;
+    nmea0183_subscribe (onRmc) ;
+
+    expect (capture_replay (path, 0, capture_toParser, NULL) && (rmcs == 3), "3 RMCs replayed into the parser") ;
+
+    // into a pty, read from its slave as a receiver's device
+    char slave [64] ;
+    int  master = capture_openPty (slave, sizeof (slave)) ;
+    int  device = (master >= 0) ? open (slave, O_RDONLY | O_NOCTTY | O_NONBLOCK) : -1 ;
+
+    expect (device >= 0, "a pty to replay into") ;
+    if (device < 0)
+        return ;
+
+    expect (capture_replay (path, 0, capture_toFd, & master), "replayed into the pty") ;
+
+    string received ;
+    struct pollfd readable = { device, POLLIN, 0 } ;
+
+    while ((received.size () < 3 * strlen (Rmc)) && (poll (& readable, 1, 1000) == 1))
+    {
+        char buffer [256] ;
+        ssize_t length = read (device, buffer, sizeof (buffer)) ;
+        if (length <= 0)
+            break ;
+
+        received.append (buffer, length) ;
+    }
+
+    expect (received == string (Rmc) + Rmc + Rmc, "the bytes read from the pty as captured, raw") ;
+
+    close (device) ;
+    close (master) ;
+}
+
+
+
+int main ()
+{
+    snprintf (path,    sizeof (path),    "/tmp/test-capture-%d",         (int) getpid ()) ;
+    snprintf (damaged, sizeof (damaged), "/tmp/test-capture-damaged-%d", (int) getpid ()) ;
+
+    vector <uint8_t> captured ;
+
+    checkRoundTrip (& captured) ;
+    checkDamage (captured) ;
+    checkAge () ;
+    checkSinks () ;
+
+    unlink (path) ;
+    unlink (damaged) ;
+
+    if (! failed)
+        printf ("ok: %zu bytes replayed as captured, at speed, aged and flushed chunks, damage, parser and pty\n", captured.size ()) ;
+
+    return failed ? 1 : 0 ;
+}
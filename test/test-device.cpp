@@ -0,0 +1,199 @@
+// the reader follows the receiver to its new tty after a USB brownout
+//
+//      a fake sysfs tree and a directory of symlinks to ptys stand in for /sys and /dev
+//      (see gps-device.hpp): the receiver starts as ttyACM0, goes away, and comes back as
+//      ttyACM1, and the time from the new node appearing to the first sentence read from it
+//      is measured
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-device.cpp test/host/host.cpp gps.cpp
+//              gps-device.cpp gps-power.cpp nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp
+//              position-filter.cpp lat-long.cpp capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp
+//              ubx.cpp time-source.cpp -o test-device && ./test-device
+
+#include "gps.hpp"
+#include "nmea0183.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const int64_t    MaxReattach_ms = 1000 ;         // the reader retries every 100 ms
+
+static const char       Rmc [] = "$GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A*29\r\n" ;
+
+static char             root [64] ;
+static atomic <uint32_t> sentences ;
+
+
+static void onRmc (const NmeaRMC *)
+{
+    sentences ++ ;
+}
+
+
+static int64_t now_ms (void)
+{
+    return chrono::duration_cast <chrono::milliseconds> (chrono::steady_clock::now ().time_since_epoch ()).count () ;
+}
+
+
+static void writeFile (const char * path, const char * text)
+{
+    FILE * file = fopen (path, "w") ;
+    if (file == NULL)
+        return ;
+
+    fputs (text, file) ;
+    fclose (file) ;
+}
+
+
+static int plugIn (int n)
+{
+    // a pty for the receiver's end, and its USB device, interface and tty in the fake sysfs
+    int master = posix_openpt (O_RDWR | O_NOCTTY | O_NONBLOCK) ;
+    if ((master < 0) || (grantpt (master) != 0) || (unlockpt (master) != 0))
+        return -1 ;
+
+    char path [256], target [256] ;
+
+    snprintf (path, sizeof (path), "%s/sys/devices/usb1/1-%d", root, n) ;
+    mkdir (path, 0755) ;
+    snprintf (path, sizeof (path), "%s/sys/devices/usb1/1-%d/1-%d:1.0", root, n, n) ;
+    mkdir (path, 0755) ;
+    snprintf (path, sizeof (path), "%s/sys/devices/usb1/1-%d/idVendor", root, n) ;
+    writeFile (path, "1546\n") ;
+
+    snprintf (path, sizeof (path), "%s/sys/class/tty/ttyACM%d", root, n) ;
+    mkdir (path, 0755) ;
+    snprintf (path, sizeof (path), "%s/sys/class/tty/ttyACM%d/device", root, n) ;
+    snprintf (target, sizeof (target), "../../../devices/usb1/1-%d/1-%d:1.0", n, n) ;
+    if (symlink (target, path) != 0)
+        return -1 ;
+
+    // the node last, as udev would
+    snprintf (path, sizeof (path), "%s/dev/ttyACM%d", root, n) ;
+    if (symlink (ptsname (master), path) != 0)
+        return -1 ;
+
+    return master ;
+}
+
+
+static void unplug (int n, int master)
+{
+    char path [256] ;
+
+    snprintf (path, sizeof (path), "%s/dev/ttyACM%d", root, n) ;
+    unlink (path) ;
+    snprintf (path, sizeof (path), "%s/sys/class/tty/ttyACM%d/device", root, n) ;
+    unlink (path) ;
+    snprintf (path, sizeof (path), "%s/sys/class/tty/ttyACM%d", root, n) ;
+    rmdir (path) ;
+
+    close (master) ;
+}
+
+
+static bool sendUntilRead (int master, int64_t timeout_ms)
+{
+    // again and again, the first sentences can be lost before the reader has the port open and raw
+    uint32_t before   = sentences ;
+    int64_t  deadline = now_ms () + timeout_ms ;
+    char     echo [256] ;
+
+    while (now_ms () < deadline)
+    {
+        if (write (master, Rmc, sizeof (Rmc) - 1) < 0)
+            { }
+
+        // anything echoed while the pty was still in canonical mode
+        while (read (master, echo, sizeof (echo)) > 0)
+            { }
+
+        this_thread::sleep_for (chrono::milliseconds (2)) ;
+
+        if (sentences != before)
+            return true ;
+    }
+
+    return false ;
+}
+
+
+
+int main ()
+{
+    strcpy (root, "/tmp/gps-device-XXXXXX") ;
+    if (mkdtemp (root) == NULL)
+        return 1 ;
+
+    char path [256] ;
+    const char * const Directories [] = { "/sys", "/sys/class", "/sys/class/tty", "/sys/devices", "/sys/devices/usb1", "/dev" } ;
+
+    for (const char * directory : Directories)
+    {
+        snprintf (path, sizeof (path), "%s%s", root, directory) ;
+        mkdir (path, 0755) ;
+    }
+
+    int acm0 = plugIn (0) ;
+    if (acm0 < 0)
+    {
+        printf ("FAIL: can't make a pty\n") ;
+        return 1 ;
+    }
+
+    char sysfs [128], dev [128] ;
+    snprintf (sysfs, sizeof (sysfs), "%s/sys", root) ;
+    snprintf (dev,   sizeof (dev),   "%s/dev", root) ;
+
+    gps_initialize () ;
+    nmea0183_subscribe (onRmc) ;
+
+    bool ok = gps_followDevice (sysfs, dev) ;
+    gps_startStreaming () ;
+
+    ok = ok && sendUntilRead (acm0, MaxReattach_ms) ;
+    if (! ok)
+        printf ("FAIL: nothing read from ttyACM0\n") ;
+
+    // the brownout
+    unplug (0, acm0) ;
+    this_thread::sleep_for (chrono::milliseconds (50)) ;
+
+    int acm1 = plugIn (1) ;
+    int64_t plugged_ms = now_ms () ;
+
+    bool reattached = ok && (acm1 >= 0) && sendUntilRead (acm1, MaxReattach_ms) ;
+    int64_t reattach_ms = now_ms () - plugged_ms ;
+
+    if (ok && ! reattached)
+        printf ("FAIL: nothing read from ttyACM1 within %lld ms\n", (long long) MaxReattach_ms) ;
+
+    gps_stopStreaming () ;
+    gps_stopFollowingDevice () ;
+
+    if (acm1 >= 0)
+        unplug (1, acm1) ;
+
+    snprintf (path, sizeof (path), "rm -rf %s", root) ;
+    if (system (path) != 0)
+        { }
+
+    if (reattached)
+        printf ("ok: reattached to ttyACM1 in %lld ms\n", (long long) reattach_ms) ;
+
+    return reattached ? 0 : 1 ;
+}
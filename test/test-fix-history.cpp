@@ -0,0 +1,312 @@
+// the windowed statistics of the fix history, against the same worked out from the fixes each time
+//
+//      20000 fixes a few seconds to a minute apart (so past the point where the time base is
+//      moved on), scattered and drifting about a point on the antimeridian, some without a
+//      position, speed or HDOP; every few fixes each window (a minute, an hour, and a day the
+//      ring can't hold) is checked against a sum over the fixes it should hold: counts, span,
+//      mean position, sigmas, drift and means; after a day's gap the history moves 3 degrees
+//      (beyond the offsets it can hold from the old reference), and recording what gps-fix
+//      assembles keeps the receiver streaming until it stops
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-fix-history.cpp test/host/host.cpp fix-history.cpp
+//              gps.cpp gps-device.cpp gps-power.cpp nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp
+//              position-filter.cpp lat-long.cpp capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp
+//              ubx.cpp time-source.cpp -o test-fix-history && ./test-fix-history
+
+#include "fix-history.hpp"
+#include "gps.hpp"
+#include "main-cm4-task.h"
+#include "nmea0183.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+
+
+static const uint32_t   Capacity = 1024 ;
+static const uint32_t   Windows_s [] = { 60, 60 * 60, 24 * 60 * 60 } ;
+static const uint8_t    WindowCount = sizeof (Windows_s) / sizeof (Windows_s [0]) ;
+
+static const int64_t    FullCircle_x1e5 = 360ll * 60 * 100000 ;
+static const double     MetresPerMinute_x1e5 = 1852.0 / 100000 ;
+
+static bool             failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static uint32_t random32 (void)
+{
+    static uint32_t state = 2463534242u ;
+
+    state ^= state << 13 ;
+    state ^= state >> 17 ;
+    state ^= state << 5 ;
+
+    return state ;
+}
+
+
+static int64_t wrap (int64_t longitude)
+{
+    while (longitude >   FullCircle_x1e5 / 2)   longitude -= FullCircle_x1e5 ;
+    while (longitude <= -FullCircle_x1e5 / 2)   longitude += FullCircle_x1e5 ;
+
+    return longitude ;
+}
+
+
+static bool near (double value, double expected, double relative, double absolute)
+{
+    return fabs (value - expected) <= fabs (expected) * relative + absolute ;
+}
+
+
+
+typedef struct
+{
+    GpsFix      fix ;
+    int64_t     time_ms ;
+} Added ;
+
+static vector <Added> added ;
+
+
+static void checkWindow (const FixHistory * history, uint8_t window)
+{
+    // the fixes the window should hold: in its time, and still in the ring
+    size_t newest = added.size () - 1 ;
+    size_t first  = (added.size () > Capacity) ? added.size () - Capacity : 0 ;
+
+    while (added [first].time_ms <= added [newest].time_ms - Windows_s [window] * 1000ll)
+        first ++ ;
+
+    double  fixes = 0, positions = 0, speeds = 0, speed = 0, hdops = 0, hdop = 0, satellites = 0 ;
+    double  x = 0, y = 0, xx = 0, yy = 0, t = 0, tt = 0, tx = 0, ty = 0 ;
+    int64_t referenceLatitude = 0, referenceLongitude = 0 ;
+
+    for (size_t i = first ; i <= newest ; i ++)
+    {
+        const GpsFix * fix = & added [i].fix ;
+
+        fixes      ++ ;
+        satellites += fix->satellitesUsed ;
+
+        if (fix->speed_knots_x1000 >= 0)    { speeds ++ ;  speed += fix->speed_knots_x1000 / 1000.0 ; }
+        if (fix->hdop_x100 >= 0)            { hdops ++ ;   hdop  += fix->hdop_x100 / 100.0 ; }
+
+        if (! fix->positionValid)
+            continue ;
+
+        if (positions == 0)
+        {
+            referenceLatitude  = fix->position.latitude_minutes_x1e5 ;
+            referenceLongitude = fix->position.longitude_minutes_x1e5 ;
+        }
+
+        double north = fix->position.latitude_minutes_x1e5 - referenceLatitude ;
+        double east  = wrap (fix->position.longitude_minutes_x1e5 - referenceLongitude) ;
+        double hours = (added [i].time_ms - added [first].time_ms) / 3600000.0 ;
+
+        positions ++ ;
+        x += north ;            y += east ;
+        xx += north * north ;   yy += east * east ;
+        t += hours ;            tt += hours * hours ;
+        tx += hours * north ;   ty += hours * east ;
+    }
+
+    FixHistoryStats stats ;
+    expect (fixHistory_getStats (history, window, & stats), "stats for the window") ;
+
+    bool ok = (stats.fixes == fixes) && (stats.positions == positions) &&
+              (stats.span_ms == added [newest].time_ms - added [first].time_ms) &&
+              near (stats.availability, positions / fixes, 1e-6, 0) &&
+              near (stats.meanSatellites, satellites / fixes, 1e-6, 0) &&
+              near (stats.meanSpeed_knots, speeds != 0 ? speed / speeds : -1, 1e-5, 0) &&
+              near (stats.meanHdop,        hdops  != 0 ? hdop  / hdops  : -1, 1e-5, 0) ;
+
+    if (positions != 0)
+    {
+        double meanX = x / positions, meanY = y / positions ;
+        double metresPerEast = MetresPerMinute_x1e5 * cos ((referenceLatitude + meanX) / 6e6 * M_PI / 180) ;
+
+        double sigmaNorth = sqrt (fmax (xx / positions - meanX * meanX, 0)) * MetresPerMinute_x1e5 ;
+        double sigmaEast  = sqrt (fmax (yy / positions - meanY * meanY, 0)) * metresPerEast ;
+
+        ok = ok && (llabs (stats.meanPosition.latitude_minutes_x1e5 - (referenceLatitude + llround (meanX))) <= 1) &&
+                   (llabs (wrap (stats.meanPosition.longitude_minutes_x1e5 - (referenceLongitude + llround (meanY)))) <= 1) &&
+                   near (stats.sigmaNorth_m, sigmaNorth, 1e-4, 1e-4) &&
+                   near (stats.sigmaEast_m,  sigmaEast,  1e-4, 1e-4) &&
+                   near (stats.cep50_m, 1.1774 * (sigmaNorth + sigmaEast) / 2, 1e-4, 1e-4) ;
+
+        double spread = positions * tt - t * t ;
+
+        if (spread > 1e-9 * positions * positions)
+        {
+            double driftNorth = (positions * tx - t * x) / spread * MetresPerMinute_x1e5 ;
+            double driftEast  = (positions * ty - t * y) / spread * metresPerEast ;
+
+            ok = ok && near (stats.driftNorth_m_per_h, driftNorth, 1e-3, 1e-3) &&
+                       near (stats.driftEast_m_per_h,  driftEast,  1e-3, 1e-3) ;
+        }
+    }
+
+    if (ok)
+        return ;
+
+    printf ("FAIL: window %u at fix %zu: %u fixes, %u positions, sigma %.3f %.3f m, drift %.3f %.3f m/h\n",
+            window, newest, stats.fixes, stats.positions, stats.sigmaNorth_m, stats.sigmaEast_m,
+            stats.driftNorth_m_per_h, stats.driftEast_m_per_h) ;
+    failed = true ;
+}
+
+
+static GpsFix scattered (int64_t latitude, int64_t longitude, int64_t time_ms)
+{
+    // about 100 units (1.85 m) of scatter, drifting 1 m/h north and 0.5 m/h west
+    double hours = time_ms / 3600000.0 ;
+
+    GpsFix fix ;
+    memset (& fix, 0, sizeof (fix)) ;
+
+    fix.positionValid                   = (random32 () % 10) != 0 ;
+    fix.position.latitude_minutes_x1e5  = latitude + (int32_t) (random32 () % 201) - 100 + llround (hours * 54) ;
+    fix.position.longitude_minutes_x1e5 = wrap (longitude + (int32_t) (random32 () % 201) - 100 - llround (hours * 38)) ;
+    fix.speed_knots_x1000               = (random32 () % 8 == 0) ? -1 : random32 () % 500 ;
+    fix.hdop_x100                       = (random32 () % 8 == 0) ? -1 : 60 + random32 () % 200 ;
+    fix.satellitesUsed                  = 4 + random32 () % 20 ;
+
+    return fix ;
+}
+
+
+static void add (FixHistory * history, const GpsFix * fix, int64_t time_ms)
+{
+    fixHistory_add (history, fix, time_ms) ;
+    added.push_back ({ * fix, time_ms }) ;
+}
+
+
+static void checkWindows (void)
+{
+    expect (fixHistory_create (Capacity, Windows_s, 0) == NULL, "no windows refused") ;
+
+    uint32_t tooLong = FixHistory_MaxWindow_s + 1 ;
+    expect (fixHistory_create (Capacity, & tooLong, 1) == NULL, "a window too long refused") ;
+
+    FixHistory * history = fixHistory_create (Capacity, Windows_s, WindowCount) ;
+
+    FixHistoryStats stats ;
+    expect (! fixHistory_getStats (history, WindowCount, & stats), "no such window") ;
+    expect (fixHistory_getStats (history, 0, & stats) && (stats.fixes == 0) && (stats.meanSpeed_knots < 0), "empty") ;
+
+    // 45 N, on the antimeridian
+    int64_t latitude  = 45 * 60 * 100000ll ;
+    int64_t longitude = 180 * 60 * 100000ll ;
+    int64_t time_ms   = 1000 ;
+
+    for (uint32_t i = 0 ; i < 20000 ; i ++)
+    {
+        // a day with nothing, then 3 degrees further south and east
+        if (i == 12000)
+        {
+            time_ms   += 25 * 60 * 60 * 1000ll ;
+            latitude  -= 3 * 60 * 100000 ;
+            longitude += 3 * 60 * 100000 ;
+        }
+
+        GpsFix fix = scattered (latitude, longitude, time_ms) ;
+
+        // the first few without a position, so the reference is the first that has one
+        if (i < 5)
+            fix.positionValid = false ;
+
+        add (history, & fix, time_ms) ;
+
+        if ((i % 7 == 0) || (i == 12000) || (i == 12001))
+            for (uint8_t window = 0 ; window < WindowCount ; window ++)
+                checkWindow (history, window) ;
+
+        time_ms += 1000 * (1 + random32 () % 60) ;
+    }
+
+    expect (time_ms > 2 * (1 << 21) * 100ll, "past where the time base is moved on, twice") ;
+    expect (fixHistory_count (history) == Capacity, "the ring full") ;
+
+    fixHistory_destroy (history) ;
+}
+
+
+
+static uint8_t  stream [256] ;
+static size_t   streamLength ;
+
+static void addSentence (const char * body)
+{
+    uint8_t checksum = 0 ;
+    for (const char * c = body ; * c != 0 ; c ++)
+        checksum ^= (uint8_t) * c ;
+
+    streamLength += snprintf ((char *) stream + streamLength, sizeof (stream) - streamLength, "$%s*%02X\r\n", body, checksum) ;
+}
+
+
+static void checkRecording (void)
+{
+    FixHistory * history = fixHistory_create (16, Windows_s, 1) ;
+    FixHistory * other   = fixHistory_create (16, Windows_s, 1) ;
+
+    host_gpio [GPS_EN_N] = 0 ;
+
+    expect (fixHistory_recordFixes (history), "recording the fixes") ;
+    expect (fixHistory_recordFixes (history), "recording the fixes again, to the same history") ;
+    expect (! fixHistory_recordFixes (other), "not to another history at the same time") ;
+
+    addSentence ("GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A") ;
+    addSentence ("GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,") ;
+    addSentence ("GPGLL,4807.038,N,01131.000,E,123519.00,A,A") ;
+    nmea0183_updateFromBytes (stream, streamLength) ;
+
+    FixHistoryStats stats ;
+    expect (fixHistory_getStats (history, 0, & stats) && (stats.positions == 1) &&
+            (stats.meanPosition.latitude_minutes_x1e5 == 288703800) && (stats.meanPosition.longitude_minutes_x1e5 == 69100000) &&
+            (stats.meanSatellites == 8),
+            "the assembled fix in the history") ;
+
+    expect (host_gpio [GPS_EN_N] == 0, "powered while recording") ;
+
+    fixHistory_destroy (history) ;
+    expect (host_gpio [GPS_EN_N] == 1, "powered down once the history recording is destroyed") ;
+
+    fixHistory_destroy (other) ;
+}
+
+
+
+int main ()
+{
+    serialPort_setDevicePath (SerialPort_GPS, "/nonexistent/ttyACM0") ;
+
+    nmea0183_initialize () ;
+    gps_initialize () ;
+
+    checkWindows () ;
+    checkRecording () ;
+
+    if (! failed)
+        printf ("ok: %zu fixes, 3 windows as worked out from their fixes, moved 3 degrees, recorded while streaming\n", added.size ()) ;
+
+    return failed ? 1 : 0 ;
+}
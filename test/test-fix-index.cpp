@@ -0,0 +1,268 @@
+// the spatial index against a brute force search over the same fixes
+//
+//      20000 fixes, clustered and worldwide, so queries see runs, merges and the pending buffer;
+//      box queries (one across the antimeridian) and radius queries find exactly the fixes a
+//      linear scan finds, at the positions inserted; fixes just inside a radius, north, south,
+//      east and west of the centre at the equator and at 70 degrees, are all found; and an index
+//      saved and opened again answers the same, with more inserted on top of it
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -I. test/test-fix-index.cpp fix-index.cpp geodesy.cpp lat-long.cpp
+//              -o test-fix-index && ./test-fix-index
+
+#include "fix-index.hpp"
+#include "geodesy.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const int32_t  Degree = 60 * 100000 ;        // minutes_x1e5
+static const uint32_t Count  = 20000 ;
+
+static vector <LatitudeLongitude> fixes ;
+static bool failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static uint32_t random32 (void)
+{
+    // xorshift, so every run sees the same fixes
+    static uint32_t state = 2463534242u ;
+
+    state ^= state << 13 ;
+    state ^= state >> 17 ;
+    state ^= state <<  5 ;
+
+    return state ;
+}
+
+
+static int32_t randomIn (int32_t low, int32_t high)
+{
+    return low + (int32_t) (random32 () % (uint32_t) (high - low + 1)) ;
+}
+
+
+
+typedef struct
+{
+    vector <uint32_t>   ids ;
+    bool                positionsExact ;
+} Found ;
+
+
+static void collect (const LatitudeLongitude * position, uint32_t id, void * context)
+{
+    Found * found = (Found *) context ;
+
+    found->ids.push_back (id) ;
+    found->positionsExact &= (id < fixes.size ()) &&
+                             (position-> latitude_minutes_x1e5 == fixes [id]. latitude_minutes_x1e5) &&
+                             (position->longitude_minutes_x1e5 == fixes [id].longitude_minutes_x1e5) ;
+}
+
+
+static bool inBox (const LatitudeLongitude & p, const LatitudeLongitude & southWest, const LatitudeLongitude & northEast)
+{
+    if ((p.latitude_minutes_x1e5 < southWest.latitude_minutes_x1e5) || (p.latitude_minutes_x1e5 > northEast.latitude_minutes_x1e5))
+        return false ;
+
+    if (southWest.longitude_minutes_x1e5 <= northEast.longitude_minutes_x1e5)
+        return (p.longitude_minutes_x1e5 >= southWest.longitude_minutes_x1e5) && (p.longitude_minutes_x1e5 <= northEast.longitude_minutes_x1e5) ;
+
+    return (p.longitude_minutes_x1e5 >= southWest.longitude_minutes_x1e5) || (p.longitude_minutes_x1e5 <= northEast.longitude_minutes_x1e5) ;
+}
+
+
+static void checkSame (Found & found, vector <uint32_t> & expected, const char * what)
+{
+    sort (found.ids.begin (), found.ids.end ()) ;
+    sort (expected.begin (), expected.end ()) ;
+
+    if ((found.ids == expected) && found.positionsExact)
+        return ;
+
+    printf ("FAIL: %s, %zu found rather than %zu%s\n", what, found.ids.size (), expected.size (),
+            found.positionsExact ? "" : ", at the wrong positions") ;
+    failed = true ;
+}
+
+
+
+static void queryBoxes (FixIndex * index, const char * what)
+{
+    static const LatitudeLongitude Boxes [4][2] =
+    {
+        { {  40 * Degree,  -80 * Degree }, {  42 * Degree,  -78 * Degree } },      // the Toronto cluster
+        { { -10 * Degree,  175 * Degree }, {  10 * Degree, -175 * Degree } },      // across the antimeridian
+        { { -90 * Degree, -180 * Degree }, {  90 * Degree,  180 * Degree } },      // the world
+        { {  41 * Degree,  -79 * Degree }, {  41 * Degree,  -79 * Degree } },      // a point
+    } ;
+
+    for (const auto & box : Boxes)
+    {
+        Found found = { {}, true } ;
+        size_t count = fixIndex_queryBox (index, & box [0], & box [1], collect, & found) ;
+
+        vector <uint32_t> expected ;
+        for (uint32_t id = 0 ; id < fixes.size () ; id ++)
+            if (inBox (fixes [id], box [0], box [1]))
+                expected.push_back (id) ;
+
+        expect (count == found.ids.size (), "the count returned is the fixes passed to the handler") ;
+        checkSame (found, expected, what) ;
+    }
+}
+
+
+static void queryRadii (FixIndex * index, const char * what)
+{
+    static const LatitudeLongitude Centres [3] = { { 41 * Degree, -79 * Degree }, { 0, 180 * Degree }, { 89 * Degree, 0 } } ;
+    static const float             Radii   [3] = { 20000, 300000, 500000 } ;
+
+    for (int i = 0 ; i < 3 ; i ++)
+    {
+        Found found = { {}, true } ;
+        fixIndex_queryRadius (index, & Centres [i], Radii [i], collect, & found) ;
+
+        vector <uint32_t> expected ;
+        for (uint32_t id = 0 ; id < fixes.size () ; id ++)
+        {
+            float metres ;
+            geodesy_distanceFrom (Geodesy_Equirectangular, & Centres [i], & fixes [id], & metres, 1) ;
+
+            if (metres <= Radii [i])
+                expected.push_back (id) ;
+        }
+
+        checkSame (found, expected, what) ;
+    }
+}
+
+
+static void checkRadiusEdges (void)
+{
+    // fixes 0.9995 of the radius away, on the four bearings, where the box is tightest
+    static const int32_t Latitudes [2] = { 0, 70 * Degree } ;
+    static const float   Radius = 10000 ;
+
+    for (int32_t latitude : Latitudes)
+    {
+        LatitudeLongitude centre = { latitude, 10 * Degree } ;
+        LatitudeLongitude from [4] = { centre, centre, centre, centre } ;
+        LatitudeLongitude edge [4] ;
+        float bearings [4] = { 0, 90, 180, 270 } ;
+        float metres   [4] = { Radius * 0.9995f, Radius * 0.9995f, Radius * 0.9995f, Radius * 0.9995f } ;
+
+        geodesy_destination (Geodesy_Equirectangular, from, bearings, metres, edge, 4) ;
+
+        FixIndex * index = fixIndex_create () ;
+        for (uint32_t id = 0 ; id < 4 ; id ++)
+            fixIndex_insert (index, & edge [id], id) ;
+
+        vector <uint32_t> ids ;
+        fixIndex_queryRadius (index, & centre, Radius,
+                              [] (const LatitudeLongitude *, uint32_t id, void * context) { ((vector <uint32_t> *) context)->push_back (id) ; },
+                              & ids) ;
+
+        expect (ids.size () == 4, latitude == 0 ? "every fix just inside the radius at the equator" :
+                                                  "every fix just inside the radius at 70 degrees") ;
+
+        fixIndex_destroy (index) ;
+    }
+}
+
+
+
+int main ()
+{
+    // half in a cluster around Toronto, half anywhere, some on the antimeridian and the poles
+    for (uint32_t id = 0 ; id < Count ; id ++)
+    {
+        LatitudeLongitude fix ;
+
+        if (id % 2)
+        {
+            fix.latitude_minutes_x1e5  = randomIn ( 40 * Degree,  42 * Degree) ;
+            fix.longitude_minutes_x1e5 = randomIn (-80 * Degree, -78 * Degree) ;
+        }
+        else
+        {
+            fix.latitude_minutes_x1e5  = randomIn ( -90 * Degree,  90 * Degree) ;
+            fix.longitude_minutes_x1e5 = randomIn (-180 * Degree, 180 * Degree) ;
+        }
+
+        if (id % 997 == 0)
+            fix.longitude_minutes_x1e5 = (id % 2) ? -180 * Degree : 180 * Degree ;
+
+        fixes.push_back (fix) ;
+    }
+
+    fixes [1] = { 41 * Degree, -79 * Degree } ;     // on the point box
+
+    // 20000 is four full buffers, merged into runs, and some pending
+    FixIndex * index = fixIndex_create () ;
+    for (uint32_t id = 0 ; id < Count ; id ++)
+        fixIndex_insert (index, & fixes [id], id) ;
+
+    expect (fixIndex_count (index) == Count, "every fix counted") ;
+
+    queryBoxes (index, "box query in memory") ;
+    queryRadii (index, "radius query in memory") ;
+    checkRadiusEdges () ;
+
+    // saved, opened, and added to
+    char path [64] ;
+    snprintf (path, sizeof (path), "/tmp/test-fix-index-%d", (int) getpid ()) ;
+
+    expect (fixIndex_save (index, path), "saved") ;
+    fixIndex_destroy (index) ;
+
+    expect (fixIndex_open ("/nonexistent/index") == NULL, "no index from a missing file") ;
+
+    index = fixIndex_open (path) ;
+    expect (index != NULL, "opened") ;
+
+    if (index != NULL)
+    {
+        expect (fixIndex_count (index) == Count, "every fix counted once opened") ;
+
+        queryBoxes (index, "box query once opened") ;
+
+        for (uint32_t id = 0 ; id < 100 ; id ++)
+        {
+            LatitudeLongitude fix = { randomIn (40 * Degree, 42 * Degree), randomIn (-80 * Degree, -78 * Degree) } ;
+
+            fixes.push_back (fix) ;
+            fixIndex_insert (index, & fix, Count + id) ;
+        }
+
+        queryBoxes (index, "box query with fixes on top of the file") ;
+        queryRadii (index, "radius query with fixes on top of the file") ;
+
+        fixIndex_destroy (index) ;
+    }
+
+    unlink (path) ;
+
+    if (! failed)
+        printf ("ok: %u fixes, box and radius queries as a linear scan, in memory, from a file and added to\n", Count) ;
+
+    return failed ? 1 : 0 ;
+}
@@ -0,0 +1,278 @@
+// the shared fix ring, read in order, lapped, torn under a writer, replaced, and fed by gps-fix
+//
+//      a reader follows the writer in order; one lapped is told how many fixes it lost and goes
+//      on from the oldest left; a zero copy read overwritten while in use is refused; with a
+//      writer publishing flat out on another thread, every fix read is whole and in order, and
+//      the fixes read and lost add up to those written; a reader of a ring replaced by a new
+//      writer is told it's closed; and publishing what gps-fix assembles keeps the receiver
+//      streaming until it stops
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-fix-ring.cpp test/host/host.cpp fix-ring.cpp
+//              gps.cpp gps-device.cpp gps-power.cpp nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp
+//              position-filter.cpp lat-long.cpp capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp
+//              ubx.cpp time-source.cpp -lrt -o test-fix-ring && ./test-fix-ring
+
+#include "fix-ring.hpp"
+#include "gps.hpp"
+#include "main-cm4-task.h"
+#include "nmea0183.hpp"
+
+#include <atomic>
+#include <thread>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static char name [64] ;
+static bool failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static GpsFix fixNumber (uint32_t n)
+{
+    // every field written from n, so a fix made of two is seen
+    GpsFix fix ;
+    memset (& fix, 0, sizeof (fix)) ;
+
+    fix.positionValid                   = true ;
+    fix.position.latitude_minutes_x1e5  = (int) n ;
+    fix.position.longitude_minutes_x1e5 = - (int) n ;
+    fix.smoothedPosition                = fix.position ;
+    fix.altitude_cm                     = (int32_t) (n * 3) ;
+    fix.speed_knots_x1000               = (int32_t) (n ^ 0x5a5a5a) ;
+    fix.hdop_x100                       = (int32_t) (n * 7) ;
+
+    return fix ;
+}
+
+
+static bool isFixNumber (const GpsFix * fix, uint32_t * n)
+{
+    * n = (uint32_t) fix->position.latitude_minutes_x1e5 ;
+
+    GpsFix expected = fixNumber (* n) ;
+    return memcmp (fix, & expected, sizeof (GpsFix)) == 0 ;
+}
+
+
+
+static void checkInOrder (FixRing * writer, FixRing * attached)
+{
+    FixRingReader reader ;
+    fixRing_initializeReader (& reader, attached) ;
+
+    GpsFix   fix ;
+    uint64_t lost ;
+    uint32_t n ;
+
+    expect (fixRing_read (& reader, & fix, & lost) == FixRing_Empty, "empty before a fix") ;
+
+    for (uint32_t i = 1 ; i <= 3 ; i ++)
+    {
+        GpsFix published = fixNumber (i) ;
+        fixRing_publish (writer, & published) ;
+    }
+
+    bool inOrder = true ;
+    for (uint32_t i = 1 ; i <= 3 ; i ++)
+        inOrder &= (fixRing_read (& reader, & fix, & lost) == FixRing_Ok) && (lost == 0) && isFixNumber (& fix, & n) && (n == i) ;
+
+    expect (inOrder, "3 fixes read in order") ;
+    expect (fixRing_read (& reader, & fix, & lost) == FixRing_Empty, "empty once read") ;
+
+    // 20 more is lapping a ring of 8 (5 rounded up), the first 12 are lost
+    for (uint32_t i = 4 ; i <= 23 ; i ++)
+    {
+        GpsFix published = fixNumber (i) ;
+        fixRing_publish (writer, & published) ;
+    }
+
+    expect ((fixRing_read (& reader, & fix, & lost) == FixRing_Overrun) && (lost == 12) && isFixNumber (& fix, & n) && (n == 16),
+            "lapped, 12 lost, on from the oldest left") ;
+
+    inOrder = true ;
+    for (uint32_t i = 17 ; i <= 23 ; i ++)
+        inOrder &= (fixRing_read (& reader, & fix, & lost) == FixRing_Ok) && isFixNumber (& fix, & n) && (n == i) ;
+
+    expect (inOrder, "the rest of the ring in order") ;
+
+    // zero copy, and a fix overwritten while it is used
+    GpsFix published = fixNumber (24) ;
+    fixRing_publish (writer, & published) ;
+
+    const GpsFix * peeked = fixRing_peek (& reader, & lost) ;
+    expect ((peeked != NULL) && isFixNumber (peeked, & n) && (n == 24) && fixRing_release (& reader), "peeked and released") ;
+    expect (fixRing_peek (& reader, & lost) == NULL, "nothing to peek once read") ;
+
+    published = fixNumber (25) ;
+    fixRing_publish (writer, & published) ;
+    peeked = fixRing_peek (& reader, & lost) ;
+
+    for (uint32_t i = 26 ; i <= 34 ; i ++)
+    {
+        published = fixNumber (i) ;
+        fixRing_publish (writer, & published) ;
+    }
+
+    expect ((peeked != NULL) && ! fixRing_release (& reader), "a peeked fix overwritten, refused on release") ;
+}
+
+
+static void checkTorn (FixRing * writer, FixRing * attached)
+{
+    static const uint32_t Fixes = 200000 ;
+
+    FixRingReader reader ;
+    fixRing_initializeReader (& reader, attached) ;
+
+    // from 1000, after what checkInOrder () wrote
+    thread publisher ([writer] ()
+    {
+        for (uint32_t i = 1000 ; i < 1000 + Fixes ; i ++)
+        {
+            GpsFix published = fixNumber (i) ;
+            fixRing_publish (writer, & published) ;
+        }
+    }) ;
+
+    uint64_t read = 0, lostTotal = 0, torn = 0, disorder = 0 ;
+    uint32_t last = 999 ;
+    bool     done = false ;
+
+    while (! done)
+    {
+        GpsFix   fix ;
+        uint64_t lost ;
+        uint32_t n ;
+
+        FixRingStatus status = fixRing_read (& reader, & fix, & lost) ;
+        lostTotal += lost ;
+
+        if ((status == FixRing_Ok) || (status == FixRing_Overrun))
+        {
+            read ++ ;
+            torn     += ! isFixNumber (& fix, & n) ;
+            disorder += (n != last + 1 + lost) ;
+            last = n ;
+        }
+
+        done = (status == FixRing_Empty) && (last == 1000 + Fixes - 1) ;
+    }
+
+    publisher.join () ;
+
+    expect ((torn == 0) && (disorder == 0), "every fix read whole and in order under the writer") ;
+    expect (read + lostTotal == Fixes, "the fixes read and lost are the fixes written") ;
+}
+
+
+
+static uint8_t  stream [256] ;
+static size_t   streamLength ;
+
+static void addSentence (const char * body)
+{
+    uint8_t checksum = 0 ;
+    for (const char * c = body ; * c != 0 ; c ++)
+        checksum ^= (uint8_t) * c ;
+
+    streamLength += snprintf ((char *) stream + streamLength, sizeof (stream) - streamLength, "$%s*%02X\r\n", body, checksum) ;
+}
+
+
+static void checkPublishFixes (void)
+{
+    FixRing * writer   = fixRing_create (name, 16) ;
+    FixRing * attached = fixRing_attach (name) ;
+    FixRing * other    = fixRing_create ("test-fix-ring-other", 16) ;
+
+    FixRingReader reader ;
+    fixRing_initializeReader (& reader, attached) ;
+
+    host_gpio [GPS_EN_N] = 0 ;
+
+    expect (fixRing_publishFixes (writer), "publishing the fixes") ;
+    expect (fixRing_publishFixes (writer), "publishing the fixes again, to the same ring") ;
+    expect (! fixRing_publishFixes (other), "not to another ring at the same time") ;
+
+    addSentence ("GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A") ;
+    addSentence ("GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,") ;
+    addSentence ("GPGLL,4807.038,N,01131.000,E,123519.00,A,A") ;
+    nmea0183_updateFromBytes (stream, streamLength) ;
+
+    GpsFix   fix ;
+    uint64_t lost ;
+    expect ((fixRing_read (& reader, & fix, & lost) == FixRing_Ok) &&
+            (fix.position.latitude_minutes_x1e5 == 288703800) && (fix.position.longitude_minutes_x1e5 == 69100000) &&
+            (fix.altitude_cm == 54540) && (fix.time.seconds == 19),
+            "the assembled fix in the ring") ;
+
+    expect (host_gpio [GPS_EN_N] == 0, "powered while publishing") ;
+
+    fixRing_stopPublishing () ;
+    expect (host_gpio [GPS_EN_N] == 1, "powered down once publishing stops") ;
+
+    fixRing_destroy (other) ;
+    fixRing_detach (attached) ;
+    fixRing_destroy (writer) ;
+}
+
+
+
+int main ()
+{
+    snprintf (name, sizeof (name), "test-fix-ring-%d", (int) getpid ()) ;
+
+    serialPort_setDevicePath (SerialPort_GPS, "/nonexistent/ttyACM0") ;
+
+    nmea0183_initialize () ;
+    gps_initialize () ;
+
+    FixRing * writer = fixRing_create (name, 5) ;
+    expect (writer != NULL, "ring created") ;
+    expect (fixRing_attach ("test-fix-ring-nonexistent") == NULL, "no ring to attach under another name") ;
+
+    FixRing * attached = fixRing_attach (name) ;
+    expect (attached != NULL, "ring attached") ;
+
+    if ((writer == NULL) || (attached == NULL))
+        return 1 ;
+
+    checkInOrder (writer, attached) ;
+    checkTorn (writer, attached) ;
+
+    // a new writer under the name, the reader of the old ring is told, and attaches again
+    FixRingReader reader ;
+    fixRing_initializeReader (& reader, attached) ;
+
+    FixRing * restarted = fixRing_create (name, 5) ;
+
+    GpsFix   fix ;
+    uint64_t lost ;
+    expect (fixRing_read (& reader, & fix, & lost) == FixRing_Closed, "closed once a new writer replaces it") ;
+
+    fixRing_detach (attached) ;
+    fixRing_destroy (writer) ;
+    fixRing_destroy (restarted) ;
+
+    checkPublishFixes () ;
+
+    if (! failed)
+        printf ("ok: in order, lapped, torn reads refused, replaced, and gps-fix's fixes published while streaming\n") ;
+
+    return failed ? 1 : 0 ;
+}
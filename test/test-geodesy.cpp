@@ -0,0 +1,176 @@
+// distance, bearing and destination against worked answers
+//
+//      Vincenty on the published example (Vincenty 1975, Flinders Peak to Buninyong): 54972.271 m
+//      at 306 52 05.37, and the direct problem back again; equirectangular distance against
+//      Vincenty up to 50 km in every direction, within its 0.1%, its bearing and destination within
+//      the convergence of the meridians of Vincenty's, and its destination the inverse of its own
+//      distance and bearing; and both across the antimeridian, the short way round
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -I. test/test-geodesy.cpp geodesy.cpp lat-long.cpp -o test-geodesy && ./test-geodesy
+
+#include "geodesy.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+static const double Pi         = 3.14159265358979323846 ;
+static const double Degree     = 60.0 * 100000 ;        // minutes_x1e5
+
+static bool failed ;
+
+
+static void expectNear (double value, double expected, double tolerance, const char * what)
+{
+    if (fabs (value - expected) <= tolerance)
+        return ;
+
+    printf ("FAIL: %s, %.6f rather than %.6f\n", what, value, expected) ;
+    failed = true ;
+}
+
+
+static LatitudeLongitude dms (int latDegrees, int latMinutes, double latSeconds, int lonDegrees, int lonMinutes, double lonSeconds)
+{
+    // south and west by negative degrees
+    double latitude  = abs (latDegrees) * 60 + latMinutes + latSeconds / 60 ;
+    double longitude = abs (lonDegrees) * 60 + lonMinutes + lonSeconds / 60 ;
+
+    LatitudeLongitude position ;
+    position.latitude_minutes_x1e5  = (int) lround ((latDegrees < 0 ? -latitude  : latitude)  * 100000) ;
+    position.longitude_minutes_x1e5 = (int) lround ((lonDegrees < 0 ? -longitude : longitude) * 100000) ;
+
+    return position ;
+}
+
+
+
+static void checkVincenty (void)
+{
+    // the encoding is a 1.85 cm grid, so a few cm is as close as the positions themselves
+    LatitudeLongitude flindersPeak = dms (-37, 57,  3.72030, 144, 25, 29.52440) ;
+    LatitudeLongitude buninyong    = dms (-37, 39, 10.15610, 143, 55, 35.38390) ;
+
+    static const double Distance = 54972.271 ;
+    static const double Bearing  = 306 + 52.0 / 60 + 5.37 / 3600 ;
+
+    double metres, degrees ;
+    geodesy_distance (Geodesy_Vincenty, & flindersPeak, & buninyong, & metres,  1) ;
+    geodesy_bearing  (Geodesy_Vincenty, & flindersPeak, & buninyong, & degrees, 1) ;
+
+    expectNear (metres,  Distance, 0.05,   "Vincenty distance, Flinders Peak to Buninyong") ;
+    expectNear (degrees, Bearing,  0.0001, "Vincenty bearing, Flinders Peak to Buninyong") ;
+
+    float metresFloat ;
+    geodesy_distance (Geodesy_Vincenty, & flindersPeak, & buninyong, & metresFloat, 1) ;
+    expectNear (metresFloat, Distance, 0.01, "Vincenty distance in float, rounded to float") ;
+
+    LatitudeLongitude reached ;
+    geodesy_destination (Geodesy_Vincenty, & flindersPeak, & Bearing, & Distance, & reached, 1) ;
+
+    expectNear (reached. latitude_minutes_x1e5, buninyong. latitude_minutes_x1e5, 3, "Vincenty destination latitude") ;
+    expectNear (reached.longitude_minutes_x1e5, buninyong.longitude_minutes_x1e5, 3, "Vincenty destination longitude") ;
+
+    // along the equator, an arc of the semi-major axis
+    LatitudeLongitude west = { 0, (int) lround (-179.99 * Degree) } ;
+    LatitudeLongitude east = { 0, (int) lround ( 179.99 * Degree) } ;
+
+    geodesy_distance (Geodesy_Vincenty, & east, & west, & metres,  1) ;
+    geodesy_bearing  (Geodesy_Vincenty, & east, & west, & degrees, 1) ;
+
+    expectNear (metres,  6378137.0 * 0.02 * Pi / 180, 0.01, "Vincenty across the antimeridian, the short way") ;
+    expectNear (degrees, 90, 0.0001, "Vincenty bearing across the antimeridian, east") ;
+}
+
+
+static void checkEquirectangular (void)
+{
+    // 0.1 degrees north and east on the equator, and east across the antimeridian
+    LatitudeLongitude from [3] = { { 0, 0 }, { 0, 0 }, { 0, (int) lround (179.95 * Degree) } } ;
+    LatitudeLongitude to   [3] = { { (int) lround (0.1 * Degree), 0 }, { 0, (int) lround (0.1 * Degree) }, { 0, (int) lround (-179.95 * Degree) } } ;
+
+    float  metres [3], degrees [3] ;
+    double exact [3] ;
+    geodesy_distance (Geodesy_Equirectangular, from, to, metres,  3) ;
+    geodesy_bearing  (Geodesy_Equirectangular, from, to, degrees, 3) ;
+    geodesy_distance (Geodesy_Vincenty,        from, to, exact,   3) ;
+
+    expectNear (metres [0], exact [0], exact [0] * 1e-5, "equirectangular distance north") ;
+    expectNear (metres [1], exact [1], exact [1] * 1e-5, "equirectangular distance east") ;
+    expectNear (metres [2], exact [2], exact [2] * 1e-5, "equirectangular distance across the antimeridian") ;
+
+    expectNear (degrees [0],  0, 0.001, "equirectangular bearing north") ;
+    expectNear (degrees [1], 90, 0.001, "equirectangular bearing east") ;
+    expectNear (degrees [2], 90, 0.001, "equirectangular bearing east across the antimeridian") ;
+
+    // at 45 and 70 degrees over 5 and 50 km, in every direction, where a sphere of the mean radius
+    //      is out by 0.3% east-west
+    static const double Latitudes [2] = { 45, 70 } ;
+    static const double Ranges    [2] = { 5000, 50000 } ;
+
+    for (double latitude : Latitudes)
+    {
+        for (double range : Ranges)
+        {
+            LatitudeLongitude origin = { (int) lround (latitude * Degree), (int) lround (7 * Degree) } ;
+            LatitudeLongitude origins [8], points [8], reached [8] ;
+            double bearings [8], distances [8], exactDistances [8] ;
+
+            for (int i = 0 ; i < 8 ; i ++)
+            {
+                origins   [i] = origin ;
+                bearings  [i] = i * 45 ;
+                distances [i] = range ;
+            }
+
+            geodesy_destination  (Geodesy_Vincenty, origins, bearings, distances, points, 8) ;
+            geodesy_distanceFrom (Geodesy_Vincenty, & origin, points, exactDistances, 8) ;
+
+            float flat [8], flatBearings [8] ;
+            geodesy_distanceFrom (Geodesy_Equirectangular, & origin, points, flat, 8) ;
+            geodesy_bearing      (Geodesy_Equirectangular, origins, points, flatBearings, 8) ;
+
+            // the grid line turns from the geodesic by half the convergence of the meridians
+            double convergence = range * tan (latitude * Pi / 180) / (2 * 6371000) ;
+
+            for (int i = 0 ; i < 8 ; i ++)
+            {
+                expectNear (flat [i], exactDistances [i], range * 0.001, "equirectangular distance against Vincenty") ;
+                expectNear (fmod (flatBearings [i] - bearings [i] + 540, 360) - 180, 0, 1.1 * convergence * 180 / Pi + 0.001,
+                            "equirectangular bearing against Vincenty") ;
+            }
+
+            // and so its destination ends up across the track from Vincenty's by as much again
+            geodesy_destination (Geodesy_Equirectangular, origins, bearings, distances, reached, 8) ;
+            geodesy_distance    (Geodesy_Vincenty, points, reached, exactDistances, 8) ;
+
+            for (int i = 0 ; i < 8 ; i ++)
+                expectNear (exactDistances [i], 0, 1.1 * convergence * range + range * 0.001, "equirectangular destination against Vincenty") ;
+        }
+    }
+
+    // its own destination is the inverse of its distance and bearing, to the grid
+    LatitudeLongitude reached [3] ;
+    geodesy_destination (Geodesy_Equirectangular, from, degrees, metres, reached, 3) ;
+
+    for (int i = 0 ; i < 3 ; i ++)
+    {
+        expectNear (reached [i]. latitude_minutes_x1e5, to [i]. latitude_minutes_x1e5, 2, "equirectangular destination latitude") ;
+        expectNear (reached [i].longitude_minutes_x1e5, to [i].longitude_minutes_x1e5, 2, "equirectangular destination longitude") ;
+    }
+}
+
+
+int main ()
+{
+    checkVincenty () ;
+    checkEquirectangular () ;
+
+    if (! failed)
+        printf ("ok: Vincenty's example and its inverse, equirectangular against Vincenty, the antimeridian\n") ;
+
+    return failed ? 1 : 0 ;
+}
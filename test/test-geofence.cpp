@@ -0,0 +1,303 @@
+// enter and exit events, for fences at every level of the grid, and the receiver kept streaming
+//
+//      a walk in and out of a circle, a square and a 10 degree polygon gives each event once, in
+//      order, and nothing while the position stays put or isn't valid; 400 random circles of 50 m
+//      to 200 km, on a random walk, are never missed nor left early by more than 1% of a radius
+//      (the fences are on the sphere, the check on the ellipsoid); fences load from a file, and
+//      loading stops at a malformed line; enabled, the receiver streams until disabled
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-geofence.cpp test/host/host.cpp geofence.cpp geodesy.cpp
+//              gps.cpp gps-device.cpp gps-power.cpp nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp
+//              position-filter.cpp lat-long.cpp capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp
+//              ubx.cpp time-source.cpp -o test-geofence && ./test-geofence
+
+#include "geodesy.hpp"
+#include "geofence.hpp"
+#include "gps.hpp"
+#include "main-cm4-task.h"
+#include "nmea0183.hpp"
+
+#include <set>
+#include <vector>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const int32_t  Degree  = 60 * 100000 ;       // minutes_x1e5
+static const int32_t  Chicago [2] = { 251338633, -526635785 } ;
+
+typedef struct
+{
+    uint32_t        fenceId ;
+    GeofenceEvent   event ;
+} Event ;
+
+static vector <Event>   events ;
+static set <uint32_t>   inside ;                    // as the events have it
+static bool             failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static uint32_t random32 (void)
+{
+    static uint32_t state = 88675123u ;
+
+    state ^= state << 13 ;
+    state ^= state >> 17 ;
+    state ^= state <<  5 ;
+
+    return state ;
+}
+
+
+static void onEvent (uint32_t fenceId, GeofenceEvent event, const GpsFix *)
+{
+    events.push_back ({ fenceId, event }) ;
+
+    if (event == Geofence_Enter)
+        inside.insert (fenceId) ;
+    else
+        inside.erase (fenceId) ;
+}
+
+
+static void at (int64_t latitude, int64_t longitude, bool valid = true)
+{
+    GpsFix fix ;
+    memset (& fix, 0, sizeof (fix)) ;
+
+    fix.positionValid = valid ;
+    fix.position.latitude_minutes_x1e5  = (int) latitude ;
+    fix.position.longitude_minutes_x1e5 = (int) longitude ;
+    fix.smoothedPosition = fix.position ;
+
+    geofence_update (& fix) ;
+}
+
+
+static void expectEvents (const vector <Event> & expected, const char * what)
+{
+    bool same = events.size () == expected.size () ;
+
+    for (size_t i = 0 ; same && (i < expected.size ()) ; i ++)
+        same = (events [i].fenceId == expected [i].fenceId) && (events [i].event == expected [i].event) ;
+
+    if (! same)
+    {
+        printf ("FAIL: %s, %zu events:", what, events.size ()) ;
+        for (const Event & event : events)
+            printf (" %s %u", (event.event == Geofence_Enter) ? "enter" : "exit", event.fenceId) ;
+        printf ("\n") ;
+
+        failed = true ;
+    }
+
+    events.clear () ;
+}
+
+
+
+static void checkWalk (void)
+{
+    // a 1 km circle on Chicago, a 2 km square north of it, and a polygon across the whole area
+    LatitudeLongitude centre = { Chicago [0], Chicago [1] } ;
+
+    int32_t k = 54000 ;                 // 1 km of latitude, near enough
+    int32_t n = Chicago [0] + 3 * k ;
+    int32_t w = Chicago [1] ;
+
+    LatitudeLongitude square [4] = { { n, w }, { n + 2 * k, w }, { n + 2 * k, w + 3 * k }, { n, w + 3 * k } } ;
+    LatitudeLongitude area   [5] = { { 38 * Degree, -93 * Degree }, { 48 * Degree, -93 * Degree }, { 48 * Degree, -83 * Degree },
+                                     { 43 * Degree, -80 * Degree }, { 38 * Degree, -83 * Degree } } ;
+
+    expect (geofence_addCircle  (1, & centre, 1000), "circle added") ;
+    expect (geofence_addPolygon (2, square, 4), "square added") ;
+    expect (geofence_addPolygon (3, area, 5), "polygon added") ;
+
+    expect (! geofence_addCircle  (4, & centre, 0), "a circle of no radius refused") ;
+    expect (! geofence_addPolygon (4, square, 2), "a polygon of two vertices refused") ;
+
+    at (30 * Degree, -90 * Degree) ;
+    expectEvents ({}, "far away") ;
+
+    at (Chicago [0] - 2 * k, Chicago [1]) ;
+    expectEvents ({ { 3, Geofence_Enter } }, "into the area") ;
+
+    at (Chicago [0], Chicago [1]) ;
+    at (Chicago [0], Chicago [1]) ;
+    at (0, 0, false) ;
+    expectEvents ({ { 1, Geofence_Enter } }, "into the circle, once, and an invalid fix ignored") ;
+
+    at (n + k, w + k) ;
+    expectEvents ({ { 1, Geofence_Exit }, { 2, Geofence_Enter } }, "out of the circle and into the square") ;
+
+    at (n - 100, w + k) ;
+    expectEvents ({ { 2, Geofence_Exit } }, "out of the square by a few metres") ;
+
+    at (50 * Degree, -85 * Degree) ;
+    expectEvents ({ { 3, Geofence_Exit } }, "out of the area") ;
+
+    geofence_clear () ;
+    at (Chicago [0], Chicago [1]) ;
+    expectEvents ({}, "no fences once cleared") ;
+
+    inside.clear () ;
+}
+
+
+static void checkRandom (void)
+{
+    // circles from 50 m to 200 km, so every level has some, around 45 N 7 E
+    static const uint32_t Fences = 400 ;
+    static const uint32_t Steps  = 3000 ;
+
+    LatitudeLongitude centres [Fences] ;
+    float             radii   [Fences] ;
+
+    for (uint32_t id = 0 ; id < Fences ; id ++)
+    {
+        centres [id].latitude_minutes_x1e5  = 45 * Degree + (int32_t) (random32 () % (4 * Degree)) - 2 * Degree ;
+        centres [id].longitude_minutes_x1e5 =  7 * Degree + (int32_t) (random32 () % (4 * Degree)) - 2 * Degree ;
+
+        radii [id] = 50 * powf (4000, (float) (random32 () % 1000) / 1000) ;
+
+        geofence_addCircle (id, & centres [id], radii [id]) ;
+    }
+
+    LatitudeLongitude position = { 45 * Degree, 7 * Degree } ;
+    uint32_t missed = 0, early = 0, entered = 0 ;
+
+    for (uint32_t step = 0 ; step < Steps ; step ++)
+    {
+        // mostly short steps, now and then a jump
+        int32_t reach = (step % 50) ? 2000 : 100000 ;
+
+        position.latitude_minutes_x1e5  += (int32_t) (random32 () % (2 * reach + 1)) - reach ;
+        position.longitude_minutes_x1e5 += (int32_t) (random32 () % (2 * reach + 1)) - reach ;
+
+        position.latitude_minutes_x1e5  = max (43 * Degree, min (47 * Degree, position.latitude_minutes_x1e5)) ;
+        position.longitude_minutes_x1e5 = max ( 5 * Degree, min ( 9 * Degree, position.longitude_minutes_x1e5)) ;
+
+        at (position.latitude_minutes_x1e5, position.longitude_minutes_x1e5) ;
+
+        float metres [Fences] ;
+        LatitudeLongitude here [Fences] ;
+        fill (here, here + Fences, position) ;
+        geodesy_distance (Geodesy_Equirectangular, centres, here, metres, Fences) ;
+
+        for (uint32_t id = 0 ; id < Fences ; id ++)
+        {
+            bool in = inside.count (id) != 0 ;
+
+            missed += (metres [id] < radii [id] * 0.99f) && ! in ;
+            early  += (metres [id] > radii [id] * 1.01f) &&   in ;
+        }
+
+        entered += inside.size () ;
+    }
+
+    expect (entered > Steps, "the walk spends time in the fences") ;
+
+    if ((missed != 0) || (early != 0))
+    {
+        printf ("FAIL: random fences, %u times not inside one, %u times still inside one\n", missed, early) ;
+        failed = true ;
+    }
+
+    geofence_clear () ;
+    events.clear () ;
+    inside.clear () ;
+}
+
+
+static void checkLoad (void)
+{
+    char path [64] ;
+    snprintf (path, sizeof (path), "/tmp/test-geofence-%d", (int) getpid ()) ;
+
+    FILE * file = fopen (path, "w") ;
+    fprintf (file, "# two fences\n\n"
+                   "circle 7 500 41 53.38633 N, 087 46.35785 W\n"
+                   "polygon 8 41 50.0 N, 087 50.0 W ; 41 50.0 N, 087 40.0 W ; 41 55.0 N, 087 45.0 W\n") ;
+    fclose (file) ;
+
+    expect (geofence_load (path), "fences loaded from a file") ;
+
+    at (Chicago [0], Chicago [1]) ;
+    expectEvents ({ { 7, Geofence_Enter }, { 8, Geofence_Enter } }, "in both fences loaded") ;
+
+    geofence_clear () ;
+
+    file = fopen (path, "w") ;
+    fprintf (file, "circle 9 500 41 53.38633 N, 087 46.35785 W\n"
+                   "circle 10 -5 41 53.38633 N, 087 46.35785 W\n"
+                   "circle 11 500 41 53.38633 N, 087 46.35785 W\n") ;
+    fclose (file) ;
+
+    expect (! geofence_load (path), "a malformed line fails the load") ;
+
+    at (Chicago [0] + 1, Chicago [1]) ;
+    expectEvents ({ { 9, Geofence_Enter } }, "only the fences before the malformed line") ;
+
+    expect (! geofence_load ("/nonexistent/fences"), "a missing file fails the load") ;
+
+    geofence_clear () ;
+    inside.clear () ;
+    unlink (path) ;
+}
+
+
+static void checkStreaming (void)
+{
+    // the receiver's enable line goes high (off) once nothing needs it any more
+    host_gpio [GPS_EN_N] = 0 ;
+
+    expect (geofence_enable (), "enabled") ;
+    expect (geofence_enable (), "enabled again") ;
+    expect (host_gpio [GPS_EN_N] == 0, "powered while enabled") ;
+
+    geofence_disable () ;
+    expect (host_gpio [GPS_EN_N] == 1, "powered down once disabled, enabling twice counted once") ;
+
+    geofence_disable () ;
+}
+
+
+
+int main ()
+{
+    // nothing there, so the reader only retries
+    serialPort_setDevicePath (SerialPort_GPS, "/nonexistent/ttyACM0") ;
+
+    nmea0183_initialize () ;
+    gps_initialize () ;
+
+    expect (geofence_subscribe (onEvent), "subscribed") ;
+
+    checkWalk () ;
+    checkRandom () ;
+    checkLoad () ;
+    checkStreaming () ;
+
+    geofence_unsubscribe (onEvent) ;
+
+    if (! failed)
+        printf ("ok: events walking in and out, 400 random fences, loaded from a file, streaming while enabled\n") ;
+
+    return failed ? 1 : 0 ;
+}
@@ -0,0 +1,302 @@
+// the shared memory refclock, and gps-clock's samples through it, read back as ntpd reads them
+//
+//      ntp-shm: nothing to read before a sample, a sample reads back whole (ns included) and only
+//      once, a writer caught mid-sample (odd count) is refused, and with a writer publishing flat
+//      out on another thread every sample read is one the writer wrote, never two halves (which
+//      takes more than one core to put to the test)
+//      gps-clock: with the receiver on a pty, an RMC epoch and a NAV-PVT epoch each give one
+//      sample, at the receiver's time and the epoch's arrival less the delay, at their precision;
+//      disabled, the receiver is powered down
+//
+//      it uses SHM unit 3, and says so and passes without running if a time server has it
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-gps-clock.cpp test/host/host.cpp gps-clock.cpp
+//              ntp-shm.cpp gps.cpp gps-device.cpp gps-power.cpp nmea0183.cpp nmea-sentence.cpp gps-fix.cpp
+//              satellite-table.cpp position-filter.cpp lat-long.cpp capture.cpp event-log.cpp metrics.cpp
+//              serial-tx.cpp ubx-tx.cpp ubx.cpp time-source.cpp -o test-gps-clock && ./test-gps-clock
+
+#include "gps.hpp"
+#include "gps-clock.hpp"
+#include "main-cm4-task.h"
+#include "nmea0183.hpp"
+#include "ntp-shm.hpp"
+#include "ubx.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const uint8_t    Unit   = 3 ;
+static const key_t      ShmKey = 0x4E545030 + Unit ;
+
+// ntpd's layout (refclock_shm.c), to play the writer caught in the middle
+typedef struct
+{
+    int             mode ;
+    volatile int    count ;
+    time_t          clockTimeStampSec ;
+    int             clockTimeStampUSec ;
+    time_t          receiveTimeStampSec ;
+    int             receiveTimeStampUSec ;
+    int             leap ;
+    int             precision ;
+    int             nsamples ;
+    volatile int    valid ;
+    unsigned        clockTimeStampNSec ;
+    unsigned        receiveTimeStampNSec ;
+    int             dummy [8] ;
+} ShmTime ;
+
+static bool failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static NtpShmSample sampleOf (time_t second, long nanoseconds)
+{
+    // each field from the one number, so a sample made of two is seen
+    NtpShmSample sample ;
+
+    sample.clock.tv_sec    = second ;
+    sample.clock.tv_nsec   = nanoseconds ;
+    sample.receive.tv_sec  = second + 1 ;
+    sample.receive.tv_nsec = nanoseconds ;
+    sample.leap            = (int) (second % 3) ;
+    sample.precision       = - (int) (second % 20) ;
+
+    return sample ;
+}
+
+
+static bool whole (const NtpShmSample * sample)
+{
+    NtpShmSample expected = sampleOf (sample->clock.tv_sec, sample->clock.tv_nsec) ;
+
+    return (sample->receive.tv_sec  == expected.receive.tv_sec) &&
+           (sample->receive.tv_nsec == expected.receive.tv_nsec) &&
+           (sample->leap            == expected.leap) &&
+           (sample->precision       == expected.precision) ;
+}
+
+
+
+static void checkProtocol (void)
+{
+    NtpShmSample sample ;
+
+    expect (! ntpShm_read (Unit, & sample), "nothing to read before the segment exists") ;
+    expect (ntpShm_open (Unit), "segment created") ;
+    expect (! ntpShm_read (Unit, & sample), "nothing to read before a sample") ;
+
+    NtpShmSample written = sampleOf (1589299200, 123456789) ;
+    ntpShm_publish (Unit, & written) ;
+
+    memset (& sample, 0, sizeof (sample)) ;
+    expect (ntpShm_read (Unit, & sample), "a sample read") ;
+    expect ((sample.clock.tv_sec == written.clock.tv_sec) && (sample.clock.tv_nsec == written.clock.tv_nsec) && whole (& sample),
+            "the sample read back whole, to the ns") ;
+    expect (! ntpShm_read (Unit, & sample), "a sample read only once") ;
+
+    // mode 1, and a writer in the middle of a sample: count is odd until it is done
+    ShmTime * shm = (ShmTime *) shmat (shmget (ShmKey, sizeof (ShmTime), 0), NULL, 0) ;
+    expect (shm->mode == 1, "mode 1, the count protocol") ;
+
+    ntpShm_publish (Unit, & written) ;
+    shm->count = shm->count + 1 ;
+    expect (! ntpShm_read (Unit, & sample), "a sample refused while the writer is busy") ;
+
+    shm->count = shm->count + 1 ;
+    ntpShm_publish (Unit, & written) ;
+    expect (ntpShm_read (Unit, & sample), "a sample once the writer is done") ;
+
+    shmdt ((void *) shm) ;
+
+    // a writer on another thread, flat out
+    atomic <bool> writing (true) ;
+
+    thread writer ([& writing] ()
+    {
+        for (uint32_t i = 1 ; writing ; i ++)
+        {
+            NtpShmSample next = sampleOf (1589299200 + i, (long) (i * 7919) % 1000000000) ;
+            ntpShm_publish (Unit, & next) ;
+        }
+    }) ;
+
+    uint32_t reads = 0, torn = 0 ;
+
+    for (auto end = chrono::steady_clock::now () + chrono::milliseconds (300) ; chrono::steady_clock::now () < end ; )
+    {
+        if (ntpShm_read (Unit, & sample))
+        {
+            reads ++ ;
+            torn += ! whole (& sample) ;
+        }
+    }
+
+    writing = false ;
+    writer.join () ;
+
+    expect (reads > 0, "samples read while the writer runs") ;
+
+    if (torn != 0)
+    {
+        printf ("FAIL: %u of %u samples read were torn\n", torn, reads) ;
+        failed = true ;
+    }
+
+    ntpShm_close (Unit) ;
+}
+
+
+
+static void writeSentence (int master, const char * body)
+{
+    uint8_t checksum = 0 ;
+    for (const char * c = body ; * c != 0 ; c ++)
+        checksum ^= (uint8_t) * c ;
+
+    char sentence [128] ;
+    int length = snprintf (sentence, sizeof (sentence), "$%s*%02X\r\n", body, checksum) ;
+
+    expect (write (master, sentence, length) == length, "sentence written to the pty") ;
+}
+
+
+static void writeNavPvt (int master, uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second,
+                         int32_t nano, uint32_t accuracy_ns)
+{
+    uint8_t payload [92] ;
+    memset (payload, 0, sizeof (payload)) ;
+
+    payload [4]  = (uint8_t) year ;
+    payload [5]  = (uint8_t) (year >> 8) ;
+    payload [6]  = month ;
+    payload [7]  = day ;
+    payload [8]  = hour ;
+    payload [9]  = minute ;
+    payload [10] = second ;
+    payload [11] = 0x07 ;                       // validDate, validTime, fullyResolved
+    memcpy (payload + 12, & accuracy_ns, 4) ;   // little endian, as the host
+    memcpy (payload + 16, & nano, 4) ;
+
+    uint8_t frame [sizeof (payload) + 8] ;
+    uint16_t length = ubx_frame (frame, UbxClass_NAV, 0x07, payload, sizeof (payload)) ;
+
+    expect (write (master, frame, length) == length, "NAV-PVT written to the pty") ;
+}
+
+
+static bool awaitSample (NtpShmSample * sample)
+{
+    for (int i = 0 ; i < 400 ; i ++)
+    {
+        if (ntpShm_read (Unit, sample))
+            return true ;
+
+        this_thread::sleep_for (chrono::milliseconds (5)) ;
+    }
+
+    return false ;
+}
+
+
+static void checkClock (void)
+{
+    int master = posix_openpt (O_RDWR | O_NOCTTY | O_NONBLOCK) ;
+    expect ((master >= 0) && (grantpt (master) == 0) && (unlockpt (master) == 0), "a pty for the receiver") ;
+    serialPort_setDevicePath (SerialPort_GPS, ptsname (master)) ;
+
+    host_gpio [GPS_EN_N] = 0 ;
+
+    gpsClock_setDelay_ns (5000000) ;
+    expect (gpsClock_enable (Unit), "enabled") ;
+
+    int64_t latency ;
+    expect (! gpsClock_getLatency_ns (& latency), "no latency before a sample") ;
+
+    // the reader opens the pty once streaming starts
+    this_thread::sleep_for (chrono::milliseconds (200)) ;
+
+    // an RMC epoch, 1994-03-23 12:35:19.50
+    NtpShmSample sample ;
+    struct timespec before ;
+    clock_gettime (CLOCK_REALTIME, & before) ;
+
+    writeSentence (master, "GPRMC,123519.50,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A") ;
+
+    expect (awaitSample (& sample), "a sample from the RMC epoch") ;
+    expect ((sample.clock.tv_sec == 764426119) && (sample.clock.tv_nsec == 500000000), "at the RMC's time") ;
+    expect ((sample.precision == -6) && (sample.leap == 0), "at NMEA precision, no leap warning") ;
+    expect ((sample.receive.tv_sec >= before.tv_sec - 1) && (sample.receive.tv_sec <= before.tv_sec + 2), "received about now") ;
+    expect (gpsClock_getLatency_ns (& latency), "a latency once there is a sample") ;
+
+    // the rest of the epoch doesn't give another
+    writeSentence (master, "GPRMC,123519.50,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A") ;
+    this_thread::sleep_for (chrono::milliseconds (20)) ;
+    expect (! ntpShm_read (Unit, & sample), "one sample an epoch") ;
+
+    // a NAV-PVT epoch after the gap, 2030-01-01 00:00:00 less 0.25 s at 100 ms accuracy
+    //      so late in gps time its latency is the least, arrival = gps time + latency
+    this_thread::sleep_for (chrono::milliseconds (100)) ;
+    writeNavPvt (master, 2030, 1, 1, 0, 0, 0, -250000000, 100000000) ;
+
+    expect (awaitSample (& sample), "a sample from the NAV-PVT epoch") ;
+    expect ((sample.clock.tv_sec == 1893455999) && (sample.clock.tv_nsec == 750000000), "at the NAV-PVT's time, ns and all") ;
+    expect (sample.precision == -3, "at the accuracy NAV-PVT gives, 2^-3 s") ;
+
+    expect (gpsClock_getLatency_ns (& latency), "the latency of the NAV-PVT epoch") ;
+
+    int64_t arrival_ns = (int64_t) sample.clock.tv_sec * 1000000000 + sample.clock.tv_nsec + latency ;
+    int64_t receive_ns = (int64_t) sample.receive.tv_sec * 1000000000 + sample.receive.tv_nsec ;
+    expect (receive_ns == arrival_ns - 5000000, "received at the arrival less the delay") ;
+
+    gpsClock_disable () ;
+    expect (host_gpio [GPS_EN_N] == 1, "powered down once disabled") ;
+
+    close (master) ;
+}
+
+
+
+int main ()
+{
+    if (shmget (ShmKey, 0, 0) >= 0)
+    {
+        printf ("ok: not run, SHM unit %u is there already, a time server may be using it\n", Unit) ;
+        return 0 ;
+    }
+
+    nmea0183_initialize () ;
+    gps_initialize () ;
+
+    checkProtocol () ;
+    checkClock () ;
+
+    shmctl (shmget (ShmKey, 0, 0), IPC_RMID, NULL) ;
+
+    if (! failed)
+        printf ("ok: samples read back whole and once, none torn, RMC and NAV-PVT epochs exported, powered down\n") ;
+
+    return failed ? 1 : 0 ;
+}
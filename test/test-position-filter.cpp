@@ -0,0 +1,148 @@
+// the smoothed position, for a receiver standing still and for one crossing the antimeridian
+//
+//      standing still the smoothed position is the fix, exactly, every second
+//      crossing the antimeridian eastward and westward, with the velocity estimated by the filter
+//      and with the receiver's own (RMC) speed and course, the smoothed longitude stays within a
+//      few tens of metres of the track, on the right side of it, rather than jumping by a circle
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -Itest/host -I. test/test-position-filter.cpp position-filter.cpp lat-long.cpp
+//              -o test-position-filter && ./test-position-filter
+
+#include "lat-long.hpp"
+#include "position-filter.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static const int32_t  Degree = 60 * 100000 ;        // minutes_x1e5
+static const int32_t  Chicago [2] = { 251338633, -526635785 } ;      // 41 53.38633 N, 087 46.35785 W
+
+static bool failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static GpsFix fixAt (uint32_t second, int32_t latitude, int32_t longitude, int32_t speed_knots_x1000, int32_t course_degrees_x100)
+{
+    GpsFix fix ;
+    memset (& fix, 0, sizeof (fix)) ;
+
+    fix.time.hours   = 12 ;
+    fix.time.minutes = second / 60 ;
+    fix.time.seconds = second % 60 ;
+    fix.time.valid   = true ;
+
+    fix.positionValid                   = true ;
+    fix.position.latitude_minutes_x1e5  = latitude ;
+    fix.position.longitude_minutes_x1e5 = longitude ;
+
+    fix.speed_knots_x1000   = speed_knots_x1000 ;
+    fix.course_degrees_x100 = course_degrees_x100 ;
+
+    return fix ;
+}
+
+
+static void checkWrap (void)
+{
+    expect (latitudeLongitude_wrapLongitude (0) == 0, "0 stays 0") ;
+    expect (latitudeLongitude_wrapLongitude (180ll * Degree) == 180 * Degree, "+180 stays +180") ;
+    expect (latitudeLongitude_wrapLongitude (181ll * Degree) == -179 * Degree, "+181 is -179") ;
+    expect (latitudeLongitude_wrapLongitude (-181ll * Degree) == 179 * Degree, "-181 is +179") ;
+    expect (latitudeLongitude_wrapLongitude (359ll * Degree) == -1 * Degree, "a difference of 359 is -1") ;
+    expect (latitudeLongitude_wrapLongitude (-719ll * Degree) == 1 * Degree, "-719 is +1") ;
+}
+
+
+static void checkStationary (void)
+{
+    PositionFilter filter ;
+    positionFilter_initialize (& filter, 64, 8) ;
+
+    bool exact = true ;
+
+    for (uint32_t second = 0 ; second < 60 ; second ++)
+    {
+        GpsFix fix = fixAt (second, Chicago [0], Chicago [1], -1, -1) ;
+        LatitudeLongitude smoothed ;
+
+        exact &= positionFilter_update (& filter, & fix, & smoothed) &&
+                 (smoothed.latitude_minutes_x1e5  == Chicago [0]) &&
+                 (smoothed.longitude_minutes_x1e5 == Chicago [1]) ;
+    }
+
+    expect (exact, "standing still, the smoothed position is the fix") ;
+}
+
+
+static void checkCrossing (int32_t step, bool withVelocity, const char * what)
+{
+    // step minutes_x1e5 of longitude a second along the equator, from 10 s short of the antimeridian
+    //      an estimated velocity lags by about two steps while it settles, the receiver's doesn't
+    int32_t maxError = withVelocity ? 10 : 5 * abs (step) / 2 ;
+
+    PositionFilter filter ;
+    positionFilter_initialize (& filter, 64, 8) ;
+
+    // 1 minute_x1e5 a second is 0.036 knots on the equator
+    int32_t speed_knots_x1000   = withVelocity ? abs (step) * 36 : -1 ;
+    int32_t course_degrees_x100 = withVelocity ? ((step > 0) ? 9000 : 27000) : -1 ;
+
+    int64_t start = (step > 0) ? 180ll * Degree - 10 * step : -180ll * Degree - 10 * step ;
+
+    int32_t worst = 0 ;
+    bool    inRange = true ;
+
+    for (uint32_t second = 0 ; second < 30 ; second ++)
+    {
+        int32_t longitude = latitudeLongitude_wrapLongitude (start + (int64_t) second * step) ;
+
+        GpsFix fix = fixAt (second, 0, longitude, speed_knots_x1000, course_degrees_x100) ;
+        LatitudeLongitude smoothed ;
+
+        positionFilter_update (& filter, & fix, & smoothed) ;
+
+        int32_t error = latitudeLongitude_wrapLongitude ((int64_t) smoothed.longitude_minutes_x1e5 - longitude) ;
+
+        if (abs (error) > worst)
+            worst = abs (error) ;
+
+        inRange &= (smoothed.longitude_minutes_x1e5 >= -180 * Degree) && (smoothed.longitude_minutes_x1e5 <= 180 * Degree) ;
+    }
+
+    if ((worst <= maxError) && inRange)
+        return ;
+
+    printf ("FAIL: %s, %d minutes_x1e5 from the track at worst\n", what, worst) ;
+    failed = true ;
+}
+
+
+
+int main ()
+{
+    checkWrap () ;
+    checkStationary () ;
+
+    checkCrossing ( 1000, false, "eastward across the antimeridian, estimated velocity") ;
+    checkCrossing (-1000, false, "westward across the antimeridian, estimated velocity") ;
+    checkCrossing ( 1000, true,  "eastward across the antimeridian, receiver velocity") ;
+    checkCrossing (-1000, true,  "westward across the antimeridian, receiver velocity") ;
+
+    if (! failed)
+        printf ("ok: longitude wraps, stationary fix unchanged, antimeridian crossed both ways\n") ;
+
+    return failed ? 1 : 0 ;
+}
@@ -0,0 +1,314 @@
+// the position track's predictions, against the motion that made its fixes
+//
+//      fixes once a second, exact and with RMC speed and course, of a car at constant velocity and
+//      one accelerating (both east across the antimeridian), and one turning hard: between fixes
+//      and up to 10 s after the newest, the true position is within the error bound less the
+//      fixes' own error (at constant velocity, within a few cm and cm/s); past that, before the
+//      fixes kept, and ahead of a fix with no velocity, there is no estimate; a velocity comes
+//      from the positions when RMC gives none; and recording what gps-fix assembles, at the RMC's
+//      time, keeps the receiver streaming until it stops
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-position-track.cpp test/host/host.cpp position-track.cpp
+//              gps.cpp gps-device.cpp gps-power.cpp nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp
+//              position-filter.cpp lat-long.cpp capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp
+//              ubx.cpp time-source.cpp -o test-position-track && ./test-position-track
+
+#include "gps.hpp"
+#include "main-cm4-task.h"
+#include "nmea0183.hpp"
+#include "position-track.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+using namespace std;
+
+
+
+static const int64_t    Start_ms = 1589299200000ll ;            // 2020-05-12 16:00:00 UTC
+static const int64_t    FullCircle_x1e5 = 360ll * 60 * 100000 ;
+
+// 45 N, 300 m west of the antimeridian, crossed after 15 to 18 s
+static const double     OriginLatitude_x1e5  = 45 * 60 * 100000.0 ;
+static const double     MetresPerNorth       = 1852.0 / 100000 ;
+static const double     MetresPerEast        = MetresPerNorth * M_SQRT1_2 ;
+static const double     OriginLongitude_x1e5 = 180 * 60 * 100000.0 - 300 / MetresPerEast ;
+
+// a fix is rounded to 1.85 cm, an estimate too
+static const double     Rounding_m = 0.03 ;
+
+static bool             failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static int64_t wrap (int64_t longitude)
+{
+    while (longitude >   FullCircle_x1e5 / 2)   longitude -= FullCircle_x1e5 ;
+    while (longitude <= -FullCircle_x1e5 / 2)   longitude += FullCircle_x1e5 ;
+
+    return longitude ;
+}
+
+
+
+typedef struct
+{
+    double  north_m, east_m ;
+    double  velocityNorth_m_s, velocityEast_m_s ;
+} State ;
+
+typedef State (* Motion) (double t) ;
+
+
+static State steady (double t)
+{
+    // 20 m/s on a course of 60 degrees
+    return { 10 * t, 17.320508 * t, 10, 17.320508 } ;
+}
+
+
+static State accelerating (double t)
+{
+    // from 5 m/s east, 2 m/s2 east and 1 m/s2 north
+    return { 0.5 * t * t, 5 * t + t * t, t, 5 + 2 * t } ;
+}
+
+
+static State turning (double t)
+{
+    // 10 m/s round a circle of 50 m, 2 m/s2 towards its centre, starting east
+    double w = 10.0 / 50 ;
+    return { 50 - 50 * cos (w * t), 50 * sin (w * t), 10 * sin (w * t), 10 * cos (w * t) } ;
+}
+
+
+static LatitudeLongitude positionOf (const State * state)
+{
+    LatitudeLongitude position ;
+    position.latitude_minutes_x1e5  = llround (OriginLatitude_x1e5 + state->north_m / MetresPerNorth) ;
+    position.longitude_minutes_x1e5 = wrap (llround (OriginLongitude_x1e5 + state->east_m / MetresPerEast)) ;
+
+    return position ;
+}
+
+
+static double metresBetween (const LatitudeLongitude * a, const LatitudeLongitude * b)
+{
+    double north = ((int64_t) a->latitude_minutes_x1e5 - b->latitude_minutes_x1e5) * MetresPerNorth ;
+    double east  = wrap ((int64_t) a->longitude_minutes_x1e5 - b->longitude_minutes_x1e5) * MetresPerEast ;
+
+    return hypot (north, east) ;
+}
+
+
+static GpsFix fixOf (const State * state, bool withVelocity)
+{
+    GpsFix fix ;
+    memset (& fix, 0, sizeof (fix)) ;
+
+    double speed  = hypot (state->velocityNorth_m_s, state->velocityEast_m_s) ;
+    double course = atan2 (state->velocityEast_m_s, state->velocityNorth_m_s) * 180 / M_PI ;
+
+    fix.positionValid       = true ;
+    fix.position            = positionOf (state) ;
+    fix.speed_knots_x1000   = withVelocity ? (int32_t) lround (speed * 3600 / 1852 * 1000) : -1 ;
+    fix.course_degrees_x100 = withVelocity ? (int32_t) lround (fmod (course + 360, 360) * 100) : -1 ;
+    fix.hdop_x100           = 100 ;
+
+    return fix ;
+}
+
+
+
+static void checkMotion (const char * name, Motion motion, float maxAcceleration, double tight_m)
+{
+    // tight_m, if not 0, is how close the estimates should be, not only within the bound
+    PositionTrack * track = positionTrack_create (maxAcceleration) ;
+    PositionEstimate estimate ;
+
+    expect (! positionTrack_at (track, Start_ms, & estimate), "no estimate without a fix") ;
+
+    for (int second = 0 ; second <= 20 ; second ++)
+    {
+        State state = motion (second) ;
+        GpsFix fix  = fixOf (& state, true) ;
+        positionTrack_add (track, & fix, Start_ms + second * 1000) ;
+    }
+
+    // the fixes' own error, which these don't have
+    const double FixError_m = PositionTrack_Uere_m ;
+
+    double worst = 0, worstVelocity = 0 ;
+    bool   within = true ;
+
+    for (int64_t ms = 13000 ; ms <= 20000 + PositionTrack_MaxExtrapolation_ms ; ms += 125)
+    {
+        State truth = motion (ms / 1000.0) ;
+        LatitudeLongitude position = positionOf (& truth) ;
+
+        if (! positionTrack_at (track, Start_ms + ms, & estimate))
+        {
+            printf ("FAIL: %s, no estimate at %.3f s\n", name, ms / 1000.0) ;
+            failed = true ;
+            continue ;
+        }
+
+        double error = metresBetween (& estimate.position, & position) ;
+
+        if (error > estimate.error_m - FixError_m + Rounding_m)
+        {
+            printf ("FAIL: %s at %.3f s, %.3f m off, beyond the bound of %.3f m\n", name, ms / 1000.0, error, estimate.error_m - FixError_m) ;
+            within = false ;
+        }
+
+        if ((estimate.method != ((ms < 20000) ? PositionTrack_Interpolated : PositionTrack_Extrapolated)) ||
+            (estimate.age_ms != ((ms < 20000) ? min (ms % 1000, 1000 - ms % 1000) : ms - 20000)))
+        {
+            printf ("FAIL: %s at %.3f s, method or age\n", name, ms / 1000.0) ;
+            within = false ;
+        }
+
+        worst         = fmax (worst, error) ;
+        worstVelocity = fmax (worstVelocity, hypot (estimate.velocityNorth_m_s - truth.velocityNorth_m_s,
+                                                    estimate.velocityEast_m_s  - truth.velocityEast_m_s)) ;
+    }
+
+    failed |= ! within ;
+
+    if ((tight_m != 0) && ((worst > tight_m) || (worstVelocity > 0.05)))
+    {
+        printf ("FAIL: %s, %.3f m and %.4f m/s off at worst\n", name, worst, worstVelocity) ;
+        failed = true ;
+    }
+
+    // too long after, and before the fixes kept
+    expect (! positionTrack_at (track, Start_ms + 20000 + PositionTrack_MaxExtrapolation_ms + 1, & estimate), "no estimate too long after the newest fix") ;
+    expect (! positionTrack_at (track, Start_ms + (20 - PositionTrack_Fixes) * 1000 + 500, & estimate), "no estimate before the fixes kept") ;
+
+    positionTrack_destroy (track) ;
+}
+
+
+static void checkWithoutVelocity (void)
+{
+    PositionTrack * track = positionTrack_create (3) ;
+    PositionEstimate estimate ;
+
+    // 15 s apart with no speed or course, too far apart for a velocity from the positions
+    State first = steady (0), second = steady (15), third = steady (16) ;
+    GpsFix fix ;
+
+    fix = fixOf (& first, false) ;
+    positionTrack_add (track, & fix, Start_ms) ;
+    fix = fixOf (& second, false) ;
+    positionTrack_add (track, & fix, Start_ms + 15000) ;
+
+    expect (positionTrack_at (track, Start_ms + 15000, & estimate), "an estimate at a fix with no velocity") ;
+    expect (! positionTrack_at (track, Start_ms + 15001, & estimate), "none ahead of a fix with no velocity") ;
+
+    // a straight line between them, the same as steady motion here
+    State truth = steady (7.5) ;
+    LatitudeLongitude position = positionOf (& truth) ;
+
+    expect (positionTrack_at (track, Start_ms + 7500, & estimate) &&
+            (metresBetween (& estimate.position, & position) < Rounding_m) &&
+            (fabs (estimate.velocityNorth_m_s - 10) < 0.01) && (fabs (estimate.error_m - (PositionTrack_Uere_m + 3 * 15 * 15 / 8.0)) < 0.01),
+            "straight between fixes with no velocity, bounded for the acceleration") ;
+
+    // a second later, the velocity comes from the difference
+    fix = fixOf (& third, false) ;
+    positionTrack_add (track, & fix, Start_ms + 16000) ;
+
+    truth    = steady (21) ;
+    position = positionOf (& truth) ;
+
+    expect (positionTrack_at (track, Start_ms + 21000, & estimate) && (metresBetween (& estimate.position, & position) < 0.1),
+            "dead reckoned on the velocity between the last two") ;
+
+    // fixes without a position, or not after the newest, are left out
+    fix = fixOf (& third, false) ;
+    fix.positionValid = false ;
+    positionTrack_add (track, & fix, Start_ms + 17000) ;
+
+    expect (positionTrack_at (track, Start_ms + 17000, & estimate) && (estimate.age_ms == 1000), "a fix with no position left out") ;
+
+    positionTrack_destroy (track) ;
+}
+
+
+
+static uint8_t  stream [256] ;
+static size_t   streamLength ;
+
+static void addSentence (const char * body)
+{
+    uint8_t checksum = 0 ;
+    for (const char * c = body ; * c != 0 ; c ++)
+        checksum ^= (uint8_t) * c ;
+
+    streamLength += snprintf ((char *) stream + streamLength, sizeof (stream) - streamLength, "$%s*%02X\r\n", body, checksum) ;
+}
+
+
+static void checkRecording (void)
+{
+    PositionTrack * track = positionTrack_create (3) ;
+    PositionTrack * other = positionTrack_create (3) ;
+
+    host_gpio [GPS_EN_N] = 0 ;
+
+    expect (positionTrack_recordFixes (track), "recording the fixes") ;
+    expect (positionTrack_recordFixes (track), "recording the fixes again, to the same track") ;
+    expect (! positionTrack_recordFixes (other), "not to another track at the same time") ;
+
+    addSentence ("GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A") ;
+    addSentence ("GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,") ;
+    addSentence ("GPGLL,4807.038,N,01131.000,E,123519.00,A,A") ;
+    nmea0183_updateFromBytes (stream, streamLength) ;
+
+    // 1994-03-23 12:35:19
+    PositionEstimate estimate ;
+    expect (positionTrack_at (track, 764426119000ll, & estimate) && (estimate.age_ms == 0) &&
+            (estimate.position.latitude_minutes_x1e5 == 288703800) && (estimate.position.longitude_minutes_x1e5 == 69100000) &&
+            (fabs (estimate.error_m - 0.9f * PositionTrack_Uere_m) < 0.001),
+            "the assembled fix in the track, at the RMC's time") ;
+
+    expect (host_gpio [GPS_EN_N] == 0, "powered while recording") ;
+
+    positionTrack_destroy (track) ;
+    expect (host_gpio [GPS_EN_N] == 1, "powered down once the track recording is destroyed") ;
+
+    positionTrack_destroy (other) ;
+}
+
+
+
+int main ()
+{
+    serialPort_setDevicePath (SerialPort_GPS, "/nonexistent/ttyACM0") ;
+
+    nmea0183_initialize () ;
+    gps_initialize () ;
+
+    checkMotion ("steady",       steady,       0.1f, 0.06) ;
+    checkMotion ("accelerating", accelerating, 3,    0) ;
+    checkMotion ("turning",      turning,      3,    0) ;
+
+    checkWithoutVelocity () ;
+    checkRecording () ;
+
+    if (! failed)
+        printf ("ok: steady, accelerating and turning within their bounds, across the antimeridian, recorded while streaming\n") ;
+
+    return failed ? 1 : 0 ;
+}
@@ -0,0 +1,204 @@
+// the power modes' UBX frames, the policy's choices, and what suspend and resume send
+//
+//      the frames are checked byte for byte against ones worked out by hand from the u-blox M8
+//      protocol description (checksums included), so a change to ubx_frame () can't hide a mistake
+//      suspend and resume only queue, what they send is taken from serial-tx as the reader would
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-power.cpp test/host/host.cpp gps-power.cpp
+//              serial-tx.cpp ubx-tx.cpp ubx.cpp time-source.cpp metrics.cpp event-log.cpp -o test-power && ./test-power
+
+#include "gps-power.hpp"
+#include "serial-tx.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+using namespace std;
+
+
+
+// UBX-RXM-PMREQ, 16 byte form: backup | force, wake on uart rx, no duration
+static const uint8_t BackupRequest [] =
+{
+    0xb5, 0x62, 0x02, 0x41, 0x10, 0x00,
+    0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00,   0x06, 0x00, 0x00, 0x00,   0x08, 0x00, 0x00, 0x00,
+    0x61, 0x6b,
+} ;
+
+// UBX-CFG-PM2 version 1: update ephemeris | cyclic tracking, 1 s update, 10 s search
+static const uint8_t CyclicConfig [] =
+{
+    0xb5, 0x62, 0x06, 0x3b, 0x2c, 0x00,
+    0x01, 0x00, 0x00, 0x00,   0x00, 0x10, 0x02, 0x00,   0xe8, 0x03, 0x00, 0x00,   0x10, 0x27, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00,   0x00, 0x00, 0x00, 0x00,
+    0xa2, 0x87,
+} ;
+
+// UBX-CFG-RXM, power save and continuous
+static const uint8_t PowerSave  [] = { 0xb5, 0x62, 0x06, 0x11, 0x02, 0x00, 0x08, 0x01, 0x22, 0x92 } ;
+static const uint8_t Continuous [] = { 0xb5, 0x62, 0x06, 0x11, 0x02, 0x00, 0x08, 0x00, 0x21, 0x91 } ;
+
+
+static bool failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static bool same (const uint8_t * bytes, uint16_t length, const uint8_t * expected, size_t expectedLength)
+{
+    return (length == expectedLength) && (memcmp (bytes, expected, length) == 0) ;
+}
+
+
+static bool sent (const vector <uint8_t> & bytes, const vector <const uint8_t *> & frames, const vector <size_t> & lengths)
+{
+    // exactly the frames, in order
+    size_t at = 0 ;
+
+    for (size_t i = 0 ; i < frames.size () ; i ++)
+    {
+        if ((at + lengths [i] > bytes.size ()) || (memcmp (& bytes [at], frames [i], lengths [i]) != 0))
+            return false ;
+
+        at += lengths [i] ;
+    }
+
+    return at == bytes.size () ;
+}
+
+
+
+static void checkFrames (void)
+{
+    uint8_t buffer [64] ;
+
+    expect (same (buffer, gpsPower_backupRequest (buffer),       BackupRequest, sizeof (BackupRequest)), "UBX-RXM-PMREQ frame") ;
+    expect (same (buffer, gpsPower_cyclicConfig  (buffer),       CyclicConfig,  sizeof (CyclicConfig)),  "UBX-CFG-PM2 frame") ;
+    expect (same (buffer, gpsPower_lowPowerMode  (buffer, true),  PowerSave,     sizeof (PowerSave)),     "UBX-CFG-RXM power save frame") ;
+    expect (same (buffer, gpsPower_lowPowerMode  (buffer, false), Continuous,    sizeof (Continuous)),    "UBX-CFG-RXM continuous frame") ;
+}
+
+
+static void checkChoice (uint32_t interval_s, uint32_t maxTimeToFix_s, uint32_t energyBudget_mJ,
+                         GpsPowerMode expected, const char * what)
+{
+    GpsPowerNeeds needs = { interval_s, maxTimeToFix_s, energyBudget_mJ } ;
+
+    if (gpsPower_choose (& needs) == expected)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static void checkPolicy (void)
+{
+    // the default model: tracking 70 mW, cyclic 12 mW, backup 45 uW, cold / warm / hot start 30 / 25 / 2 s
+
+    // hourly: backup is 162 mJ asleep and 140 mJ to a hot fix, off is 2100 mJ, cyclic 43200 mJ
+    checkChoice (3600, 0, 0,     GpsPower_Backup, "hourly looks, no limits, backup") ;
+
+    // daily: the ephemeris has expired, backup's warm start costs more than a cold start from off
+    checkChoice (86400, 0, 0,    GpsPower_Off,    "daily looks, no limits, off") ;
+
+    // only cyclic tracking has a fix within a second
+    checkChoice (60, 1, 0,       GpsPower_Cyclic, "a fix within 1 s, cyclic") ;
+
+    // too fast for the budget, the fastest that fits
+    checkChoice (3600, 1, 500,   GpsPower_Backup, "a fix within 1 s on 500 mJ, the fastest in budget") ;
+
+    // nothing fits, the cheapest
+    checkChoice (3600, 0, 10,    GpsPower_Backup, "10 mJ, the cheapest") ;
+
+    GpsPowerNeeds    needs = { 3600, 0, 0 } ;
+    GpsPowerEstimate estimates [GpsPowerModes] ;
+    gpsPower_choose (& needs, estimates) ;
+
+    expect ((estimates [GpsPower_Off]   .timeToFix_s == 30) && (estimates [GpsPower_Off]   .energy_mJ == 2100),  "off estimate") ;
+    expect ((estimates [GpsPower_Backup].timeToFix_s == 2)  && (estimates [GpsPower_Backup].energy_mJ == 302),   "backup estimate") ;
+    expect ((estimates [GpsPower_Cyclic].timeToFix_s == 1)  && (estimates [GpsPower_Cyclic].energy_mJ == 43200), "cyclic estimate") ;
+}
+
+
+static SerialPort * port ;
+
+static void suspend (void)
+{
+    gpsPower_suspend () ;
+    serialTx_service (port, 1024) ;
+}
+
+static void resume (void)
+{
+    gpsPower_resume () ;
+    serialTx_service (port, 1024) ;
+}
+
+
+static void checkSuspendAndResume (void)
+{
+    static const uint8_t Wake [8] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } ;
+
+    vector <uint8_t> bytes ;
+    host_captureTx (& bytes) ;
+
+    port = serialPort_open (SerialPort_GPS) ;
+
+    // off: nothing is sent, gps_close () cuts the supply
+    gpsPower_setMode (GpsPower_Off) ;
+    suspend () ;
+    expect (bytes.empty () && ! gpsPower_isSuspended (), "off sends nothing and isn't suspended") ;
+
+    // backup: the request, then traffic on rx to wake it
+    gpsPower_setMode (GpsPower_Backup) ;
+    suspend () ;
+    expect (sent (bytes, { BackupRequest }, { sizeof (BackupRequest) }) && gpsPower_isSuspended (), "backup suspend") ;
+
+    bytes.clear () ;
+    resume () ;
+    expect (sent (bytes, { Wake }, { sizeof (Wake) }) && ! gpsPower_isSuspended (), "backup resume") ;
+
+    // cyclic: configured then put in power save, and left cycling while the mode stays cyclic
+    bytes.clear () ;
+    gpsPower_setMode (GpsPower_Cyclic) ;
+    suspend () ;
+    expect (sent (bytes, { CyclicConfig, PowerSave }, { sizeof (CyclicConfig), sizeof (PowerSave) }), "cyclic suspend") ;
+
+    bytes.clear () ;
+    resume () ;
+    expect (bytes.empty () && ! gpsPower_isSuspended (), "cyclic resume, staying cyclic") ;
+
+    // back to continuous once the mode changes
+    suspend () ;
+    bytes.clear () ;
+    gpsPower_setMode (GpsPower_Off) ;
+    resume () ;
+    expect (sent (bytes, { Continuous }, { sizeof (Continuous) }), "cyclic resume, leaving cyclic") ;
+
+    host_captureTx (NULL) ;
+}
+
+
+
+int main ()
+{
+    checkFrames () ;
+    checkPolicy () ;
+    checkSuspendAndResume () ;
+
+    if (! failed)
+        printf ("ok: power frames, policy and suspend/resume\n") ;
+
+    return failed ? 1 : 0 ;
+}
@@ -0,0 +1,217 @@
+// capture of RXM-RAWX and RXM-SFRBX to a file, with the receiver streaming while it runs
+//
+//      a few MB of RAWX and SFRBX of all sizes, among other UBX and a corrupt frame, are captured
+//      byte for byte as received and nothing else, across buffers, buffered and O_DIRECT (or its
+//      fallback); into a fifo nobody reads yet, messages are dropped once every buffer is queued,
+//      and what reaches the file is whole messages, as many as were counted; only one capture at
+//      a time, and the receiver is kept streaming until it stops
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-raw-capture.cpp test/host/host.cpp raw-capture.cpp
+//              gps.cpp gps-device.cpp gps-power.cpp nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp
+//              position-filter.cpp lat-long.cpp capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp
+//              ubx.cpp time-source.cpp -o test-raw-capture && ./test-raw-capture
+
+#include "gps.hpp"
+#include "main-cm4-task.h"
+#include "nmea0183.hpp"
+#include "raw-capture.hpp"
+#include "ubx.hpp"
+
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+
+
+static const uint8_t    RXM_SFRBX = 0x13 ;
+static const uint8_t    RXM_MEASX = 0x14 ;
+static const uint8_t    RXM_RAWX  = 0x15 ;
+static const uint8_t    NAV_PVT   = 0x07 ;
+
+static char             path [64] ;
+static bool             failed ;
+
+
+static void expect (bool condition, const char * what)
+{
+    if (condition)
+        return ;
+
+    printf ("FAIL: %s\n", what) ;
+    failed = true ;
+}
+
+
+static uint32_t random32 (void)
+{
+    static uint32_t state = 2463534242u ;
+
+    state ^= state << 13 ;
+    state ^= state >> 17 ;
+    state ^= state << 5 ;
+
+    return state ;
+}
+
+
+static vector <uint8_t> frame (uint8_t messageClass, uint8_t messageId, uint16_t length)
+{
+    vector <uint8_t> payload (length), framed (length + UbxOverhead) ;
+
+    for (uint8_t & byte : payload)
+        byte = (uint8_t) random32 () ;
+
+    framed.resize (ubx_frame (framed.data (), messageClass, messageId, payload.data (), length)) ;
+    return framed ;
+}
+
+
+static void receive (const vector <uint8_t> & bytes)
+{
+    nmea0183_updateFromBytes (bytes.data (), bytes.size ()) ;
+}
+
+
+static vector <uint8_t> readFile (const char * name)
+{
+    vector <uint8_t> bytes ;
+
+    FILE * file = fopen (name, "rb") ;
+    if (file == NULL)
+        return bytes ;
+
+    uint8_t buffer [65536] ;
+    size_t  length ;
+
+    while ((length = fread (buffer, 1, sizeof (buffer), file)) != 0)
+        bytes.insert (bytes.end (), buffer, buffer + length) ;
+
+    fclose (file) ;
+    return bytes ;
+}
+
+
+
+static void checkCapture (bool direct)
+{
+    host_gpio [GPS_EN_N] = 0 ;
+
+    expect (rawCapture_start (path, direct), "capture started") ;
+    expect (! rawCapture_start (path, direct), "only one capture at a time") ;
+
+    // about 3 MB, so 3 buffers and a part filled one, with other messages among them
+    vector <uint8_t> expected ;
+
+    while (expected.size () < 3 * RawCapture_BufferBytes + 1000)
+    {
+        vector <uint8_t> rawx  = frame (UbxClass_RXM, RXM_RAWX,  16 + random32 () % 4000) ;
+        vector <uint8_t> sfrbx = frame (UbxClass_RXM, RXM_SFRBX, 8 + 4 * (random32 () % 10)) ;
+
+        receive (rawx) ;
+        receive (frame (UbxClass_NAV, NAV_PVT, 92)) ;
+        receive (sfrbx) ;
+        receive (frame (UbxClass_RXM, RXM_MEASX, 44)) ;
+
+        expected.insert (expected.end (), rawx.begin (),  rawx.end ()) ;
+        expected.insert (expected.end (), sfrbx.begin (), sfrbx.end ()) ;
+    }
+
+    vector <uint8_t> corrupt = frame (UbxClass_RXM, RXM_RAWX, 100) ;
+    corrupt [50] ^= 1 ;
+    receive (corrupt) ;
+
+    expect (host_gpio [GPS_EN_N] == 0, "powered while capturing") ;
+
+    rawCapture_stop () ;
+    expect (host_gpio [GPS_EN_N] == 1, "powered down once the capture stops") ;
+
+    RawCaptureStats stats ;
+    rawCapture_getStats (& stats) ;
+
+    expect (readFile (path) == expected, direct ? "RAWX and SFRBX as received, O_DIRECT" : "RAWX and SFRBX as received") ;
+    expect ((stats.bytes == expected.size ()) && (stats.dropped == 0) && ! stats.writeFailed &&
+            (stats.buffersWritten == (expected.size () + RawCapture_BufferBytes - 1) / RawCapture_BufferBytes),
+            "counted, in whole buffers and the last") ;
+
+    // receiving goes on, but nothing is captured
+    receive (frame (UbxClass_RXM, RXM_RAWX, 100)) ;
+    rawCapture_getStats (& stats) ;
+    expect (stats.bytes == expected.size (), "nothing captured once stopped") ;
+}
+
+
+static void checkDropped (void)
+{
+    // a fifo, opened to read but not read until every buffer is queued for the writer
+    unlink (path) ;
+    expect (mkfifo (path, 0600) == 0, "a fifo to capture to") ;
+
+    int fifo = open (path, O_RDONLY | O_NONBLOCK) ;
+    expect (rawCapture_start (path), "capture started, to the fifo") ;
+
+    vector <uint8_t> rawx = frame (UbxClass_RXM, RXM_RAWX, 4000) ;
+    uint32_t sent = 0 ;
+
+    for ( ; sent * rawx.size () < 2 * RawCapture_MaxBufferedBytes ; sent ++)
+        receive (rawx) ;
+
+    RawCaptureStats stats ;
+    rawCapture_getStats (& stats) ;
+    expect ((stats.dropped != 0) && (stats.messages + stats.dropped == sent), "messages dropped once the buffers are full") ;
+    expect (stats.maxBuffersQueued >= RawCapture_MaxBufferedBytes / RawCapture_BufferBytes - 2, "all but the filling buffers queued") ;
+
+    // read it all, as the capture stops
+    vector <uint8_t> received ;
+    fcntl (fifo, F_SETFL, fcntl (fifo, F_GETFL) & ~O_NONBLOCK) ;
+
+    thread reader ([fifo, & received] ()
+    {
+        uint8_t buffer [65536] ;
+        ssize_t length ;
+
+        while ((length = read (fifo, buffer, sizeof (buffer))) > 0)
+            received.insert (received.end (), buffer, buffer + length) ;
+    }) ;
+
+    rawCapture_stop () ;
+    reader.join () ;
+    close (fifo) ;
+
+    rawCapture_getStats (& stats) ;
+
+    bool whole = (received.size () == stats.messages * rawx.size ()) ;
+    for (size_t at = 0 ; whole && (at < received.size ()) ; at += rawx.size ())
+        whole = (memcmp (& received [at], rawx.data (), rawx.size ()) == 0) ;
+
+    expect (whole && ! stats.writeFailed, "every message counted reached the fifo, whole") ;
+}
+
+
+
+int main ()
+{
+    snprintf (path, sizeof (path), "/tmp/test-raw-capture-%d", (int) getpid ()) ;
+
+    serialPort_setDevicePath (SerialPort_GPS, "/nonexistent/ttyACM0") ;
+
+    nmea0183_initialize () ;
+    gps_initialize () ;
+
+    checkCapture (false) ;
+    checkCapture (true) ;
+    checkDropped () ;
+
+    unlink (path) ;
+
+    if (! failed)
+        printf ("ok: RAWX and SFRBX captured as received, buffered and direct, dropped whole, streaming while capturing\n") ;
+
+    return failed ? 1 : 0 ;
+}
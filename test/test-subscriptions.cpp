@@ -0,0 +1,141 @@
+// subscribing and unsubscribing while another thread reads the receiver
+//
+//      a thread stands in for the reader, feeding whole epochs to nmea0183 as fast as it can,
+//      while the test subscribes and unsubscribes an RMC handler, a fix handler and a UBX handler
+//      over and over; a handler must never run once its unsubscribe has returned, and each must
+//      have run while it was subscribed
+//
+//      best run with -fsanitize=thread added, which also checks the lists themselves
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-subscriptions.cpp test/host/host.cpp
+//              nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp position-filter.cpp lat-long.cpp
+//              capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp ubx.cpp time-source.cpp
+//              -o test-subscriptions && ./test-subscriptions
+
+#include "gps-fix.hpp"
+#include "nmea0183.hpp"
+#include "ubx.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+using namespace std;
+
+
+
+static const uint32_t   Rounds = 300 ;
+
+static atomic <bool>    subscribed ;            // cleared once unsubscribe has returned
+static atomic <bool>    running ;
+static atomic <uint32_t> calls, lateCalls ;
+
+static uint8_t          stream [512] ;
+static size_t           streamLength ;
+
+
+static void addSentence (const char * body)
+{
+    uint8_t checksum = 0 ;
+    for (const char * c = body ; * c != 0 ; c ++)
+        checksum ^= (uint8_t) * c ;
+
+    streamLength += snprintf ((char *) stream + streamLength, sizeof (stream) - streamLength, "$%s*%02X\r\n", body, checksum) ;
+}
+
+
+static void addUbx (void)
+{
+    static const uint8_t payload [4] = { 1, 2, 3, 4 } ;
+    streamLength += ubx_frame (stream + streamLength, UbxClass_NAV, 0x20, payload, sizeof (payload)) ;
+}
+
+
+static void called (void)
+{
+    // long enough for an unsubscribe that doesn't wait for it to return meanwhile
+    calls ++ ;
+    this_thread::sleep_for (chrono::microseconds (50)) ;
+
+    if (! subscribed)
+        lateCalls ++ ;
+}
+
+static void onRmc (const NmeaRMC *)     { called () ; }
+static void onFix (const GpsFix *)      { called () ; }
+static void onNav (uint8_t, uint8_t, const uint8_t *, uint16_t) { called () ; }
+
+
+static void read (void)
+{
+    while (running)
+        nmea0183_updateFromBytes (stream, streamLength) ;
+}
+
+
+static bool waitForCall (void)
+{
+    uint32_t before = calls ;
+
+    for (int i = 0 ; (i < 1000) && (calls == before) ; i ++)
+        this_thread::sleep_for (chrono::microseconds (100)) ;
+
+    return calls != before ;
+}
+
+
+
+int main ()
+{
+    addSentence ("GPRMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A") ;
+    addSentence ("GPGGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,") ;
+    addSentence ("GPGLL,4807.038,N,01131.000,E,123519.00,A,A") ;
+    addUbx () ;
+
+    nmea0183_initialize () ;
+
+    running = true ;
+    thread reader (read) ;
+
+    bool ok = true ;
+    uint32_t missed = 0 ;
+
+    for (uint32_t round = 0 ; round < Rounds ; round ++)
+    {
+        switch (round % 3)
+        {
+            case 0:
+                subscribed = nmea0183_subscribe (onRmc) ;
+                missed += ! waitForCall () ;
+                nmea0183_unsubscribe (onRmc) ;
+                break ;
+
+            case 1:
+                subscribed = gpsFix_subscribe (onFix) ;
+                missed += ! waitForCall () ;
+                gpsFix_unsubscribe (onFix) ;
+                break ;
+
+            default:
+                subscribed = ubx_subscribe (UbxClass_NAV, onNav) ;
+                missed += ! waitForCall () ;
+                ubx_unsubscribe (UbxClass_NAV, onNav) ;
+                break ;
+        }
+
+        ok &= subscribed ;
+        subscribed = false ;
+    }
+
+    running = false ;
+    reader.join () ;
+
+    ok &= (lateCalls == 0) && (missed == 0) ;
+
+    printf ("%s: %u rounds, %u handler calls, %u after unsubscribing, %u rounds without a call\n",
+            ok ? "ok" : "FAIL", Rounds, (uint32_t) calls, (uint32_t) lateCalls, missed) ;
+
+    return ok ? 0 : 1 ;
+}
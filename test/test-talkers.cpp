@@ -0,0 +1,127 @@
+// the talkers and sentences recognized, the same for the compile time parsers and the reader
+//
+//      every talker in the table (BD included) with every sentence id is decoded by an NmeaParser
+//      of all six sentences and published by nmea0183 to a subscriber of its type; an unknown
+//      talker or sentence id is refused by both
+//
+//      from the top of the tree, as one line:
+//          g++ -std=c++17 -pthread -Itest/host -I. test/test-talkers.cpp test/host/host.cpp
+//              nmea0183.cpp nmea-sentence.cpp gps-fix.cpp satellite-table.cpp position-filter.cpp lat-long.cpp
+//              capture.cpp event-log.cpp metrics.cpp serial-tx.cpp ubx-tx.cpp ubx.cpp time-source.cpp
+//              -o test-talkers && ./test-talkers
+
+#include "nmea0183.hpp"
+#include "nmea-parser.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+using namespace std;
+
+
+
+// a body for each sentence type, after the talker
+static const char * const Bodies [NmeaSentenceTypes] =
+{
+    "RMC,123519.00,A,4807.038,N,01131.000,E,022.4,084.4,230394,003.1,W,A",
+    "GGA,123519.00,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,",
+    "GSA,A,3,04,05,,09,12,,,24,,,,,2.5,1.3,2.1",
+    "GSV,2,1,08,01,40,083,46,02,17,308,41,12,07,344,39,14,22,228,45",
+    "VTG,054.7,T,034.4,M,005.5,N,010.2,K,A",
+    "GLL,4807.038,N,01131.000,E,123519.00,A,A",
+} ;
+
+static uint32_t published [NmeaSentenceTypes] ;
+static bool     failed ;
+
+
+static void onRmc (const NmeaRMC *) { published [NmeaSentence_RMC] ++ ; }
+static void onGga (const NmeaGGA *) { published [NmeaSentence_GGA] ++ ; }
+static void onGsa (const NmeaGSA *) { published [NmeaSentence_GSA] ++ ; }
+static void onGsv (const NmeaGSV *) { published [NmeaSentence_GSV] ++ ; }
+static void onVtg (const NmeaVTG *) { published [NmeaSentence_VTG] ++ ; }
+static void onGll (const NmeaGLL *) { published [NmeaSentence_GLL] ++ ; }
+
+
+struct Decoded
+{
+    int type = -1 ;
+
+    void operator () (const NmeaRMC *) { type = NmeaSentence_RMC ; }
+    void operator () (const NmeaGGA *) { type = NmeaSentence_GGA ; }
+    void operator () (const NmeaGSA *) { type = NmeaSentence_GSA ; }
+    void operator () (const NmeaGSV *) { type = NmeaSentence_GSV ; }
+    void operator () (const NmeaVTG *) { type = NmeaSentence_VTG ; }
+    void operator () (const NmeaGLL *) { type = NmeaSentence_GLL ; }
+} ;
+
+typedef NmeaParser <Rmc <>, Gga <>, Gsa <>, Gsv <>, Vtg <>, Gll <>> AllSentences ;
+
+
+static string sentence (char a, char b, const char * body)
+{
+    string text = string ("$") + a + b + body ;
+
+    uint8_t checksum = 0 ;
+    for (size_t i = 1 ; i < text.size () ; i ++)
+        checksum ^= (uint8_t) text [i] ;
+
+    char tail [8] ;
+    snprintf (tail, sizeof (tail), "*%02X\r\n", checksum) ;
+
+    return text + tail ;
+}
+
+
+static void check (char a, char b, const char * body, int expected)
+{
+    // expected is the sentence type, or -1 if it should be refused
+    string text = sentence (a, b, body) ;
+
+    Decoded decoded ;
+    AllSentences::parse (string_view (text.data (), text.size () - 2), decoded) ;
+
+    uint32_t before [NmeaSentenceTypes] ;
+    memcpy (before, published, sizeof (before)) ;
+
+    nmea0183_updateFromBytes ((const uint8_t *) text.data (), text.size ()) ;
+
+    int publishedAs = -1 ;
+    for (int type = 0 ; type < NmeaSentenceTypes ; type ++)
+        if (published [type] != before [type])
+            publishedAs = type ;
+
+    if ((decoded.type == expected) && (publishedAs == expected))
+        return ;
+
+    printf ("FAIL: %c%c%.3s, parsed as %d and published as %d rather than %d\n", a, b, body, decoded.type, publishedAs, expected) ;
+    failed = true ;
+}
+
+
+
+int main ()
+{
+    nmea0183_initialize () ;
+
+    nmea0183_subscribe (onRmc) ;
+    nmea0183_subscribe (onGga) ;
+    nmea0183_subscribe (onGsa) ;
+    nmea0183_subscribe (onGsv) ;
+    nmea0183_subscribe (onVtg) ;
+    nmea0183_subscribe (onGll) ;
+
+    for (uint16_t talker : nmeaTalkers)
+        for (int type = 0 ; type < NmeaSentenceTypes ; type ++)
+            check ((char) (talker >> 8), (char) talker, Bodies [type], type) ;
+
+    check ('B', 'D', Bodies [NmeaSentence_GSV], NmeaSentence_GSV) ;
+    check ('X', 'X', Bodies [NmeaSentence_RMC], -1) ;
+    check ('G', 'P', "ZDA,123519.00,23,03,1994,00,00", -1) ;
+
+    if (! failed)
+        printf ("ok: %zu talkers by %d sentences, parsed and published alike, unknown ones refused\n",
+                sizeof (nmeaTalkers) / sizeof (nmeaTalkers [0]), (int) NmeaSentenceTypes) ;
+
+    return failed ? 1 : 0 ;
+}
@@ -0,0 +1,63 @@
+#include "time-source.hpp"
+
+#include <atomic>
+using namespace std;
+
+
+
+static struct {
+    atomic <bool>       simulated ;
+    atomic <int64_t>    now_ms ;                // since the epoch
+    atomic <uint32_t>   pollStep_ms ;
+} simulation ;
+
+
+
+time_t timeSource_time (void)
+{
+    if (simulation.simulated.load (memory_order_acquire))
+        return simulation.now_ms.load (memory_order_relaxed) / 1000 ;
+
+    return time (NULL) ;
+}
+
+
+int64_t timeSource_monotonic_ms (void)
+{
+    if (simulation.simulated.load (memory_order_acquire))
+        return simulation.now_ms.load (memory_order_relaxed) ;
+
+    struct timespec now ;
+    clock_gettime (CLOCK_MONOTONIC, & now) ;
+
+    return (int64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000 ;
+}
+
+
+void timeSource_waited (void)
+{
+    if (simulation.simulated.load (memory_order_acquire))
+        simulation.now_ms.fetch_add (simulation.pollStep_ms.load (memory_order_relaxed), memory_order_relaxed) ;
+}
+
+
+
+void timeSource_simulate (time_t start, uint32_t pollStep_ms)
+{
+    simulation.now_ms.store ((int64_t) start * 1000, memory_order_relaxed) ;
+    simulation.pollStep_ms.store (pollStep_ms, memory_order_relaxed) ;
+
+    simulation.simulated.store (true, memory_order_release) ;
+}
+
+
+void timeSource_advance (int64_t ms)
+{
+    simulation.now_ms.fetch_add (ms, memory_order_relaxed) ;
+}
+
+
+void timeSource_useSystem (void)
+{
+    simulation.simulated.store (false, memory_order_release) ;
+}
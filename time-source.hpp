@@ -0,0 +1,33 @@
+#ifndef _TIME_SOURCE_H_
+#define _TIME_SOURCE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+
+// the clock seen by the acquisition logic (gps.cpp) and the stream timeout (nmea0183.cpp)
+//
+//      normally the system clock, or a simulated one that only moves when told to, so the
+//      minutes long update intervals and the 3 hour acquisition timeout can be run through
+//      in milliseconds
+//
+//      in simulation each poll of the port that finds nothing to read moves the clock on by
+//      the poll step, so a read from a silent port times out after timeout / step polls
+//      rather than after its timeout in real time
+
+
+time_t  timeSource_time         (void) ;       // as time (NULL)
+int64_t timeSource_monotonic_ms (void) ;       // for measuring intervals
+
+// a poll found nothing to read
+void timeSource_waited (void) ;
+
+
+// simulation ...
+
+void timeSource_simulate  (time_t start, uint32_t pollStep_ms) ;
+void timeSource_advance   (int64_t ms) ;
+void timeSource_useSystem (void) ;             // the default
+
+
+#endif
@@ -0,0 +1,268 @@
+#include "ubx-tx.hpp"
+
+#include "serial-tx.hpp"
+#include "time-source.hpp"
+#include "ubx.hpp"
+
+#include <list>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+
+
+static const uint8_t ACK_NAK = 0x00 ;
+static const uint8_t ACK_ACK = 0x01 ;
+
+
+typedef struct
+{
+    uint8_t             messageClass ;
+    uint8_t             messageId ;
+    vector <uint8_t>    framed ;
+    bool                awaitAck ;
+
+    uint8_t             attempts ;
+    bool                inQueue ;       // an attempt is waiting in serial-tx, which holds a pointer to this
+    bool                written ;       // at least once
+    int64_t             written_ms ;    // the last attempt
+    bool                finished ;      // done has been called, dropped once out of the queue
+
+    UbxTxDone           done ;
+    void *              context ;
+    UbxTxStamp          stamp ;
+} Request ;
+
+
+typedef struct
+{
+    uint8_t             messageClass ;
+    uint8_t             messageId ;
+    UbxTxResult         result ;
+    UbxTxDone           done ;
+    void *              context ;
+} Completion ;
+
+
+static struct {
+    mutex               lock ;
+    list <Request>      messages ;      // in the order queued
+    mutex               subscribing ;   // not under lock, onAck () takes that under ubx.cpp's lock
+    bool                subscribed ;
+    UbxTxStats          stats ;
+} tx ;
+
+
+
+static void finish (list <Request>::iterator message, UbxTxResult result, vector <Completion> & completions)
+{
+    // with the lock held
+    message->finished = true ;
+
+    if (message->done != NULL)
+        completions.push_back ({ message->messageClass, message->messageId, result, message->done, message->context }) ;
+
+    if (! message->inQueue)
+        tx.messages.erase (message) ;
+}
+
+
+static void complete (vector <Completion> & completions)
+{
+    // outside the lock, so done can send again
+    for (Completion & completion : completions)
+        completion.done (completion.messageClass, completion.messageId, completion.result, completion.context) ;
+}
+
+
+static list <Request>::iterator find (const Request * message)
+{
+    for (list <Request>::iterator i = tx.messages.begin () ; i != tx.messages.end () ; ++ i)
+        if (& * i == message)
+            return i ;
+
+    return tx.messages.end () ;
+}
+
+
+static void onWritten (void * context, bool sent)
+{
+    vector <Completion> completions ;
+
+    {
+        lock_guard <mutex> guard (tx.lock) ;
+
+        list <Request>::iterator message = find ((Request *) context) ;
+        if (message == tx.messages.end ())
+            return ;
+
+        message->inQueue = false ;
+
+        if (message->finished)
+            tx.messages.erase (message) ;
+        else if (! sent)
+            finish (message, UbxTx_Dropped, completions) ;
+        else if (! message->awaitAck)
+            finish (message, UbxTx_Sent, completions) ;
+        else
+        {
+            message->written    = true ;
+            message->written_ms = timeSource_monotonic_ms () ;
+        }
+    }
+
+    complete (completions) ;
+}
+
+
+static void onStamp (uint8_t * framed, uint16_t length, void * context)
+{
+    // on the thread servicing the port, with the attempt about to be written; the request is
+    // in the list while serial-tx has it, and its stamp doesn't change
+    Request * request = (Request *) context ;
+
+    request->stamp (& framed [6], length - UbxOverhead, request->context) ;
+
+    uint16_t cksum = ubx_checksum (& framed [2], length - 4) ;
+    framed [length - 2] = cksum  & 0xff ;   // ck_a
+    framed [length - 1] = cksum >>    8 ;   // ck_b
+}
+
+
+static void onAck (uint8_t, uint8_t messageId, const uint8_t * payload, uint16_t length)
+{
+    if (((messageId != ACK_ACK) && (messageId != ACK_NAK)) || (length < 2))
+        return ;
+
+    vector <Completion> completions ;
+
+    {
+        lock_guard <mutex> guard (tx.lock) ;
+
+        // the oldest written and unanswered with the class and id, a late answer to an attempt
+        // being sent again counts
+        for (list <Request>::iterator message = tx.messages.begin () ; message != tx.messages.end () ; ++ message)
+        {
+            if (message->finished || ! message->written || ! message->awaitAck)
+                continue ;
+
+            if ((message->messageClass != payload [0]) || (message->messageId != payload [1]))
+                continue ;
+
+            if (messageId == ACK_ACK)
+                ++ tx.stats.acked ;
+            else
+                ++ tx.stats.nacked ;
+
+            finish (message, (messageId == ACK_ACK) ? UbxTx_Acked : UbxTx_Nacked, completions) ;
+            break ;
+        }
+    }
+
+    complete (completions) ;
+}
+
+
+
+bool ubxTx_send (uint8_t messageClass, uint8_t messageId, const uint8_t * payload, uint16_t length,
+                 UbxTxDone done, void * context, UbxTxStamp stamp)
+{
+    if (length > UINT16_MAX - UbxOverhead)
+        return false ;
+
+    {
+        lock_guard <mutex> guard (tx.subscribing) ;
+
+        if (! tx.subscribed)
+            tx.subscribed = ubx_subscribe (UbxClass_ACK, onAck) ;
+    }
+
+    lock_guard <mutex> guard (tx.lock) ;
+
+    tx.messages.emplace_back () ;
+    Request & message = tx.messages.back () ;
+
+    message.messageClass = messageClass ;
+    message.messageId    = messageId ;
+    message.awaitAck     = (messageClass == UbxClass_CFG) ;
+    message.attempts     = 1 ;
+    message.inQueue      = true ;
+    message.done         = done ;
+    message.context      = context ;
+    message.stamp        = stamp ;
+
+    message.framed.resize (length + UbxOverhead) ;
+    ubx_frame (message.framed.data (), messageClass, messageId, payload, length) ;
+
+    if (! serialTx_queue (SerialTx_Config, message.framed.data (), message.framed.size (), onWritten, & message,
+                         (stamp != NULL) ? onStamp : NULL))
+    {
+        tx.messages.pop_back () ;
+        ++ tx.stats.refused ;
+        return false ;
+    }
+
+    ++ tx.stats.queued ;
+    return true ;
+}
+
+
+void ubxTx_poll (void)
+{
+    vector <Completion> completions ;
+
+    {
+        lock_guard <mutex> guard (tx.lock) ;
+
+        int64_t now_ms = timeSource_monotonic_ms () ;
+
+        list <Request>::iterator next ;
+
+        for (list <Request>::iterator message = tx.messages.begin () ; message != tx.messages.end () ; message = next)
+        {
+            next = message ;
+            ++ next ;
+
+            if (message->finished || message->inQueue || ! message->written)
+                continue ;
+
+            if (now_ms - message->written_ms < UbxTx_AckTimeout_ms)
+                continue ;
+
+            if ((message->attempts < UbxTx_MaxAttempts) &&
+                serialTx_queue (SerialTx_Config, message->framed.data (), message->framed.size (), onWritten, & * message,
+                               (message->stamp != NULL) ? onStamp : NULL))
+            {
+                ++ message->attempts ;
+                ++ tx.stats.retries ;
+                message->inQueue = true ;
+                continue ;
+            }
+
+            ++ tx.stats.timedOut ;
+            finish (message, UbxTx_TimedOut, completions) ;
+        }
+    }
+
+    complete (completions) ;
+}
+
+
+size_t ubxTx_outstanding (void)
+{
+    lock_guard <mutex> guard (tx.lock) ;
+
+    size_t outstanding = 0 ;
+    for (const Request & message : tx.messages)
+        if (! message.finished)
+            ++ outstanding ;
+
+    return outstanding ;
+}
+
+
+void ubxTx_getStats (UbxTxStats * stats)
+{
+    lock_guard <mutex> guard (tx.lock) ;
+    * stats = tx.stats ;
+}
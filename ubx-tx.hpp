@@ -0,0 +1,66 @@
+#ifndef _UBX_TX_H_
+#define _UBX_TX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// UBX messages to the receiver with their UBX-ACK-ACK / ACK-NAK tracked
+//
+//      a message is framed and queued at config priority (serial-tx.hpp), so any number can be
+//      queued at once and go out together in a few writes; its acknowledgement is waited for from
+//      when its last byte was written, and matched by class and id, the receiver answering
+//      messages of the same class and id in the order it got them
+//      a message not answered within AckTimeout_ms is sent again, up to MaxAttempts in all
+//
+//      only CFG messages are acknowledged by the receiver, others are done once written
+//      done is called on the thread reading the receiver (nmea0183_run()), where the queue is
+//      serviced and the answers arrive, so nothing is sent or answered while the receiver is off
+
+
+static const uint32_t UbxTx_AckTimeout_ms = 1000 ;
+static const uint8_t  UbxTx_MaxAttempts   = 3 ;
+
+
+typedef enum
+{
+    UbxTx_Acked,
+    UbxTx_Nacked,
+    UbxTx_TimedOut,                     // no answer to any attempt
+    UbxTx_Sent,                         // written, no answer expected
+    UbxTx_Dropped,                      // never written, the queue was cleared
+} UbxTxResult ;
+
+
+typedef void (* UbxTxDone) (uint8_t messageClass, uint8_t messageId, UbxTxResult, void * context) ;
+
+
+typedef struct
+{
+    uint64_t    queued ;
+    uint64_t    acked ;
+    uint64_t    nacked ;
+    uint64_t    timedOut ;
+    uint64_t    retries ;
+    uint64_t    refused ;               // the queue was full, not queued
+} UbxTxStats ;
+
+
+// fills in the payload as each attempt is about to be written, for what must be as late as possible
+// (a time), the checksum is made again after it; on the thread reading the receiver, with context
+typedef void (* UbxTxStamp) (uint8_t * payload, uint16_t length, void * context) ;
+
+
+// false if the queue is full, done is not called then
+bool ubxTx_send (uint8_t messageClass, uint8_t messageId, const uint8_t * payload, uint16_t length,
+                 UbxTxDone = NULL, void * context = NULL, UbxTxStamp = NULL) ;
+
+// sends again or gives up on what hasn't been answered in time, from the stream's poll
+void ubxTx_poll (void) ;
+
+size_t ubxTx_outstanding (void) ;      // queued or waiting for an answer
+
+void ubxTx_getStats (UbxTxStats *) ;
+
+
+#endif
@@ -0,0 +1,270 @@
+#include "ubx.hpp"
+
+#include "metrics.hpp"
+
+#include <mutex>
+#include <string.h>
+using namespace std;
+
+
+
+static const uint8_t  MaxSubscribers = 8 ;
+static const uint16_t MaxPayload     = 8192 ;       // longer lengths are taken as a false sync, RXM-RAWX is up to 16 + 32 * 255
+
+
+static struct
+{
+    uint8_t     messageClass ;
+    UbxHandler  handler ;
+} subscribers [MaxSubscribers] ;
+
+static uint8_t subscriberCount ;
+
+// the list, held while the handlers run so none runs once it is unsubscribed
+static mutex   subscribersLock ;
+
+
+static enum { WaitSync1, WaitSync2, WaitClass, WaitId, WaitLength1, WaitLength2, InPayload, WaitChecksum1, WaitChecksum2 } state ;
+
+static struct
+{
+    uint8_t     header [4] ;        // class, id, length lsb, length msb
+    uint8_t     payload [MaxPayload] ;
+    uint16_t    length ;
+    uint16_t    received ;
+    bool        wanted ;            // of a subscribed class
+    uint8_t     ck_a, ck_b ;        // running checksum, from the class on
+    uint8_t     checksum [2] ;
+} message ;
+
+static bool replaying ;             // resync () is feeding the framer
+
+
+
+uint16_t ubx_checksum (const uint8_t * data, uint16_t length)
+{
+    uint8_t ck_a = 0 ;
+    uint8_t ck_b = 0 ;
+
+    while (length --)
+    {
+        ck_a += * data ++ ;
+        ck_b += ck_a ;
+    }
+
+    return ck_b * 256 + ck_a ;
+}
+
+
+
+uint16_t ubx_frame (uint8_t * buffer, uint8_t messageClass, uint8_t messageId, const uint8_t * payload, uint16_t length)
+{
+    uint8_t * out = buffer ;
+
+    * out ++ = UbxSync1 ;
+    * out ++ = UbxSync2 ;
+    * out ++ = messageClass ;
+    * out ++ = messageId ;
+    * out ++ = length  & 0xff ;     // lsb
+    * out ++ = length >>    8 ;     // msb
+
+    memcpy (out, payload, length) ;
+    out += length ;
+
+    uint16_t cksum = ubx_checksum (& buffer [2], length + 4) ;
+
+    * out ++ = cksum  & 0xff ;      // ck_a
+    * out ++ = cksum >>    8 ;      // ck_b
+
+    return out - buffer ;
+}
+
+
+bool ubx_subscribe (uint8_t messageClass, UbxHandler handler)
+{
+    lock_guard <mutex> guard (subscribersLock) ;
+
+    if (subscriberCount >= MaxSubscribers)
+        return false ;
+
+    subscribers [subscriberCount].messageClass = messageClass ;
+    subscribers [subscriberCount].handler      = handler ;
+    ++ subscriberCount ;
+
+    return true ;
+}
+
+
+void ubx_unsubscribe (uint8_t messageClass, UbxHandler handler)
+{
+    lock_guard <mutex> guard (subscribersLock) ;
+
+    for (uint8_t i = 0 ; i < subscriberCount ; i ++)
+    {
+        if ((subscribers [i].messageClass == messageClass) && (subscribers [i].handler == handler))
+        {
+            subscribers [i] = subscribers [-- subscriberCount] ;
+            return ;
+        }
+    }
+}
+
+
+static bool isSubscribed (uint8_t messageClass)
+{
+    lock_guard <mutex> guard (subscribersLock) ;
+
+    for (uint8_t i = 0 ; i < subscriberCount ; i ++)
+        if (subscribers [i].messageClass == messageClass)
+            return true ;
+
+    return false ;
+}
+
+
+static void publish (void)
+{
+    metrics_count (Metric_UbxMessages) ;
+
+    lock_guard <mutex> guard (subscribersLock) ;
+
+    for (uint8_t i = 0 ; i < subscriberCount ; i ++)
+        if (subscribers [i].messageClass == message.header [0])
+            subscribers [i].handler (message.header [0], message.header [1], message.payload, message.length) ;
+}
+
+
+static void resync (void)
+{
+    // the sync bytes may have been a false match (noise, or a line glitch), in which case a real
+    // message can start anywhere in what was taken as this one, so everything after the false
+    // sync is fed back through the framer; bytes the replay doesn't take as UBX are dropped,
+    // the NMEA framer finds the next '$' by itself
+    static uint8_t replay [sizeof (message.header) + MaxPayload + sizeof (message.checksum)] ;
+
+    // a false match inside the replay is skipped rather than replayed again
+    if (replaying)
+        return ;
+
+    uint16_t length = 0 ;
+
+    memcpy (& replay [length], message.header, sizeof (message.header)) ;
+    length += sizeof (message.header) ;
+
+    memcpy (& replay [length], message.payload, message.length) ;
+    length += message.length ;
+
+    memcpy (& replay [length], message.checksum, sizeof (message.checksum)) ;
+    length += sizeof (message.checksum) ;
+
+    replaying = true ;
+
+    for (uint16_t i = 0 ; i < length ; i ++)
+        ubx_rxByte (replay [i]) ;
+
+    replaying = false ;
+}
+
+
+static void add (uint8_t in)
+{
+    message.ck_a += in ;
+    message.ck_b += message.ck_a ;
+}
+
+
+
+bool ubx_rxByte (uint8_t in)
+{
+    switch (state)
+    {
+        case WaitSync1:
+            if (in != UbxSync1)
+                return false ;
+            state = WaitSync2 ;
+            return true ;
+
+        case WaitSync2:
+            // not a UBX message after all, so the byte may be NMEA
+            state = WaitSync1 ;
+            if (in != UbxSync2)
+                return ubx_rxByte (in) ;
+            message.ck_a = message.ck_b = 0 ;
+            state = WaitClass ;
+            return true ;
+
+        case WaitClass:
+            message.header [0] = in ;
+            add (in) ;
+            state = WaitId ;
+            return true ;
+
+        case WaitId:
+            message.header [1] = in ;
+            add (in) ;
+            state = WaitLength1 ;
+            return true ;
+
+        case WaitLength1:
+            message.header [2] = in ;
+            add (in) ;
+            state = WaitLength2 ;
+            return true ;
+
+        case WaitLength2:
+            message.header [3] = in ;
+            add (in) ;
+            message.length     = message.header [2] | (in << 8) ;
+            message.received   = 0 ;
+            message.wanted     = isSubscribed (message.header [0]) ;
+
+            // no message is this long, so the sync was false, look for the next one straight away
+            // rather than skipping up to 64 KiB of the stream
+            if (message.length > MaxPayload)
+            {
+                metrics_count (Metric_UbxTooLong) ;
+                state = WaitSync1 ;
+                return true ;
+            }
+
+            state = (message.length > 0) ? InPayload : WaitChecksum1 ;
+            return true ;
+
+        case InPayload:
+            // every message is buffered, so a bad one can be replayed by resync ()
+            message.payload [message.received] = in ;
+            add (in) ;
+            if (++ message.received == message.length)
+                state = WaitChecksum1 ;
+            return true ;
+
+        case WaitChecksum1:
+            message.checksum [0] = in ;
+            state = WaitChecksum2 ;
+            return true ;
+
+        case WaitChecksum2:
+            message.checksum [1] = in ;
+            state = WaitSync1 ;
+
+            if ((message.checksum [0] != message.ck_a) || (message.checksum [1] != message.ck_b))
+            {
+                metrics_count (Metric_UbxChecksumFailures) ;
+                resync () ;
+            }
+            else if (message.wanted)
+                publish () ;
+            return true ;
+    }
+
+    return false ;
+}
+
+
+
+void ubx_initialize (void)
+{
+    // subscriptions are kept, only the framer is reset
+    state     = WaitSync1 ;
+    replaying = false ;
+}
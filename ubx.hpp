@@ -0,0 +1,56 @@
+#ifndef _UBX_H_
+#define _UBX_H_
+
+#include <stdint.h>
+
+
+// u-blox UBX binary protocol
+//
+//      sync 0xb5 0x62, class, id, 2 byte payload length (lsb first), payload, 2 byte checksum
+//      the checksum is an 8 bit Fletcher over class, id, length and payload
+
+
+static const uint8_t UbxSync1 = 0xb5 ;
+static const uint8_t UbxSync2 = 0x62 ;
+
+typedef enum
+{
+    UbxClass_NAV = 0x01,
+    UbxClass_RXM = 0x02,
+    UbxClass_INF = 0x04,
+    UbxClass_ACK = 0x05,
+    UbxClass_CFG = 0x06,
+    UbxClass_MON = 0x0a,
+    UbxClass_TIM = 0x0d,
+    UbxClass_MGA = 0x13,
+} UbxClass ;
+
+
+// called with each complete message whose checksum is ok
+typedef void (* UbxHandler) (uint8_t messageClass, uint8_t messageId, const uint8_t * payload, uint16_t length) ;
+
+// every message is checked, only those of a subscribed class are published
+//      a length over the buffer, or a bad checksum, is taken as a false sync: the framer
+//      resynchronizes on the bytes after it rather than skipping the whole claimed length
+//      safe while the reader runs, but not from a handler, as for nmea0183_subscribe ()
+bool ubx_subscribe   (uint8_t messageClass, UbxHandler) ;
+void ubx_unsubscribe (uint8_t messageClass, UbxHandler) ;
+
+// feed one received byte
+//      returns true if the byte belongs to a UBX message (so is not NMEA)
+bool ubx_rxByte (uint8_t) ;
+
+uint16_t ubx_checksum (const uint8_t * data, uint16_t length) ;     // ck_b * 256 + ck_a
+
+// transmitting ...
+
+static const uint16_t UbxOverhead = 8 ;    // sync, class, id, length and checksum
+
+// frame a message into buffer, which must have room for length + UbxOverhead bytes
+//      returns the framed length
+uint16_t ubx_frame (uint8_t * buffer, uint8_t messageClass, uint8_t messageId, const uint8_t * payload, uint16_t length) ;
+
+void ubx_initialize (void) ;
+
+
+#endif